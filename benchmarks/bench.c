@@ -0,0 +1,369 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * bench.c
+ * SurgeScript benchmark driver
+ */
+
+#include <surgescript.h>
+#include <locale.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/* where the benchmark scripts are located */
+#ifndef BENCHMARK_DIR
+#define BENCHMARK_DIR "benchmarks"
+#endif
+
+/* default settings */
+#define DEFAULT_RUNS 10
+#define DEFAULT_WARMUP 1
+#define DEFAULT_SEED 0x5EED
+#define MAX_FRAMES 100000 /* a safety net for scripts that never exit */
+
+/* the default benchmark suite */
+static const char* DEFAULT_SUITE[] = {
+    "dispatch.ss",
+    "calls.ss",
+    "properties.ss",
+    "strings.ss",
+    "array.ss",
+    "dictionary.ss",
+    "spawn.ss",
+    "gc.ss",
+    "tags.ss",
+    "entities.ss",
+    NULL
+};
+
+/* output formats */
+enum output_format_t { FORMAT_CSV, FORMAT_JSON };
+
+/* benchmark results, in milliseconds */
+typedef struct result_t result_t;
+struct result_t
+{
+    const char* name;
+    int runs;
+    int frames;
+    double min, max, mean;
+    double median, p90, p99;
+};
+
+static bool run_benchmark(const char* filepath, int runs, int warmup, uint64_t seed, result_t* result);
+static bool run_once(const char* filepath, uint64_t seed, double* elapsed_ms, int* frames);
+static void print_header(enum output_format_t format);
+static void print_result(enum output_format_t format, const result_t* result, bool first);
+static void print_footer(enum output_format_t format);
+static double percentile(const double* sorted, int n, double p);
+static int compare_doubles(const void* a, const void* b);
+static double now_ms();
+static void show_help(const char* executable);
+static void crash(const char* message);
+static void discard(const char* message);
+
+/*
+ * main()
+ * Entry point
+ */
+int main(int argc, char* argv[])
+{
+    enum output_format_t format = FORMAT_CSV;
+    int runs = DEFAULT_RUNS, warmup = DEFAULT_WARMUP;
+    uint64_t seed = DEFAULT_SEED;
+    bool first = true, success = true;
+    char filepath[4096];
+    int i;
+
+    /* SurgeScript uses UTF-8 */
+    setlocale(LC_ALL, "en_US.UTF-8");
+
+    /* be quiet */
+    surgescript_util_set_error_functions(discard, crash);
+
+    /* parse the command line options */
+    for(i = 1; i < argc && *argv[i] == '-'; i++) {
+        const char* arg = argv[i];
+        if(strcmp(arg, "--runs") == 0 || strcmp(arg, "-n") == 0) {
+            if(++i < argc)
+                runs = ssmax(1, atoi(argv[i]));
+        }
+        else if(strcmp(arg, "--warmup") == 0 || strcmp(arg, "-w") == 0) {
+            if(++i < argc)
+                warmup = ssmax(0, atoi(argv[i]));
+        }
+        else if(strcmp(arg, "--seed") == 0 || strcmp(arg, "-s") == 0) {
+            if(++i < argc)
+                seed = strtoull(argv[i], NULL, 0);
+        }
+        else if(strcmp(arg, "--json") == 0) {
+            format = FORMAT_JSON;
+        }
+        else if(strcmp(arg, "--csv") == 0) {
+            format = FORMAT_CSV;
+        }
+        else if(strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            show_help(surgescript_util_basename(argv[0]));
+            return 0;
+        }
+        else {
+            fprintf(stderr, "Unrecognized option: '%s'.\nType '%s --help' for more information.\n", arg, surgescript_util_basename(argv[0]));
+            return 1;
+        }
+    }
+
+    /* run the benchmarks */
+    print_header(format);
+    if(i < argc) {
+        /* user-specified scripts */
+        for(; i < argc; i++) {
+            result_t result;
+            if(run_benchmark(argv[i], runs, warmup, seed, &result)) {
+                print_result(format, &result, first);
+                first = false;
+            }
+            else
+                success = false;
+        }
+    }
+    else {
+        /* default suite */
+        for(const char** name = DEFAULT_SUITE; *name != NULL; name++) {
+            result_t result;
+            snprintf(filepath, sizeof(filepath), "%s/%s", BENCHMARK_DIR, *name);
+            if(run_benchmark(filepath, runs, warmup, seed, &result)) {
+                print_result(format, &result, first);
+                first = false;
+            }
+            else
+                success = false;
+        }
+    }
+    print_footer(format);
+
+    /* done! */
+    return success ? 0 : 1;
+}
+
+/*
+ * run_benchmark()
+ * Runs a benchmark script several times and computes statistics
+ */
+bool run_benchmark(const char* filepath, int runs, int warmup, uint64_t seed, result_t* result)
+{
+    double* sample = ssmalloc(runs * sizeof(*sample));
+    double sum = 0.0;
+    int frames = 0;
+
+    /* warm up */
+    for(int i = 0; i < warmup; i++) {
+        if(!run_once(filepath, seed, &sample[0], &frames)) {
+            ssfree(sample);
+            return false;
+        }
+    }
+
+    /* collect samples */
+    for(int i = 0; i < runs; i++) {
+        if(!run_once(filepath, seed, &sample[i], &frames)) {
+            ssfree(sample);
+            return false;
+        }
+        sum += sample[i];
+    }
+
+    /* compute statistics */
+    qsort(sample, runs, sizeof(*sample), compare_doubles);
+    result->name = surgescript_util_basename(filepath);
+    result->runs = runs;
+    result->frames = frames;
+    result->min = sample[0];
+    result->max = sample[runs - 1];
+    result->mean = sum / runs;
+    result->median = percentile(sample, runs, 50.0);
+    result->p90 = percentile(sample, runs, 90.0);
+    result->p99 = percentile(sample, runs, 99.0);
+
+    /* done */
+    ssfree(sample);
+    return true;
+}
+
+/*
+ * run_once()
+ * Runs a benchmark script once on a fresh VM, measuring
+ * the time spent from launch to exit (compilation is excluded)
+ */
+bool run_once(const char* filepath, uint64_t seed, double* elapsed_ms, int* frames)
+{
+    surgescript_vm_t* vm = surgescript_vm_create();
+    double start_time;
+    int count = 0;
+
+    /* compile */
+    if(!surgescript_vm_compile(vm, filepath)) {
+        fprintf(stderr, "Can't compile benchmark \"%s\"\n", filepath);
+        surgescript_vm_destroy(vm);
+        return false;
+    }
+
+    /* make the runs reproducible */
+    surgescript_util_srand(seed);
+
+    /* run */
+    start_time = now_ms();
+    surgescript_vm_launch(vm);
+    while(surgescript_vm_update(vm) && ++count < MAX_FRAMES);
+    *elapsed_ms = now_ms() - start_time;
+    *frames = count;
+
+    /* done */
+    surgescript_vm_destroy(vm);
+    return true;
+}
+
+/*
+ * print_header()
+ * Prints the header of the report
+ */
+void print_header(enum output_format_t format)
+{
+    if(format == FORMAT_JSON)
+        printf("{\n  \"version\": \"%s\",\n  \"unit\": \"ms\",\n  \"benchmarks\": [", surgescript_util_version());
+    else
+        printf("benchmark,runs,frames,min_ms,median_ms,p90_ms,p99_ms,max_ms,mean_ms\n");
+}
+
+/*
+ * print_result()
+ * Prints the results of a benchmark
+ */
+void print_result(enum output_format_t format, const result_t* result, bool first)
+{
+    if(format == FORMAT_JSON) {
+        printf("%s\n    { \"benchmark\": \"%s\", \"runs\": %d, \"frames\": %d, \"min\": %.4f, \"median\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f }",
+            first ? "" : ",",
+            result->name, result->runs, result->frames,
+            result->min, result->median, result->p90, result->p99, result->max, result->mean
+        );
+    }
+    else {
+        printf("%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+            result->name, result->runs, result->frames,
+            result->min, result->median, result->p90, result->p99, result->max, result->mean
+        );
+    }
+
+    fflush(stdout);
+}
+
+/*
+ * print_footer()
+ * Prints the footer of the report
+ */
+void print_footer(enum output_format_t format)
+{
+    if(format == FORMAT_JSON)
+        printf("\n  ]\n}\n");
+}
+
+/*
+ * percentile()
+ * Computes the p-th percentile of a sorted sample using linear interpolation
+ */
+double percentile(const double* sorted, int n, double p)
+{
+    double rank = (p / 100.0) * (n - 1);
+    int lo = (int)rank, hi = ssmin(lo + 1, n - 1);
+    return sorted[lo] + (rank - lo) * (sorted[hi] - sorted[lo]);
+}
+
+/*
+ * compare_doubles()
+ * Comparison function for qsort()
+ */
+int compare_doubles(const void* a, const void* b)
+{
+    double x = *((const double*)a), y = *((const double*)b);
+    return (x > y) - (x < y);
+}
+
+/*
+ * now_ms()
+ * A high resolution monotonic timer, given in milliseconds. The wall clock
+ * is used only where a monotonic clock isn't available, since it may be
+ * adjusted (e.g., by NTP) while the benchmarks run
+ */
+double now_ms()
+{
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * show_help()
+ * Shows a help message
+ */
+void show_help(const char* executable)
+{
+    printf(
+        "SurgeScript benchmark driver, version %s\n"
+        "\n"
+        "Usage: %s [OPTIONS] [<scripts>]\n"
+        "Runs the given benchmark scripts (or the default suite) and reports timing statistics.\n"
+        "\n"
+        "Options:\n"
+        "    -n, --runs <count>                    number of measured runs per script (default: %d)\n"
+        "    -w, --warmup <count>                  number of unmeasured runs per script (default: %d)\n"
+        "    -s, --seed <number>                   seed of the pseudo-random number generator\n"
+        "    --csv                                 outputs CSV (default)\n"
+        "    --json                                outputs JSON\n"
+        "    -h, --help                            shows this message\n"
+        "\n"
+        "The default suite is read from: %s\n",
+        surgescript_util_version(),
+        executable,
+        DEFAULT_RUNS,
+        DEFAULT_WARMUP,
+        BENCHMARK_DIR
+    );
+}
+
+/*
+ * crash()
+ * Prints a message to the standard error stream and exits the application
+ */
+void crash(const char* message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+/*
+ * discard()
+ * Discards a message
+ */
+void discard(const char* message)
+{
+    ;
+}
@@ -0,0 +1,31 @@
+# ------------------------------------
+# Cross-compiling for AArch64 Linux
+# ------------------------------------
+# Use the commands below to build SurgeScript for 64-bit ARM Linux and to run
+# the tests with QEMU (user mode emulation):
+#
+#     mkdir build && cd build
+#     cmake .. \
+#         -DCMAKE_TOOLCHAIN_FILE=../cmake/toolchain-aarch64.cmake
+#     make && ctest
+#
+# On Debian/Ubuntu, install gcc-aarch64-linux-gnu and qemu-user first.
+# This is for cross-compiling only.
+
+# Set the system name
+set(CMAKE_SYSTEM_NAME Linux)
+
+# Set the target architecture
+set(CMAKE_SYSTEM_PROCESSOR aarch64)
+
+# Set the location of the C compiler and of the target environment
+set(CMAKE_C_COMPILER aarch64-linux-gnu-gcc)
+set(CMAKE_FIND_ROOT_PATH /usr/aarch64-linux-gnu)
+
+# Run the executables of the tests with QEMU
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-aarch64 -L /usr/aarch64-linux-gnu)
+
+# Other settings
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
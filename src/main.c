@@ -38,6 +38,7 @@
 static surgescript_vm_t* make_vm(int argc, char** argv, int* time_limit);
 static void run_vm(surgescript_vm_t* vm, int time_limit);
 static void destroy_vm(surgescript_vm_t* vm);
+static void translate_vm(surgescript_vm_t* vm, const char* filename);
 static void print(const char* message);
 static void crash(const char* message);
 static void discard(const char* message);
@@ -160,6 +161,23 @@ void destroy_vm(surgescript_vm_t* vm)
     surgescript_vm_destroy(vm);
 }
 
+/*
+ * translate_vm()
+ * Translates the compiled scripts to C
+ */
+void translate_vm(surgescript_vm_t* vm, const char* filename)
+{
+    FILE* fp = fopen(filename, "w");
+
+    if(fp == NULL) {
+        fprintf(stderr, "Can't open \"%s\" for writing.\n", filename);
+        return;
+    }
+
+    surgescript_aot_translate(surgescript_vm_programpool(vm), fp, "surgescript_aot_register");
+    fclose(fp);
+}
+
 #if ENABLE_THREADS
 
 /*
@@ -208,6 +226,7 @@ bool timeout(time_t limit)
 surgescript_vm_t* make_vm(int argc, char** argv, int* time_limit)
 {
     surgescript_vm_t* vm = NULL;
+    const char* aot_filename = NULL;
     int i;
 
     /* disable debugging */
@@ -237,6 +256,11 @@ surgescript_vm_t* make_vm(int argc, char** argv, int* time_limit)
                 *time_limit = (seconds > 0) ? seconds : INT_MAX;
             }
         }
+        else if(strcmp(arg, "--aot") == 0 || strcmp(arg, "-a") == 0) {
+            /* translate the scripts to C instead of running them */
+            if(++i < argc)
+                aot_filename = argv[i];
+        }
         else if(strcmp(arg, "--") == 0) {
             /* user-specific command line arguments */
             break;
@@ -268,6 +292,13 @@ surgescript_vm_t* make_vm(int argc, char** argv, int* time_limit)
         ssfree(code);
     }
 
+    /* ahead-of-time compilation */
+    if(aot_filename != NULL) {
+        translate_vm(vm, aot_filename);
+        destroy_vm(vm);
+        return NULL;
+    }
+
     /* launch the VM */
     if(i < argc && strcmp(argv[i], "--") == 0) {
         /* launch with user-specific command line arguments */
@@ -301,6 +332,7 @@ void show_help(const char* executable)
         "    -v, --version                         shows the version of SurgeScript\n"
         "    -D, --debug                           prints debugging information\n"
         "    -t, --timelimit                       sets a maximum execution time, in seconds (0 = no limit)\n"
+        "    -a, --aot <file.c>                    translates the scripts to C instead of running them\n"
         "    -h, --help                            shows this message\n"
         "\n"
         "Examples:\n"
@@ -309,6 +341,7 @@ void show_help(const char* executable)
         "    %s --debug test.ss           compiles and runs test.ss with debugging information\n"
         "    %s file.ss -- -x -y          passes custom arguments -x and -y to file.ss\n"
         "    %s -t 5                      runs a script read from stdin, with a time limit of 5 seconds\n"
+        "    %s --aot game.c game.ss      translates game.ss to C; call surgescript_aot_register(vm) in your host\n"
         "\n"
         "Full documentation available at: <%s>\n",
         surgescript_util_version(),
@@ -321,6 +354,7 @@ void show_help(const char* executable)
         executable,
         executable,
         executable,
+        executable,
         surgescript_util_website()
     );
 }
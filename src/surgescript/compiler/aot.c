@@ -0,0 +1,879 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/aot.c
+ * SurgeScript Compiler: ahead-of-time translation of bytecode to C
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "aot.h"
+#include "../runtime/program.h"
+#include "../runtime/program_pool.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+/*
+ * Each program becomes a C function that replaces the interpreter loop. Simple
+ * instructions are translated to calls to the public API of the runtime, and
+ * jumps become gotos. Complex instructions (calls, states, heap operations...)
+ * are delegated to the interpreter with surgescript_program_run_line(). If the
+ * interpreter returns an unexpected line, we jump to it via a dispatch table.
+ *
+ * Within a basic block, values known to be numbers are kept in plain double
+ * locals, local variables are read from the stack only when they are used,
+ * and values pushed & popped within the block never reach the stack. The
+ * temps t[0..3] are updated only where a liveness analysis says they are
+ * read later on: at the end of the block, or before the interpreter runs.
+ */
+
+/* a program of the pool */
+typedef struct aotentry_t aotentry_t;
+struct aotentry_t
+{
+    char* object_name;
+    char* program_name;
+};
+
+/* the programs to be translated */
+typedef struct aotlist_t aotlist_t;
+struct aotlist_t
+{
+    surgescript_programpool_t* program_pool;
+    const char* object_name;
+    SSARRAY(aotentry_t, entry);
+};
+
+static void collect_object(const char* object_name, void* data);
+static void collect_program(const char* program_name, void* data);
+/* where a value is while translating a basic block */
+typedef enum aotwhere_t aotwhere_t;
+enum aotwhere_t
+{
+    IN_VAR,         /* in the variable t[k] */
+    IN_NUMBER,      /* in a double dN */
+    IN_RAWBITS,     /* in an int64_t rN */
+    IN_STACK        /* in the local variable stack[base + N], not yet read */
+};
+
+/* the value of a temp or of a value pushed onto the stack */
+typedef struct aotvalue_t aotvalue_t;
+struct aotvalue_t
+{
+    aotwhere_t where;
+    int id; /* N */
+    bool var_ok; /* is t[k] up-to-date? (temps only) */
+};
+
+/* the state of the translation of a program */
+typedef struct aotstate_t aotstate_t;
+struct aotstate_t
+{
+    surgescript_program_t* program;
+    FILE* fp;
+    int num_lines;
+    bool* target; /* target[line] is true if we may jump to line */
+    unsigned* live; /* live[line] is the set of temps that may be read from line on */
+    aotvalue_t temp[4]; /* the values of the temps */
+    aotvalue_t pushed[16]; /* values pushed onto the stack within the block */
+    int num_pushed;
+    int counter; /* used to name the C locals */
+};
+
+#define ALL_TEMPS 0xF
+#define RETURN_TEMPS 0x1 /* t[0] holds the return value */
+#define TEMP(k) (1u << ((k).u & 3))
+
+static void translate_program(surgescript_program_t* program, int id, FILE* fp);
+static void translate_line(aotstate_t* state, int line);
+static void analyze_liveness(aotstate_t* state);
+static unsigned used_temps(surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b);
+static unsigned defined_temps(surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b);
+static const char* read_number(aotstate_t* state, int k, bool proven, char* buf);
+static const char* read_rawbits(aotstate_t* state, int k, char* buf);
+static void write_number(aotstate_t* state, int k, const char* expr);
+static void write_rawbits(aotstate_t* state, int k, const char* expr);
+static void written_var(aotstate_t* state, int k);
+static void materialize(aotstate_t* state, int k);
+static void flush_pushed(aotstate_t* state);
+static void sync(aotstate_t* state, unsigned temps);
+static void reset(aotstate_t* state);
+static void forget_stack_cell(aotstate_t* state, int offset, unsigned live_temps);
+static void fputs_cstring(const char* str, FILE* fp);
+static inline bool is_conditional_jump(surgescript_program_operator_t instruction);
+static inline const char* jump_condition(surgescript_program_operator_t instruction);
+
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_aot_translate()
+ * Translates all programs of the pool written in SurgeScript to C,
+ * writing the generated code to fp. Returns the number of translated programs
+ */
+int surgescript_aot_translate(surgescript_programpool_t* program_pool, FILE* fp, const char* register_function_name)
+{
+    aotlist_t list = { .program_pool = program_pool, .object_name = NULL };
+    int count = 0;
+
+    /* find the programs */
+    ssarray_init(list.entry);
+    surgescript_programpool_foreach_object_ex(program_pool, &list, collect_object);
+
+    /* header */
+    fprintf(fp,
+        "/*\n"
+        " * Ahead-of-time compiled SurgeScript code\n"
+        " * Generated by SurgeScript %s. Do not edit.\n"
+        " *\n"
+        " * Compile the same scripts, call %s(vm) and then launch the VM.\n"
+        " * Programs whose code has changed since the translation are interpreted.\n"
+        " */\n"
+        "\n"
+        "#include <stdint.h>\n"
+        "#include <string.h>\n"
+        "#include <math.h>\n"
+        "#include <surgescript.h>\n"
+        "\n"
+        "static inline double aot_number(uint64_t bits) { double x; memcpy(&x, &bits, sizeof(x)); return x; }\n"
+        "static inline int64_t aot_compare(double x, double y) { return isgreater(x, y) - isless(x, y); }\n"
+        "static inline void aot_poke_number(surgescript_stack_t* stack, int offset, double x) { surgescript_var_set_number((surgescript_var_t*)surgescript_stack_peek(stack, offset), x); }\n",
+        surgescript_util_version(),
+        register_function_name
+    );
+
+    /* one function per program */
+    for(int i = 0; i < ssarray_length(list.entry); i++) {
+        surgescript_program_t* program = surgescript_programpool_get(program_pool, list.entry[i].object_name, list.entry[i].program_name);
+        translate_program(program, i, fp);
+    }
+
+    /* registration function */
+    fprintf(fp, "\nvoid %s(surgescript_vm_t* vm)\n{\n", register_function_name);
+    for(int i = 0; i < ssarray_length(list.entry); i++) {
+        surgescript_program_t* program = surgescript_programpool_get(program_pool, list.entry[i].object_name, list.entry[i].program_name);
+
+        fputs("    surgescript_vm_bind_aot(vm, ", fp);
+        fputs_cstring(list.entry[i].object_name, fp);
+        fputs(", ", fp);
+        fputs_cstring(list.entry[i].program_name, fp);
+        fprintf(fp, ", aot_%d, UINT64_C(0x%016" PRIX64 "));\n", i, surgescript_program_fingerprint(program));
+        count++;
+    }
+    fputs("}\n", fp);
+
+    /* done */
+    for(int i = 0; i < ssarray_length(list.entry); i++) {
+        ssfree(list.entry[i].program_name);
+        ssfree(list.entry[i].object_name);
+    }
+    ssarray_release(list.entry);
+    return count;
+}
+
+
+
+/* -------------------------------
+ * private stuff
+ * ------------------------------- */
+
+/* collects the programs of an object */
+void collect_object(const char* object_name, void* data)
+{
+    aotlist_t* list = (aotlist_t*)data;
+    list->object_name = object_name;
+    surgescript_programpool_foreach_ex(list->program_pool, object_name, data, collect_program);
+}
+
+/* collects a program written in SurgeScript */
+void collect_program(const char* program_name, void* data)
+{
+    aotlist_t* list = (aotlist_t*)data;
+    surgescript_program_t* program = surgescript_programpool_get(list->program_pool, list->object_name, program_name);
+
+    if(program != NULL && !surgescript_program_is_native(program)) {
+        aotentry_t entry = {
+            .object_name = ssstrdup(list->object_name),
+            .program_name = ssstrdup(program_name)
+        };
+        ssarray_push(list->entry, entry);
+    }
+}
+
+/* translates a program to a C function named aot_<id> */
+void translate_program(surgescript_program_t* program, int id, FILE* fp)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    aotstate_t state = { .program = program, .fp = fp };
+    int n, line;
+
+    /* resolve the labels */
+    surgescript_program_fingerprint(program);
+    n = state.num_lines = surgescript_program_count_lines(program);
+
+    /* find the lines we may jump to */
+    state.target = ssmalloc((n + 1) * sizeof(*state.target));
+    memset(state.target, 0, (n + 1) * sizeof(*state.target));
+    state.target[0] = true;
+    for(line = 0; line < n; line++) {
+        surgescript_program_read_line(program, line, &op, &a, &b);
+        if(op == SSOP_JMP || is_conditional_jump(op) || op == SSOP_ITER || op == SSOP_NEXT)
+            state.target[ssmin(a.u, (unsigned)n)] = true;
+        if(op == SSOP_NEXT)
+            state.target[ssmin(b.u, (unsigned)n)] = true;
+    }
+    state.target[n] = false;
+
+    /* find the temps that are read later on */
+    state.live = ssmalloc((n + 1) * sizeof(*state.live));
+    analyze_liveness(&state);
+
+    /* function header */
+    fprintf(fp, "\nstatic void aot_%d(surgescript_program_t* program, const surgescript_renv_t* renv)\n{\n", id);
+    fputs("    surgescript_var_t** t = surgescript_renv_tmp(renv);\n", fp);
+    fputs("    surgescript_stack_t* stack = surgescript_renv_stack(renv);\n", fp);
+    fputs("    unsigned ip = 0;\n\n", fp);
+    fputs("    (void)t; (void)stack;\n\n", fp);
+
+    /* dispatch table */
+    fputs("dispatch:\n    switch(ip) {\n", fp);
+    for(line = 0; line < n; line++) {
+        if(state.target[line])
+            fprintf(fp, "        case %d: goto L%d;\n", line, line);
+    }
+    fprintf(fp, "        default: if(ip >= %d) return; ip = surgescript_program_run_line(program, renv, ip); goto dispatch;\n", n);
+    fputs("    }\n\n", fp);
+
+    /* code */
+    reset(&state);
+    for(line = 0; line < n; line++) {
+        if(state.target[line]) {
+            /* all values are in the temps when entering a block */
+            sync(&state, state.live[line]);
+            fprintf(fp, "L%d: ;\n", line);
+            reset(&state);
+        }
+
+        translate_line(&state, line);
+    }
+
+    sync(&state, RETURN_TEMPS);
+    fputs("    return;\n}\n", fp);
+
+    ssfree(state.live);
+    ssfree(state.target);
+}
+
+/* translates a line of code */
+void translate_line(aotstate_t* state, int line)
+{
+    #define t(k) ((k).u & 3)
+
+    FILE* fp = state->fp;
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    unsigned n = state->num_lines;
+    char x[64], y[64], expr[256];
+
+    surgescript_program_read_line(state->program, line, &op, &a, &b);
+    op = surgescript_program_unfused_operator(op); /* only the first instruction of a superinstruction; the others follow it */
+    switch(op) {
+        case SSOP_NOP:
+            break;
+
+        case SSOP_MOVN:
+            fprintf(fp, "    surgescript_var_set_null(t[%u]);\n", t(a));
+            written_var(state, t(a));
+            break;
+
+        case SSOP_MOVB:
+            fprintf(fp, "    surgescript_var_set_bool(t[%u], %s);\n", t(a), b.b ? "true" : "false");
+            written_var(state, t(a));
+            break;
+
+        case SSOP_MOVF:
+            snprintf(expr, sizeof(expr), "aot_number(UINT64_C(0x%016" PRIX64 "))", b.u64);
+            write_number(state, t(a), expr);
+            break;
+
+        case SSOP_MOVS:
+            if(b.u < surgescript_program_text_count(state->program)) {
+                fprintf(fp, "    surgescript_var_set_string(t[%u], surgescript_program_get_text(program, %u));\n", t(a), b.u);
+                written_var(state, t(a));
+            }
+            break;
+
+        case SSOP_MOVO:
+            fprintf(fp, "    surgescript_var_set_objecthandle(t[%u], %uu);\n", t(a), b.u);
+            written_var(state, t(a));
+            break;
+
+        case SSOP_MOVX:
+            fprintf(fp, "    surgescript_var_set_rawbits(t[%u], (int64_t)UINT64_C(0x%016" PRIX64 "));\n", t(a), b.u64);
+            written_var(state, t(a));
+            break;
+
+        case SSOP_MOV:
+            if(t(a) == t(b))
+                break;
+            else if(state->temp[t(b)].where != IN_VAR) {
+                state->temp[t(a)] = state->temp[t(b)];
+                state->temp[t(a)].var_ok = false;
+            }
+            else {
+                fprintf(fp, "    surgescript_var_copy(t[%u], t[%u]);\n", t(a), t(b));
+                written_var(state, t(a));
+            }
+            break;
+
+        case SSOP_XCHG: {
+            /* the values that are not up-to-date in the temps are swapped as well */
+            aotvalue_t tmp = state->temp[t(a)];
+            if(state->temp[t(a)].var_ok || state->temp[t(b)].var_ok)
+                fprintf(fp, "    surgescript_var_swap(t[%u], t[%u]);\n", t(a), t(b));
+            state->temp[t(a)] = state->temp[t(b)];
+            state->temp[t(b)] = tmp;
+            break;
+        }
+
+        case SSOP_PUSH: {
+            aotvalue_t value = state->temp[t(a)];
+            if((value.where == IN_NUMBER || value.where == IN_STACK) && state->num_pushed < (int)(sizeof(state->pushed) / sizeof(*state->pushed))) {
+                /* the value stays in a C local until it's popped */
+                value.var_ok = false;
+                state->pushed[state->num_pushed++] = value;
+            }
+            else {
+                materialize(state, t(a));
+                flush_pushed(state);
+                fprintf(fp, "    surgescript_stack_push(stack, surgescript_var_clone(t[%u]));\n", t(a));
+            }
+            break;
+        }
+
+        case SSOP_POP:
+            if(state->num_pushed > 0)
+                state->temp[t(a)] = state->pushed[--state->num_pushed];
+            else {
+                fprintf(fp, "    surgescript_var_copy(t[%u], surgescript_stack_top(stack));\n", t(a));
+                fputs("    surgescript_stack_pop(stack);\n", fp);
+                written_var(state, t(a));
+            }
+            break;
+
+        case SSOP_SPEEK:
+            /* local variables are read when they are used */
+            state->temp[t(a)].where = IN_STACK;
+            state->temp[t(a)].id = b.i;
+            state->temp[t(a)].var_ok = false;
+            break;
+
+        case SSOP_SPOKE: {
+            aotvalue_t value = state->temp[t(a)];
+            forget_stack_cell(state, b.i, state->live[line]);
+            if(value.where == IN_NUMBER)
+                fprintf(fp, "    aot_poke_number(stack, %d, d%d);\n", b.i, value.id);
+            else if(value.where == IN_STACK && !value.var_ok)
+                fprintf(fp, "    surgescript_stack_poke(stack, %d, surgescript_stack_peek(stack, %d));\n", b.i, value.id);
+            else {
+                materialize(state, t(a));
+                fprintf(fp, "    surgescript_stack_poke(stack, %d, t[%u]);\n", b.i, t(a));
+            }
+            break;
+        }
+
+        case SSOP_PUSHN:
+            flush_pushed(state);
+            fprintf(fp, "    surgescript_stack_pushn(stack, %u);\n", a.u);
+            break;
+
+        case SSOP_POPN: {
+            /* discard the values that never reached the stack */
+            unsigned m = ssmin(a.u, (unsigned)state->num_pushed);
+            state->num_pushed -= m;
+            if(a.u > m)
+                fprintf(fp, "    surgescript_stack_popn(stack, %u);\n", a.u - m);
+            break;
+        }
+
+        case SSOP_INC:
+        case SSOP_DEC:
+            if(a.u != 2) {
+                snprintf(expr, sizeof(expr), "%s %c 1", read_number(state, t(a), false, x), op == SSOP_INC ? '+' : '-');
+                write_number(state, t(a), expr);
+            }
+            else {
+                snprintf(expr, sizeof(expr), "%s %c 1", read_rawbits(state, t(a), x), op == SSOP_INC ? '+' : '-');
+                write_rawbits(state, t(a), expr);
+            }
+            break;
+
+        case SSOP_ADD:
+        case SSOP_SUB:
+        case SSOP_MUL:
+        case SSOP_DIV:
+        case SSOP_FADD:
+        case SSOP_FSUB:
+        case SSOP_FMUL:
+        case SSOP_FDIV: {
+            /* the operands of the F-instructions are known to be numbers */
+            bool proven = (op == SSOP_FADD || op == SSOP_FSUB || op == SSOP_FMUL || op == SSOP_FDIV);
+            char c = (op == SSOP_ADD || op == SSOP_FADD) ? '+' : ((op == SSOP_SUB || op == SSOP_FSUB) ? '-' : ((op == SSOP_MUL || op == SSOP_FMUL) ? '*' : '/'));
+            read_number(state, t(a), proven, x);
+            read_number(state, t(b), proven, y);
+            snprintf(expr, sizeof(expr), "%s %c %s", x, c, y);
+            write_number(state, t(a), expr);
+            break;
+        }
+
+        case SSOP_REM:
+            read_number(state, t(a), false, x);
+            read_number(state, t(b), false, y);
+            snprintf(expr, sizeof(expr), "fmod(%s, %s)", x, y);
+            write_number(state, t(a), expr);
+            break;
+
+        case SSOP_NEG:
+            snprintf(expr, sizeof(expr), "-%s", read_number(state, t(b), false, x));
+            write_number(state, t(a), expr);
+            break;
+
+        case SSOP_LNOT:
+        case SSOP_LNOT2:
+            materialize(state, t(b));
+            fprintf(fp, "    surgescript_var_set_bool(t[%u], %ssurgescript_var_get_bool(t[%u]));\n", t(a), op == SSOP_LNOT ? "!" : "", t(b));
+            written_var(state, t(a));
+            break;
+
+        case SSOP_NOT:
+            snprintf(expr, sizeof(expr), "~%s", read_rawbits(state, t(b), x));
+            write_rawbits(state, t(a), expr);
+            break;
+
+        case SSOP_AND:
+        case SSOP_OR:
+        case SSOP_XOR: {
+            char c = (op == SSOP_AND) ? '&' : ((op == SSOP_OR) ? '|' : '^');
+            read_rawbits(state, t(a), x);
+            read_rawbits(state, t(b), y);
+            snprintf(expr, sizeof(expr), "%s %c %s", x, c, y);
+            write_rawbits(state, t(a), expr);
+            break;
+        }
+
+        case SSOP_TEST:
+            if(a.u64 == b.u64)
+                snprintf(expr, sizeof(expr), "%s", read_rawbits(state, t(a), x));
+            else
+                snprintf(expr, sizeof(expr), "%s & %s", read_rawbits(state, t(a), x), read_rawbits(state, t(b), y));
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_TCHK:
+            materialize(state, t(a));
+            snprintf(expr, sizeof(expr), "surgescript_var_typecheck(t[%u], %d)", t(a), b.i);
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_TC01:
+            materialize(state, 0);
+            materialize(state, 1);
+            snprintf(expr, sizeof(expr), "surgescript_var_typecheck(t[0], %d) & surgescript_var_typecheck(t[1], %d)", a.i, a.i);
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_TCMP:
+            materialize(state, t(a));
+            materialize(state, t(b));
+            snprintf(expr, sizeof(expr), "surgescript_var_typecode(t[%u]) ^ surgescript_var_typecode(t[%u])", t(a), t(b));
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_CMP:
+            materialize(state, t(a));
+            materialize(state, t(b));
+            snprintf(expr, sizeof(expr), "surgescript_var_compare(t[%u], t[%u])", t(a), t(b));
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_FCMP:
+            read_number(state, t(a), true, x);
+            read_number(state, t(b), true, y);
+            snprintf(expr, sizeof(expr), "aot_compare(%s, %s)", x, y);
+            write_rawbits(state, 2, expr);
+            break;
+
+        case SSOP_JMP:
+            if(a.u < n) {
+                sync(state, state->live[a.u]);
+                fprintf(fp, "    goto L%u;\n", a.u);
+            }
+            else {
+                sync(state, RETURN_TEMPS);
+                fputs("    return;\n", fp);
+            }
+            break;
+
+        case SSOP_JE:
+        case SSOP_JNE:
+        case SSOP_JG:
+        case SSOP_JGE:
+        case SSOP_JL:
+        case SSOP_JLE:
+            read_rawbits(state, 2, x);
+            sync(state, a.u < n ? state->live[a.u] : RETURN_TEMPS);
+            if(a.u < n)
+                fprintf(fp, "    if(%s %s) goto L%u;\n", x, jump_condition(op), a.u);
+            else
+                fprintf(fp, "    if(%s %s) return;\n", x, jump_condition(op));
+            break;
+
+        case SSOP_RET:
+            sync(state, RETURN_TEMPS);
+            fputs("    return;\n", fp);
+            break;
+
+        case SSOP_CALL:
+        case SSOP_OPTCALL:
+            /* the interpreter handles the inline cache of the call site */
+            sync(state, state->live[line]);
+            fprintf(fp, "    if((ip = surgescript_program_run_line(program, renv, %d)) != %d) goto dispatch;\n", line, line + 1);
+            reset(state);
+            break;
+
+        case SSOP_ITER:
+        case SSOP_NEXT:
+            sync(state, state->live[line]);
+            fprintf(fp, "    ip = surgescript_program_run_line(program, renv, %d);\n", line);
+            if(a.u < n)
+                fprintf(fp, "    if(ip == %u) goto L%u;\n", a.u, a.u);
+            if(op == SSOP_NEXT && b.u < n)
+                fprintf(fp, "    if(ip == %u) goto L%u;\n", b.u, b.u);
+            fprintf(fp, "    if(ip != %d) goto dispatch;\n", line + 1);
+            reset(state);
+            break;
+
+        default:
+            /* let the interpreter run the other instructions */
+            sync(state, state->live[line]);
+            fprintf(fp, "    if((ip = surgescript_program_run_line(program, renv, %d)) != %d) goto dispatch;\n", line, line + 1);
+            reset(state);
+            break;
+    }
+
+    #undef t
+}
+
+/* computes the set of temps that may be read from each line on */
+void analyze_liveness(aotstate_t* state)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    int n = state->num_lines;
+    bool changed = true;
+
+    /* the return value is read by the caller */
+    for(int line = 0; line <= n; line++)
+        state->live[line] = 0;
+    state->live[n] = RETURN_TEMPS;
+
+    /* iterate until a fixed point is reached */
+    while(changed) {
+        changed = false;
+        for(int line = n - 1; line >= 0; line--) {
+            unsigned out = 0, in;
+
+            surgescript_program_read_line(state->program, line, &op, &a, &b);
+            op = surgescript_program_unfused_operator(op);
+
+            if(op == SSOP_JMP)
+                out = state->live[ssmin(a.u, (unsigned)n)];
+            else if(is_conditional_jump(op))
+                out = state->live[ssmin(a.u, (unsigned)n)] | state->live[line + 1];
+            else if(op == SSOP_RET)
+                out = RETURN_TEMPS;
+            else
+                out = state->live[line + 1];
+
+            in = used_temps(op, a, b) | (out & ~defined_temps(op, a, b));
+            if(in != state->live[line]) {
+                state->live[line] = in;
+                changed = true;
+            }
+        }
+    }
+}
+
+/* the temps read by an instruction */
+unsigned used_temps(surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
+{
+    switch(op) {
+        case SSOP_NOP: case SSOP_MOVN: case SSOP_MOVB: case SSOP_MOVF: case SSOP_MOVS:
+        case SSOP_MOVO: case SSOP_MOVX: case SSOP_POP: case SSOP_SPEEK:
+        case SSOP_PUSHN: case SSOP_POPN: case SSOP_JMP:
+            return 0;
+
+        case SSOP_MOV: case SSOP_NEG: case SSOP_LNOT: case SSOP_LNOT2: case SSOP_NOT:
+            return TEMP(b);
+
+        case SSOP_PUSH: case SSOP_SPOKE: case SSOP_INC: case SSOP_DEC: case SSOP_TCHK:
+            return TEMP(a);
+
+        case SSOP_XCHG: case SSOP_ADD: case SSOP_SUB: case SSOP_MUL: case SSOP_DIV:
+        case SSOP_FADD: case SSOP_FSUB: case SSOP_FMUL: case SSOP_FDIV: case SSOP_REM:
+        case SSOP_AND: case SSOP_OR: case SSOP_XOR:
+        case SSOP_TEST: case SSOP_TCMP: case SSOP_CMP: case SSOP_FCMP:
+            return TEMP(a) | TEMP(b);
+
+        case SSOP_TC01:
+            return 0x3;
+
+        case SSOP_RET:
+            return RETURN_TEMPS;
+
+        case SSOP_CALL: case SSOP_OPTCALL: case SSOP_MATH:
+            /* the arguments are on the stack and the callee shares the temps */
+            return 0;
+
+        case SSOP_JE: case SSOP_JNE: case SSOP_JG: case SSOP_JGE: case SSOP_JL: case SSOP_JLE:
+            return 0x4;
+
+        default:
+            /* the interpreter may read any temp */
+            return ALL_TEMPS;
+    }
+}
+
+/* the temps overwritten by an instruction */
+unsigned defined_temps(surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
+{
+    switch(op) {
+        case SSOP_MOVN: case SSOP_MOVB: case SSOP_MOVF: case SSOP_MOVS: case SSOP_MOVO: case SSOP_MOVX:
+        case SSOP_MOV: case SSOP_POP: case SSOP_SPEEK: case SSOP_INC: case SSOP_DEC:
+        case SSOP_ADD: case SSOP_SUB: case SSOP_MUL: case SSOP_DIV:
+        case SSOP_FADD: case SSOP_FSUB: case SSOP_FMUL: case SSOP_FDIV: case SSOP_REM:
+        case SSOP_NEG: case SSOP_LNOT: case SSOP_LNOT2: case SSOP_NOT:
+        case SSOP_AND: case SSOP_OR: case SSOP_XOR:
+            return TEMP(a);
+
+        case SSOP_XCHG:
+            return TEMP(a) | TEMP(b);
+
+        case SSOP_TEST: case SSOP_TCHK: case SSOP_TC01: case SSOP_TCMP: case SSOP_CMP: case SSOP_FCMP:
+            return 0x4;
+
+        default:
+            return 0;
+    }
+}
+
+/* an expression with the numeric value of temp k; proven is true if the value is known to be a number */
+const char* read_number(aotstate_t* state, int k, bool proven, char* buf)
+{
+    aotvalue_t* value = &state->temp[k];
+
+    if(value->where == IN_NUMBER) {
+        sprintf(buf, "d%d", value->id);
+        return buf;
+    }
+    else if(!proven) {
+        if(value->where == IN_STACK && !value->var_ok)
+            sprintf(buf, "surgescript_var_get_number(surgescript_stack_peek(stack, %d))", value->id);
+        else {
+            materialize(state, k);
+            sprintf(buf, "surgescript_var_get_number(t[%d])", k);
+        }
+        return buf;
+    }
+
+    /* read the number once */
+    if(value->where == IN_STACK && !value->var_ok)
+        fprintf(state->fp, "    double d%d = surgescript_var_fast_get_number(surgescript_stack_peek(stack, %d));\n", state->counter, value->id);
+    else {
+        materialize(state, k);
+        fprintf(state->fp, "    double d%d = surgescript_var_fast_get_number(t[%d]);\n", state->counter, k);
+    }
+
+    value->where = IN_NUMBER;
+    value->id = state->counter++;
+    sprintf(buf, "d%d", value->id);
+    return buf;
+}
+
+/* an expression with the raw bits of temp k */
+const char* read_rawbits(aotstate_t* state, int k, char* buf)
+{
+    aotvalue_t* value = &state->temp[k];
+
+    if(value->where == IN_RAWBITS)
+        sprintf(buf, "r%d", value->id);
+    else {
+        materialize(state, k);
+        sprintf(buf, "surgescript_var_get_rawbits(t[%d])", k);
+    }
+
+    return buf;
+}
+
+/* temp k is set to a number */
+void write_number(aotstate_t* state, int k, const char* expr)
+{
+    fprintf(state->fp, "    double d%d = %s;\n", state->counter, expr);
+    state->temp[k].where = IN_NUMBER;
+    state->temp[k].id = state->counter++;
+    state->temp[k].var_ok = false;
+}
+
+/* temp k is set to raw bits */
+void write_rawbits(aotstate_t* state, int k, const char* expr)
+{
+    fprintf(state->fp, "    int64_t r%d = %s;\n", state->counter, expr);
+    state->temp[k].where = IN_RAWBITS;
+    state->temp[k].id = state->counter++;
+    state->temp[k].var_ok = false;
+}
+
+/* the variable t[k] has been written */
+void written_var(aotstate_t* state, int k)
+{
+    state->temp[k].where = IN_VAR;
+    state->temp[k].var_ok = true;
+}
+
+/* updates the variable t[k] */
+void materialize(aotstate_t* state, int k)
+{
+    aotvalue_t* value = &state->temp[k];
+
+    if(value->var_ok)
+        return;
+
+    switch(value->where) {
+        case IN_NUMBER:
+            fprintf(state->fp, "    surgescript_var_set_number(t[%d], d%d);\n", k, value->id);
+            break;
+
+        case IN_RAWBITS:
+            fprintf(state->fp, "    surgescript_var_set_rawbits(t[%d], r%d);\n", k, value->id);
+            break;
+
+        case IN_STACK:
+            fprintf(state->fp, "    surgescript_var_copy(t[%d], surgescript_stack_peek(stack, %d));\n", k, value->id);
+            value->where = IN_VAR;
+            break;
+
+        case IN_VAR:
+            break;
+    }
+
+    value->var_ok = true;
+}
+
+/* pushes onto the stack the values that haven't reached it yet */
+void flush_pushed(aotstate_t* state)
+{
+    for(int i = 0; i < state->num_pushed; i++) {
+        const aotvalue_t* value = &state->pushed[i];
+
+        if(value->where == IN_NUMBER)
+            fprintf(state->fp, "    surgescript_stack_push(stack, surgescript_var_set_number(surgescript_var_create(), d%d));\n", value->id);
+        else
+            fprintf(state->fp, "    surgescript_stack_push(stack, surgescript_var_clone(surgescript_stack_peek(stack, %d)));\n", value->id);
+    }
+
+    state->num_pushed = 0;
+}
+
+/* updates the stack and the given temps, as at the end of a basic block */
+void sync(aotstate_t* state, unsigned temps)
+{
+    flush_pushed(state);
+    for(int k = 0; k < 4; k++) {
+        if(temps & (1u << k))
+            materialize(state, k);
+    }
+}
+
+/* all values are in the temps */
+void reset(aotstate_t* state)
+{
+    ssassert(state->num_pushed == 0);
+
+    for(int k = 0; k < 4; k++)
+        written_var(state, k);
+}
+
+/* stack[base + offset] is about to be written: the values that haven't been read from it are read now */
+void forget_stack_cell(aotstate_t* state, int offset, unsigned live_temps)
+{
+    for(int i = 0; i < state->num_pushed; i++) {
+        if(state->pushed[i].where == IN_STACK && state->pushed[i].id == offset) {
+            flush_pushed(state);
+            break;
+        }
+    }
+
+    for(int k = 0; k < 4; k++) {
+        aotvalue_t* value = &state->temp[k];
+        if(value->where == IN_STACK && value->id == offset && !value->var_ok) {
+            if(live_temps & (1u << k))
+                materialize(state, k);
+            else
+                written_var(state, k); /* t[k] is overwritten before it's read */
+        }
+    }
+}
+
+/* writes a C string literal */
+void fputs_cstring(const char* str, FILE* fp)
+{
+    fputc('"', fp);
+    for(const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        if(*p == '"' || *p == '\\')
+            fprintf(fp, "\\%c", *p);
+        else if(*p < 32 || *p >= 127)
+            fprintf(fp, "\\%03o", *p);
+        else
+            fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+/* is this a conditional jump? */
+bool is_conditional_jump(surgescript_program_operator_t instruction)
+{
+    return jump_condition(instruction) != NULL;
+}
+
+/* the condition of a conditional jump, given t[2] */
+const char* jump_condition(surgescript_program_operator_t instruction)
+{
+    switch(instruction) {
+        case SSOP_JE:  return "== 0";
+        case SSOP_JNE: return "!= 0";
+        case SSOP_JG:  return "> 0";
+        case SSOP_JGE: return ">= 0";
+        case SSOP_JL:  return "< 0";
+        case SSOP_JLE: return "<= 0";
+        default:       return NULL;
+    }
+}
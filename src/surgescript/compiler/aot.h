@@ -0,0 +1,36 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/aot.h
+ * SurgeScript Compiler: ahead-of-time translation of bytecode to C
+ */
+
+#ifndef _SURGESCRIPT_COMPILER_AOT_H
+#define _SURGESCRIPT_COMPILER_AOT_H
+
+#include <stdio.h>
+
+struct surgescript_programpool_t;
+
+/*
+ * The translator writes a C file with one function per program of the pool
+ * and a registration function that binds them to a VM with surgescript_vm_bind_aot().
+ * Compile the scripts, call the registration function and then launch the VM.
+ */
+int surgescript_aot_translate(struct surgescript_programpool_t* program_pool, FILE* fp, const char* register_function_name); /* returns the number of translated programs */
+
+#endif
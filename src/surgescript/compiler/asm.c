@@ -21,11 +21,13 @@
 
 #include <ctype.h>
 #include <string.h>
+#include <math.h>
 #include "asm.h"
 #include "symtable.h"
 #include "../runtime/program.h"
 #include "../runtime/program_pool.h"
 #include "../runtime/object_manager.h"
+#include "../runtime/intrinsics.h"
 #include "../util/util.h"
 
 #ifdef F
@@ -61,6 +63,40 @@
 #define T3                              U(3)
 #define BREAKPOINT(str)                 emit_breakpoint(context, (str))
 
+/* literals of Arrays and Dictionaries are built in chunks of items taken from the stack */
+static const int LITERAL_CHUNK_SIZE = 256;
+
+/* type inference: which values are known to be numbers at a line of code? */
+typedef struct numericstate_t numericstate_t;
+struct numericstate_t
+{
+    bool reached; /* may the line be reached? */
+    int depth; /* number of cells of the stack frame (locals and pushed values) */
+    unsigned temp; /* bit k is set iff t[k] is known to be a number */
+    uint64_t cell; /* bit k is set iff stack[base + 1 + k] is known to be a number */
+    bool nonzero; /* is t[2] known to be non-zero? */
+};
+
+/* helpers */
+static void emit_literal_chunk(surgescript_nodecontext_t context, surgescript_program_operator_t op, int cells_per_item, int index);
+static void emit_literal_end(surgescript_nodecontext_t context, surgescript_program_operator_t op, int cells_per_item, int count);
+static void emit_methodcall(surgescript_nodecontext_t context, const char* fun_name, int num_params);
+static bool is_math_object(surgescript_nodecontext_t context, int line);
+static bool fold_binaryexpr(surgescript_nodecontext_t context, const char* op);
+static bool fold_unaryexpr(surgescript_nodecontext_t context, char op);
+static bool read_constant(surgescript_nodecontext_t context, int line, surgescript_var_t* value);
+static void emit_constant(surgescript_nodecontext_t context, const surgescript_var_t* value);
+static void specialize_numeric_operations(surgescript_nodecontext_t context);
+static void fuse_superinstructions(surgescript_nodecontext_t context);
+static int find_superinstruction(const surgescript_program_t* program, int line, surgescript_program_operator_t* fused);
+static bool infer_numeric_types(const surgescript_program_t* program, numericstate_t* state);
+static bool numeric_transfer(numericstate_t* s, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b);
+static bool numeric_merge(numericstate_t* dst, const numericstate_t* src, bool* changed);
+static inline bool is_numeric_temp(const numericstate_t* s, surgescript_program_operand_t k) { return (s->temp >> (k.u & 3)) & 1; }
+static inline void set_numeric_temp(numericstate_t* s, surgescript_program_operand_t k, bool numeric) { s->temp = numeric ? (s->temp | (1u << (k.u & 3))) : (s->temp & ~(1u << (k.u & 3))); }
+static inline bool is_numeric_cell(const numericstate_t* s, int offset) { return offset >= 1 && offset <= s->depth && offset <= 64 && ((s->cell >> (offset - 1)) & 1); }
+static inline void set_numeric_cell(numericstate_t* s, int offset, bool numeric) { if(offset >= 1 && offset <= 64) s->cell = numeric ? (s->cell | (UINT64_C(1) << (offset - 1))) : (s->cell & ~(UINT64_C(1) << (offset - 1))); }
+
 
 /* objects */
 void emit_object_header(surgescript_nodecontext_t context, surgescript_program_label_t start, surgescript_program_label_t end)
@@ -214,8 +250,12 @@ void emit_equalityexpr1(surgescript_nodecontext_t context)
 
 void emit_equalityexpr2(surgescript_nodecontext_t context, const char* equalityop)
 {
-    surgescript_program_label_t done = NEWLABEL();
+    surgescript_program_label_t done;
+
+    if(fold_binaryexpr(context, equalityop))
+        return;
 
+    done = NEWLABEL();
     SSASM(SSOP_POP, T1);
     if(strcmp(equalityop, "==") == 0) {
         SSASM(SSOP_CMP, T1, T0);
@@ -255,8 +295,12 @@ void emit_relationalexpr1(surgescript_nodecontext_t context)
 
 void emit_relationalexpr2(surgescript_nodecontext_t context, const char* relationalop)
 {
-    surgescript_program_label_t done = NEWLABEL();
+    surgescript_program_label_t done;
 
+    if(fold_binaryexpr(context, relationalop))
+        return;
+
+    done = NEWLABEL();
     SSASM(SSOP_POP, T1);
     SSASM(SSOP_CMP, T1, T0);
     SSASM(SSOP_MOVB, T0, B(true));
@@ -286,6 +330,9 @@ void emit_additiveexpr1(surgescript_nodecontext_t context)
 
 void emit_additiveexpr2(surgescript_nodecontext_t context, const char* additiveop)
 {
+    if(fold_binaryexpr(context, additiveop))
+        return;
+
     SSASM(SSOP_POP, T1);
     switch(*additiveop) {
         case '+': {
@@ -324,6 +371,9 @@ void emit_multiplicativeexpr1(surgescript_nodecontext_t context)
 
 void emit_multiplicativeexpr2(surgescript_nodecontext_t context, const char* multiplicativeop)
 {
+    if(fold_binaryexpr(context, multiplicativeop))
+        return;
+
     SSASM(SSOP_POP, T1);
     switch(*multiplicativeop) {
         case '*':
@@ -348,7 +398,7 @@ void emit_multiplicativeexpr2(surgescript_nodecontext_t context, const char* mul
 
 void emit_unarysign(surgescript_nodecontext_t context, const char* op)
 {
-    if(*op == '-')
+    if(*op == '-' && !fold_unaryexpr(context, '-'))
         SSASM(SSOP_NEG, T0, T0);
 }
 
@@ -368,7 +418,8 @@ void emit_unaryincdec(surgescript_nodecontext_t context, const char* op, const c
 
 void emit_unarynot(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_LNOT, T0, T0);
+    if(!fold_unaryexpr(context, '!'))
+        SSASM(SSOP_LNOT, T0, T0);
 }
 
 void emit_unarytype(surgescript_nodecontext_t context)
@@ -433,10 +484,17 @@ void emit_popparams(surgescript_nodecontext_t context, int n)
     SSASM(SSOP_POPN, U(n));
 }
 
-void emit_funcall(surgescript_nodecontext_t context, const char* fun_name, int num_params)
+void emit_funcall(surgescript_nodecontext_t context, const char* fun_name, int num_params, int receiver_line)
 {
+    /* methods of the Math object run inline, without a call frame */
+    int math_id = surgescript_mathintrinsic_find(fun_name, num_params);
+    if(math_id >= 0 && is_math_object(context, receiver_line)) {
+        SSASM(SSOP_MATH, I(math_id), U(num_params));
+        return;
+    }
+
     /*BREAKPOINT(fun_name);*/
-    SSASM(SSOP_CALL, TEXT(fun_name), U(num_params));
+    emit_methodcall(context, fun_name, num_params);
 }
 
 void emit_dictptr(surgescript_nodecontext_t context)
@@ -453,7 +511,7 @@ void emit_dictkey(surgescript_nodecontext_t context)
 
 void emit_dictget(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_CALL, TEXT("get"), U(1));
+    emit_methodcall(context, "get", 1);
     SSASM(SSOP_POPN, U(2));
 }
 
@@ -542,10 +600,19 @@ void emit_dictincdec(surgescript_nodecontext_t context, const char* op)
 void emit_getter(surgescript_nodecontext_t context, const char* property_name)
 {
     char* getter_name = surgescript_util_accessorfun("get", property_name);
+    int line = surgescript_program_count_lines(context.program);
+    int math_id = surgescript_mathintrinsic_find(getter_name, 0);
 
-    SSASM(SSOP_PUSH, T0); /* object pointer */
-    SSASM(SSOP_CALL, TEXT(getter_name), U(0));
-    SSASM(SSOP_POPN, U(1));
+    if(math_id >= 0 && is_math_object(context, line)) {
+        /* a constant of the Math object, such as Math.pi: replace the
+           MOVO of the Math object by the computation of the constant */
+        surgescript_program_chg_line(context.program, line - 1, SSOP_MATH, I(math_id), U(0));
+    }
+    else {
+        SSASM(SSOP_PUSH, T0); /* object pointer */
+        emit_methodcall(context, getter_name, 0);
+        SSASM(SSOP_POPN, U(1));
+    }
 
     ssfree(getter_name);
 }
@@ -653,41 +720,30 @@ void emit_setterincdec(surgescript_nodecontext_t context, const char* property_n
 
 void emit_arrayexpr1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_MOVO, T0, U(surgescript_objectmanager_system_object(NULL, "__Temp")));
-    SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_MOVS, T0, TEXT("Array"));
-    SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_CALL, TEXT("spawn"), U(1)); /* t0 = t0.spawn("Array") */
-    SSASM(SSOP_POPN, U(2));
-    SSASM(SSOP_PUSH, T0); /* save the handle */
+    /* the elements are pushed onto the stack */
 }
 
-void emit_arrayexpr2(surgescript_nodecontext_t context)
+void emit_arrayexpr2(surgescript_nodecontext_t context, int length)
 {
-    SSASM(SSOP_POP, T0); /* (t0 = array) is the return value of the expression */
+    /* t0 = new Array with the pushed elements */
+    emit_literal_end(context, SSOP_ARRAY, 1, length);
 }
 
-void emit_arrayelement(surgescript_nodecontext_t context)
+void emit_arrayelement(surgescript_nodecontext_t context, int index)
 {
     SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_CALL, TEXT("push"), U(1)); /* array.push(<assignexpr>) */
-    SSASM(SSOP_POPN, U(1));
+    emit_literal_chunk(context, SSOP_ARRAY, 1, index);
 }
 
 void emit_dictdecl1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_MOVO, T0, U(surgescript_objectmanager_system_object(NULL, "__Temp")));
-    SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_MOVS, T0, TEXT("Dictionary"));
-    SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_CALL, TEXT("spawn"), U(1)); /* t0 = t0.spawn("Dictionary") */
-    SSASM(SSOP_POPN, U(2));
-    SSASM(SSOP_PUSH, T0); /* save the handle */
+    /* the entries are pushed onto the stack */
 }
 
-void emit_dictdecl2(surgescript_nodecontext_t context)
+void emit_dictdecl2(surgescript_nodecontext_t context, int count)
 {
-    SSASM(SSOP_POP, T0); /* retrieve the handle to the dictionary */
+    /* t0 = new Dictionary with the pushed entries */
+    emit_literal_end(context, SSOP_DICT, 2, count);
 }
 
 void emit_dictdeclkey(surgescript_nodecontext_t context)
@@ -695,11 +751,10 @@ void emit_dictdeclkey(surgescript_nodecontext_t context)
     SSASM(SSOP_PUSH, T0);
 }
 
-void emit_dictdeclvalue(surgescript_nodecontext_t context)
+void emit_dictdeclvalue(surgescript_nodecontext_t context, int index)
 {
     SSASM(SSOP_PUSH, T0);
-    SSASM(SSOP_CALL, TEXT("set"), U(2)); /* dict.set(key, value) */
-    SSASM(SSOP_POPN, U(2));
+    emit_literal_chunk(context, SSOP_DICT, 2, index);
 }
 
 void emit_timeout(surgescript_nodecontext_t context)
@@ -729,6 +784,19 @@ void emit_assert(surgescript_nodecontext_t context, int line, const char* messag
     SSASM(SSOP_POPN, U(4));
 }
 
+void emit_wait(surgescript_nodecontext_t context)
+{
+    /* suspend the state for <expr> seconds */
+    SSASM(SSOP_WAIT, T0);
+}
+
+void emit_yield(surgescript_nodecontext_t context)
+{
+    /* suspend the state until the next frame */
+    SSASM(SSOP_MOVF, T0, F(0.0));
+    SSASM(SSOP_WAIT, T0);
+}
+
 /* statements */
 void emit_if(surgescript_nodecontext_t context, surgescript_program_label_t nope)
 {
@@ -808,10 +876,18 @@ void emit_for3(surgescript_nodecontext_t context, surgescript_program_label_t in
 
 void emit_foreach1(surgescript_nodecontext_t context, const char* identifier, surgescript_program_label_t begin, surgescript_program_label_t end)
 {
-    /* get the iterator */
+    surgescript_program_label_t native = NEWLABEL();
+    surgescript_program_label_t body = NEWLABEL();
+
+    /* get the iterator. Arrays are iterated natively, without
+       iterator objects: we keep their length and an index */
     SSASM(SSOP_PUSH, T0); /* push <expr> */
+    SSASM(SSOP_ITER, U(native));
     SSASM(SSOP_CALL, TEXT("iterator"), U(0));
-    SSASM(SSOP_PUSH, T0); /* push <expr>.iterator() */
+    SSASM(SSOP_MOVN, T1);
+    LABEL(native);
+    SSASM(SSOP_PUSH, T1); /* push the length of the Array, or null */
+    SSASM(SSOP_PUSH, T0); /* push <expr>.iterator(), or an index */
 
     /* reserve an address on the stack to the element of the foreach loop */
     if(!surgescript_symtable_has_symbol(context.symtable, identifier))
@@ -819,10 +895,12 @@ void emit_foreach1(surgescript_nodecontext_t context, const char* identifier, su
 
     /* foreach loop */
     LABEL(begin);
+    SSASM(SSOP_NEXT, U(end), U(body));
     SSASM(SSOP_CALL, TEXT("hasNext"), U(0));
     SSASM(SSOP_TEST, T0, T0);
     SSASM(SSOP_JE, U(end));
     SSASM(SSOP_CALL, TEXT("next"), U(0));
+    LABEL(body);
     surgescript_symtable_emit_write(context.symtable, identifier, context.program, 0);
 }
 
@@ -833,7 +911,7 @@ void emit_foreach2(surgescript_nodecontext_t context, const char* identifier, su
 
     /* done */
     LABEL(end);
-    SSASM(SSOP_POPN, U(2)); /* pop stuff */
+    SSASM(SSOP_POPN, U(3)); /* pop stuff */
 }
 
 void emit_break(surgescript_nodecontext_t context, int line)
@@ -929,6 +1007,10 @@ void emit_function_footer(surgescript_nodecontext_t context, int num_locals, int
     SSASM(SSOP_MOVN, T0); /* return null */
     /*SSASM(SSOP_POPN, U(num_locals));*/ /* not needed, since popenv() clears the stack frame for us */
     SSASM(SSOP_RET);
+
+    /* the function is complete */
+    specialize_numeric_operations(context);
+    fuse_superinstructions(context);
 }
 
 void emit_function_argument(surgescript_nodecontext_t context, const char* identifier, int line, int idx, int argc)
@@ -1005,6 +1087,11 @@ void emit_setstate(surgescript_nodecontext_t context)
     SSASM(SSOP_STATE, T0, I(-1)); /* return value is in t[0] */
 }
 
+void emit_setstateid(surgescript_nodecontext_t context, int state_id)
+{
+    SSASM(SSOP_SETSTATEID, I(state_id)); /* return value is in t[0] */
+}
+
 void emit_nop(surgescript_nodecontext_t context)
 {
     SSASM(SSOP_NOP);
@@ -1014,3 +1101,597 @@ void emit_breakpoint(surgescript_nodecontext_t context, const char* text)
 {
     SSASM(SSOP_NOP, I(-1), TEXT(text));
 }
+
+
+
+/* private stuff */
+
+/* after pushing the index-th item of a literal, moves a complete chunk of
+   items from the stack to the Array / Dictionary, so that large literals
+   don't overflow the stack. The handle of the container is kept on the stack */
+void emit_literal_chunk(surgescript_nodecontext_t context, surgescript_program_operator_t op, int cells_per_item, int index)
+{
+    if((index + 1) % LITERAL_CHUNK_SIZE == 0) {
+        bool first_chunk = (index + 1 == LITERAL_CHUNK_SIZE);
+        SSASM(op, U(LITERAL_CHUNK_SIZE), B(!first_chunk));
+        SSASM(SSOP_POPN, U(LITERAL_CHUNK_SIZE * cells_per_item));
+        if(first_chunk)
+            SSASM(SSOP_PUSH, T0); /* save the handle */
+    }
+}
+
+/* builds the Array / Dictionary of a literal with count items, storing its handle in t0 */
+void emit_literal_end(surgescript_nodecontext_t context, surgescript_program_operator_t op, int cells_per_item, int count)
+{
+    int remaining = count % LITERAL_CHUNK_SIZE;
+
+    if(count < LITERAL_CHUNK_SIZE) {
+        SSASM(op, U(remaining), B(false));
+        if(remaining > 0)
+            SSASM(SSOP_POPN, U(remaining * cells_per_item));
+    }
+    else {
+        if(remaining > 0) {
+            SSASM(op, U(remaining), B(true));
+            SSASM(SSOP_POPN, U(remaining * cells_per_item));
+        }
+        SSASM(SSOP_POP, T0); /* retrieve the handle */
+    }
+}
+
+/* calls a method of the object at stack[top - num_params] */
+void emit_methodcall(surgescript_nodecontext_t context, const char* fun_name, int num_params)
+{
+    SSASM(SSOP_CALL, TEXT(fun_name), U(num_params));
+}
+
+/* checks if t[0] holds the Math object at the given line. We look for the
+   MOVO instruction of the Math object at the previous line, which must not
+   be skipped (i.e., no label points to the given line) */
+bool is_math_object(surgescript_nodecontext_t context, int line)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+
+    return line > 0 &&
+        surgescript_program_find_label(context.program, line) == SURGESCRIPT_PROGRAM_UNDEFINED_LABEL &&
+        surgescript_program_read_line(context.program, line - 1, &op, &a, &b) &&
+        op == SSOP_MOVO && a.u == 0 &&
+        b.u == surgescript_objectmanager_system_object(NULL, "Math");
+}
+
+/* constant folding: if both operands of the binary expression being emitted
+   are literals, i.e., the last lines of the program are "MOVx t[0], lhs;
+   PUSH t[0]; MOVx t[0], rhs", then we replace these lines by the result of
+   the expression. The result is computed just like it would be at runtime */
+bool fold_binaryexpr(surgescript_nodecontext_t context, const char* op)
+{
+    int n = surgescript_program_count_lines(context.program);
+    surgescript_program_operator_t push_op;
+    surgescript_program_operand_t push_a;
+    surgescript_var_t* lhs;
+    surgescript_var_t* rhs;
+    surgescript_var_t* result;
+    bool folded = true;
+
+    /* the lines of the expression must not be skipped */
+    for(int line = n - 2; line <= n; line++) {
+        if(surgescript_program_find_label(context.program, line) != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL)
+            return false;
+    }
+
+    /* match the pattern */
+    if(!surgescript_program_read_line(context.program, n - 2, &push_op, &push_a, NULL) || push_op != SSOP_PUSH || push_a.u != 0)
+        return false;
+
+    lhs = surgescript_var_create();
+    rhs = surgescript_var_create();
+    result = surgescript_var_create();
+
+    if(!read_constant(context, n - 3, lhs) || !read_constant(context, n - 1, rhs)) {
+        folded = false;
+    }
+    else if(strcmp(op, "+") == 0) {
+        if(surgescript_var_is_string(lhs) || surgescript_var_is_string(rhs)) {
+            /* same as String.concat() */
+            char* str[] = { surgescript_var_get_string(lhs, NULL), surgescript_var_get_string(rhs, NULL) };
+            char* buf = ssmalloc((1 + strlen(str[0]) + strlen(str[1])) * sizeof(*buf));
+            surgescript_var_set_string(result, strcat(strcpy(buf, str[0]), str[1]));
+            ssfree(buf);
+            ssfree(str[1]);
+            ssfree(str[0]);
+        }
+        else
+            surgescript_var_set_number(result, surgescript_var_get_number(lhs) + surgescript_var_get_number(rhs));
+    }
+    else if(strcmp(op, "-") == 0)
+        surgescript_var_set_number(result, surgescript_var_get_number(lhs) - surgescript_var_get_number(rhs));
+    else if(strcmp(op, "*") == 0)
+        surgescript_var_set_number(result, surgescript_var_get_number(lhs) * surgescript_var_get_number(rhs));
+    else if(strcmp(op, "/") == 0)
+        surgescript_var_set_number(result, surgescript_var_get_number(lhs) / surgescript_var_get_number(rhs));
+    else if(strcmp(op, "%") == 0)
+        surgescript_var_set_number(result, fmod(surgescript_var_get_number(lhs), surgescript_var_get_number(rhs)));
+    else if(strcmp(op, "==") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) == 0);
+    else if(strcmp(op, "!=") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) != 0);
+    else if(strcmp(op, "===") == 0)
+        surgescript_var_set_bool(result, surgescript_var_typecode(lhs) == surgescript_var_typecode(rhs) && surgescript_var_compare(lhs, rhs) == 0);
+    else if(strcmp(op, "!==") == 0)
+        surgescript_var_set_bool(result, !(surgescript_var_typecode(lhs) == surgescript_var_typecode(rhs) && surgescript_var_compare(lhs, rhs) == 0));
+    else if(strcmp(op, "<") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) < 0);
+    else if(strcmp(op, ">") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) > 0);
+    else if(strcmp(op, "<=") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) <= 0);
+    else if(strcmp(op, ">=") == 0)
+        surgescript_var_set_bool(result, surgescript_var_compare(lhs, rhs) >= 0);
+    else
+        folded = false;
+
+    /* replace the lines */
+    if(folded) {
+        surgescript_program_truncate(context.program, n - 3);
+        emit_constant(context, result);
+    }
+
+    surgescript_var_destroy(result);
+    surgescript_var_destroy(rhs);
+    surgescript_var_destroy(lhs);
+    return folded;
+}
+
+/* constant folding of unary expressions: if the last line of the program
+   loads a literal to t[0], we replace it by the result of the expression */
+bool fold_unaryexpr(surgescript_nodecontext_t context, char op)
+{
+    int n = surgescript_program_count_lines(context.program);
+    surgescript_var_t* operand;
+    surgescript_var_t* result;
+    bool folded = true;
+
+    /* the operand must not be skipped */
+    if(surgescript_program_find_label(context.program, n) != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL)
+        return false;
+    else if(surgescript_program_find_label(context.program, n - 1) != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL)
+        return false;
+
+    operand = surgescript_var_create();
+    result = surgescript_var_create();
+
+    if(!read_constant(context, n - 1, operand))
+        folded = false;
+    else if(op == '-')
+        surgescript_var_set_number(result, -surgescript_var_get_number(operand));
+    else if(op == '!')
+        surgescript_var_set_bool(result, !surgescript_var_get_bool(operand));
+    else
+        folded = false;
+
+    if(folded) {
+        surgescript_program_truncate(context.program, n - 1);
+        emit_constant(context, result);
+    }
+
+    surgescript_var_destroy(result);
+    surgescript_var_destroy(operand);
+    return folded;
+}
+
+/* reads the literal loaded to t[0] at the given line, if there is one */
+bool read_constant(surgescript_nodecontext_t context, int line, surgescript_var_t* value)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+
+    if(!surgescript_program_read_line(context.program, line, &op, &a, &b) || a.u != 0)
+        return false;
+
+    switch(op) {
+        case SSOP_MOVN:
+            surgescript_var_set_null(value);
+            return true;
+
+        case SSOP_MOVB:
+            surgescript_var_set_bool(value, b.b);
+            return true;
+
+        case SSOP_MOVF:
+            surgescript_var_set_number(value, b.f);
+            return true;
+
+        case SSOP_MOVS:
+            surgescript_var_set_string(value, surgescript_program_get_text(context.program, b.u));
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* loads a literal to t[0] */
+void emit_constant(surgescript_nodecontext_t context, const surgescript_var_t* value)
+{
+    if(surgescript_var_is_number(value))
+        emit_number(context, surgescript_var_get_number(value));
+    else if(surgescript_var_is_bool(value))
+        emit_bool(context, surgescript_var_get_bool(value));
+    else if(surgescript_var_is_string(value))
+        emit_string(context, surgescript_var_fast_get_string(value));
+    else
+        emit_null(context);
+}
+
+/* type-specialized operations: we infer which temps and which cells of the
+   stack frame are known to be numbers at each line of the program, and then
+   replace the generic arithmetic and comparisons on them by numeric ones */
+void specialize_numeric_operations(surgescript_nodecontext_t context)
+{
+    int n = surgescript_program_count_lines(context.program);
+    numericstate_t* state = ssmalloc(ssmax(n, 1) * sizeof(*state));
+    int string_code = surgescript_var_type2code("string");
+
+    if(!infer_numeric_types(context.program, state)) {
+        ssfree(state);
+        return;
+    }
+
+    for(int line = 0; line < n; line++) {
+        surgescript_program_operator_t op, op1, op2, op3;
+        surgescript_program_operand_t a, b, a2, b2, a3;
+        const numericstate_t* s = &state[line];
+
+        if(!s->reached)
+            continue;
+
+        surgescript_program_read_line(context.program, line, &op, &a, &b);
+        switch(op) {
+            case SSOP_ADD:
+            case SSOP_SUB:
+            case SSOP_MUL:
+            case SSOP_DIV:
+                if(is_numeric_temp(s, a) && is_numeric_temp(s, b)) {
+                    surgescript_program_operator_t fop = (op == SSOP_ADD) ? SSOP_FADD : ((op == SSOP_SUB) ? SSOP_FSUB : ((op == SSOP_MUL) ? SSOP_FMUL : SSOP_FDIV));
+                    surgescript_program_chg_line(context.program, line, fop, a, b);
+                }
+                break;
+
+            case SSOP_CMP:
+                if(is_numeric_temp(s, a) && is_numeric_temp(s, b))
+                    surgescript_program_chg_line(context.program, line, SSOP_FCMP, a, b);
+                break;
+
+            case SSOP_TC01:
+                /* the operator + is emitted as "TC01 string; JE concat; ADD; JMP end".
+                   If both operands are numbers, we add them and jump to the end */
+                if(a.i == string_code && (s->temp & 3) == 3 &&
+                    surgescript_program_read_line(context.program, line + 1, &op1, NULL, NULL) && op1 == SSOP_JE &&
+                    surgescript_program_read_line(context.program, line + 2, &op2, &a2, &b2) && op2 == SSOP_ADD && (a2.u & 2) == 0 && (b2.u & 2) == 0 &&
+                    surgescript_program_read_line(context.program, line + 3, &op3, &a3, NULL) && op3 == SSOP_JMP &&
+                    surgescript_program_find_label(context.program, line + 1) == SURGESCRIPT_PROGRAM_UNDEFINED_LABEL
+                ) {
+                    surgescript_program_chg_line(context.program, line, SSOP_FADD, a2, b2);
+                    surgescript_program_chg_line(context.program, line + 1, SSOP_JMP, a3, U(0));
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    ssfree(state);
+}
+
+/* superinstructions: common sequences of instructions are fused into one,
+   so that they're dispatched only once. The first instruction of the
+   sequence is replaced; the others are kept, as they may be jump targets */
+void fuse_superinstructions(surgescript_nodecontext_t context)
+{
+    int n = surgescript_program_count_lines(context.program);
+
+    for(int line = 0; line < n; line++) {
+        surgescript_program_operator_t fused, next;
+        surgescript_program_operand_t a, b;
+        int length = find_superinstruction(context.program, line, &fused);
+
+        if(length == 0)
+            continue;
+
+        /* prefer "push; movf; pop" to "speek; push" */
+        if(length == 2 && find_superinstruction(context.program, line + 1, &next) > 2)
+            continue;
+
+        /* the superinstruction keeps the operands of the first instruction */
+        surgescript_program_read_line(context.program, line, NULL, &a, &b);
+        surgescript_program_chg_line(context.program, line, fused, a, b);
+        line += length - 1;
+    }
+}
+
+/* finds the superinstruction that fuses the sequence of instructions
+   starting at the given line. Returns the length of the sequence, or 0 */
+int find_superinstruction(const surgescript_program_t* program, int line, surgescript_program_operator_t* fused)
+{
+    surgescript_program_operator_t op[4];
+    surgescript_program_operand_t a[4], b[4];
+
+    for(int k = 0; k < 4; k++)
+        surgescript_program_read_line(program, line + k, &op[k], &a[k], &b[k]);
+
+    /* speek a, b; mov c, a; inc c; spoke c, b (the operator ++ on a local variable) */
+    if(op[0] == SSOP_SPEEK && op[1] == SSOP_MOV && op[2] == SSOP_INC && op[3] == SSOP_SPOKE &&
+        b[1].u == a[0].u && a[1].u != a[0].u && a[2].u == a[1].u && a[2].u != 2 && a[3].u == a[1].u && b[3].i == b[0].i) {
+        *fused = SSOP_SPEEKINC;
+        return 4;
+    }
+
+    /* push a; movf a, f; pop c (a binary operator with a numeric literal on the right) */
+    if(op[0] == SSOP_PUSH && op[1] == SSOP_MOVF && op[2] == SSOP_POP && a[1].u == a[0].u && a[2].u != a[0].u) {
+        *fused = SSOP_PUSHMOVFPOP;
+        return 3;
+    }
+
+    /* speek a, b; push a */
+    if(op[0] == SSOP_SPEEK && op[1] == SSOP_PUSH && a[1].u == a[0].u) {
+        *fused = SSOP_SPEEKPUSH;
+        return 2;
+    }
+
+    /* peek a, b; push a */
+    if(op[0] == SSOP_PEEK && op[1] == SSOP_PUSH && a[1].u == a[0].u) {
+        *fused = SSOP_PEEKPUSH;
+        return 2;
+    }
+
+    /* test a, b; je line */
+    if(op[0] == SSOP_TEST && op[1] == SSOP_JE) {
+        *fused = SSOP_TESTJE;
+        return 2;
+    }
+
+    *fused = SSOP_NOP;
+    return 0;
+}
+
+/* forward data-flow analysis: computes the state at each line of the program.
+   Returns false if the program has a shape that we don't expect */
+bool infer_numeric_types(const surgescript_program_t* program, numericstate_t* state)
+{
+    int n = surgescript_program_count_lines(program);
+    bool changed = true;
+
+    for(int line = 0; line < n; line++)
+        state[line] = (numericstate_t){ .reached = false };
+
+    if(n == 0)
+        return false;
+
+    state[0] = (numericstate_t){ .reached = true, .depth = 0, .temp = 0, .cell = 0, .nonzero = false };
+
+    /* iterate until a fixed point is reached; the states only lose information */
+    while(changed) {
+        changed = false;
+
+        for(int line = 0; line < n; line++) {
+            surgescript_program_operator_t op;
+            surgescript_program_operand_t a, b;
+            numericstate_t s = state[line];
+            int next[3], count = 0;
+
+            if(!s.reached)
+                continue;
+
+            surgescript_program_read_line(program, line, &op, &a, &b);
+            if(!numeric_transfer(&s, op, a, b))
+                return false;
+
+            /* successors */
+            switch(op) {
+                case SSOP_RET:
+                    break;
+
+                case SSOP_JE:
+                    /* skip the concatenation of numbers: see specialize_numeric_operations() */
+                    if(!state[line].nonzero)
+                        next[count++] = surgescript_program_label_line(program, a.u);
+                    next[count++] = line + 1;
+                    break;
+
+                case SSOP_JMP:
+                    next[count++] = surgescript_program_label_line(program, a.u);
+                    break;
+
+                case SSOP_NEXT:
+                    next[count++] = surgescript_program_label_line(program, b.u);
+                    /* fall through */
+
+                case SSOP_JNE:
+                case SSOP_JG:
+                case SSOP_JGE:
+                case SSOP_JL:
+                case SSOP_JLE:
+                case SSOP_ITER:
+                    next[count++] = surgescript_program_label_line(program, a.u);
+                    /* fall through */
+
+                default:
+                    next[count++] = line + 1;
+                    break;
+            }
+
+            for(int i = 0; i < count; i++) {
+                if(next[i] < 0)
+                    return false;
+                else if(next[i] < n && !numeric_merge(&state[next[i]], &s, &changed))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* updates the state after running an instruction. Returns false if the
+   stack frame isn't used as expected */
+bool numeric_transfer(numericstate_t* s, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
+{
+    s->nonzero = false;
+
+    switch(op) {
+        case SSOP_NOP:
+        case SSOP_POKE:
+        case SSOP_JMP:
+        case SSOP_JE:
+        case SSOP_JNE:
+        case SSOP_JG:
+        case SSOP_JGE:
+        case SSOP_JL:
+        case SSOP_JLE:
+        case SSOP_RET:
+            break;
+
+        case SSOP_MOVF:
+        case SSOP_ALLOC:
+        case SSOP_ADD:
+        case SSOP_SUB:
+        case SSOP_MUL:
+        case SSOP_DIV:
+        case SSOP_REM:
+        case SSOP_NEG:
+        case SSOP_FADD:
+        case SSOP_FSUB:
+        case SSOP_FMUL:
+        case SSOP_FDIV:
+            set_numeric_temp(s, a, true);
+            break;
+
+        case SSOP_INC:
+        case SSOP_DEC:
+            set_numeric_temp(s, a, a.u != 2); /* t[2] is incremented as an integer */
+            break;
+
+        case SSOP_MOV:
+            set_numeric_temp(s, a, is_numeric_temp(s, b));
+            break;
+
+        case SSOP_XCHG: {
+            bool x = is_numeric_temp(s, a), y = is_numeric_temp(s, b);
+            set_numeric_temp(s, a, y);
+            set_numeric_temp(s, b, x);
+            break;
+        }
+
+        case SSOP_PUSH:
+            set_numeric_cell(s, ++s->depth, is_numeric_temp(s, a));
+            break;
+
+        case SSOP_POP:
+            if(s->depth < 1)
+                return false;
+            set_numeric_temp(s, a, is_numeric_cell(s, s->depth));
+            set_numeric_cell(s, s->depth--, false);
+            break;
+
+        case SSOP_SPEEK:
+            set_numeric_temp(s, a, is_numeric_cell(s, b.i)); /* the parameters (b < 0) are unknown */
+            break;
+
+        case SSOP_SPOKE:
+            if(b.i > s->depth)
+                return false;
+            set_numeric_cell(s, b.i, is_numeric_temp(s, a));
+            break;
+
+        case SSOP_PUSHN:
+            for(unsigned i = 0; i < a.u; i++)
+                set_numeric_cell(s, ++s->depth, false);
+            break;
+
+        case SSOP_POPN:
+            if(a.u > (unsigned)s->depth)
+                return false;
+            for(unsigned i = 0; i < a.u; i++)
+                set_numeric_cell(s, s->depth--, false);
+            break;
+
+        case SSOP_MATH:
+            set_numeric_temp(s, T0, surgescript_mathintrinsic_is_numeric(a.i));
+            break;
+
+        case SSOP_SELF:
+        case SSOP_CALLER:
+        case SSOP_MOVN:
+        case SSOP_MOVB:
+        case SSOP_MOVS:
+        case SSOP_MOVO:
+        case SSOP_MOVX:
+        case SSOP_PEEK: /* the fields of the object may be changed elsewhere */
+        case SSOP_LNOT:
+        case SSOP_LNOT2:
+        case SSOP_NOT:
+        case SSOP_AND:
+        case SSOP_OR:
+        case SSOP_XOR:
+            set_numeric_temp(s, a, false);
+            break;
+
+        case SSOP_TC01:
+            /* t[2] = typecode(number) ^ a if both t[0] and t[1] are numbers */
+            s->nonzero = ((s->temp & 3) == 3) && (a.i != surgescript_var_type2code("number"));
+            set_numeric_temp(s, T2, false);
+            break;
+
+        case SSOP_TEST:
+        case SSOP_TCHK:
+        case SSOP_TCMP:
+        case SSOP_CMP:
+        case SSOP_FCMP:
+            set_numeric_temp(s, T2, false);
+            break;
+
+        case SSOP_CALL:
+        case SSOP_OPTCALL:
+            /* the callee may change its parameters, i.e., the cells at the top of the stack */
+            for(int i = 0; i <= (int)b.u; i++)
+                set_numeric_cell(s, s->depth - i, false);
+            s->temp = 0;
+            break;
+
+        case SSOP_NEXT:
+            set_numeric_cell(s, s->depth, false); /* the cursor of the foreach loop */
+            s->temp = 0;
+            break;
+
+        default:
+            /* other instructions may run code that changes the temps */
+            s->temp = 0;
+            break;
+    }
+
+    return true;
+}
+
+/* merges the state src into the state dst of a line that is reached from
+   another. Returns false if the stack frames don't match */
+bool numeric_merge(numericstate_t* dst, const numericstate_t* src, bool* changed)
+{
+    if(!dst->reached) {
+        *dst = *src;
+        *changed = true;
+        return true;
+    }
+    else if(dst->depth != src->depth)
+        return false;
+
+    if((dst->temp & src->temp) != dst->temp || (dst->cell & src->cell) != dst->cell || (dst->nonzero && !src->nonzero)) {
+        dst->temp &= src->temp;
+        dst->cell &= src->cell;
+        dst->nonzero = dst->nonzero && src->nonzero;
+        *changed = true;
+    }
+
+    return true;
+}
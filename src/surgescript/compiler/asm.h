@@ -59,7 +59,7 @@ void emit_unarytype(surgescript_nodecontext_t context);
 void emit_postincdec(surgescript_nodecontext_t context, const char* op, const char* identifier, int line);
 void emit_pushparam(surgescript_nodecontext_t context);
 void emit_popparams(surgescript_nodecontext_t context, int n);
-void emit_funcall(surgescript_nodecontext_t context, const char* fun_name, int num_params);
+void emit_funcall(surgescript_nodecontext_t context, const char* fun_name, int num_params, int receiver_line);
 void emit_dictptr(surgescript_nodecontext_t context);
 void emit_dictkey(surgescript_nodecontext_t context);
 void emit_dictget(surgescript_nodecontext_t context);
@@ -70,14 +70,16 @@ void emit_setter1(surgescript_nodecontext_t context, const char* property_name);
 void emit_setter2(surgescript_nodecontext_t context, const char* property_name, const char* assignop);
 void emit_setterincdec(surgescript_nodecontext_t context, const char* property_name, const char* op);
 void emit_arrayexpr1(surgescript_nodecontext_t context);
-void emit_arrayexpr2(surgescript_nodecontext_t context);
-void emit_arrayelement(surgescript_nodecontext_t context);
+void emit_arrayexpr2(surgescript_nodecontext_t context, int length);
+void emit_arrayelement(surgescript_nodecontext_t context, int index);
 void emit_dictdecl1(surgescript_nodecontext_t context);
-void emit_dictdecl2(surgescript_nodecontext_t context);
+void emit_dictdecl2(surgescript_nodecontext_t context, int count);
 void emit_dictdeclkey(surgescript_nodecontext_t context);
-void emit_dictdeclvalue(surgescript_nodecontext_t context);
+void emit_dictdeclvalue(surgescript_nodecontext_t context, int index);
 void emit_timeout(surgescript_nodecontext_t context);
 void emit_assert(surgescript_nodecontext_t context, int line, const char* message);
+void emit_wait(surgescript_nodecontext_t context);
+void emit_yield(surgescript_nodecontext_t context);
 
 /* statements */
 void emit_if(surgescript_nodecontext_t context, surgescript_program_label_t nope);
@@ -123,6 +125,7 @@ void emit_zero(surgescript_nodecontext_t context);
 
 /* misc */
 void emit_setstate(surgescript_nodecontext_t context);
+void emit_setstateid(surgescript_nodecontext_t context, int state_id);
 void emit_nop(surgescript_nodecontext_t context);
 void emit_breakpoint(surgescript_nodecontext_t context, const char* text);
 
@@ -49,6 +49,7 @@ struct surgescript_parser_t
     surgescript_tagsystem_t* tag_system; /* reference to the tag system */
     surgescript_symtable_t* base_table; /* valid symbols in the current file (code unit) */
     SSARRAY(char*, known_plugins); /* known plugins in all files (the names of the objects) */
+    SSARRAY(char*, known_isolated); /* known isolated objects in all files (their subtrees may be updated in parallel) */
     surgescript_parser_flags_t flags;
 };
 
@@ -66,7 +67,6 @@ static void expect_something(surgescript_parser_t* parser);
 static void expect_exactly(surgescript_parser_t* parser, surgescript_tokentype_t symbol, const char* lexeme);
 static void unexpected_symbol(surgescript_parser_t* parser);
 static void validate_object(surgescript_parser_t* parser, surgescript_nodecontext_t context);
-static surgescript_var_t* empty_main(surgescript_object_t* object, const surgescript_var_t* param[], int num_params);
 static void create_getter(surgescript_parser_t* parser, surgescript_nodecontext_t context, const char* identifier);
 static void create_setter(surgescript_parser_t* parser, surgescript_nodecontext_t context, const char* identifier);
 static void import_public_vars(surgescript_parser_t* parser, surgescript_nodecontext_t context, const char* object_name);
@@ -74,6 +74,7 @@ static void make_accessor(const char* fun_name, void* symtable);
 static void init_plugins_list(surgescript_parser_t* parser);
 static void add_to_plugins_list(surgescript_parser_t* parser, const char* plugin_name);
 static void release_plugins_list(surgescript_parser_t* parser);
+static void add_to_isolated_list(surgescript_parser_t* parser, const char* object_name);
 static surgescript_symtable_t* configure_base_table(surgescript_symtable_t* base_table);
 static void read_annotations(surgescript_parser_t* parser, char*** annotations);
 static void release_annotations(char** annotations);
@@ -83,6 +84,7 @@ static void pick_non_natives(const char* program_name, void* data);
 static void remove_object_definition(surgescript_programpool_t* pool, const char* object_name);
 static bool forbid_duplicates(const surgescript_parser_t* parser, const char* object_name);
 static bool is_state_context(surgescript_nodecontext_t context);
+static void assignstate(surgescript_parser_t* parser, surgescript_nodecontext_t context, int first_line);
 static char* randstr(char* buf, size_t size);
 static bool is_large_name(const char* name);
 static bool is_valid_name(const char* name);
@@ -224,6 +226,16 @@ void surgescript_parser_foreach_plugin(surgescript_parser_t* parser, void* data,
         fun(parser->known_plugins[i], data);
 }
 
+/*
+ * surgescript_parser_foreach_isolated()
+ * Calls fun() for each isolated object found in any parsed script
+ */
+void surgescript_parser_foreach_isolated(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*))
+{
+    for(int i = 0; i < ssarray_length(parser->known_isolated); i++)
+        fun(parser->known_isolated[i], data);
+}
+
 
 
 /*
@@ -404,8 +416,10 @@ void validate_object(surgescript_parser_t* parser, surgescript_nodecontext_t con
     /* do we have a "main" state? */
     if(!surgescript_programpool_exists(parser->program_pool, context.object_name, "state:main")) {
         if(strcmp(context.object_name, "Application") != 0) {
-            surgescript_program_t* cprogram = surgescript_program_create_native(0, empty_main);
-            surgescript_programpool_put(parser->program_pool, context.object_name, "state:main", cprogram);
+            /* an empty "main" state; empty states aren't run by the objects */
+            surgescript_nodecontext_t main_context = nodecontext(context.source_file, context.object_name, "state:main", context.symtable, surgescript_program_create(0));
+            emit_function_footer(main_context, 0, emit_function_header(main_context));
+            surgescript_programpool_put(parser->program_pool, context.object_name, "state:main", main_context.program);
             /*sslog("Object \"%s\" in \"%s\" has omitted its \"main\" state and will be disabled.", context.object_name, context.source_file);*/
         }
         else
@@ -413,15 +427,6 @@ void validate_object(surgescript_parser_t* parser, surgescript_nodecontext_t con
     }
 }
 
-/* an empty "main" state */
-surgescript_var_t* empty_main(surgescript_object_t* object, const surgescript_var_t* param[], int num_params)
-{
-    /* disable the object for optimization purposes?
-       no! what about the children? */
-    /*surgescript_object_set_active(object, false);*/
-    return NULL;
-}
-
 /* create a getter for the variable named identifier */
 void create_getter(surgescript_parser_t* parser, surgescript_nodecontext_t context, const char* identifier)
 {
@@ -506,6 +511,9 @@ void remove_object_definition(surgescript_programpool_t* pool, const char* objec
         }
         ssfree(programs);
     }
+
+    /* forget the layout of the fields */
+    surgescript_programpool_clear_fields(pool, object_name);
     
     /* FIXME: remove all tags of object_name (ps: how about tags added in C?) */
 }
@@ -535,6 +543,30 @@ bool is_state_context(surgescript_nodecontext_t context)
     return context.program_name != NULL && strncmp(context.program_name, "state:", 6) == 0;
 }
 
+/* sets the state to the value of the expression that has been emitted since the given line */
+void assignstate(surgescript_parser_t* parser, surgescript_nodecontext_t context, int first_line)
+{
+    int line = surgescript_program_count_lines(context.program) - 1;
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+
+    /* if the expression is just a string literal, resolve it to a state id
+       at compile-time. The programs of "Object" are shared by all classes
+       of objects, so they can't use state ids */
+    if(
+        line == first_line &&
+        surgescript_program_read_line(context.program, line, &op, &a, &b) &&
+        op == SSOP_MOVS && a.u == 0 &&
+        strcmp(context.object_name, "Object") != 0
+    ) {
+        const char* state_name = surgescript_program_get_text(context.program, b.u);
+        int state_id = surgescript_programpool_register_state(parser->program_pool, context.object_name, state_name);
+        emit_setstateid(context, state_id);
+    }
+    else
+        emit_setstate(context);
+}
+
 /* generates a random string, filling at most size bytes */
 /* null character included. Returns buf */
 char* randstr(char* buf, size_t size)
@@ -622,6 +654,10 @@ void object(surgescript_parser_t* parser)
             object_name = ssstrdup(randstr(buf + 5, sizeof(buf) - 5) - 5);
             context.object_name = object_name;
         }
+        else if((parser->flags & SSPARSER_RELOAD) && (strcmp(object_name, "Application") == 0 || !forbid_duplicates(parser, object_name))) {
+            sslog("Reloading object \"%s\" in %s:%d.", object_name, parser->filename, surgescript_token_linenumber(parser->lookahead));
+            remove_object_definition(parser->program_pool, object_name);
+        }
         else if((parser->flags & SSPARSER_ALLOW_DUPLICATES) && !forbid_duplicates(parser, object_name)) {
             sslog("Warning: reading duplicate definition of object \"%s\" in %s:%d.", object_name, parser->filename, surgescript_token_linenumber(parser->lookahead));
             remove_object_definition(parser->program_pool, object_name);
@@ -748,6 +784,10 @@ void vardecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
     conditionalexpr(parser, context);
     match(parser, SSTOK_SEMICOLON);
 
+    /* the heap address of a new field is the number of symbols of the object */
+    if(!surgescript_symtable_has_symbol(context.symtable, id))
+        surgescript_programpool_register_field(parser->program_pool, context.object_name, id, surgescript_symtable_local_count(context.symtable));
+
     emit_vardecl(context, id);
     if(public_var) {
         create_getter(parser, context, id);
@@ -962,9 +1002,10 @@ void assignexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context)
     }
     else if(optmatch(parser, SSTOK_STATE)) {
         if(got_type(parser, SSTOK_ASSIGNOP)) {
+            int first_line = surgescript_program_count_lines(context.program);
             match_exactly(parser, SSTOK_ASSIGNOP, "=");
             assignexpr(parser, context);
-            emit_setstate(context);
+            assignstate(parser, context, first_line);
         }
         else {
             unmatch(parser);
@@ -1255,6 +1296,7 @@ void funcallexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context
     }
 
     /* emit the function call code */
+    int receiver_line = surgescript_program_count_lines(context.program);
     emit_pushparam(context); /* push the object handle */
     if(!got_type(parser, SSTOK_RPAREN)) { /* read the parameters */
         do {
@@ -1263,7 +1305,7 @@ void funcallexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context
             emit_pushparam(context); /* push the i-th param */
         } while(optmatch(parser, SSTOK_COMMA));
     }
-    emit_funcall(context, fun_name, num_params);
+    emit_funcall(context, fun_name, num_params, receiver_line);
     emit_popparams(context, 1 + num_params); /* pop the parameters and the object handle */
 
     match(parser, SSTOK_RPAREN);
@@ -1340,18 +1382,22 @@ void constant(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 
 void arrayexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 {
+    int length = 0;
+
     emit_arrayexpr1(context);
     if(!got_type(parser, SSTOK_RBRACKET)) {
         do {
             assignexpr(parser, context);
-            emit_arrayelement(context);
+            emit_arrayelement(context, length++);
         } while(optmatch(parser, SSTOK_COMMA) && !got_type(parser, SSTOK_RBRACKET));
     }
-    emit_arrayexpr2(context);
+    emit_arrayexpr2(context, length);
 }
 
 void dictexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 {
+    int count = 0;
+
     emit_dictdecl1(context);
     if(!got_type(parser, SSTOK_RCURLY)) {
         do {
@@ -1366,10 +1412,10 @@ void dictexpr(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 
             /* read value */
             assignexpr(parser, context);
-            emit_dictdeclvalue(context);
+            emit_dictdeclvalue(context, count++);
         } while(optmatch(parser, SSTOK_COMMA) && !got_type(parser, SSTOK_RCURLY));
     }
-    emit_dictdecl2(context);
+    emit_dictdecl2(context, count);
 }
 
 /* constant expressions */
@@ -1509,7 +1555,7 @@ bool stmt(surgescript_parser_t* parser, surgescript_nodecontext_t context)
         jumpstmt(parser, context);
         return true;
     }
-    else if(got_type(parser, SSTOK_ASSERT)) {
+    else if(got_type(parser, SSTOK_ASSERT) || got_type(parser, SSTOK_WAIT) || got_type(parser, SSTOK_YIELD)) {
         miscstmt(parser, context);
         return true;
     }
@@ -1845,6 +1891,21 @@ void miscstmt(surgescript_parser_t* parser, surgescript_nodecontext_t context)
         match(parser, SSTOK_RPAREN);
         match(parser, SSTOK_SEMICOLON);
     }
+    else if(optmatch(parser, SSTOK_WAIT)) {
+        if(!is_state_context(context))
+            ssfatal("Compile Error: wait can only be used inside a state (see %s:%d).", context.source_file, surgescript_token_linenumber(parser->previous));
+        match(parser, SSTOK_LPAREN);
+        assignexpr(parser, context);
+        match(parser, SSTOK_RPAREN);
+        match(parser, SSTOK_SEMICOLON);
+        emit_wait(context);
+    }
+    else if(optmatch(parser, SSTOK_YIELD)) {
+        if(!is_state_context(context))
+            ssfatal("Compile Error: yield can only be used inside a state (see %s:%d).", context.source_file, surgescript_token_linenumber(parser->previous));
+        match(parser, SSTOK_SEMICOLON);
+        emit_yield(context);
+    }
 }
 
 /* utilities */
@@ -1871,6 +1932,7 @@ void import_public_vars(surgescript_parser_t* parser, surgescript_nodecontext_t
 void init_plugins_list(surgescript_parser_t* parser)
 {
     ssarray_init(parser->known_plugins);
+    ssarray_init(parser->known_isolated);
 }
 
 void release_plugins_list(surgescript_parser_t* parser)
@@ -1881,6 +1943,12 @@ void release_plugins_list(surgescript_parser_t* parser)
         ssfree(plugin);
     }
     ssarray_release(parser->known_plugins);
+
+    while(ssarray_length(parser->known_isolated) > 0) {
+        ssarray_pop(parser->known_isolated, plugin);
+        ssfree(plugin);
+    }
+    ssarray_release(parser->known_isolated);
 }
 
 void add_to_plugins_list(surgescript_parser_t* parser, const char* plugin_name)
@@ -1895,6 +1963,18 @@ void add_to_plugins_list(surgescript_parser_t* parser, const char* plugin_name)
     ssarray_push(parser->known_plugins, ssstrdup(plugin_name));
 }
 
+void add_to_isolated_list(surgescript_parser_t* parser, const char* object_name)
+{
+    /* won't accept repeated elements */
+    for(int i = 0; i < ssarray_length(parser->known_isolated); i++) {
+        if(strcmp(parser->known_isolated[i], object_name) == 0)
+            return;
+    }
+
+    /* add to the list */
+    ssarray_push(parser->known_isolated, ssstrdup(object_name));
+}
+
 surgescript_symtable_t* configure_base_table(surgescript_symtable_t* base_table)
 {
     const char** builtins = surgescript_objectmanager_builtin_objects(NULL);
@@ -1950,6 +2030,8 @@ void process_annotations(surgescript_parser_t* parser, char** annotations, const
             const char* annotation = *annotations++;
             if(strcmp(annotation, "@Package") == 0 || strcmp(annotation, "@Plugin") == 0)
                 add_to_plugins_list(parser, object_name);
+            else if(strcmp(annotation, "@Isolated") == 0)
+                add_to_isolated_list(parser, object_name);
             else
                 ssfatal("Compile Error: unrecognized annotation \"%s\" around object \"%s\" in %s.", annotation, object_name, parser->filename);
         }
@@ -158,6 +158,7 @@ typedef enum surgescript_parser_flags_t {
     SSPARSER_DEFAULTS = 0, /* default configuration */
     SSPARSER_ALLOW_DUPLICATES = 1, /* allow duplicate objects */
     SSPARSER_SKIP_DUPLICATES = 2, /* skip duplicate objects */
+    SSPARSER_RELOAD = 4, /* replace existing objects, including the Application (hot reloading) */
 } surgescript_parser_flags_t;
 
 /* create & destroy */
@@ -167,6 +168,7 @@ surgescript_parser_t* surgescript_parser_destroy(surgescript_parser_t* parser);
 /* operations */
 bool surgescript_parser_parse(surgescript_parser_t* parser, const char* code_in_memory, const char* filename); /* parse a script in memory with an optional filename */
 void surgescript_parser_foreach_plugin(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*)); /* foreach plugin object found in any parsed script, run fun(object_name, data) */
+void surgescript_parser_foreach_isolated(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*)); /* foreach isolated object found in any parsed script, run fun(object_name, data) */
 void surgescript_parser_set_flags(surgescript_parser_t* parser, surgescript_parser_flags_t flags); /* set parser options (flags) */
 surgescript_parser_flags_t surgescript_parser_get_flags(surgescript_parser_t* parser); /* get parser flags */
 
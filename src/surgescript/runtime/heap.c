@@ -21,6 +21,7 @@
 
 #include "heap.h"
 #include "variable.h"
+#include "snapshot.h"
 #include "../util/util.h"
 
 /* constants */
@@ -101,6 +102,27 @@ surgescript_heapptr_t surgescript_heap_malloc(surgescript_heap_t* heap)
     return surgescript_heap_malloc(heap);
 }
 
+/*
+ * surgescript_heap_reserve()
+ * Makes room for num_cells cells, so that the heap doesn't need
+ * to be resized until that many cells are allocated
+ */
+void surgescript_heap_reserve(surgescript_heap_t* heap, size_t num_cells)
+{
+    if(num_cells <= heap->size)
+        return;
+
+    if(num_cells >= SSHEAP_MAX_SIZE) { /* just in case... */
+        ssfatal("surgescript_heap_reserve(): max size exceeded.");
+        return;
+    }
+
+    heap->mem = ssrealloc(heap->mem, num_cells * sizeof(*(heap->mem)));
+    for(size_t i = heap->size; i < num_cells; i++)
+        heap->mem[i] = NULL;
+    heap->size = num_cells;
+}
+
 /*
  * surgescript_heap_free()
  * Deallocates the memory cell pointed by ptr
@@ -194,3 +216,65 @@ size_t surgescript_heap_memspent(const surgescript_heap_t* heap)
 
     return size;
 }
+
+/*
+ * surgescript_heap_snapshot()
+ * Writes the contents of the heap to a snapshot
+ */
+void surgescript_heap_snapshot(const surgescript_heap_t* heap, surgescript_snapshot_t* snapshot)
+{
+    size_t used = heap->size;
+
+    /* the free cells at the end of the heap aren't written */
+    while(used > 0 && heap->mem[used - 1] == NULL)
+        used--;
+
+    surgescript_snapshot_write_uint(snapshot, heap->size);
+    surgescript_snapshot_write_uint(snapshot, heap->ptr);
+    surgescript_snapshot_write_uint(snapshot, used);
+
+    for(size_t i = 0; i < used; i++) {
+        if(heap->mem[i] != NULL) {
+            surgescript_snapshot_write_byte(snapshot, 1);
+            surgescript_var_snapshot(heap->mem[i], snapshot);
+        }
+        else
+            surgescript_snapshot_write_byte(snapshot, 0);
+    }
+}
+
+/*
+ * surgescript_heap_restore()
+ * Replaces the contents of the heap by those stored in a snapshot
+ */
+void surgescript_heap_restore(surgescript_heap_t* heap, surgescript_snapshot_t* snapshot)
+{
+    size_t size = surgescript_snapshot_read_uint(snapshot);
+    size_t ptr = surgescript_snapshot_read_uint(snapshot);
+    size_t used = surgescript_snapshot_read_uint(snapshot);
+
+    if(size < SSHEAP_INITIAL_SIZE || size >= SSHEAP_MAX_SIZE || used > size || ptr > size) {
+        ssfatal("surgescript_heap_restore(): corrupted snapshot.");
+        return;
+    }
+
+    /* clear the heap */
+    for(size_t i = 0; i < heap->size; i++) {
+        if(heap->mem[i] != NULL)
+            heap->mem[i] = surgescript_var_destroy(heap->mem[i]);
+    }
+
+    /* read the cells */
+    heap->mem = ssrealloc(heap->mem, size * sizeof(*(heap->mem)));
+    heap->size = size;
+    heap->ptr = ptr;
+
+    for(size_t i = 0; i < size; i++) {
+        if(i < used && surgescript_snapshot_read_byte(snapshot) != 0) {
+            heap->mem[i] = surgescript_var_create();
+            surgescript_var_restore(heap->mem[i], snapshot);
+        }
+        else
+            heap->mem[i] = NULL;
+    }
+}
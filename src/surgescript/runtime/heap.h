@@ -32,11 +32,13 @@ typedef unsigned surgescript_heapptr_t;
 
 /* forward declarations */
 struct surgescript_var_t;
+struct surgescript_snapshot_t;
 
 /* public methods */
 surgescript_heap_t* surgescript_heap_create();
 surgescript_heap_t* surgescript_heap_destroy(surgescript_heap_t* heap);
 surgescript_heapptr_t surgescript_heap_malloc(surgescript_heap_t* heap);
+void surgescript_heap_reserve(surgescript_heap_t* heap, size_t num_cells);
 surgescript_heapptr_t surgescript_heap_free(surgescript_heap_t* heap, surgescript_heapptr_t ptr);
 struct surgescript_var_t* surgescript_heap_at(const surgescript_heap_t* heap, surgescript_heapptr_t ptr);
 void surgescript_heap_scan_objects(surgescript_heap_t* heap, void* userdata, bool (*callback)(unsigned,void*));
@@ -44,5 +46,7 @@ bool surgescript_heap_scan_all(surgescript_heap_t* heap, void* userdata, bool (*
 size_t surgescript_heap_size(const surgescript_heap_t* heap);
 bool surgescript_heap_validaddress(const surgescript_heap_t* heap, surgescript_heapptr_t ptr);
 size_t surgescript_heap_memspent(const surgescript_heap_t* heap);
+void surgescript_heap_snapshot(const surgescript_heap_t* heap, struct surgescript_snapshot_t* snapshot);
+void surgescript_heap_restore(surgescript_heap_t* heap, struct surgescript_snapshot_t* snapshot);
 
 #endif
@@ -0,0 +1,747 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/intrinsics.c
+ * SurgeScript intrinsics: methods of primitive values that run inline
+ *
+ * Calling a method on a primitive value, as in "abc".length or n.toString(),
+ * normally goes through the String, Number or Boolean wrapper object. Call
+ * sites whose method has an intrinsic remember it. When such a call misses
+ * its inline cache and the receiver has a primitive type, the interpreter
+ * skips the call and computes the result right away.
+ * Each intrinsic must behave exactly like the corresponding method of the
+ * wrapper object (see runtime/sslib/). If the receiver or the parameters
+ * have unexpected types, the intrinsic declines and the regular call runs.
+ *
+ * Math intrinsics are methods of the Math system object. When the compiler
+ * knows that the receiver of a call is the Math object, it replaces the call
+ * with a SSOP_MATH instruction, which runs without a call frame. They must
+ * behave exactly like the methods of runtime/sslib/math.c.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "intrinsics.h"
+#include "variable.h"
+#include "stack.h"
+#include "../util/util.h"
+#include "../third_party/utf8.h"
+
+/* math constants */
+static const double EPSILON = DBL_EPSILON;
+static const double PI = 3.14159265358979323846;
+static const double RAD2DEG = 57.29577951308232087684;
+static const double DEG2RAD = 0.01745329251994329576;
+
+/* an intrinsic computes result from param[] (param[0] is the receiver) */
+typedef bool (*surgescript_intrinsic_fun_t)(const surgescript_var_t** param, surgescript_var_t* result);
+
+/* intrinsics are indexed by method name & arity; the implementation is picked according to the type of the receiver */
+typedef struct surgescript_intrinsic_t surgescript_intrinsic_t;
+struct surgescript_intrinsic_t
+{
+    const char* fun_name; /* name of the method */
+    int num_params; /* number of parameters, not counting the receiver */
+    surgescript_intrinsic_fun_t on_string; /* implementation for strings (may be NULL) */
+    surgescript_intrinsic_fun_t on_number; /* implementation for numbers (may be NULL) */
+    surgescript_intrinsic_fun_t on_boolean; /* implementation for booleans (may be NULL) */
+};
+
+/* implementations */
+static bool string_getlength(const surgescript_var_t** param, surgescript_var_t* result);
+static bool string_get(const surgescript_var_t** param, surgescript_var_t* result);
+static bool string_indexof(const surgescript_var_t** param, surgescript_var_t* result);
+static bool string_substr(const surgescript_var_t** param, surgescript_var_t* result);
+static bool string_tostring(const surgescript_var_t** param, surgescript_var_t* result);
+static bool string_equals(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_tostring(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_valueof(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_equals(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_isfinite(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_isnan(const surgescript_var_t** param, surgescript_var_t* result);
+static bool number_isinteger(const surgescript_var_t** param, surgescript_var_t* result);
+static bool boolean_tostring(const surgescript_var_t** param, surgescript_var_t* result);
+static bool boolean_valueof(const surgescript_var_t** param, surgescript_var_t* result);
+static bool boolean_equals(const surgescript_var_t** param, surgescript_var_t* result);
+
+/* the table of intrinsics */
+static const surgescript_intrinsic_t intrinsic[] = {
+    { "get_length", 0, string_getlength, NULL, NULL },
+    { "get", 1, string_get, NULL, NULL },
+    { "indexOf", 1, string_indexof, NULL, NULL },
+    { "substr", 2, string_substr, NULL, NULL },
+    { "toString", 0, string_tostring, number_tostring, boolean_tostring },
+    { "valueOf", 0, string_tostring, number_valueof, boolean_valueof },
+    { "equals", 1, string_equals, number_equals, boolean_equals },
+    { "isFinite", 0, NULL, number_isfinite, NULL },
+    { "isNaN", 0, NULL, number_isnan, NULL },
+    { "isInteger", 0, NULL, number_isinteger, NULL }
+};
+
+static const int NUMBER_OF_INTRINSICS = sizeof(intrinsic) / sizeof(intrinsic[0]);
+static const int MAX_INTRINSIC_PARAMS = 2;
+
+/* a math intrinsic computes result from the numeric values of its parameters */
+typedef void (*surgescript_mathintrinsic_fun_t)(const double* x, surgescript_var_t* result);
+
+/* math intrinsics are indexed by method name & arity */
+typedef struct surgescript_mathintrinsic_t surgescript_mathintrinsic_t;
+struct surgescript_mathintrinsic_t
+{
+    const char* fun_name; /* name of the method of the Math object */
+    int num_params; /* number of parameters */
+    surgescript_mathintrinsic_fun_t fun; /* implementation */
+};
+
+/* implementations */
+static void math_getepsilon(const double* x, surgescript_var_t* result);
+static void math_getpi(const double* x, surgescript_var_t* result);
+static void math_getinfinity(const double* x, surgescript_var_t* result);
+static void math_getnan(const double* x, surgescript_var_t* result);
+static void math_random(const double* x, surgescript_var_t* result);
+static void math_sin(const double* x, surgescript_var_t* result);
+static void math_cos(const double* x, surgescript_var_t* result);
+static void math_tan(const double* x, surgescript_var_t* result);
+static void math_asin(const double* x, surgescript_var_t* result);
+static void math_acos(const double* x, surgescript_var_t* result);
+static void math_atan(const double* x, surgescript_var_t* result);
+static void math_atan2(const double* x, surgescript_var_t* result);
+static void math_deg2rad(const double* x, surgescript_var_t* result);
+static void math_rad2deg(const double* x, surgescript_var_t* result);
+static void math_pow(const double* x, surgescript_var_t* result);
+static void math_sqrt(const double* x, surgescript_var_t* result);
+static void math_exp(const double* x, surgescript_var_t* result);
+static void math_log(const double* x, surgescript_var_t* result);
+static void math_log10(const double* x, surgescript_var_t* result);
+static void math_floor(const double* x, surgescript_var_t* result);
+static void math_ceil(const double* x, surgescript_var_t* result);
+static void math_round(const double* x, surgescript_var_t* result);
+static void math_trunc(const double* x, surgescript_var_t* result);
+static void math_mod(const double* x, surgescript_var_t* result);
+static void math_sign(const double* x, surgescript_var_t* result);
+static void math_signum(const double* x, surgescript_var_t* result);
+static void math_abs(const double* x, surgescript_var_t* result);
+static void math_min(const double* x, surgescript_var_t* result);
+static void math_max(const double* x, surgescript_var_t* result);
+static void math_clamp(const double* x, surgescript_var_t* result);
+static void math_approximately(const double* x, surgescript_var_t* result);
+static void math_lerp(const double* x, surgescript_var_t* result);
+static void math_smoothstep(const double* x, surgescript_var_t* result);
+static void math_lerpangle(const double* x, surgescript_var_t* result);
+static void math_deltaangle(const double* x, surgescript_var_t* result);
+static inline double clamp01(double t);
+
+/* the table of math intrinsics */
+static const surgescript_mathintrinsic_t math_intrinsic[] = {
+    { "get_epsilon", 0, math_getepsilon },
+    { "get_pi", 0, math_getpi },
+    { "get_infinity", 0, math_getinfinity },
+    { "get_NaN", 0, math_getnan },
+    { "random", 0, math_random },
+    { "sin", 1, math_sin },
+    { "cos", 1, math_cos },
+    { "tan", 1, math_tan },
+    { "asin", 1, math_asin },
+    { "acos", 1, math_acos },
+    { "atan", 1, math_atan },
+    { "atan2", 2, math_atan2 },
+    { "deg2rad", 1, math_deg2rad },
+    { "rad2deg", 1, math_rad2deg },
+    { "pow", 2, math_pow },
+    { "sqrt", 1, math_sqrt },
+    { "exp", 1, math_exp },
+    { "log", 1, math_log },
+    { "log10", 1, math_log10 },
+    { "floor", 1, math_floor },
+    { "ceil", 1, math_ceil },
+    { "round", 1, math_round },
+    { "trunc", 1, math_trunc },
+    { "mod", 2, math_mod },
+    { "sign", 1, math_sign },
+    { "signum", 1, math_signum },
+    { "abs", 1, math_abs },
+    { "min", 2, math_min },
+    { "max", 2, math_max },
+    { "clamp", 3, math_clamp },
+    { "approximately", 2, math_approximately },
+    { "lerp", 3, math_lerp },
+    { "smoothstep", 3, math_smoothstep },
+    { "lerpAngle", 3, math_lerpangle },
+    { "deltaAngle", 2, math_deltaangle }
+};
+
+static const int NUMBER_OF_MATH_INTRINSICS = sizeof(math_intrinsic) / sizeof(math_intrinsic[0]);
+#define MAX_MATH_INTRINSIC_PARAMS 3
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_intrinsic_find()
+ * Finds the intrinsic of a method call, given its name and number of
+ * parameters. Returns -1 if there is no such intrinsic
+ */
+int surgescript_intrinsic_find(const char* fun_name, int num_params)
+{
+    for(int i = 0; i < NUMBER_OF_INTRINSICS; i++) {
+        if(intrinsic[i].num_params == num_params && strcmp(intrinsic[i].fun_name, fun_name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * surgescript_intrinsic_arity()
+ * The number of parameters of an intrinsic, not counting the receiver
+ */
+int surgescript_intrinsic_arity(int intrinsic_id)
+{
+    ssassert(intrinsic_id >= 0 && intrinsic_id < NUMBER_OF_INTRINSICS);
+    return intrinsic[intrinsic_id].num_params;
+}
+
+/*
+ * surgescript_intrinsic_run()
+ * Runs an intrinsic. The receiver and the parameters are expected to be at
+ * the top of the stack, stacked in left-to-right order, as in a method call.
+ * Returns false, leaving result untouched, if the intrinsic doesn't apply
+ */
+bool surgescript_intrinsic_run(int intrinsic_id, const surgescript_stack_t* stack, surgescript_var_t* result)
+{
+    const surgescript_intrinsic_t* in = &intrinsic[intrinsic_id];
+    const surgescript_var_t* param[1 + MAX_INTRINSIC_PARAMS];
+    surgescript_intrinsic_fun_t fun;
+
+    /* pick the implementation according to the type of the receiver */
+    param[0] = surgescript_stack_peek_top(stack, -in->num_params);
+    if(surgescript_var_is_string(param[0]))
+        fun = in->on_string;
+    else if(surgescript_var_is_number(param[0]))
+        fun = in->on_number;
+    else if(surgescript_var_is_bool(param[0]))
+        fun = in->on_boolean;
+    else
+        return false;
+
+    if(fun == NULL)
+        return false;
+
+    /* grab the parameters */
+    for(int i = 1; i <= in->num_params; i++)
+        param[i] = surgescript_stack_peek_top(stack, i - in->num_params);
+
+    /* done! */
+    return fun(param, result);
+}
+
+
+
+/*
+ * surgescript_mathintrinsic_find()
+ * Finds the intrinsic of a method of the Math object, given its name and
+ * number of parameters. Returns -1 if there is no such intrinsic
+ */
+int surgescript_mathintrinsic_find(const char* fun_name, int num_params)
+{
+    for(int i = 0; i < NUMBER_OF_MATH_INTRINSICS; i++) {
+        if(math_intrinsic[i].num_params == num_params && strcmp(math_intrinsic[i].fun_name, fun_name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * surgescript_mathintrinsic_run()
+ * Runs a math intrinsic. Its parameters are expected to be at the top of the
+ * stack, stacked in left-to-right order, as in a method call
+ */
+void surgescript_mathintrinsic_run(int intrinsic_id, const surgescript_stack_t* stack, surgescript_var_t* result)
+{
+    const surgescript_mathintrinsic_t* in = &math_intrinsic[intrinsic_id];
+    double x[MAX_MATH_INTRINSIC_PARAMS];
+
+    /* grab the parameters */
+    for(int i = 0; i < in->num_params; i++)
+        x[i] = surgescript_var_get_number(surgescript_stack_peek_top(stack, 1 + i - in->num_params));
+
+    /* done! */
+    in->fun(x, result);
+}
+
+/*
+ * surgescript_mathintrinsic_is_numeric()
+ * Does a math intrinsic always produce a number? (used in type inference)
+ */
+bool surgescript_mathintrinsic_is_numeric(int intrinsic_id)
+{
+    ssassert(intrinsic_id >= 0 && intrinsic_id < NUMBER_OF_MATH_INTRINSICS);
+    return math_intrinsic[intrinsic_id].fun != math_approximately; /* approximately() returns a boolean */
+}
+
+
+
+/* -------------------------------
+ * private
+ * ------------------------------- */
+
+/* String.length */
+bool string_getlength(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    const char* str = surgescript_var_fast_get_string(param[0]);
+    surgescript_var_set_number(result, u8_strlen(str));
+    return true;
+}
+
+/* String.get(index): character at */
+bool string_get(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    const char* str;
+    char chr[7] = { 0 };
+    int index;
+
+    if(!surgescript_var_is_number(param[1]))
+        return false;
+
+    str = surgescript_var_fast_get_string(param[0]);
+    index = (int)surgescript_var_get_number(param[1]);
+    if(index >= 0 && index < u8_strlen(str)) {
+        size_t offset = u8_offset(str, index);
+        size_t seq_len = u8_seqlen(str + offset);
+        for(int i = 0; i < sizeof(chr) - 1 && seq_len--; i++)
+            chr[i] = str[offset + i];
+    }
+
+    surgescript_var_set_string(result, chr);
+    return true;
+}
+
+/* String.indexOf(needle): first occurrence of a string */
+bool string_indexof(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    const char* haystack, *needle, *occurrence;
+
+    if(!surgescript_var_is_string(param[1]))
+        return false;
+
+    haystack = surgescript_var_fast_get_string(param[0]);
+    needle = surgescript_var_fast_get_string(param[1]);
+    occurrence = strstr(haystack, needle);
+    surgescript_var_set_number(result, occurrence ? (int)u8_charnum(haystack, occurrence - haystack) : -1);
+    return true;
+}
+
+/* String.substr(start, length) */
+bool string_substr(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    const char* str, *begin, *end;
+    char buf[256], *substr;
+    int start, length, utf8len;
+
+    if(!surgescript_var_is_number(param[1]) || !surgescript_var_is_number(param[2]))
+        return false;
+
+    str = surgescript_var_fast_get_string(param[0]);
+    utf8len = u8_strlen(str);
+    start = surgescript_var_get_number(param[1]);
+    length = surgescript_var_get_number(param[2]);
+
+    /* sanity check */
+    if(start < 0) {
+        if(utf8len == 0)
+            return false; /* let the wrapper handle this */
+        start = utf8len - (-start % utf8len);
+    }
+    else if(start > utf8len)
+        start = utf8len;
+    length = ssclamp(length, 0, utf8len - start);
+
+    /* extract the substring */
+    begin = str + u8_offset(str, start);
+    end = str + u8_offset(str, start + length);
+    ssassert(end >= begin);
+    substr = (end - begin) < sizeof(buf) ? buf : ssmalloc((1 + end - begin) * sizeof(*substr));
+    surgescript_util_strncpy(substr, begin, 1 + end - begin);
+
+    /* done! */
+    surgescript_var_set_string(result, substr);
+    if(substr != buf)
+        ssfree(substr);
+    return true;
+}
+
+/* String.toString(), String.valueOf() */
+bool string_tostring(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    surgescript_var_copy(result, param[0]);
+    return true;
+}
+
+/* String.equals(x) */
+bool string_equals(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    if(surgescript_var_sametype(param[0], param[1])) {
+        const char* a = surgescript_var_fast_get_string(param[0]);
+        const char* b = surgescript_var_fast_get_string(param[1]);
+        surgescript_var_set_bool(result, strcmp(a, b) == 0);
+    }
+    else
+        surgescript_var_set_bool(result, false);
+
+    return true;
+}
+
+/* Number.toString() */
+bool number_tostring(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    char buf[32];
+    surgescript_var_set_string(result, surgescript_var_to_string(param[0], buf, sizeof(buf)));
+    return true;
+}
+
+/* Number.valueOf() */
+bool number_valueof(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, surgescript_var_get_number(param[0]));
+    return true;
+}
+
+/* Number.equals(x) */
+bool number_equals(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    if(surgescript_var_sametype(param[0], param[1])) {
+        double a = surgescript_var_get_number(param[0]);
+        double b = surgescript_var_get_number(param[1]);
+        double ma = fabs(a), mb = fabs(b);
+        surgescript_var_set_bool(result, (a == b) || fabs(a - b) <= ssmax(ma, mb) * FLT_EPSILON);
+    }
+    else
+        surgescript_var_set_bool(result, false);
+
+    return true;
+}
+
+/* Number.isFinite() */
+bool number_isfinite(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    double x = surgescript_var_get_number(param[0]);
+    surgescript_var_set_bool(result, isfinite(x));
+    return true;
+}
+
+/* Number.isNaN() */
+bool number_isnan(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    double x = surgescript_var_get_number(param[0]);
+    surgescript_var_set_bool(result, isnan(x));
+    return true;
+}
+
+/* Number.isInteger() */
+bool number_isinteger(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    double x = surgescript_var_get_number(param[0]);
+    surgescript_var_set_bool(result, isfinite(x) && x == ceil(x));
+    return true;
+}
+
+/* Boolean.toString() */
+bool boolean_tostring(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    surgescript_var_set_string(result, surgescript_var_get_bool(param[0]) ? "true" : "false");
+    return true;
+}
+
+/* Boolean.valueOf() */
+bool boolean_valueof(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    surgescript_var_set_bool(result, surgescript_var_get_bool(param[0]));
+    return true;
+}
+
+/* Boolean.equals(x) */
+bool boolean_equals(const surgescript_var_t** param, surgescript_var_t* result)
+{
+    if(surgescript_var_sametype(param[0], param[1])) {
+        bool a = surgescript_var_get_bool(param[0]);
+        bool b = surgescript_var_get_bool(param[1]);
+        surgescript_var_set_bool(result, a == b);
+    }
+    else
+        surgescript_var_set_bool(result, false);
+
+    return true;
+}
+
+/* Math.epsilon */
+void math_getepsilon(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, EPSILON);
+}
+
+/* Math.pi */
+void math_getpi(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, PI);
+}
+
+/* Math.infinity */
+void math_getinfinity(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, INFINITY);
+}
+
+/* Math.NaN */
+void math_getnan(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, NAN);
+}
+
+/* Math.random() */
+void math_random(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, surgescript_util_random());
+}
+
+/* Math.sin(x) */
+void math_sin(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, sin(x[0]));
+}
+
+/* Math.cos(x) */
+void math_cos(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, cos(x[0]));
+}
+
+/* Math.tan(x) */
+void math_tan(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, tan(x[0]));
+}
+
+/* Math.asin(x) */
+void math_asin(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, asin(x[0]));
+}
+
+/* Math.acos(x) */
+void math_acos(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, acos(x[0]));
+}
+
+/* Math.atan(x) */
+void math_atan(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, atan(x[0]));
+}
+
+/* Math.atan2(y, x) */
+void math_atan2(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, atan2(x[0], x[1]));
+}
+
+/* Math.deg2rad(x) */
+void math_deg2rad(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, x[0] * DEG2RAD);
+}
+
+/* Math.rad2deg(x) */
+void math_rad2deg(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, x[0] / DEG2RAD);
+}
+
+/* Math.pow(base, exponent) */
+void math_pow(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, pow(x[0], x[1]));
+}
+
+/* Math.sqrt(x) */
+void math_sqrt(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, sqrt(x[0]));
+}
+
+/* Math.exp(x) */
+void math_exp(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, exp(x[0]));
+}
+
+/* Math.log(x) */
+void math_log(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, log(x[0]));
+}
+
+/* Math.log10(x) */
+void math_log10(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, log10(x[0]));
+}
+
+/* Math.floor(x) */
+void math_floor(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, floor(x[0]));
+}
+
+/* Math.ceil(x) */
+void math_ceil(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, ceil(x[0]));
+}
+
+/* Math.round(x): round half away from zero */
+void math_round(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, (x[0] >= 0.0) ? floor(x[0] + 0.5) : ceil(x[0] - 0.5));
+}
+
+/* Math.trunc(x) */
+void math_trunc(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, trunc(x[0]));
+}
+
+/* Math.mod(x, y): see runtime/sslib/math.c */
+void math_mod(const double* x, surgescript_var_t* result)
+{
+    double remainder = fmod(x[0], x[1]);
+    surgescript_var_set_number(result, fmod(remainder + x[1], x[1]));
+}
+
+/* Math.sign(x) */
+void math_sign(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, copysign(1.0, x[0]));
+}
+
+/* Math.signum(x) */
+void math_signum(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, (0.0 < x[0]) - (x[0] < 0.0));
+}
+
+/* Math.abs(x) */
+void math_abs(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, fabs(x[0]));
+}
+
+/* Math.min(x, y) */
+void math_min(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, (x[0] < x[1]) ? x[0] : x[1]);
+}
+
+/* Math.max(x, y) */
+void math_max(const double* x, surgescript_var_t* result)
+{
+    surgescript_var_set_number(result, (x[0] >= x[1]) ? x[0] : x[1]);
+}
+
+/* Math.clamp(x, min, max) */
+void math_clamp(const double* x, surgescript_var_t* result)
+{
+    double minval = x[1], maxval = x[2];
+
+    if(minval > maxval) {
+        double tmp = minval;
+        minval = maxval;
+        maxval = tmp;
+    }
+
+    surgescript_var_set_number(result, (x[0] >= minval) ? (x[0] <= maxval ? x[0] : maxval) : minval);
+}
+
+/* Math.approximately(a, b) */
+void math_approximately(const double* x, surgescript_var_t* result)
+{
+    double fa = fabs(x[0]), fb = fabs(x[1]);
+    double fm = ssmax(fa, fb);
+    double eps = EPSILON * ssmax(fm, 1.0);
+    surgescript_var_set_bool(result, (x[0] >= x[1] - eps) && (x[0] <= x[1] + eps));
+}
+
+/* Math.lerp(a, b, t) */
+void math_lerp(const double* x, surgescript_var_t* result)
+{
+    double t = clamp01(x[2]);
+    surgescript_var_set_number(result, (x[1] - x[0]) * t + x[0]);
+}
+
+/* Math.smoothstep(a, b, t) */
+void math_smoothstep(const double* x, surgescript_var_t* result)
+{
+    double t = clamp01(x[2]);
+    t = (t * t) * (3.0 - 2.0 * t);
+    surgescript_var_set_number(result, (x[1] - x[0]) * t + x[0]);
+}
+
+/* Math.lerpAngle(alpha, beta, t): see runtime/sslib/math.c */
+void math_lerpangle(const double* x, surgescript_var_t* result)
+{
+    double alpha = x[0] * DEG2RAD;
+    double beta = x[1] * DEG2RAD;
+    double t = clamp01(x[2]);
+    double theta;
+
+    double vx = cos(alpha);
+    double vy = sin(alpha);
+    double ux = cos(beta);
+    double uy = sin(beta);
+
+    double dot = ux * vx + uy * vy;
+    if(fabs(dot + 1.0) < 1e-5) {
+        theta = alpha + t * PI;
+    }
+    else {
+        double r = 1.0 - t;
+        double wx = r * vx + t * ux;
+        double wy = r * vy + t * uy;
+        theta = atan2(wy, wx);
+    }
+
+    surgescript_var_set_number(result, fmod(theta * RAD2DEG, 360.0));
+}
+
+/* Math.deltaAngle(a, b) */
+void math_deltaangle(const double* x, surgescript_var_t* result)
+{
+    double alpha = x[0] * DEG2RAD;
+    double beta = x[1] * DEG2RAD;
+    double cos_delta = cos(alpha) * cos(beta) + sin(alpha) * sin(beta);
+    surgescript_var_set_number(result, acos(cos_delta) * RAD2DEG);
+}
+
+/* clamps t to the [0,1] range */
+double clamp01(double t)
+{
+    return t + (t > 1.0) * (1.0 - t) - (t < 0.0) * t;
+}
@@ -0,0 +1,39 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/intrinsics.h
+ * SurgeScript intrinsics: methods of primitive values & of the Math object that run inline
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_INTRINSICS_H
+#define _SURGESCRIPT_RUNTIME_INTRINSICS_H
+
+#include <stdbool.h>
+
+/* forward declarations */
+struct surgescript_var_t;
+struct surgescript_stack_t;
+
+int surgescript_intrinsic_find(const char* fun_name, int num_params); /* the id of an intrinsic, or -1 if there is none */
+int surgescript_intrinsic_arity(int intrinsic_id); /* the number of parameters of an intrinsic (the receiver is not counted) */
+bool surgescript_intrinsic_run(int intrinsic_id, const struct surgescript_stack_t* stack, struct surgescript_var_t* result); /* runs an intrinsic on the receiver & parameters at the top of the stack; returns false if they have unexpected types */
+
+int surgescript_mathintrinsic_find(const char* fun_name, int num_params); /* the id of an intrinsic of the Math object, or -1 if there is none */
+void surgescript_mathintrinsic_run(int intrinsic_id, const struct surgescript_stack_t* stack, struct surgescript_var_t* result); /* runs a math intrinsic on the parameters at the top of the stack */
+bool surgescript_mathintrinsic_is_numeric(int intrinsic_id); /* does a math intrinsic always produce a number? */
+
+#endif
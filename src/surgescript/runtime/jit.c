@@ -0,0 +1,711 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/jit.c
+ * SurgeScript template JIT compiler (x86-64 and AArch64 Linux)
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "jit.h"
+#include "program.h"
+#include "variable.h"
+#include "stack.h"
+#include "renv.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+#if SURGESCRIPT_ENABLE_JIT
+
+#include <sys/mman.h>
+
+/*
+ * Hot programs are translated to machine code stitched from per-opcode
+ * templates. A template loads the operands of its instruction into the
+ * argument registers and calls a function of the runtime. Jumps become
+ * native branches. Complex instructions (calls, states, heap operations...)
+ * are delegated to the interpreter with surgescript_program_run_line(),
+ * and a guard exits the machine code whenever the interpreter returns an
+ * unexpected line (e.g., when an OPTCALL is de-optimized). The runtime
+ * then re-enters the machine code at that line.
+ *
+ * The machine code is called as a C function. Its prologue stores the
+ * program, the runtime environment, the temps and the stack in callee-saved
+ * registers and jumps to the entry point of the requested line. Its epilogue
+ * returns the next line to be run.
+ */
+
+/* the machine code of a program */
+struct surgescript_jit_t
+{
+    uint8_t* code; /* executable memory */
+    size_t size; /* size of the mapping */
+    uint32_t* entry; /* entry[line] is the offset of the machine code of a line */
+};
+
+/* the signature of the machine code */
+typedef unsigned (*jitcode_t)(surgescript_program_t*, const surgescript_renv_t*, const uint8_t*, surgescript_var_t**, surgescript_stack_t*);
+
+/* arguments passed to the functions called by the templates */
+typedef enum jitargtype_t { JITARG_TEMP, JITARG_IMM, JITARG_PROGRAM, JITARG_RENV, JITARG_STACK } jitargtype_t;
+typedef struct jitarg_t { jitargtype_t type; uint64_t value; } jitarg_t;
+#define TEMP(k)         ((jitarg_t){ JITARG_TEMP, (k) & 3 })
+#define IMM(x)          ((jitarg_t){ JITARG_IMM, (uint64_t)(x) })
+#define PROGRAM()       ((jitarg_t){ JITARG_PROGRAM, 0 })
+#define RENV()          ((jitarg_t){ JITARG_RENV, 0 })
+#define STACK()         ((jitarg_t){ JITARG_STACK, 0 })
+#define MAX_JIT_ARGS    4
+
+/* a branch to be patched once the offsets of all lines are known */
+typedef struct jitfixup_t { size_t at; unsigned line; } jitfixup_t;
+#define EXIT_LINE       (~0u)
+
+/* machine code being generated */
+typedef struct jitbuf_t jitbuf_t;
+struct jitbuf_t
+{
+    SSARRAY(uint8_t, byte);
+    SSARRAY(jitfixup_t, fixup);
+};
+
+/* condition of a branch taken after a call, given its return value */
+typedef enum jitcond_t { JIT_EQ, JIT_NE } jitcond_t;
+
+/* backend */
+static void emit_prologue(jitbuf_t* buf);
+static void emit_epilogue(jitbuf_t* buf);
+static void emit_call(jitbuf_t* buf, void (*fn)(void), const jitarg_t* arg, int argc);
+static void emit_jump(jitbuf_t* buf, unsigned line);
+static void emit_jump_if_result(jitbuf_t* buf, jitcond_t cond, unsigned value, unsigned line);
+static void emit_jump_if_true(jitbuf_t* buf, unsigned line);
+static void emit_return(jitbuf_t* buf, unsigned value);
+static void patch_jump(jitbuf_t* buf, size_t at, size_t target);
+
+/* templates */
+static void emit_line(jitbuf_t* buf, surgescript_program_t* program, unsigned line);
+static void emit_interpreted_line(jitbuf_t* buf, unsigned line, unsigned next_line);
+#define CALL(buf, fn, ...) do { \
+    const jitarg_t _arg[] = { __VA_ARGS__ }; \
+    emit_call((buf), (void(*)(void))(fn), _arg, sizeof(_arg) / sizeof(_arg[0])); \
+} while(0)
+
+/* helpers */
+static inline void emit8(jitbuf_t* buf, uint8_t x) { ssarray_push(buf->byte, x); }
+static inline void emit32(jitbuf_t* buf, uint32_t x) { for(int i = 0; i < 4; i++, x >>= 8) emit8(buf, x & 0xFF); }
+static inline void emit64(jitbuf_t* buf, uint64_t x) { for(int i = 0; i < 8; i++, x >>= 8) emit8(buf, x & 0xFF); }
+static inline void add_fixup(jitbuf_t* buf, unsigned line) { jitfixup_t f = { ssarray_length(buf->byte), line }; ssarray_push(buf->fixup, f); }
+static inline uint32_t read32(const jitbuf_t* buf, size_t at) { uint32_t x = 0; for(int i = 3; i >= 0; i--) x = (x << 8) | buf->byte[at + i]; return x; }
+static inline void write32(jitbuf_t* buf, size_t at, uint32_t x) { for(int i = 0; i < 4; i++, x >>= 8) buf->byte[at + i] = x & 0xFF; }
+
+/* functions called by the templates */
+static void jit_movb(surgescript_var_t* x, uint64_t b) { surgescript_var_set_bool(x, b != 0); }
+static void jit_movf(surgescript_var_t* x, uint64_t bits) { double f; memcpy(&f, &bits, sizeof(f)); surgescript_var_set_number(x, f); }
+static void jit_movs(const surgescript_program_t* program, surgescript_var_t* x, int index) { surgescript_var_set_string(x, surgescript_program_get_text(program, index)); }
+static void jit_push(surgescript_stack_t* stack, const surgescript_var_t* x) { surgescript_stack_push(stack, surgescript_var_clone(x)); }
+static void jit_pop(surgescript_stack_t* stack, surgescript_var_t* x) { surgescript_var_copy(x, surgescript_stack_top(stack)); surgescript_stack_pop(stack); }
+static void jit_speek(const surgescript_stack_t* stack, surgescript_var_t* x, int offset) { surgescript_var_copy(x, surgescript_stack_peek(stack, offset)); }
+static void jit_inc(surgescript_var_t* x) { surgescript_var_set_number(x, surgescript_var_get_number(x) + 1); }
+static void jit_dec(surgescript_var_t* x) { surgescript_var_set_number(x, surgescript_var_get_number(x) - 1); }
+static void jit_incx(surgescript_var_t* x) { surgescript_var_set_rawbits(x, surgescript_var_get_rawbits(x) + 1); }
+static void jit_decx(surgescript_var_t* x) { surgescript_var_set_rawbits(x, surgescript_var_get_rawbits(x) - 1); }
+static void jit_add(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_get_number(x) + surgescript_var_get_number(y)); }
+static void jit_sub(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_get_number(x) - surgescript_var_get_number(y)); }
+static void jit_mul(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_get_number(x) * surgescript_var_get_number(y)); }
+static void jit_div(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_get_number(x) / surgescript_var_get_number(y)); }
+static void jit_rem(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, fmod(surgescript_var_get_number(x), surgescript_var_get_number(y))); }
+static void jit_neg(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, -surgescript_var_get_number(y)); }
+static void jit_lnot(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_bool(x, !surgescript_var_get_bool(y)); }
+static void jit_lnot2(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_bool(x, surgescript_var_get_bool(y)); }
+static void jit_not(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(x, ~surgescript_var_get_rawbits(y)); }
+static void jit_and(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(x, surgescript_var_get_rawbits(x) & surgescript_var_get_rawbits(y)); }
+static void jit_or(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(x, surgescript_var_get_rawbits(x) | surgescript_var_get_rawbits(y)); }
+static void jit_xor(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(x, surgescript_var_get_rawbits(x) ^ surgescript_var_get_rawbits(y)); }
+static void jit_fadd(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_fast_get_number(x) + surgescript_var_fast_get_number(y)); }
+static void jit_fsub(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_fast_get_number(x) - surgescript_var_fast_get_number(y)); }
+static void jit_fmul(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_fast_get_number(x) * surgescript_var_fast_get_number(y)); }
+static void jit_fdiv(surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_number(x, surgescript_var_fast_get_number(x) / surgescript_var_fast_get_number(y)); }
+static void jit_test(surgescript_var_t* t2, const surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(t2, surgescript_var_get_rawbits(x) & surgescript_var_get_rawbits(y)); }
+static void jit_test1(surgescript_var_t* t2, const surgescript_var_t* x) { surgescript_var_set_rawbits(t2, surgescript_var_get_rawbits(x)); }
+static void jit_tchk(surgescript_var_t* t2, const surgescript_var_t* x, int code) { surgescript_var_set_rawbits(t2, surgescript_var_typecheck(x, code)); }
+static void jit_tc01(surgescript_var_t* t2, const surgescript_var_t* t0, const surgescript_var_t* t1, int code) { surgescript_var_set_rawbits(t2, surgescript_var_typecheck(t0, code) & surgescript_var_typecheck(t1, code)); }
+static void jit_tcmp(surgescript_var_t* t2, const surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(t2, surgescript_var_typecode(x) ^ surgescript_var_typecode(y)); }
+static void jit_cmp(surgescript_var_t* t2, const surgescript_var_t* x, const surgescript_var_t* y) { surgescript_var_set_rawbits(t2, surgescript_var_compare(x, y)); }
+static void jit_fcmp(surgescript_var_t* t2, const surgescript_var_t* x, const surgescript_var_t* y) { double a = surgescript_var_fast_get_number(x), b = surgescript_var_fast_get_number(y); surgescript_var_set_rawbits(t2, isgreater(a, b) - isless(a, b)); }
+static int jit_je(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) == 0; }
+static int jit_jne(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) != 0; }
+static int jit_jl(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) < 0; }
+static int jit_jg(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) > 0; }
+static int jit_jle(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) <= 0; }
+static int jit_jge(const surgescript_var_t* t2) { return surgescript_var_get_rawbits(t2) >= 0; }
+
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_jit_compile()
+ * Translates a program to machine code. Returns NULL on failure
+ */
+surgescript_jit_t* surgescript_jit_compile(surgescript_program_t* program)
+{
+    unsigned length = surgescript_program_count_lines(program);
+    uint32_t* entry = ssmalloc((length + 1) * sizeof(*entry));
+    surgescript_jit_t* jit = NULL;
+    size_t exit_offset, size;
+    jitbuf_t buf;
+
+    /* generate the machine code */
+    ssarray_init_ex(buf.byte, 64 + 32 * length);
+    ssarray_init(buf.fixup);
+
+    emit_prologue(&buf);
+    for(unsigned line = 0; line < length; line++) {
+        entry[line] = ssarray_length(buf.byte);
+        emit_line(&buf, program, line);
+    }
+
+    entry[length] = ssarray_length(buf.byte);
+    emit_return(&buf, length);
+
+    exit_offset = ssarray_length(buf.byte);
+    emit_epilogue(&buf);
+
+    /* link the branches */
+    for(int i = 0; i < ssarray_length(buf.fixup); i++) {
+        unsigned line = buf.fixup[i].line;
+        patch_jump(&buf, buf.fixup[i].at, line != EXIT_LINE ? entry[line] : exit_offset);
+    }
+
+    /* copy the machine code to executable memory */
+    size = ssarray_length(buf.byte);
+    void* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code != MAP_FAILED) {
+        memcpy(code, buf.byte, size);
+        if(mprotect(code, size, PROT_READ | PROT_EXEC) == 0) {
+#if defined(__aarch64__)
+            __builtin___clear_cache((char*)code, (char*)code + size);
+#endif
+            jit = ssmalloc(sizeof *jit);
+            jit->code = code;
+            jit->size = size;
+            jit->entry = entry;
+            entry = NULL;
+        }
+        else
+            munmap(code, size);
+    }
+
+    /* done */
+    if(jit == NULL)
+        sslog("Can't allocate executable memory for the JIT compiler");
+
+    ssarray_release(buf.fixup);
+    ssarray_release(buf.byte);
+    if(entry != NULL)
+        ssfree(entry);
+
+    return jit;
+}
+
+/*
+ * surgescript_jit_destroy()
+ * Releases the machine code of a program
+ */
+surgescript_jit_t* surgescript_jit_destroy(surgescript_jit_t* jit)
+{
+    munmap(jit->code, jit->size);
+    ssfree(jit->entry);
+    return ssfree(jit);
+}
+
+/*
+ * surgescript_jit_run()
+ * Runs the machine code of a program starting at the given line, until
+ * a guard exits it or the program returns. Returns the next line to be run
+ */
+unsigned surgescript_jit_run(const surgescript_jit_t* jit, surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned line)
+{
+    jitcode_t code = (jitcode_t)(uintptr_t)jit->code;
+
+    return code(
+        program,
+        runtime_environment,
+        jit->code + jit->entry[line],
+        surgescript_renv_tmp(runtime_environment),
+        surgescript_renv_stack(runtime_environment)
+    );
+}
+
+
+
+/* -------------------------------
+ * templates
+ * ------------------------------- */
+
+/* emits the machine code of a line of the program */
+void emit_line(jitbuf_t* buf, surgescript_program_t* program, unsigned line)
+{
+    unsigned length = surgescript_program_count_lines(program);
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    int (*condition)(const surgescript_var_t*) = NULL;
+
+    surgescript_program_read_line(program, line, &op, &a, &b);
+    op = surgescript_program_unfused_operator(op); /* only the first instruction of a superinstruction; the others follow it */
+    switch(op) {
+        case SSOP_NOP:
+            break;
+
+        case SSOP_MOVN:
+            CALL(buf, surgescript_var_set_null, TEMP(a.u));
+            break;
+
+        case SSOP_MOVB:
+            CALL(buf, jit_movb, TEMP(a.u), IMM(b.b));
+            break;
+
+        case SSOP_MOVF:
+            CALL(buf, jit_movf, TEMP(a.u), IMM(b.u64));
+            break;
+
+        case SSOP_MOVS:
+            if(b.u < surgescript_program_text_count(program))
+                CALL(buf, jit_movs, PROGRAM(), TEMP(a.u), IMM(b.u));
+            break;
+
+        case SSOP_MOVO:
+            CALL(buf, surgescript_var_set_objecthandle, TEMP(a.u), IMM(b.u));
+            break;
+
+        case SSOP_MOVX:
+            CALL(buf, surgescript_var_set_rawbits, TEMP(a.u), IMM(b.u64));
+            break;
+
+        case SSOP_MOV:
+            CALL(buf, surgescript_var_copy, TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_XCHG:
+            CALL(buf, surgescript_var_swap, TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_PUSH:
+            CALL(buf, jit_push, STACK(), TEMP(a.u));
+            break;
+
+        case SSOP_POP:
+            CALL(buf, jit_pop, STACK(), TEMP(a.u));
+            break;
+
+        case SSOP_SPEEK:
+            CALL(buf, jit_speek, STACK(), TEMP(a.u), IMM(b.u));
+            break;
+
+        case SSOP_SPOKE:
+            CALL(buf, surgescript_stack_poke, STACK(), IMM(b.u), TEMP(a.u));
+            break;
+
+        case SSOP_PUSHN:
+            CALL(buf, surgescript_stack_pushn, STACK(), IMM(a.u));
+            break;
+
+        case SSOP_POPN:
+            CALL(buf, surgescript_stack_popn, STACK(), IMM(a.u));
+            break;
+
+        case SSOP_INC:
+            CALL(buf, a.u != 2 ? jit_inc : jit_incx, TEMP(a.u));
+            break;
+
+        case SSOP_DEC:
+            CALL(buf, a.u != 2 ? jit_dec : jit_decx, TEMP(a.u));
+            break;
+
+        case SSOP_ADD: CALL(buf, jit_add, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_SUB: CALL(buf, jit_sub, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_MUL: CALL(buf, jit_mul, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_DIV: CALL(buf, jit_div, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_REM: CALL(buf, jit_rem, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_NEG: CALL(buf, jit_neg, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_LNOT: CALL(buf, jit_lnot, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_LNOT2: CALL(buf, jit_lnot2, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_NOT: CALL(buf, jit_not, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_AND: CALL(buf, jit_and, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_OR: CALL(buf, jit_or, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_XOR: CALL(buf, jit_xor, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_FADD: CALL(buf, jit_fadd, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_FSUB: CALL(buf, jit_fsub, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_FMUL: CALL(buf, jit_fmul, TEMP(a.u), TEMP(b.u)); break;
+        case SSOP_FDIV: CALL(buf, jit_fdiv, TEMP(a.u), TEMP(b.u)); break;
+
+        case SSOP_TEST:
+            if(a.u64 == b.u64)
+                CALL(buf, jit_test1, TEMP(2), TEMP(a.u));
+            else
+                CALL(buf, jit_test, TEMP(2), TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_TCHK:
+            CALL(buf, jit_tchk, TEMP(2), TEMP(a.u), IMM(b.u));
+            break;
+
+        case SSOP_TC01:
+            CALL(buf, jit_tc01, TEMP(2), TEMP(0), TEMP(1), IMM(a.u));
+            break;
+
+        case SSOP_TCMP:
+            CALL(buf, jit_tcmp, TEMP(2), TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_CMP:
+            CALL(buf, jit_cmp, TEMP(2), TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_FCMP:
+            CALL(buf, jit_fcmp, TEMP(2), TEMP(a.u), TEMP(b.u));
+            break;
+
+        case SSOP_JMP:
+            if(a.u < length)
+                emit_jump(buf, a.u);
+            else
+                emit_return(buf, length);
+            break;
+
+        case SSOP_JE: condition = jit_je; goto conditional_jump;
+        case SSOP_JNE: condition = jit_jne; goto conditional_jump;
+        case SSOP_JL: condition = jit_jl; goto conditional_jump;
+        case SSOP_JG: condition = jit_jg; goto conditional_jump;
+        case SSOP_JLE: condition = jit_jle; goto conditional_jump;
+        case SSOP_JGE: condition = jit_jge; goto conditional_jump;
+        conditional_jump:
+            if(a.u < length) {
+                CALL(buf, condition, TEMP(2));
+                emit_jump_if_true(buf, a.u);
+            }
+            else
+                emit_interpreted_line(buf, line, line + 1);
+            break;
+
+        case SSOP_RET:
+            emit_return(buf, length);
+            break;
+
+        case SSOP_CALL:
+        case SSOP_OPTCALL:
+            /* the interpreter manages the inline cache of the call site.
+               When an OPTCALL is de-optimized, the guard exits the machine
+               code and the call runs again. */
+            emit_interpreted_line(buf, line, line + 1);
+            break;
+
+        case SSOP_ITER:
+        case SSOP_NEXT:
+            CALL(buf, surgescript_program_run_line, PROGRAM(), RENV(), IMM(line));
+            if(a.u < length)
+                emit_jump_if_result(buf, JIT_EQ, a.u, a.u);
+            if(op == SSOP_NEXT && b.u < length)
+                emit_jump_if_result(buf, JIT_EQ, b.u, b.u);
+            emit_jump_if_result(buf, JIT_NE, line + 1, EXIT_LINE);
+            break;
+
+        default:
+            emit_interpreted_line(buf, line, line + 1);
+            break;
+    }
+}
+
+/* delegates a line to the interpreter, exiting the machine code if the next line isn't the expected one */
+void emit_interpreted_line(jitbuf_t* buf, unsigned line, unsigned next_line)
+{
+    CALL(buf, surgescript_program_run_line, PROGRAM(), RENV(), IMM(line));
+    emit_jump_if_result(buf, JIT_NE, next_line, EXIT_LINE);
+}
+
+
+
+/* -------------------------------
+ * x86-64 backend (System V ABI)
+ * ------------------------------- */
+
+#if defined(__x86_64__)
+
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7, R8 = 8, R12 = 12, R13 = 13, R14 = 14 };
+static const int ARG_REG[MAX_JIT_ARGS] = { RDI, RSI, RDX, RCX };
+#define REG_PROGRAM     RBX
+#define REG_RENV        R12
+#define REG_TEMPS       R13
+#define REG_STACK       R14
+
+/* mov dst, src */
+static void x64_mov(jitbuf_t* buf, int dst, int src)
+{
+    emit8(buf, 0x48 | ((src >> 3) << 2) | (dst >> 3));
+    emit8(buf, 0x89);
+    emit8(buf, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+/* mov dst, imm */
+static void x64_mov_imm(jitbuf_t* buf, int dst, uint64_t imm)
+{
+    if(imm <= UINT32_MAX) {
+        if(dst >= 8)
+            emit8(buf, 0x41);
+        emit8(buf, 0xB8 + (dst & 7));
+        emit32(buf, (uint32_t)imm);
+    }
+    else {
+        emit8(buf, 0x48 | (dst >> 3));
+        emit8(buf, 0xB8 + (dst & 7));
+        emit64(buf, imm);
+    }
+}
+
+/* mov dst, [r13 + disp] */
+static void x64_load_temp(jitbuf_t* buf, int dst, uint8_t disp)
+{
+    emit8(buf, 0x48 | ((dst >> 3) << 2) | (REG_TEMPS >> 3));
+    emit8(buf, 0x8B);
+    emit8(buf, 0x40 | ((dst & 7) << 3) | (REG_TEMPS & 7));
+    emit8(buf, disp);
+}
+
+/* jmp/jcc to a line, to be patched */
+static void x64_branch(jitbuf_t* buf, uint8_t jcc, unsigned line)
+{
+    if(jcc == 0) {
+        emit8(buf, 0xE9); /* jmp rel32 */
+    }
+    else {
+        emit8(buf, 0x0F);
+        emit8(buf, jcc);
+    }
+    add_fixup(buf, line);
+    emit32(buf, 0);
+}
+
+void emit_prologue(jitbuf_t* buf)
+{
+    emit8(buf, 0x55); /* push rbp */
+    emit8(buf, 0x53); /* push rbx */
+    emit8(buf, 0x41); emit8(buf, 0x54); /* push r12 */
+    emit8(buf, 0x41); emit8(buf, 0x55); /* push r13 */
+    emit8(buf, 0x41); emit8(buf, 0x56); /* push r14; the stack is now 16-byte aligned */
+    x64_mov(buf, REG_PROGRAM, RDI);
+    x64_mov(buf, REG_RENV, RSI);
+    x64_mov(buf, REG_TEMPS, RCX);
+    x64_mov(buf, REG_STACK, R8);
+    emit8(buf, 0xFF); emit8(buf, 0xE2); /* jmp rdx */
+}
+
+void emit_epilogue(jitbuf_t* buf)
+{
+    emit8(buf, 0x41); emit8(buf, 0x5E); /* pop r14 */
+    emit8(buf, 0x41); emit8(buf, 0x5D); /* pop r13 */
+    emit8(buf, 0x41); emit8(buf, 0x5C); /* pop r12 */
+    emit8(buf, 0x5B); /* pop rbx */
+    emit8(buf, 0x5D); /* pop rbp */
+    emit8(buf, 0xC3); /* ret */
+}
+
+void emit_call(jitbuf_t* buf, void (*fn)(void), const jitarg_t* arg, int argc)
+{
+    ssassert(argc <= MAX_JIT_ARGS);
+
+    for(int i = 0; i < argc; i++) {
+        switch(arg[i].type) {
+            case JITARG_TEMP: x64_load_temp(buf, ARG_REG[i], arg[i].value * sizeof(surgescript_var_t*)); break;
+            case JITARG_IMM: x64_mov_imm(buf, ARG_REG[i], arg[i].value); break;
+            case JITARG_PROGRAM: x64_mov(buf, ARG_REG[i], REG_PROGRAM); break;
+            case JITARG_RENV: x64_mov(buf, ARG_REG[i], REG_RENV); break;
+            case JITARG_STACK: x64_mov(buf, ARG_REG[i], REG_STACK); break;
+        }
+    }
+
+    x64_mov_imm(buf, RAX, (uint64_t)(uintptr_t)fn);
+    emit8(buf, 0xFF); emit8(buf, 0xD0); /* call rax */
+}
+
+void emit_jump(jitbuf_t* buf, unsigned line)
+{
+    x64_branch(buf, 0, line);
+}
+
+void emit_jump_if_result(jitbuf_t* buf, jitcond_t cond, unsigned value, unsigned line)
+{
+    emit8(buf, 0x3D); emit32(buf, value); /* cmp eax, value */
+    x64_branch(buf, cond == JIT_EQ ? 0x84 : 0x85, line); /* je / jne */
+}
+
+void emit_jump_if_true(jitbuf_t* buf, unsigned line)
+{
+    emit8(buf, 0x85); emit8(buf, 0xC0); /* test eax, eax */
+    x64_branch(buf, 0x85, line); /* jne */
+}
+
+void emit_return(jitbuf_t* buf, unsigned value)
+{
+    x64_mov_imm(buf, RAX, value);
+    x64_branch(buf, 0, EXIT_LINE);
+}
+
+void patch_jump(jitbuf_t* buf, size_t at, size_t target)
+{
+    write32(buf, at, (uint32_t)((int64_t)target - (int64_t)(at + 4)));
+}
+
+#endif
+
+
+
+/* -------------------------------
+ * AArch64 backend (AAPCS64)
+ * ------------------------------- */
+
+#if defined(__aarch64__)
+
+static const int ARG_REG[MAX_JIT_ARGS] = { 0, 1, 2, 3 };
+#define REG_PROGRAM     19
+#define REG_RENV        20
+#define REG_TEMPS       21
+#define REG_STACK       22
+#define REG_SCRATCH     16
+#define REG_FP          29
+#define REG_LR          30
+#define REG_SP          31
+
+/* mov xd, xm */
+static void a64_mov(jitbuf_t* buf, int d, int m)
+{
+    emit32(buf, 0xAA0003E0 | (m << 16) | d); /* orr xd, xzr, xm */
+}
+
+/* mov xd, imm */
+static void a64_mov_imm(jitbuf_t* buf, int d, uint64_t imm)
+{
+    emit32(buf, 0xD2800000 | ((uint32_t)(imm & 0xFFFF) << 5) | d); /* movz xd, #imm16 */
+    for(int hw = 1; hw < 4; hw++) {
+        uint32_t chunk = (imm >> (16 * hw)) & 0xFFFF;
+        if(chunk != 0)
+            emit32(buf, 0xF2800000 | (hw << 21) | (chunk << 5) | d); /* movk xd, #imm16, lsl #(16*hw) */
+    }
+}
+
+/* b to a line, to be patched */
+static void a64_branch(jitbuf_t* buf, unsigned line)
+{
+    add_fixup(buf, line);
+    emit32(buf, 0x14000000);
+}
+
+void emit_prologue(jitbuf_t* buf)
+{
+    emit32(buf, 0xA9800000 | ((-48 / 8) & 0x7F) << 15 | (REG_LR << 10) | (REG_SP << 5) | REG_FP); /* stp x29, x30, [sp, #-48]! */
+    emit32(buf, 0x910003FD); /* mov x29, sp */
+    emit32(buf, 0xA9000000 | (2 << 15) | (REG_RENV << 10) | (REG_SP << 5) | REG_PROGRAM); /* stp x19, x20, [sp, #16] */
+    emit32(buf, 0xA9000000 | (4 << 15) | (REG_STACK << 10) | (REG_SP << 5) | REG_TEMPS); /* stp x21, x22, [sp, #32] */
+    a64_mov(buf, REG_PROGRAM, 0);
+    a64_mov(buf, REG_RENV, 1);
+    a64_mov(buf, REG_TEMPS, 3);
+    a64_mov(buf, REG_STACK, 4);
+    emit32(buf, 0xD61F0000 | (2 << 5)); /* br x2 */
+}
+
+void emit_epilogue(jitbuf_t* buf)
+{
+    emit32(buf, 0xA9400000 | (2 << 15) | (REG_RENV << 10) | (REG_SP << 5) | REG_PROGRAM); /* ldp x19, x20, [sp, #16] */
+    emit32(buf, 0xA9400000 | (4 << 15) | (REG_STACK << 10) | (REG_SP << 5) | REG_TEMPS); /* ldp x21, x22, [sp, #32] */
+    emit32(buf, 0xA8C00000 | (6 << 15) | (REG_LR << 10) | (REG_SP << 5) | REG_FP); /* ldp x29, x30, [sp], #48 */
+    emit32(buf, 0xD65F03C0); /* ret */
+}
+
+void emit_call(jitbuf_t* buf, void (*fn)(void), const jitarg_t* arg, int argc)
+{
+    ssassert(argc <= MAX_JIT_ARGS);
+
+    for(int i = 0; i < argc; i++) {
+        switch(arg[i].type) {
+            case JITARG_TEMP: emit32(buf, 0xF9400000 | ((uint32_t)arg[i].value << 10) | (REG_TEMPS << 5) | ARG_REG[i]); break; /* ldr xi, [x21, #8k] */
+            case JITARG_IMM: a64_mov_imm(buf, ARG_REG[i], arg[i].value); break;
+            case JITARG_PROGRAM: a64_mov(buf, ARG_REG[i], REG_PROGRAM); break;
+            case JITARG_RENV: a64_mov(buf, ARG_REG[i], REG_RENV); break;
+            case JITARG_STACK: a64_mov(buf, ARG_REG[i], REG_STACK); break;
+        }
+    }
+
+    a64_mov_imm(buf, REG_SCRATCH, (uint64_t)(uintptr_t)fn);
+    emit32(buf, 0xD63F0000 | (REG_SCRATCH << 5)); /* blr x16 */
+}
+
+void emit_jump(jitbuf_t* buf, unsigned line)
+{
+    a64_branch(buf, line);
+}
+
+void emit_jump_if_result(jitbuf_t* buf, jitcond_t cond, unsigned value, unsigned line)
+{
+    a64_mov_imm(buf, REG_SCRATCH, value);
+    emit32(buf, 0x6B00001F | (REG_SCRATCH << 16)); /* cmp w0, w16 */
+    emit32(buf, cond == JIT_EQ ? 0x54000041 : 0x54000040); /* skip the branch: b.ne / b.eq +8 */
+    a64_branch(buf, line);
+}
+
+void emit_jump_if_true(jitbuf_t* buf, unsigned line)
+{
+    emit32(buf, 0x34000040); /* cbz w0, +8 */
+    a64_branch(buf, line);
+}
+
+void emit_return(jitbuf_t* buf, unsigned value)
+{
+    a64_mov_imm(buf, 0, value);
+    a64_branch(buf, EXIT_LINE);
+}
+
+void patch_jump(jitbuf_t* buf, size_t at, size_t target)
+{
+    int64_t offset = ((int64_t)target - (int64_t)at) / 4;
+    write32(buf, at, read32(buf, at) | ((uint32_t)offset & 0x03FFFFFF));
+}
+
+#endif
+
+#else
+
+/* the JIT compiler is disabled */
+
+surgescript_jit_t* surgescript_jit_compile(struct surgescript_program_t* program)
+{
+    return NULL;
+}
+
+surgescript_jit_t* surgescript_jit_destroy(surgescript_jit_t* jit)
+{
+    return NULL;
+}
+
+unsigned surgescript_jit_run(const surgescript_jit_t* jit, struct surgescript_program_t* program, const struct surgescript_renv_t* runtime_environment, unsigned line)
+{
+    return surgescript_program_run_line(program, runtime_environment, line);
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/jit.h
+ * SurgeScript template JIT compiler (x86-64 and AArch64 Linux)
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_JIT_H
+#define _SURGESCRIPT_RUNTIME_JIT_H
+
+/* the JIT compiler is enabled with the WANT_JIT build option */
+#ifndef SURGESCRIPT_ENABLE_JIT
+#define SURGESCRIPT_ENABLE_JIT 0
+#endif
+
+/* supported platforms */
+#if SURGESCRIPT_ENABLE_JIT && !(defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__)))
+#undef SURGESCRIPT_ENABLE_JIT
+#define SURGESCRIPT_ENABLE_JIT 0
+#endif
+
+/* types */
+typedef struct surgescript_jit_t surgescript_jit_t;
+struct surgescript_program_t;
+struct surgescript_renv_t;
+
+/* api */
+surgescript_jit_t* surgescript_jit_compile(struct surgescript_program_t* program); /* translates a program to machine code; returns NULL on failure */
+surgescript_jit_t* surgescript_jit_destroy(surgescript_jit_t* jit); /* releases the machine code */
+unsigned surgescript_jit_run(const surgescript_jit_t* jit, struct surgescript_program_t* program, const struct surgescript_renv_t* runtime_environment, unsigned line); /* runs the machine code from a line until it exits, returning the next line to be run */
+
+#endif
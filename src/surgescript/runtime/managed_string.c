@@ -24,6 +24,7 @@
 #include "managed_string.h"
 #include "../util/ssarray.h"
 #include "../util/util.h"
+#include "../util/thread.h"
 #include "../third_party/utf8.h"
 
 /* constants */
@@ -61,6 +62,9 @@ struct surgescript_managedstringpool_t
 
     /* the head of the free list */
     surgescript_managedstring_t* head;
+
+    /* taken only while objects are updated in parallel */
+    surgescript_mutex_t mutex;
 };
 
 /* private */
@@ -92,15 +96,16 @@ surgescript_managedstring_t* surgescript_managedstring_create(const char* string
 #else
     if(false) {
 #endif
+        bool concurrent = ssconcurrent_any(); /* the pool is shared by all VMs */
+        if(concurrent)
+            ssmutex_lock(&pool.mutex);
+
         /* quickly prepare a managed string from the pool */
         ssassert(pool.head != NULL && !pool.head->in_use);
         managed_string = pool.head;
         managed_string->in_use = true;
         pool.head = managed_string->next;
 
-        /* copy string */
-        memcpy(managed_string->data, string, length + 1); /* we already know that length <= MAXLEN */
-
         /* let's allocate a new page if necessary */
         if(pool.head == NULL) {
             surgescript_managedstringpage_t* page = allocate_page();
@@ -108,6 +113,12 @@ surgescript_managedstring_t* surgescript_managedstring_create(const char* string
             pool.head = managed_string->next = &page->managed_string[0];
         }
 
+        if(concurrent)
+            ssmutex_unlock(&pool.mutex);
+
+        /* copy string */
+        memcpy(managed_string->data, string, length + 1); /* we already know that length <= MAXLEN */
+
         /* now managed_string->next != NULL */
     }
     else {
@@ -156,10 +167,17 @@ surgescript_managedstring_t* surgescript_managedstring_destroy(surgescript_manag
     managed_string->in_use = false;
 
     /* quickly put the managed string back into the pool */
+    bool concurrent = ssconcurrent_any();
+    if(concurrent)
+        ssmutex_lock(&pool.mutex);
+
     ssassert(pool.head != NULL);
     managed_string->next = pool.head;
     pool.head = managed_string;
 
+    if(concurrent)
+        ssmutex_unlock(&pool.mutex);
+
     /* done! */
     return NULL;
 }
@@ -187,6 +205,8 @@ void surgescript_managedstring_init_pool()
     ssarray_init(pool.page);
     ssarray_push(pool.page, page);
     pool.head = &page->managed_string[0];
+
+    ssmutex_init(&pool.mutex);
 }
 
 /*
@@ -200,6 +220,8 @@ void surgescript_managedstring_release_pool()
 
     ssarray_release(pool.page);
     pool.head = NULL;
+
+    ssmutex_destroy(&pool.mutex);
 }
 
 
@@ -29,11 +29,22 @@
 #include "stack.h"
 #include "renv.h"
 #include "vm_time.h"
+#include "snapshot.h"
 #include "../util/transform.h"
 #include "../util/ssarray.h"
 #include "../util/util.h"
+#include "../util/thread.h"
 #include "../third_party/gettimeofday.h"
 
+/* a function scheduled to be called later */
+typedef struct surgescript_scheduledcall_t surgescript_scheduledcall_t;
+struct surgescript_scheduledcall_t
+{
+    int timer; /* ID of the timer in the object manager */
+    uint64_t time; /* VM time of the call */
+    char* fun_name; /* name of the function */
+};
+
 /* object structure */
 struct surgescript_object_t
 {
@@ -51,10 +62,15 @@ struct surgescript_object_t
 
     /* inner state */
     surgescript_program_t* current_state; /* current state */
-    char* state_name; /* current state name */
+    bool is_state_empty; /* is the program of the current state empty? */
+    const char* state_name; /* current state name */
+    int state_id; /* id of the current state in the state table, or -1 if it isn't listed there */
+    char* unlisted_state_name; /* a copy of the current state name if state_id < 0, or NULL */
+    surgescript_statetable_t* state_table; /* state table of my class of objects */
     bool is_active; /* can i run programs? */
     bool is_killed; /* am i scheduled to be destroyed? */
     bool is_reachable; /* is this object reachable through some other? (garbage-collection) */
+    bool is_isolated; /* may my subtree be updated in parallel with the rest of the object tree? */
 
     /* internal timer */
     const surgescript_vmtime_t* vmtime; /* VM time */
@@ -62,11 +78,22 @@ struct surgescript_object_t
     uint64_t time_spent; /* time spent updating the object since the last state change, measured in microseconds */
     uint64_t frames_spent; /* number of update cycles since the last state change */
 
+    /* coroutine */
+    unsigned resume_line; /* line of code at which the suspended current state is resumed, or 0 if it isn't suspended */
+    uint64_t wake_time; /* VM time at which the suspended current state is resumed */
+    SSARRAY(surgescript_var_t*, suspended_var); /* stack frame of the suspended current state */
+
+    /* timers */
+    int sleep_timer; /* the timer that wakes me up, or -1 if I'm not sleeping */
+    uint64_t sleep_until; /* VM time at which I wake up */
+    SSARRAY(surgescript_scheduledcall_t, scheduled_call); /* functions to be called later */
+
     /* tags */
     const surgescript_boundtagsystem_t* bound_tag_system; /* bound tag system for quicker tag tests */
 
     /* local transform */
     surgescript_transform_t* transform;
+    surgescript_worldtransform2d_t world_transform; /* cached world transform */
 
     /* user-data */
     void* user_data; /* custom user-data */
@@ -74,17 +101,48 @@ struct surgescript_object_t
 
 /* functions */
 void surgescript_object_release(surgescript_object_t* object);
+void surgescript_object_bind_thread_stack(surgescript_stack_t* stack);
+void surgescript_object_set_state_id(surgescript_object_t* object, int state_id);
+surgescript_worldtransform2d_t* surgescript_object_world_transform_cache(surgescript_object_t* object);
+void surgescript_object_invalidate_world_transform(surgescript_object_t* object);
+void surgescript_object_snapshot(const surgescript_object_t* object, surgescript_snapshot_t* snapshot);
+void surgescript_object_restore(surgescript_object_t* object, surgescript_snapshot_t* snapshot);
+surgescript_object_t* surgescript_object_discard(surgescript_object_t* object);
+void surgescript_object_reload(surgescript_object_t* object, char* const* old_field, int old_field_count, bool replaced);
+void surgescript_object_suspend(surgescript_object_t* object, const surgescript_program_t* program, unsigned line, double seconds, const surgescript_stack_t* stack);
+void surgescript_object_scan_suspended_objects(surgescript_object_t* object, void* userdata, bool (*callback)(unsigned,void*));
+void surgescript_object_fire_timer(surgescript_object_t* object, int timer);
+extern void surgescript_program_resume(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned line); /* program.c */
+extern bool surgescript_program_is_jump_target(surgescript_program_t* program, int line); /* program.c */
+extern void surgescript_transform_snapshot(const surgescript_transform_t* t, surgescript_snapshot_t* snapshot); /* transform.c */
+extern void surgescript_transform_restore(surgescript_transform_t* t, surgescript_snapshot_t* snapshot); /* transform.c */
 
 /* private stuff */
 #define MAIN_STATE "main"
+#define SNAPSHOT_ACTIVE     0x1 /* flags of the objects in a snapshot */
+#define SNAPSHOT_KILLED     0x2
+#define SNAPSHOT_REACHABLE  0x4
 #define STATE2FUN_BUFFER_SIZE ((SS_NAMEMAX+1)+6) /* prefix a string with "state:" */
 static char* state2fun(const char* state, char* buffer, size_t size);
-static inline void run_current_state(const surgescript_object_t* object);
-static inline uint64_t run_and_measure_current_state(const surgescript_object_t* object);
+static inline void run_current_state(surgescript_object_t* object);
+static inline uint64_t run_and_measure_current_state(surgescript_object_t* object);
+static inline bool is_waiting(const surgescript_object_t* object);
+static void cancel_coroutine(surgescript_object_t* object);
+static void sleep_until(surgescript_object_t* object, uint64_t time);
+static void cancel_timers(surgescript_object_t* object);
+static inline uint64_t seconds_to_ms(double seconds);
 static surgescript_program_t* get_state_program(const surgescript_object_t* object, const char* state_name);
+static void change_state(surgescript_object_t* object, const char* state_name);
+static void enter_state(surgescript_object_t* object, int state_id);
 static bool object_exists(surgescript_programpool_t* program_pool, const char* object_name);
 static bool simple_traversal(surgescript_object_t* object, void* data);
 static inline void call_object_function(surgescript_object_t* object, const char* class_name, const char* fun_name, const surgescript_var_t* param[], int num_params, surgescript_var_t* return_value);
+static inline surgescript_renv_t* thread_renv(const surgescript_object_t* object, surgescript_renv_t* buffer);
+static inline bool is_traversed(const surgescript_object_t* object);
+static inline void invalidate_tree(const surgescript_object_t* object);
+static void migrate_fields(surgescript_object_t* object, char* const* old_field, int old_field_count);
+static void initialize_field(surgescript_object_t* object, int address);
+static SS_THREAD_LOCAL surgescript_stack_t* thread_stack = NULL; /* the stack of a worker thread */
 
 /* -------------------------------
  * public methods
@@ -119,20 +177,27 @@ surgescript_object_t* surgescript_object_create(const char* name, surgescript_ob
     ssarray_init(obj->child);
     obj->depth = 0;
 
-    obj->state_name = ssstrdup(MAIN_STATE);
-    obj->current_state = get_state_program(obj, obj->state_name);
+    obj->state_table = surgescript_programpool_statetable(program_pool, name);
+    obj->unlisted_state_name = NULL;
+    obj->resume_line = 0;
+    obj->wake_time = 0;
+    ssarray_init(obj->suspended_var);
+    obj->sleep_timer = -1;
+    obj->sleep_until = 0;
+    ssarray_init(obj->scheduled_call);
+    change_state(obj, MAIN_STATE);
     obj->is_active = true;
     obj->is_killed = false;
     obj->is_reachable = false;
+    obj->is_isolated = surgescript_objectmanager_is_isolated_class(object_manager, class_id);
 
     obj->vmtime = vmtime;
     obj->last_state_change = surgescript_vmtime_time(obj->vmtime);
-    obj->time_spent = 0;
-    obj->frames_spent = 0;
 
     obj->bound_tag_system = surgescript_tagsystem_bind(surgescript_objectmanager_tagsystem(object_manager), name);
 
     obj->transform = NULL;
+    obj->world_transform.is_valid = false;
     obj->user_data = user_data;
 
     return obj;
@@ -169,9 +234,14 @@ surgescript_object_t* surgescript_object_destroy(surgescript_object_t* obj)
         surgescript_transform_destroy(obj->transform);
 
     /* clear up some data */
+    cancel_coroutine(obj);
+    ssarray_release(obj->suspended_var);
+    cancel_timers(obj);
+    ssarray_release(obj->scheduled_call);
     surgescript_renv_destroy(obj->renv);
     surgescript_heap_destroy(obj->heap);
-    ssfree(obj->state_name);
+    if(obj->unlisted_state_name != NULL)
+        ssfree(obj->unlisted_state_name);
     ssfree(obj->name);
     ssfree(obj);
 
@@ -241,6 +311,16 @@ void surgescript_object_set_userdata(surgescript_object_t* object, void* data)
     object->user_data = data;
 }
 
+/*
+ * surgescript_object_is_isolated()
+ * Is this object isolated? The subtree of an isolated object may be updated
+ * in parallel with the rest of the object tree
+ */
+bool surgescript_object_is_isolated(const surgescript_object_t* object)
+{
+    return object->is_isolated;
+}
+
 /*
  * surgescript_object_has_tag()
  * Is this object tagged tag_name?
@@ -578,6 +658,9 @@ bool surgescript_object_add_child(surgescript_object_t* object, surgescript_obje
     ssarray_push(object->child, child->handle);
     child->parent = object->handle;
     child->depth = 1 + object->depth;
+    surgescript_object_invalidate_world_transform(child);
+    if(is_traversed(object))
+        invalidate_tree(object);
 
     /* done */
     return true;
@@ -598,6 +681,9 @@ bool surgescript_object_remove_child(surgescript_object_t* object, surgescript_o
             ssarray_remove(object->child, i);
             child->parent = child->handle; /* the child is now a root */
             child->depth = 0;
+            surgescript_object_invalidate_world_transform(child);
+            if(is_traversed(object))
+                invalidate_tree(object);
             return true;
         }
     }
@@ -690,6 +776,10 @@ void surgescript_object_set_active(surgescript_object_t* object, bool active)
     /* update the flag */
     object->is_active = active;
 
+    /* my children will or will no longer be traversed */
+    if(object->parent == object->handle || is_traversed(surgescript_objectmanager_get(surgescript_renv_objectmanager(object->renv), object->parent)))
+        invalidate_tree(object);
+
     /* reset the time stats */
     object->time_spent = 0;
     object->frames_spent = 0;
@@ -711,14 +801,21 @@ const char* surgescript_object_state(const surgescript_object_t *object)
 void surgescript_object_set_state(surgescript_object_t* object, const char* state_name)
 {
     if(strcmp(object->state_name, state_name) != 0) {
-        size_t new_size = (1 + strlen(state_name)) * sizeof(char);
-        object->state_name = ssrealloc(object->state_name, new_size);
-        memcpy(object->state_name, state_name, new_size); /* include '\0' */
+        change_state(object, state_name);
+        object->last_state_change = surgescript_vmtime_time(object->vmtime);
+    }
+}
 
-        object->current_state = get_state_program(object, object->state_name);
+/*
+ * surgescript_object_set_state_id()
+ * sets a state given its id in the state table of the class of the object
+ * (this is used by compiled code: transitions are just integer comparisons)
+ */
+void surgescript_object_set_state_id(surgescript_object_t* object, int state_id)
+{
+    if(object->state_id != state_id) {
+        enter_state(object, state_id);
         object->last_state_change = surgescript_vmtime_time(object->vmtime);
-        object->time_spent = 0;
-        object->frames_spent = 0;
     }
 }
 
@@ -747,6 +844,103 @@ bool surgescript_object_is_killed(const surgescript_object_t* object)
 void surgescript_object_kill(surgescript_object_t* object)
 {
     object->is_killed = true;
+    surgescript_object_wake(object); /* sleeping objects aren't visited */
+}
+
+
+/* timers */
+
+/*
+ * surgescript_object_sleep()
+ * Puts this object to sleep for the given number of seconds. My subtree
+ * won't be updated until I wake up, neither by the VM nor by its callbacks
+ */
+void surgescript_object_sleep(surgescript_object_t* object, double seconds)
+{
+    sleep_until(object, surgescript_vmtime_time(object->vmtime) + seconds_to_ms(seconds));
+}
+
+/*
+ * surgescript_object_sleep_until()
+ * Puts this object to sleep until the given VM time, in seconds
+ */
+void surgescript_object_sleep_until(surgescript_object_t* object, double time)
+{
+    sleep_until(object, seconds_to_ms(time));
+}
+
+/*
+ * surgescript_object_wake()
+ * Wakes up this object if it's sleeping
+ */
+void surgescript_object_wake(surgescript_object_t* object)
+{
+    if(object->sleep_timer >= 0) {
+        surgescript_objectmanager_cancel_timer(surgescript_renv_objectmanager(object->renv), object->sleep_timer);
+        object->sleep_timer = -1;
+    }
+}
+
+/*
+ * surgescript_object_is_sleeping()
+ * Am I sleeping?
+ */
+bool surgescript_object_is_sleeping(const surgescript_object_t* object)
+{
+    return object->sleep_timer >= 0;
+}
+
+/*
+ * surgescript_object_schedule()
+ * Calls one of my functions, which must take no parameters,
+ * after the given number of seconds. The call takes place at the
+ * beginning of an update cycle, even if I'm sleeping or inactive
+ */
+void surgescript_object_schedule(surgescript_object_t* object, const char* fun_name, double seconds)
+{
+    surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+    surgescript_programpool_t* pool = surgescript_renv_programpool(object->renv);
+    const surgescript_program_t* program = surgescript_programpool_get(pool, object->name, fun_name);
+    uint64_t time = surgescript_vmtime_time(object->vmtime) + seconds_to_ms(seconds);
+    surgescript_scheduledcall_t call;
+
+    /* validate the function now, rather than when it's called */
+    if(program == NULL || surgescript_program_arity(program) != 0) {
+        ssfatal("Runtime Error: can't schedule function %s.%s/0 - it doesn't exist.", object->name, fun_name);
+        return;
+    }
+
+    call.timer = surgescript_objectmanager_add_timer(manager, object->handle, time);
+    call.time = time;
+    call.fun_name = ssstrdup(fun_name);
+    ssarray_push(object->scheduled_call, call);
+}
+
+/*
+ * surgescript_object_fire_timer()
+ * Called by the object manager when one of my timers expires
+ */
+void surgescript_object_fire_timer(surgescript_object_t* object, int timer)
+{
+    /* wake up */
+    if(timer == object->sleep_timer) {
+        object->sleep_timer = -1;
+        return;
+    }
+
+    /* call a scheduled function */
+    for(int i = 0; i < ssarray_length(object->scheduled_call); i++) {
+        if(object->scheduled_call[i].timer == timer) {
+            char* fun_name = object->scheduled_call[i].fun_name;
+            ssarray_remove(object->scheduled_call, i);
+
+            if(!object->is_killed)
+                surgescript_object_call_function(object, fun_name, NULL, 0, NULL);
+
+            ssfree(fun_name);
+            return;
+        }
+    }
 }
 
 /*
@@ -788,8 +982,10 @@ void surgescript_object_peek_transform(const surgescript_object_t* object, surge
  */
 void surgescript_object_poke_transform(surgescript_object_t* object, const surgescript_transform_t* transform)
 {
-    if(object->transform == NULL)
+    if(object->transform == NULL) {
         object->transform = surgescript_transform_create();
+        surgescript_transform_bind_object(object->transform, object);
+    }
 
     surgescript_transform_copy(object->transform, transform);
 }
@@ -804,8 +1000,10 @@ void surgescript_object_poke_transform(surgescript_object_t* object, const surge
  */
 surgescript_transform_t* surgescript_object_transform(surgescript_object_t* object)
 {
-    if(object->transform == NULL)
+    if(object->transform == NULL) {
         object->transform = surgescript_transform_create();
+        surgescript_transform_bind_object(object->transform, object);
+    }
 
     return object->transform;
 }
@@ -820,6 +1018,33 @@ bool surgescript_object_transform_changed(const surgescript_object_t* object)
     return object->transform != NULL;
 }
 
+/*
+ * surgescript_object_world_transform_cache()
+ * The cached world transform of this object. It's managed by util/transform.c
+ */
+surgescript_worldtransform2d_t* surgescript_object_world_transform_cache(surgescript_object_t* object)
+{
+    return &object->world_transform;
+}
+
+/*
+ * surgescript_object_invalidate_world_transform()
+ * Invalidates the cached world transform of this object and of its descendants.
+ * If the cache of an object is invalid, so are the caches of its descendants
+ */
+void surgescript_object_invalidate_world_transform(surgescript_object_t* object)
+{
+    surgescript_objectmanager_t* manager;
+
+    if(!object->world_transform.is_valid)
+        return;
+
+    object->world_transform.is_valid = false;
+    manager = surgescript_renv_objectmanager(object->renv);
+    for(int i = 0; i < ssarray_length(object->child); i++)
+        surgescript_object_invalidate_world_transform(surgescript_objectmanager_get(manager, object->child[i]));
+}
+
 
 /* life-cycle */
 
@@ -831,20 +1056,21 @@ void surgescript_object_init(surgescript_object_t* object)
 {
     static const char* CONSTRUCTOR_FUN = "constructor"; /* regular constructor */
     static const char* PRE_CONSTRUCTOR_FUN = "__ssconstructor"; /* a constructor reserved for the VM */
-    surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
-    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    surgescript_renv_t buffer, *renv = thread_renv(object, &buffer);
+    surgescript_stack_t* stack = surgescript_renv_stack(renv);
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(renv);
     surgescript_stack_push(stack, surgescript_var_set_objecthandle(surgescript_var_create(), object->handle));
 
     if(surgescript_programpool_exists(program_pool, object->name, PRE_CONSTRUCTOR_FUN)) {
         surgescript_program_t* pre_constructor = surgescript_programpool_get(program_pool, object->name, PRE_CONSTRUCTOR_FUN);
-        surgescript_program_call(pre_constructor, object->renv, 0);
+        surgescript_program_call(pre_constructor, renv, 0);
     }
 
     if(surgescript_programpool_exists(program_pool, object->name, CONSTRUCTOR_FUN)) {
         surgescript_program_t* constructor = surgescript_programpool_get(program_pool, object->name, CONSTRUCTOR_FUN);
         if(surgescript_program_arity(constructor) != 0)
             ssfatal("Runtime Error: Object \"%s\"'s %s() cannot receive parameters", object->name, CONSTRUCTOR_FUN);
-        surgescript_program_call(constructor, object->renv, 0);
+        surgescript_program_call(constructor, renv, 0);
     }
 
     surgescript_stack_pop(stack);
@@ -860,21 +1086,33 @@ void surgescript_object_release(surgescript_object_t* object)
     surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
 
     if(surgescript_programpool_exists(program_pool, object->name, DESTRUCTOR_FUN)) {
-        surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
+        surgescript_renv_t buffer, *renv = thread_renv(object, &buffer);
+        surgescript_stack_t* stack = surgescript_renv_stack(renv);
         surgescript_program_t* destructor = surgescript_programpool_get(program_pool, object->name, DESTRUCTOR_FUN);
         
         if(surgescript_program_arity(destructor) != 0)
             ssfatal("Runtime Error: Object \"%s\"'s %s() cannot receive parameters", object->name, DESTRUCTOR_FUN);
 
         surgescript_stack_push(stack, surgescript_var_set_objecthandle(surgescript_var_create(), object->handle));
-        surgescript_program_call(destructor, object->renv, 0);
+        surgescript_program_call(destructor, renv, 0);
         surgescript_stack_pop(stack);
     }
 }
 
+/*
+ * surgescript_object_bind_thread_stack()
+ * Sets the stack used by the calling thread to run programs (NULL means the
+ * stack of the VM). Worker threads call this, as each one has its own stack
+ */
+void surgescript_object_bind_thread_stack(surgescript_stack_t* stack)
+{
+    thread_stack = stack;
+}
+
 /*
  * surgescript_object_update()
- * Updates this object; runs the current state and returns true if my children should be updated too
+ * Updates this object; runs the current state and returns true if my children should be updated too.
+ * Sleeping objects aren't updated, and neither are their children
  */
 bool surgescript_object_update(surgescript_object_t* object)
 {
@@ -886,9 +1124,14 @@ bool surgescript_object_update(surgescript_object_t* object)
         return false;
     }
 
-    /* update myself */
+    /* sleeping objects are woken up by the timers of the object manager */
+    if(object->sleep_timer >= 0)
+        return false;
+
+    /* update myself. A waiting or an empty state costs no more than a comparison */
     if(object->is_active) {
-        object->time_spent += run_and_measure_current_state(object);
+        if(!object->is_state_empty && !is_waiting(object))
+            object->time_spent += run_and_measure_current_state(object);
         object->frames_spent++;
         return object->is_active; /* will generally be true, but not necessarily */
     }
@@ -995,6 +1238,255 @@ size_t surgescript_object_memspent(const surgescript_object_t* object)
     return surgescript_heap_memspent(object->heap);
 }
 
+
+/* snapshots */
+
+/*
+ * surgescript_object_snapshot()
+ * Writes the state of this object to a snapshot. Its name
+ * and its handle are written by the object manager
+ */
+void surgescript_object_snapshot(const surgescript_object_t* object, surgescript_snapshot_t* snapshot)
+{
+    uint8_t flags = 0;
+
+    /* object tree */
+    surgescript_snapshot_write_uint(snapshot, object->parent);
+    surgescript_snapshot_write_uint(snapshot, object->depth);
+    surgescript_snapshot_write_uint(snapshot, ssarray_length(object->child));
+    for(int i = 0; i < ssarray_length(object->child); i++)
+        surgescript_snapshot_write_uint(snapshot, object->child[i]);
+
+    /* inner state */
+    flags |= object->is_active ? SNAPSHOT_ACTIVE : 0;
+    flags |= object->is_killed ? SNAPSHOT_KILLED : 0;
+    flags |= object->is_reachable ? SNAPSHOT_REACHABLE : 0;
+    surgescript_snapshot_write_string(snapshot, object->state_name);
+    surgescript_snapshot_write_byte(snapshot, flags);
+
+    /* internal timer */
+    surgescript_snapshot_write_uint(snapshot, object->last_state_change);
+    surgescript_snapshot_write_uint(snapshot, object->time_spent);
+    surgescript_snapshot_write_uint(snapshot, object->frames_spent);
+
+    /* local transform */
+    surgescript_snapshot_write_byte(snapshot, object->transform != NULL);
+    if(object->transform != NULL)
+        surgescript_transform_snapshot(object->transform, snapshot);
+
+    /* heap */
+    surgescript_heap_snapshot(object->heap, snapshot);
+
+    /* coroutine */
+    surgescript_snapshot_write_uint(snapshot, object->resume_line);
+    if(object->resume_line != 0) {
+        surgescript_snapshot_write_uint(snapshot, object->wake_time);
+        surgescript_snapshot_write_uint(snapshot, ssarray_length(object->suspended_var));
+        for(int i = 0; i < ssarray_length(object->suspended_var); i++)
+            surgescript_var_snapshot(object->suspended_var[i], snapshot);
+    }
+
+    /* timers */
+    surgescript_snapshot_write_byte(snapshot, object->sleep_timer >= 0);
+    if(object->sleep_timer >= 0)
+        surgescript_snapshot_write_uint(snapshot, object->sleep_until);
+    surgescript_snapshot_write_uint(snapshot, ssarray_length(object->scheduled_call));
+    for(int i = 0; i < ssarray_length(object->scheduled_call); i++) {
+        surgescript_snapshot_write_string(snapshot, object->scheduled_call[i].fun_name);
+        surgescript_snapshot_write_uint(snapshot, object->scheduled_call[i].time);
+    }
+}
+
+/*
+ * surgescript_object_restore()
+ * Reads the state of this object from a snapshot. No functions are called
+ * and the other objects aren't touched: the object manager is expected to
+ * restore the whole tree at once
+ */
+void surgescript_object_restore(surgescript_object_t* object, surgescript_snapshot_t* snapshot)
+{
+    surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+    uint8_t flags;
+    char* state_name;
+
+    /* object tree */
+    object->parent = surgescript_snapshot_read_uint(snapshot);
+    object->depth = surgescript_snapshot_read_uint(snapshot);
+    ssarray_reset(object->child);
+    for(size_t n = surgescript_snapshot_read_uint(snapshot); n > 0 && !surgescript_snapshot_is_corrupted(snapshot); n--)
+        ssarray_push(object->child, surgescript_snapshot_read_uint(snapshot));
+
+    /* inner state */
+    state_name = surgescript_snapshot_read_string(snapshot);
+    change_state(object, state_name);
+    ssfree(state_name);
+
+    flags = surgescript_snapshot_read_byte(snapshot);
+    object->is_active = (flags & SNAPSHOT_ACTIVE) != 0;
+    object->is_killed = (flags & SNAPSHOT_KILLED) != 0;
+    object->is_reachable = (flags & SNAPSHOT_REACHABLE) != 0;
+
+    /* internal timer */
+    object->last_state_change = surgescript_snapshot_read_uint(snapshot);
+    object->time_spent = surgescript_snapshot_read_uint(snapshot);
+    object->frames_spent = surgescript_snapshot_read_uint(snapshot);
+
+    /* local transform */
+    if(surgescript_snapshot_read_byte(snapshot) != 0)
+        surgescript_transform_restore(surgescript_object_transform(object), snapshot);
+    else if(object->transform != NULL)
+        object->transform = surgescript_transform_destroy(object->transform);
+    object->world_transform.is_valid = false;
+
+    /* heap */
+    surgescript_heap_restore(object->heap, snapshot);
+
+    /* coroutine (change_state() has cancelled the previous one) */
+    object->resume_line = surgescript_snapshot_read_uint(snapshot);
+    if(object->resume_line != 0) {
+        object->wake_time = surgescript_snapshot_read_uint(snapshot);
+        for(size_t n = surgescript_snapshot_read_uint(snapshot); n > 0 && !surgescript_snapshot_is_corrupted(snapshot); n--) {
+            surgescript_var_t* var = surgescript_var_create();
+            surgescript_var_restore(var, snapshot);
+            ssarray_push(object->suspended_var, var);
+        }
+    }
+
+    /* timers. The VM time is restored later, so
+       we don't compare the times with the current one */
+    cancel_timers(object);
+    if(surgescript_snapshot_read_byte(snapshot) != 0) {
+        object->sleep_until = surgescript_snapshot_read_uint(snapshot);
+        object->sleep_timer = surgescript_objectmanager_add_timer(manager, object->handle, object->sleep_until);
+    }
+    for(size_t n = surgescript_snapshot_read_uint(snapshot); n > 0 && !surgescript_snapshot_is_corrupted(snapshot); n--) {
+        surgescript_scheduledcall_t call;
+        call.fun_name = surgescript_snapshot_read_string(snapshot);
+        call.time = surgescript_snapshot_read_uint(snapshot);
+        call.timer = surgescript_objectmanager_add_timer(manager, object->handle, call.time);
+        ssarray_push(object->scheduled_call, call);
+    }
+}
+
+/*
+ * surgescript_object_discard()
+ * Frees the memory used by this object without calling its destructor
+ * and without touching the object tree. Used when restoring snapshots
+ */
+surgescript_object_t* surgescript_object_discard(surgescript_object_t* object)
+{
+    ssarray_release(object->child);
+    cancel_coroutine(object);
+    ssarray_release(object->suspended_var);
+    cancel_timers(object);
+    ssarray_release(object->scheduled_call);
+
+    if(object->transform != NULL)
+        surgescript_transform_destroy(object->transform);
+
+    surgescript_renv_destroy(object->renv);
+    surgescript_heap_destroy(object->heap);
+    if(object->unlisted_state_name != NULL)
+        ssfree(object->unlisted_state_name);
+    ssfree(object->name);
+    ssfree(object);
+
+    return NULL;
+}
+
+
+/* coroutines */
+
+/*
+ * surgescript_object_suspend()
+ * Suspends the current state of this object for the given number of seconds.
+ * Its stack frame is saved, and it will be resumed at the given line of code
+ * in a later update cycle. Only the current state may be suspended
+ */
+void surgescript_object_suspend(surgescript_object_t* object, const surgescript_program_t* program, unsigned line, double seconds, const surgescript_stack_t* stack)
+{
+    int n;
+
+    /* the state has been changed before suspending it */
+    if(program != object->current_state)
+        return;
+
+    /* save the stack frame */
+    cancel_coroutine(object);
+    n = (int)surgescript_stack_envsize(stack);
+    for(int i = 1; i <= n; i++)
+        ssarray_push(object->suspended_var, surgescript_var_clone(surgescript_stack_peek(stack, i)));
+
+    /* when should it be resumed? */
+    object->resume_line = line;
+    object->wake_time = surgescript_vmtime_time(object->vmtime) + seconds_to_ms(seconds);
+}
+
+/*
+ * surgescript_object_scan_suspended_objects()
+ * Scans the objects referenced by the stack frame of the suspended
+ * current state, if any (used by the garbage collector)
+ */
+void surgescript_object_scan_suspended_objects(surgescript_object_t* object, void* userdata, bool (*callback)(unsigned,void*))
+{
+    for(int i = 0; i < ssarray_length(object->suspended_var); i++) {
+        unsigned handle = surgescript_var_get_objecthandle(object->suspended_var[i]);
+        if(handle != 0 && !callback(handle, userdata)) /* if the handle is broken */
+            surgescript_var_set_null(object->suspended_var[i]); /* fix it */
+    }
+}
+
+
+/* hot reloading */
+
+/*
+ * surgescript_object_reload()
+ * Updates this object after scripts have been reloaded. old_field[] is the
+ * previous layout of the fields, indexed by heap address. If the code of its
+ * class has been replaced, the state of the object is resolved again, keeping
+ * its timers; otherwise, a suspended state is resumed as usual
+ */
+void surgescript_object_reload(surgescript_object_t* object, char* const* old_field, int old_field_count, bool replaced)
+{
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    char buffer[STATE2FUN_BUFFER_SIZE];
+    bool same_layout = (old_field_count == surgescript_programpool_field_count(program_pool, object->name));
+    surgescript_program_t* program;
+
+    /* did the layout of the fields change? */
+    for(int i = 0; i < old_field_count && same_layout; i++) {
+        const char* field = surgescript_programpool_field_name(program_pool, object->name, i);
+        if((field == NULL) != (old_field[i] == NULL) || (field != NULL && strcmp(field, old_field[i]) != 0))
+            same_layout = false;
+    }
+
+    if(!same_layout)
+        migrate_fields(object, old_field, old_field_count);
+
+    /* the same code may have been compiled again: keep the current
+       state as it is, but point to its new program */
+    program = surgescript_programpool_get(program_pool, object->name, state2fun(object->state_name, buffer, sizeof(buffer)));
+    if(!replaced && program != NULL) {
+        object->current_state = program;
+        return;
+    }
+
+    /* the program of the current state has been replaced */
+    if(program != NULL) {
+        uint64_t time_spent = object->time_spent;
+        uint64_t frames_spent = object->frames_spent;
+
+        change_state(object, object->state_name);
+        object->time_spent = time_spent;
+        object->frames_spent = frames_spent;
+    }
+    else {
+        sslog("Warning: state \"%s\" of object \"%s\" no longer exists. Changing to \"%s\".", object->state_name, object->name, MAIN_STATE);
+        change_state(object, MAIN_STATE);
+        object->last_state_change = surgescript_vmtime_time(object->vmtime);
+    }
+}
+
 /* private stuff */
 
 /* call a SurgeScript function from C. You may pass NULL to return_value if you don't need it. You may also pass NULL to param if num_params is zero */
@@ -1002,7 +1494,8 @@ void call_object_function(surgescript_object_t* object, const char* class_name,
 {
     surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
     surgescript_program_t* program = surgescript_programpool_get(program_pool, class_name, fun_name);
-    surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
+    surgescript_renv_t buffer, *renv = thread_renv(object, &buffer);
+    surgescript_stack_t* stack = surgescript_renv_stack(renv);
 
     /* sanity check */
     if(num_params < 0)
@@ -1021,9 +1514,9 @@ void call_object_function(surgescript_object_t* object, const char* class_name,
         surgescript_stack_push(stack, surgescript_var_clone(param[i]));
 
     /* call the program */
-    surgescript_program_call(program, object->renv, num_params);
+    surgescript_program_call(program, renv, num_params);
     if(return_value != NULL)
-        surgescript_var_copy(return_value, *(surgescript_renv_tmp(object->renv) + 0)); /* the return value of the function (if any) */
+        surgescript_var_copy(return_value, *(surgescript_renv_tmp(renv) + 0)); /* the return value of the function (if any) */
 
     /* pop stuff from the stack */
     surgescript_stack_popn(stack, 1 + num_params);
@@ -1051,16 +1544,34 @@ char* state2fun(const char* state, char* buffer, size_t size)
     return buffer;
 }
 
-void run_current_state(const surgescript_object_t* object)
+void run_current_state(surgescript_object_t* object)
 {
-    surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
+    surgescript_renv_t buffer, *renv = thread_renv(object, &buffer);
+    surgescript_stack_t* stack = surgescript_renv_stack(renv);
     surgescript_stack_push(stack, surgescript_var_set_objecthandle(surgescript_var_create(), object->handle));
-    surgescript_program_call(object->current_state, object->renv, 0);
+
+    if(object->resume_line == 0) {
+        surgescript_program_call(object->current_state, renv, 0);
+    }
+    else {
+        /* resume a suspended state, restoring its stack frame */
+        unsigned line = object->resume_line;
+
+        surgescript_stack_pushenv(stack);
+        for(int i = 0; i < ssarray_length(object->suspended_var); i++)
+            surgescript_stack_push(stack, object->suspended_var[i]); /* the stack owns the variables now */
+        ssarray_reset(object->suspended_var);
+        object->resume_line = 0;
+
+        surgescript_program_resume(object->current_state, renv, line);
+        surgescript_stack_popenv(stack);
+    }
+
     surgescript_stack_pop(stack);
 }
 
 /* measured in microseconds */
-uint64_t run_and_measure_current_state(const surgescript_object_t* object)
+uint64_t run_and_measure_current_state(surgescript_object_t* object)
 {
     struct timeval begin, end;
     uint64_t begin_usec, end_usec;
@@ -1087,6 +1598,229 @@ surgescript_program_t* get_state_program(const surgescript_object_t* object, con
     return program;
 }
 
+/* is the current state suspended and waiting for a moment that hasn't arrived yet? */
+bool is_waiting(const surgescript_object_t* object)
+{
+    return object->resume_line != 0 && surgescript_vmtime_time(object->vmtime) < object->wake_time;
+}
+
+/* cancels the suspension of the current state, if any */
+void cancel_coroutine(surgescript_object_t* object)
+{
+    for(int i = 0; i < ssarray_length(object->suspended_var); i++)
+        surgescript_var_destroy(object->suspended_var[i]);
+
+    ssarray_reset(object->suspended_var);
+    object->resume_line = 0;
+}
+
+/* puts the object to sleep until the given VM time, in ms */
+void sleep_until(surgescript_object_t* object, uint64_t time)
+{
+    surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+
+    surgescript_object_wake(object);
+    if(time > surgescript_vmtime_time(object->vmtime)) {
+        object->sleep_timer = surgescript_objectmanager_add_timer(manager, object->handle, time);
+        object->sleep_until = time;
+    }
+}
+
+/* cancels all timers of the object */
+void cancel_timers(surgescript_object_t* object)
+{
+    surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+
+    surgescript_object_wake(object);
+    for(int i = 0; i < ssarray_length(object->scheduled_call); i++) {
+        surgescript_objectmanager_cancel_timer(manager, object->scheduled_call[i].timer);
+        ssfree(object->scheduled_call[i].fun_name);
+    }
+
+    ssarray_reset(object->scheduled_call);
+}
+
+/* converts a (non-negative) number of seconds to ms, avoiding overflows */
+uint64_t seconds_to_ms(double seconds)
+{
+    const uint64_t MAX_TIME = UINT64_C(1) << 40; /* more than 30 years */
+
+    if(seconds > 0.0)
+        return (seconds * 1000.0 < (double)MAX_TIME) ? (uint64_t)(seconds * 1000.0) : MAX_TIME;
+    else
+        return 0;
+}
+
+/* changes the state of the object without updating the time of the last state change */
+void change_state(surgescript_object_t* object, const char* state_name)
+{
+    int state_id = surgescript_statetable_find(object->state_table, state_name);
+    char* unlisted_state_name;
+
+    /* fast path */
+    if(state_id >= 0) {
+        enter_state(object, state_id);
+        return;
+    }
+
+    /* states that aren't listed in the state table (e.g., inherited
+       from a common base) are looked up by name */
+    cancel_coroutine(object);
+    object->current_state = get_state_program(object, state_name);
+    object->is_state_empty = surgescript_program_is_empty(object->current_state);
+    unlisted_state_name = ssstrdup(state_name);
+    if(object->unlisted_state_name != NULL)
+        ssfree(object->unlisted_state_name);
+
+    object->unlisted_state_name = unlisted_state_name;
+    object->state_name = unlisted_state_name;
+    object->state_id = -1;
+    object->time_spent = 0;
+    object->frames_spent = 0;
+}
+
+/* changes the state of the object given a state id; doesn't update the time of the last state change */
+void enter_state(surgescript_object_t* object, int state_id)
+{
+    surgescript_program_t* program = surgescript_statetable_program(object->state_table, state_id);
+    const char* state_name = surgescript_statetable_name(object->state_table, state_id);
+
+    if(program == NULL)
+        ssfatal("Runtime Error: state \"%s\" of object \"%s\" doesn't exist.", state_name, object->name);
+
+    /* a suspended state is never resumed after a state change */
+    cancel_coroutine(object);
+
+    if(object->unlisted_state_name != NULL)
+        object->unlisted_state_name = ssfree(object->unlisted_state_name);
+
+    object->current_state = program;
+    object->is_state_empty = surgescript_program_is_empty(program);
+    object->state_name = state_name;
+    object->state_id = state_id;
+    object->time_spent = 0;
+    object->frames_spent = 0;
+}
+
+/* moves the values of the fields of the object to the addresses of the
+   current layout of its class, matching them by name. Removed fields are
+   set to null and new fields are initialized if they have a constant value */
+void migrate_fields(surgescript_object_t* object, char* const* old_field, int old_field_count)
+{
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    int field_count = surgescript_programpool_field_count(program_pool, object->name);
+    surgescript_var_t** value = ssmalloc((1 + field_count) * sizeof(*value));
+
+    /* read the values of the fields that are kept */
+    for(int i = 0; i < field_count; i++) {
+        const char* field = surgescript_programpool_field_name(program_pool, object->name, i);
+
+        value[i] = NULL;
+        for(int j = 0; j < old_field_count && field != NULL; j++) {
+            if(old_field[j] != NULL && strcmp(old_field[j], field) == 0) {
+                if(surgescript_heap_validaddress(object->heap, j))
+                    value[i] = surgescript_var_clone(surgescript_heap_at(object->heap, j));
+                break;
+            }
+        }
+    }
+
+    /* clear the old fields */
+    for(int j = 0; j < old_field_count; j++) {
+        if(old_field[j] != NULL && surgescript_heap_validaddress(object->heap, j))
+            surgescript_var_set_null(surgescript_heap_at(object->heap, j));
+    }
+
+    /* write the fields to their new addresses. The cells of the fields are
+       the first ones allocated by the constructor and they're never freed */
+    for(int i = 0; i < field_count; i++) {
+        while(!surgescript_heap_validaddress(object->heap, i))
+            surgescript_heap_malloc(object->heap);
+
+        if(value[i] != NULL) {
+            surgescript_var_copy(surgescript_heap_at(object->heap, i), value[i]);
+            surgescript_var_destroy(value[i]);
+        }
+        else if(surgescript_programpool_field_name(program_pool, object->name, i) != NULL) {
+            surgescript_var_set_null(surgescript_heap_at(object->heap, i));
+            initialize_field(object, i);
+        }
+    }
+
+    ssfree(value);
+}
+
+/* initializes a new field with the value assigned to it by the constructor
+   of its class, provided that it's a constant. The constructor isn't run */
+void initialize_field(surgescript_object_t* object, int address)
+{
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    surgescript_program_t* constructor = surgescript_programpool_get(program_pool, object->name, "__ssconstructor");
+    surgescript_program_operator_t op, prev_op;
+    surgescript_program_operand_t a, b, prev_a, prev_b;
+
+    if(constructor == NULL)
+        return;
+
+    /* look for a constant loaded into t[0] and then written to the field */
+    for(int line = 1; line < surgescript_program_count_lines(constructor); line++) {
+        surgescript_program_read_line(constructor, line, &op, &a, &b);
+        if(op != SSOP_POKE || a.u != 0 || b.u != (unsigned)address)
+            continue;
+
+        surgescript_program_read_line(constructor, line - 1, &prev_op, &prev_a, &prev_b);
+        if(prev_a.u != 0 || surgescript_program_is_jump_target(constructor, line))
+            continue;
+
+        switch(prev_op) {
+            case SSOP_MOVN:
+            case SSOP_MOVB:
+            case SSOP_MOVF:
+            case SSOP_MOVS:
+            case SSOP_MOVX:
+                surgescript_program_run_line(constructor, object->renv, line - 1);
+                surgescript_program_run_line(constructor, object->renv, line);
+                return;
+
+            default:
+                break;
+        }
+    }
+}
+
+/* the runtime environment of an object as seen by the current thread: worker threads use their own stacks */
+surgescript_renv_t* thread_renv(const surgescript_object_t* object, surgescript_renv_t* buffer)
+{
+#if SURGESCRIPT_ENABLE_THREADS
+    if(thread_stack != NULL) {
+        *buffer = *(object->renv);
+        buffer->stack = thread_stack;
+        return buffer;
+    }
+#endif
+
+    return object->renv;
+}
+
+/* are the children of this object traversed when updating the object tree?
+   (i.e., are this object and all its ascendants active?) */
+bool is_traversed(const surgescript_object_t* object)
+{
+    const surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+
+    while(object->is_active && object->parent != object->handle)
+        object = surgescript_objectmanager_get(manager, object->parent);
+
+    return object->is_active;
+}
+
+/* the traversed part of the object tree has changed */
+void invalidate_tree(const surgescript_object_t* object)
+{
+    surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(object->renv);
+    surgescript_objectmanager_invalidate_tree(manager);
+}
+
 bool object_exists(surgescript_programpool_t* program_pool, const char* object_name)
 {
     return NULL != surgescript_programpool_get(program_pool, object_name, "state:" MAIN_STATE);
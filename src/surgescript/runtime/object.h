@@ -55,6 +55,7 @@ void* surgescript_object_userdata(const surgescript_object_t* object); /* custom
 void surgescript_object_set_userdata(surgescript_object_t* object, void* data); /* set custom user data */
 bool surgescript_object_has_tag(const surgescript_object_t* object, const char* tag_name); /* is this object tagged tag_name? */
 bool surgescript_object_has_function(const surgescript_object_t* object, const char* fun_name); /* does the object have the specified function? */
+bool surgescript_object_is_isolated(const surgescript_object_t* object); /* may my subtree be updated in parallel with the rest of the object tree? */
 double surgescript_object_elapsed_time(const surgescript_object_t* object); /* elapsed time (in seconds) since last state change */
 double surgescript_object_timespent(const surgescript_object_t* object); /* average time consumption (in seconds) */
 size_t surgescript_object_memspent(const surgescript_object_t* object); /* memory consumption (in bytes) */
@@ -89,6 +90,13 @@ void surgescript_object_set_active(surgescript_object_t* object, bool active); /
 bool surgescript_object_is_killed(const surgescript_object_t* object); /* has this object been killed? */
 void surgescript_object_kill(surgescript_object_t* object); /* will destroy the object as soon as the opportunity arises */
 
+/* timers */
+void surgescript_object_sleep(surgescript_object_t* object, double seconds); /* my subtree won't be updated for the given number of seconds */
+void surgescript_object_sleep_until(surgescript_object_t* object, double time); /* my subtree won't be updated until the given VM time (in seconds) */
+void surgescript_object_wake(surgescript_object_t* object); /* wakes me up if I'm sleeping */
+bool surgescript_object_is_sleeping(const surgescript_object_t* object); /* am I sleeping? */
+void surgescript_object_schedule(surgescript_object_t* object, const char* fun_name, double seconds); /* calls one of my functions (without parameters) after the given number of seconds */
+
 /* transform */
 void surgescript_object_peek_transform(const surgescript_object_t* object, struct surgescript_transform_t* transform); /* reads the local transform */
 void surgescript_object_poke_transform(surgescript_object_t* object, const struct surgescript_transform_t* transform); /* sets the local transform */
@@ -26,12 +26,16 @@
 #include "program_pool.h"
 #include "tag_system.h"
 #include "vm_time.h"
+#include "timer_wheel.h"
+#include "vm_console.h"
 #include "stack.h"
 #include "heap.h"
 #include "variable.h"
+#include "snapshot.h"
 #include "../util/ssarray.h"
 #include "../util/util.h"
 #include "../util/perfect_hash.h"
+#include "../util/thread.h"
 
 #define XXH_INLINE_ALL
 #include "../third_party/xxhash.h"
@@ -62,6 +66,7 @@ struct surgescript_objectmanager_t
 
     surgescript_vmargs_t* args; /* VM command-line arguments (NULL-terminated array) */
     const surgescript_vmtime_t* vmtime; /* VM time */
+    surgescript_vmconsole_t* console; /* VM console */
 
     SSARRAY(surgescript_objecthandle_t, objects_to_be_scanned); /* garbage collection */
     SSARRAY(surgescript_objecthandle_t, objects_scheduled_for_removal); /* a helper for the garbage collector */
@@ -72,6 +77,14 @@ struct surgescript_objectmanager_t
     SSARRAY(char*, plugin_list); /* plugin list */
 
     surgescript_perfecthashseed_t class_id_seed; /* used to generate class IDs from object names */
+    SSARRAY(surgescript_objectclassid_t, isolated_classes); /* classes whose subtrees may be updated in parallel */
+
+    surgescript_mutex_t mutex; /* serializes spawn & delete when objects are updated in parallel */
+    SSARRAY(surgescript_object_t**, retired_data); /* object tables replaced while objects were being updated in parallel */
+
+    unsigned tree_version; /* changes whenever the traversed part of the object tree changes */
+
+    surgescript_timerwheel_t* timer_wheel; /* timers of sleeping objects & scheduled functions */
 };
 
 /* fixed objects */
@@ -111,9 +124,18 @@ extern surgescript_object_t* surgescript_object_destroy(surgescript_object_t* ob
 extern void surgescript_object_init(surgescript_object_t* object); /* initializes the object (calls constructor, and so on) */
 extern void surgescript_object_release(surgescript_object_t* object); /* releases the object (calls destructor, and so on) */
 
+/* snapshots of the objects are taken & restored by me */
+extern void surgescript_object_snapshot(const surgescript_object_t* object, surgescript_snapshot_t* snapshot); /* writes the state of an object */
+extern void surgescript_object_restore(surgescript_object_t* object, surgescript_snapshot_t* snapshot); /* reads the state of an object */
+extern surgescript_object_t* surgescript_object_discard(surgescript_object_t* object); /* frees an object without calling its destructor */
+
 /* garbage collection is handled by me also */
 extern bool surgescript_object_is_reachable(const surgescript_object_t* object); /* is this object reachable through some other? */
 extern void surgescript_object_set_reachable(surgescript_object_t* object, bool reachable); /* sets whether this object is reachable or not */
+extern void surgescript_object_scan_suspended_objects(surgescript_object_t* object, void* userdata, bool (*callback)(unsigned,void*)); /* scans the stack frame of a suspended state */
+
+/* I keep the timers of the objects */
+extern void surgescript_object_fire_timer(surgescript_object_t* object, int timer); /* a timer of an object has expired */
 
 /* garbage collector: private stuff */
 static bool mark_as_reachable(surgescript_objecthandle_t handle, void* mgr);
@@ -130,6 +152,9 @@ static inline surgescript_object_t* plugin_object(const surgescript_objectmanage
 static void accumulate_object_name(const char* object_name, void* data);
 static inline surgescript_perfecthashkey_t seeded_hash(const char* string, surgescript_perfecthashseed_t seed);
 static inline surgescript_objectclassid_t find_class_id(const surgescript_objectmanager_t* manager, const char* object_name);
+static void fire_timer(int timer, unsigned handle, void* mgr);
+static void grow_object_table(surgescript_objectmanager_t* manager);
+static void release_retired_data(surgescript_objectmanager_t* manager);
 
 /* the initial size of the object table
    object handles are recycled, so we pick a large value */
@@ -148,7 +173,7 @@ SS_STATIC_ASSERT(sizeof(surgescript_objectclassid_t) == sizeof(surgescript_perfe
  * surgescript_objectmanager_create()
  * Creates a new object manager
  */
-surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_stack_t* stack, surgescript_vmargs_t* args, const surgescript_vmtime_t* vmtime)
+surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_stack_t* stack, surgescript_vmargs_t* args, const surgescript_vmtime_t* vmtime, surgescript_vmconsole_t* console)
 {
     surgescript_objectmanager_t* manager = ssmalloc(sizeof *manager);
 
@@ -164,6 +189,7 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
 
     manager->args = args;
     manager->vmtime = vmtime;
+    manager->console = console;
     manager->next_handle = ROOT_HANDLE;
 
     ssarray_init(manager->objects_to_be_scanned);
@@ -175,6 +201,14 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
     ssarray_init(manager->plugin_list);
 
     manager->class_id_seed = NO_SEED;
+    ssarray_init(manager->isolated_classes);
+
+    ssmutex_init(&manager->mutex);
+    ssarray_init(manager->retired_data);
+
+    manager->tree_version = 0;
+
+    manager->timer_wheel = surgescript_timerwheel_create(surgescript_vmtime_time(vmtime));
 
     return manager;
 }
@@ -190,11 +224,18 @@ surgescript_objectmanager_t* surgescript_objectmanager_destroy(surgescript_objec
     while(handle != 0)
         surgescript_objectmanager_delete(manager, --handle);
 
+    surgescript_timerwheel_destroy(manager->timer_wheel);
+
     ssarray_release(manager->objects_scheduled_for_removal);
     ssarray_release(manager->objects_to_be_scanned);
+    ssarray_release(manager->isolated_classes);
     ssarray_release(manager->data);
+    release_retired_data(manager);
+    ssarray_release(manager->retired_data);
     release_plugin_list(manager);
 
+    ssmutex_destroy(&manager->mutex);
+
     return ssfree(manager);
 }
 
@@ -241,15 +282,22 @@ bool surgescript_objectmanager_generate_class_ids(surgescript_objectmanager_t* m
  */
 surgescript_objecthandle_t surgescript_objectmanager_spawn(surgescript_objectmanager_t* manager, surgescript_objecthandle_t parent, const char* object_name, void* user_data)
 {
+    ssmutex_lock(&manager->mutex);
+
     surgescript_objecthandle_t handle = new_handle(manager);
     surgescript_object_t *parent_object = surgescript_objectmanager_get(manager, parent);
 
     /* can't spawn the root object, neither using the C API nor via SurgeScript code (i.e., Object.spawn("System")) */
     if(handle == ROOT_HANDLE || 0 == strcmp(object_name, "System")) {
         ssfatal("Object \"%s\" can't spawn the root object.", surgescript_object_name(parent_object));
+        ssmutex_unlock(&manager->mutex);
         return NULL_HANDLE;
     }
 
+    /* the object table can't be reallocated while other threads are reading it */
+    if(handle >= manager->data_cap && ssconcurrent())
+        grow_object_table(manager);
+
     /* create the object */
     surgescript_objectclassid_t class_id = find_class_id(manager, object_name);
     surgescript_object_t *object = surgescript_object_create(object_name, class_id, handle, manager, manager->program_pool, manager->stack, manager->vmtime, user_data);
@@ -272,6 +320,7 @@ surgescript_objecthandle_t surgescript_objectmanager_spawn(surgescript_objectman
 
     /* this is important for garbage collection (will be cleared up later) */
     surgescript_object_set_reachable(object, true); /* assume the object is reachable at this frame */
+    ssmutex_unlock(&manager->mutex);
 
     /* call constructor and so on */
     surgescript_object_init(object);
@@ -343,13 +392,132 @@ surgescript_object_t* surgescript_objectmanager_get(const surgescript_objectmana
  */
 bool surgescript_objectmanager_delete(surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle)
 {
+    bool deleted = false;
+
+    ssmutex_lock(&manager->mutex);
     if(handle < ssarray_length(manager->data)) {
         if(manager->data[handle] != NULL) {
             manager->data[handle] = surgescript_object_destroy(manager->data[handle]);
             manager->count--;
-            return true;
+            deleted = true;
         }
     }
+    ssmutex_unlock(&manager->mutex);
+
+    return deleted;
+}
+
+/*
+ * surgescript_objectmanager_invalidate_tree()
+ * Signals that the traversed part of the object tree has changed: an object
+ * has been added to or removed from it, or it has been (de)activated
+ */
+void surgescript_objectmanager_invalidate_tree(surgescript_objectmanager_t* manager)
+{
+    manager->tree_version++;
+}
+
+/*
+ * surgescript_objectmanager_tree_version()
+ * A number that changes whenever the traversed part of the object tree
+ * changes. Use it to invalidate data derived from the structure of the tree
+ */
+unsigned surgescript_objectmanager_tree_version(const surgescript_objectmanager_t* manager)
+{
+    return manager->tree_version;
+}
+
+/*
+ * surgescript_objectmanager_run_timers()
+ * Fires the timers that have expired at the current VM time: sleeping
+ * objects are woken up and scheduled functions are called. The cost
+ * depends on the number of expired timers, not on the number of objects
+ */
+void surgescript_objectmanager_run_timers(surgescript_objectmanager_t* manager)
+{
+    uint64_t now = surgescript_vmtime_time(manager->vmtime);
+    surgescript_timerwheel_advance(manager->timer_wheel, now, manager, fire_timer);
+}
+
+/*
+ * surgescript_objectmanager_add_timer()
+ * Adds a timer owned by the object with the given handle. It expires at
+ * the given VM time (in ms). Returns the ID of the timer
+ */
+int surgescript_objectmanager_add_timer(surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle, uint64_t expires)
+{
+    int timer;
+
+    ssmutex_lock(&manager->mutex);
+    timer = surgescript_timerwheel_add(manager->timer_wheel, expires, handle);
+    ssmutex_unlock(&manager->mutex);
+
+    return timer;
+}
+
+/*
+ * surgescript_objectmanager_cancel_timer()
+ * Cancels a timer. Its ID may be reused afterwards
+ */
+void surgescript_objectmanager_cancel_timer(surgescript_objectmanager_t* manager, int timer)
+{
+    ssmutex_lock(&manager->mutex);
+    surgescript_timerwheel_cancel(manager->timer_wheel, timer);
+    ssmutex_unlock(&manager->mutex);
+}
+
+/*
+ * surgescript_objectmanager_reserve()
+ * Makes sure that at least n more objects can be stored in the object table
+ * without reallocating it. Call this before updating objects in parallel:
+ * growing the table while that happens is more expensive.
+ */
+void surgescript_objectmanager_reserve(surgescript_objectmanager_t* manager, int n)
+{
+    size_t capacity = manager->data_cap;
+
+    /* no other threads are reading the tables we replaced */
+    release_retired_data(manager);
+
+    while(capacity < ssarray_length(manager->data) + n)
+        capacity *= 2;
+
+    if(capacity > manager->data_cap) {
+        manager->data = ssrealloc(manager->data, capacity * sizeof(*(manager->data)));
+        manager->data_cap = capacity;
+    }
+}
+
+/*
+ * surgescript_objectmanager_isolate_class()
+ * Marks a class of objects as isolated: the subtrees of its instances may be
+ * updated in parallel with the rest of the object tree. Call this after the
+ * class IDs have been generated.
+ */
+void surgescript_objectmanager_isolate_class(surgescript_objectmanager_t* manager, const char* object_name)
+{
+    ssassert(manager->class_id_seed != NO_SEED);
+
+    if(!surgescript_objectmanager_class_exists(manager, object_name)) {
+        ssfatal("Can't isolate \"%s\": the object doesn't exist.", object_name);
+        return;
+    }
+
+    surgescript_objectclassid_t class_id = find_class_id(manager, object_name);
+    if(!surgescript_objectmanager_is_isolated_class(manager, class_id))
+        ssarray_push(manager->isolated_classes, class_id);
+}
+
+/*
+ * surgescript_objectmanager_is_isolated_class()
+ * Is the specified class of objects isolated?
+ */
+bool surgescript_objectmanager_is_isolated_class(const surgescript_objectmanager_t* manager, surgescript_objectclassid_t class_id)
+{
+    for(int i = 0; i < ssarray_length(manager->isolated_classes); i++) {
+        if(manager->isolated_classes[i] == class_id)
+            return true;
+    }
 
     return false;
 }
@@ -487,6 +655,15 @@ surgescript_vmargs_t* surgescript_objectmanager_vmargs(const surgescript_objectm
     return manager->args;
 }
 
+/*
+ * surgescript_objectmanager_vmconsole()
+ * VM console
+ */
+surgescript_vmconsole_t* surgescript_objectmanager_vmconsole(const surgescript_objectmanager_t* manager)
+{
+    return manager->console;
+}
+
 /*
  * surgescript_objectmanager_garbagecollect()
  * Runs the garbage collector (incremental mark-and-sweep algorithm)
@@ -543,6 +720,7 @@ void surgescript_objectmanager_garbagecheck(surgescript_objectmanager_t* manager
         if(manager->data[handle] != NULL) {
             surgescript_heap_t* heap = surgescript_object_heap(manager->data[handle]);
             surgescript_heap_scan_objects(heap, manager, mark_as_reachable);
+            surgescript_object_scan_suspended_objects(manager->data[handle], manager, mark_as_reachable);
         }
     }
     manager->first_object_to_be_scanned = old_length;
@@ -604,6 +782,204 @@ bool surgescript_objectmanager_class_exists(const surgescript_objectmanager_t* m
     return surgescript_programpool_is_compiled(manager->program_pool, object_name);
 }
 
+/*
+ * surgescript_objectmanager_snapshot()
+ * Writes all objects and the state of the garbage collector to a snapshot
+ */
+void surgescript_objectmanager_snapshot(const surgescript_objectmanager_t* manager, surgescript_snapshot_t* snapshot)
+{
+    SSARRAY(const surgescript_object_t*, class_object); /* one object of each class */
+    SSARRAY(surgescript_objectclassid_t, class_id);
+
+    /* list the classes of objects. Class IDs are perfect hashes */
+    ssarray_init(class_object);
+    ssarray_init(class_id);
+    for(surgescript_objecthandle_t handle = 0; handle < ssarray_length(manager->data); handle++) {
+        const surgescript_object_t* object = manager->data[handle];
+        int i;
+
+        if(object == NULL)
+            continue;
+
+        for(i = 0; i < ssarray_length(class_id); i++) {
+            if(class_id[i] == surgescript_object_class_id(object))
+                break;
+        }
+
+        if(i == ssarray_length(class_id)) {
+            ssarray_push(class_id, surgescript_object_class_id(object));
+            ssarray_push(class_object, object);
+        }
+    }
+
+    /* write the names of the classes and fingerprints of their code */
+    surgescript_snapshot_write_uint(snapshot, ssarray_length(class_object));
+    for(int i = 0; i < ssarray_length(class_object); i++) {
+        const char* object_name = surgescript_object_name(class_object[i]);
+        surgescript_snapshot_write_string(snapshot, object_name);
+        surgescript_snapshot_write_uint(snapshot, surgescript_programpool_fingerprint(manager->program_pool, object_name));
+    }
+
+    /* write the objects */
+    surgescript_snapshot_write_uint(snapshot, ssarray_length(manager->data));
+    surgescript_snapshot_write_uint(snapshot, manager->next_handle);
+    surgescript_snapshot_write_uint(snapshot, manager->count);
+    for(surgescript_objecthandle_t handle = 0; handle < ssarray_length(manager->data); handle++) {
+        const surgescript_object_t* object = manager->data[handle];
+        int i;
+
+        if(object == NULL)
+            continue;
+
+        for(i = 0; class_id[i] != surgescript_object_class_id(object); i++);
+
+        surgescript_snapshot_write_uint(snapshot, handle);
+        surgescript_snapshot_write_uint(snapshot, i);
+        surgescript_object_snapshot(object, snapshot);
+    }
+
+    /* write the state of the garbage collector */
+    surgescript_snapshot_write_uint(snapshot, manager->first_object_to_be_scanned);
+    surgescript_snapshot_write_uint(snapshot, manager->reachables_count);
+    surgescript_snapshot_write_uint(snapshot, manager->garbage_count);
+    surgescript_snapshot_write_uint(snapshot, ssarray_length(manager->objects_to_be_scanned));
+    for(int i = 0; i < ssarray_length(manager->objects_to_be_scanned); i++)
+        surgescript_snapshot_write_uint(snapshot, manager->objects_to_be_scanned[i]);
+
+    /* done */
+    ssarray_release(class_id);
+    ssarray_release(class_object);
+}
+
+/*
+ * surgescript_objectmanager_restore()
+ * Replaces all objects and the state of the garbage collector by those stored
+ * in a snapshot. Handles are preserved. Existing objects of the same class are
+ * reused in place; the others are created or discarded without calling their
+ * constructors or destructors. Returns false if nothing could be restored
+ */
+bool surgescript_objectmanager_restore(surgescript_objectmanager_t* manager, surgescript_snapshot_t* snapshot)
+{
+    SSARRAY(char*, class_name);
+    SSARRAY(uint64_t, fingerprint);
+    SSARRAY(bool, restored);
+    surgescript_objecthandle_t table_length, handle;
+    int count;
+    bool success = true;
+
+    /* read the names of the classes */
+    ssarray_init(class_name);
+    ssarray_init(fingerprint);
+    for(size_t n = surgescript_snapshot_read_uint(snapshot); n > 0 && !surgescript_snapshot_is_corrupted(snapshot); n--) {
+        ssarray_push(class_name, surgescript_snapshot_read_string(snapshot));
+        ssarray_push(fingerprint, surgescript_snapshot_read_uint(snapshot));
+    }
+
+    /* validate the snapshot before touching anything */
+    table_length = surgescript_snapshot_read_uint(snapshot);
+    if(surgescript_snapshot_is_corrupted(snapshot) || table_length <= ROOT_HANDLE) {
+        sslog("Can't restore snapshot: the data is corrupted");
+        success = false;
+    }
+    else if(table_length > ssarray_length(manager->data) && ssconcurrent()) {
+        sslog("Can't restore snapshot: the object table can't be resized while updating objects in parallel");
+        success = false;
+    }
+    else for(int i = 0; i < ssarray_length(class_name); i++) {
+        if(!surgescript_objectmanager_class_exists(manager, class_name[i])) {
+            sslog("Can't restore snapshot: object \"%s\" doesn't exist", class_name[i]);
+            success = false;
+            break;
+        }
+        else if(surgescript_programpool_fingerprint(manager->program_pool, class_name[i]) != fingerprint[i]) {
+            /* its states, fields or functions may be different */
+            sslog("Can't restore snapshot: the code of object \"%s\" has changed", class_name[i]);
+            success = false;
+            break;
+        }
+    }
+
+    ssarray_release(fingerprint);
+    if(!success) {
+        for(int i = 0; i < ssarray_length(class_name); i++)
+            ssfree(class_name[i]);
+        ssarray_release(class_name);
+        return false;
+    }
+
+    /* resize the object table */
+    while(ssarray_length(manager->data) < table_length)
+        ssarray_push(manager->data, NULL);
+    ssarray_init_ex(restored, ssarray_length(manager->data));
+    while(ssarray_length(restored) < ssarray_length(manager->data))
+        ssarray_push(restored, false);
+
+    /* restore the objects in a single pass */
+    manager->next_handle = surgescript_snapshot_read_uint(snapshot);
+    count = surgescript_snapshot_read_uint(snapshot);
+    for(int i = 0; i < count; i++) {
+        size_t class_index;
+        surgescript_object_t* object;
+
+        handle = surgescript_snapshot_read_uint(snapshot);
+        class_index = surgescript_snapshot_read_uint(snapshot);
+        if(handle == NULL_HANDLE || handle >= table_length || restored[handle] || class_index >= ssarray_length(class_name) || surgescript_snapshot_is_corrupted(snapshot))
+            ssfatal("Can't restore snapshot: the data is corrupted");
+
+        /* reuse the existing object if it's of the same class; its user-data is kept */
+        object = manager->data[handle];
+        if(object != NULL && strcmp(surgescript_object_name(object), class_name[class_index]) != 0)
+            object = surgescript_object_discard(object);
+
+        /* create a blank object */
+        if(object == NULL) {
+            const char* object_name = class_name[class_index];
+            surgescript_objectclassid_t class_id = find_class_id(manager, object_name);
+            object = surgescript_object_create(object_name, class_id, handle, manager, manager->program_pool, manager->stack, manager->vmtime, NULL);
+            manager->data[handle] = object;
+        }
+
+        /* read its state */
+        surgescript_object_restore(object, snapshot);
+        restored[handle] = true;
+    }
+
+    /* discard the objects that aren't in the snapshot */
+    for(handle = 0; handle < ssarray_length(manager->data); handle++) {
+        if(manager->data[handle] != NULL && !restored[handle])
+            manager->data[handle] = surgescript_object_discard(manager->data[handle]);
+    }
+
+    while(ssarray_length(manager->data) > table_length) {
+        surgescript_object_t* unused;
+        ssarray_pop(manager->data, unused);
+        (void)unused;
+    }
+    manager->count = count;
+
+    /* restore the state of the garbage collector */
+    manager->first_object_to_be_scanned = surgescript_snapshot_read_uint(snapshot);
+    manager->reachables_count = surgescript_snapshot_read_uint(snapshot);
+    manager->garbage_count = surgescript_snapshot_read_uint(snapshot);
+    ssarray_reset(manager->objects_to_be_scanned);
+    ssarray_reset(manager->objects_scheduled_for_removal);
+    for(size_t n = surgescript_snapshot_read_uint(snapshot); n > 0 && !surgescript_snapshot_is_corrupted(snapshot); n--)
+        ssarray_push(manager->objects_to_be_scanned, surgescript_snapshot_read_uint(snapshot));
+
+    if(surgescript_snapshot_is_corrupted(snapshot))
+        ssfatal("Can't restore snapshot: the data is corrupted");
+
+    /* the object tree has changed */
+    surgescript_objectmanager_invalidate_tree(manager);
+
+    /* done */
+    ssarray_release(restored);
+    for(int i = 0; i < ssarray_length(class_name); i++)
+        ssfree(class_name[i]);
+    ssarray_release(class_name);
+    return true;
+}
+
 /* private stuff */
 
 /* garbage collector */
@@ -645,6 +1021,39 @@ bool sweep_unreachables(surgescript_object_t* object, void* mgr)
     }
 }
 
+/* a timer has expired: let its owner handle it. Objects
+   cancel their timers when destroyed, so the owner exists */
+void fire_timer(int timer, unsigned handle, void* mgr)
+{
+    surgescript_objectmanager_t* manager = (surgescript_objectmanager_t*)mgr;
+    surgescript_object_fire_timer(surgescript_objectmanager_get(manager, handle), timer);
+}
+
+/* grows the object table while other threads may be reading it (call with the
+   mutex locked). The old table is kept until no other thread can be using it */
+void grow_object_table(surgescript_objectmanager_t* manager)
+{
+    size_t capacity = 2 * manager->data_cap;
+    surgescript_object_t** data = ssmalloc(capacity * sizeof(*data));
+
+    memcpy(data, manager->data, ssarray_length(manager->data) * sizeof(*data));
+    ssarray_push(manager->retired_data, manager->data);
+
+    manager->data = data;
+    manager->data_cap = capacity;
+}
+
+/* releases the object tables replaced by grow_object_table() */
+void release_retired_data(surgescript_objectmanager_t* manager)
+{
+    surgescript_object_t** data = NULL;
+
+    while(ssarray_length(manager->retired_data) > 0) {
+        ssarray_pop(manager->retired_data, data);
+        ssfree(data);
+    }
+}
+
 /* gets a handle at a unused space */
 surgescript_objecthandle_t new_handle(surgescript_objectmanager_t* manager)
 {
@@ -23,6 +23,7 @@
 #define _SURGESCRIPT_RUNTIME_OBJECTMANAGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "object.h"
 
 /* opaque types */
@@ -35,12 +36,13 @@ struct surgescript_stack_t;
 struct surgescript_tagsystem_t;
 struct surgescript_vmargs_t;
 struct surgescript_vmtime_t;
+struct surgescript_vmconsole_t;
 
 
 /* public methods */
 
 /* life-cycle */
-surgescript_objectmanager_t* surgescript_objectmanager_create(struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_stack_t* stack, struct surgescript_vmargs_t* args, const struct surgescript_vmtime_t* vmtime);
+surgescript_objectmanager_t* surgescript_objectmanager_create(struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_stack_t* stack, struct surgescript_vmargs_t* args, const struct surgescript_vmtime_t* vmtime, struct surgescript_vmconsole_t* console);
 surgescript_objectmanager_t* surgescript_objectmanager_destroy(surgescript_objectmanager_t* manager);
 
 /* initialization */
@@ -55,11 +57,26 @@ bool surgescript_objectmanager_delete(surgescript_objectmanager_t* manager, surg
 int surgescript_objectmanager_count(const surgescript_objectmanager_t* manager); /* how many objects there are? */
 void surgescript_objectmanager_install_plugin(surgescript_objectmanager_t* manager, const char* object_name); /* installs a plugin */
 bool surgescript_objectmanager_class_exists(const surgescript_objectmanager_t* manager, const char* object_name); /* does the specified class of objects exist? */
+void surgescript_objectmanager_reserve(surgescript_objectmanager_t* manager, int n); /* makes room for n more objects in the object table */
+
+/* structure of the object tree */
+void surgescript_objectmanager_invalidate_tree(surgescript_objectmanager_t* manager); /* the traversed part of the object tree has changed */
+unsigned surgescript_objectmanager_tree_version(const surgescript_objectmanager_t* manager); /* changes whenever the traversed part of the object tree changes */
+
+/* timers */
+void surgescript_objectmanager_run_timers(surgescript_objectmanager_t* manager); /* wakes up the sleeping objects & calls the scheduled functions whose time has come */
+int surgescript_objectmanager_add_timer(surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle, uint64_t expires); /* adds a timer owned by an object, expiring at the given VM time (in ms); returns its ID */
+void surgescript_objectmanager_cancel_timer(surgescript_objectmanager_t* manager, int timer); /* cancels a timer */
+
+/* parallel updates */
+void surgescript_objectmanager_isolate_class(surgescript_objectmanager_t* manager, const char* object_name); /* the subtrees of objects of this class may be updated in parallel */
+bool surgescript_objectmanager_is_isolated_class(const surgescript_objectmanager_t* manager, surgescript_objectclassid_t class_id); /* is the specified class isolated? */
 
 /* components */
 struct surgescript_programpool_t* surgescript_objectmanager_programpool(const surgescript_objectmanager_t* manager); /* pointer to the program pool */
 struct surgescript_tagsystem_t* surgescript_objectmanager_tagsystem(const surgescript_objectmanager_t* manager); /* pointer to the tag manager */
 struct surgescript_vmargs_t* surgescript_objectmanager_vmargs(const surgescript_objectmanager_t* manager); /* VM command-line arguments */
+struct surgescript_vmconsole_t* surgescript_objectmanager_vmconsole(const surgescript_objectmanager_t* manager); /* VM console */
 
 /* garbage collector */
 void surgescript_objectmanager_garbagecheck(surgescript_objectmanager_t* manager); /* checks for garbage (incrementally) */
@@ -24,6 +24,7 @@
 #include <math.h>
 #include <float.h>
 #include <string.h>
+#include <inttypes.h>
 #include "program.h"
 #include "variable.h"
 #include "heap.h"
@@ -32,8 +33,12 @@
 #include "renv.h"
 #include "object_manager.h"
 #include "program_pool.h"
+#include "intrinsics.h"
+#include "jit.h"
+#include "sslib/sslib.h"
 #include "../util/util.h"
 #include "../util/ssarray.h"
+#include "../util/thread.h"
 
 /* require alloca */
 #if !(defined(__APPLE__) || defined(MACOSX) || defined(macintosh) || defined(Macintosh))
@@ -43,22 +48,52 @@
 #endif
 #endif
 
-/* an operation / command */
+/* an operation / command, packed in 8 bytes. Operands that don't fit
+   (doubles, pointers, large numbers) are stored in a separate table */
 typedef struct surgescript_program_operation_t surgescript_program_operation_t;
 struct surgescript_program_operation_t
 {
-    surgescript_program_operator_t instruction;
+    uint32_t code; /* bits 0-6: instruction; bit 7: wide flag; bits 8-31: operand a (signed) or an index of the table of wide operands */
+    uint32_t b; /* operand b */
+};
+
+/* the operands of a wide operation */
+typedef struct surgescript_program_wideoperation_t surgescript_program_wideoperation_t;
+struct surgescript_program_wideoperation_t
+{
     surgescript_program_operand_t a;
     surgescript_program_operand_t b;
 };
 
+/* a call site: operand a of a CALL is an index of the table of call sites */
+typedef struct surgescript_program_callsite_t surgescript_program_callsite_t;
+struct surgescript_program_callsite_t
+{
+    unsigned fun_name; /* the name of the called program (index of the text section) */
+    surgescript_objectclassid_t class_id; /* inline cache: class of the latest callee */
+    int count; /* inline cache: number of consecutive calls with the same class */
+    int lock; /* inline cache: nonzero while the call is running */
+    surgescript_program_t* program; /* inline cache: the cached program of an OPTCALL */
+    int intrinsic; /* intrinsic of the called method, or -1 if there is none */
+};
+
+/* encoding of the operations */
+#define OPERATION_INSTRUCTION(code)     ((surgescript_program_operator_t)((code) & 0x7F))
+#define OPERATION_WIDE                  0x80
+#define OPERATION_A(code)               ((uint32_t)((int32_t)(code) >> 8))
+
 /* the program structure */
 struct surgescript_program_t
 {
     int arity; /* config */
     bool executed; /* has this program ever been executed? */
     void (*run)(surgescript_program_t*, const surgescript_renv_t*); /* run function; strategy pattern */
+    surgescript_program_aotfunction_t aot; /* ahead-of-time compiled code (may be NULL) */
+    surgescript_jit_t* jit; /* machine code generated by the JIT compiler (may be NULL) */
+    unsigned calls; /* call counter used to detect hot programs */
     SSARRAY(surgescript_program_operation_t, line); /* a set of operations (or lines of code) */
+    SSARRAY(surgescript_program_wideoperation_t, wide); /* operands that don't fit in an operation */
+    SSARRAY(surgescript_program_callsite_t, callsite); /* call sites and their inline caches */
     SSARRAY(surgescript_program_label_t, label); /* labels (label[j] is the index of a line of code, j is a label) */
     SSARRAY(char*, text); /* read-only text data */
 };
@@ -76,24 +111,34 @@ static const char* instruction_name[] = {
     #define PRINT_NAME(x, y) y,
     SURGESCRIPT_PROGRAM_OPERATORS(PRINT_NAME)
 };
+SS_STATIC_ASSERT(sizeof(instruction_name) / sizeof(instruction_name[0]) <= 0x80, instruction_bits); /* see OPERATION_INSTRUCTION() */
 
 /* utilities */
 static surgescript_program_t* init_program(surgescript_program_t* program, int arity, void (*run_function)(surgescript_program_t*, const surgescript_renv_t*));
 static void run_program(surgescript_program_t* program, const surgescript_renv_t* runtime_environment);
+static void run_program_from(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip);
 static void run_cprogram(surgescript_program_t* program, const surgescript_renv_t* runtime_environment);
+static void run_aotprogram(surgescript_program_t* program, const surgescript_renv_t* runtime_environment);
 #ifdef __GNUC__
-static inline __attribute__((flatten,always_inline)) unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip);
+static inline __attribute__((flatten,always_inline)) unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip, bool single_line);
 #else
-static SS_FORCE_INLINE unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip);
+static SS_FORCE_INLINE unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip, bool single_line);
 #endif
-static unsigned int run_call_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_operand_t a, surgescript_program_operand_t b);
-static unsigned int run_optcall_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_operand_t a, surgescript_program_operand_t b);
+static unsigned int run_call_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_callsite_t* callsite, int number_of_params);
+static unsigned int run_optcall_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_callsite_t* callsite, int number_of_params);
 static surgescript_program_t* call_program(const surgescript_renv_t* caller_runtime_environment, int number_of_given_params, const char* program_name, surgescript_program_t* program, surgescript_objectclassid_t* out_class_id);
 static inline bool is_jump_instruction(surgescript_program_operator_t instruction);
 static inline bool remove_labels(surgescript_program_t* program);
+static surgescript_program_operation_t encode_operation(surgescript_program_t* program, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b, const surgescript_program_operation_t* previous);
+static void find_entries(const surgescript_program_t* program, const surgescript_program_operation_t* operation, int* wide_index, int* callsite_index);
+static void discard_entries(surgescript_program_t* program, int wide_index, int callsite_index);
+static inline surgescript_program_operator_t decode_operation(const surgescript_program_t* program, const surgescript_program_operation_t* operation, surgescript_program_operand_t* a, surgescript_program_operand_t* b);
+static inline void reset_callsite(surgescript_program_callsite_t* callsite);
 static char* hexdump(unsigned data, char* buf); /* writes the bytes stored in data to buf, in hex format */
 static void fputs_escaped(const char* str, FILE* fp); /* works like fputs, but escapes the string */
 static const int MAX_PROGRAM_ARITY = 256;
+extern void surgescript_object_set_state_id(surgescript_object_t* object, int state_id);
+extern void surgescript_object_suspend(surgescript_object_t* object, const surgescript_program_t* program, unsigned line, double seconds, const surgescript_stack_t* stack);
 
 /* debug mode? */
 #define SURGESCRIPT_DEBUG_MODE          0
@@ -101,10 +146,39 @@ static const int MAX_PROGRAM_ARITY = 256;
 static inline void debug(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operator_t instruction, surgescript_program_operand_t a, surgescript_program_operand_t b, surgescript_var_t** _t);
 #endif
 
+/* profiling: count the pairs of instructions that the interpreter runs in
+   sequence, so that we can find candidates for superinstructions. Enable it
+   with -DWANT_PROFILING=ON; the most frequent pairs are reported at exit */
+#ifndef SURGESCRIPT_ENABLE_PROFILING
+#define SURGESCRIPT_ENABLE_PROFILING    0
+#endif
+#if SURGESCRIPT_ENABLE_PROFILING
+#define PROFILE_REPORT_SIZE             32 /* the number of reported pairs */
+#if SURGESCRIPT_ENABLE_THREADS
+typedef atomic_uint_fast64_t surgescript_program_paircount_t;
+#define count_pair(prev, next)          atomic_fetch_add_explicit(&pair_count[(prev)][(next)], 1, memory_order_relaxed)
+#else
+typedef uint64_t surgescript_program_paircount_t;
+#define count_pair(prev, next)          (++pair_count[(prev)][(next)])
+#endif
+static surgescript_program_paircount_t pair_count[0x80][0x80]; /* pair_count[i][j]: instruction i followed by instruction j */
+static surgescript_once_t profile_once = SSONCE_INIT;
+static void init_profile();
+static void report_profile();
+static int compare_pairs(const void* a, const void* b);
+#endif
+
 /* optimizations */
 #define WANT_OPTIMIZED_PROGRAM_CALLS    1
 #define OPTIMIZED_CALL_THRESHOLD        4 /*8*/
 
+/* programs are compiled to machine code after being called this many times */
+#ifdef SURGESCRIPT_JIT_THRESHOLD
+#define JIT_THRESHOLD                   SURGESCRIPT_JIT_THRESHOLD /* the tests set it to 1 */
+#else
+#define JIT_THRESHOLD                   64
+#endif
+
 /* -------------------------------
  * public methods
  * ------------------------------- */
@@ -116,6 +190,11 @@ static inline void debug(const surgescript_program_t* program, const surgescript
 surgescript_program_t* surgescript_program_create(int arity)
 {
     surgescript_program_t* program = ssmalloc(sizeof *program);
+
+    #if SURGESCRIPT_ENABLE_PROFILING
+    ssonce(&profile_once, init_profile);
+    #endif
+
     return init_program(program, arity, run_program);
 }
 
@@ -131,6 +210,16 @@ surgescript_program_t* surgescript_program_create_native(int arity, surgescript_
     return init_program((surgescript_program_t*)cprogram, arity, run_cprogram);
 }
 
+/*
+ * surgescript_program_nop()
+ * A C-function that does nothing. Native programs that encapsulate it
+ * are empty, so objects whose state is bound to it aren't run
+ */
+surgescript_var_t* surgescript_program_nop(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    return NULL;
+}
+
 /*
  * surgescript_program_destroy()
  * Destroys an existing program
@@ -142,7 +231,13 @@ surgescript_program_t* surgescript_program_destroy(surgescript_program_t* progra
 
     ssarray_release(program->text);
     ssarray_release(program->label);
+    ssarray_release(program->callsite);
+    ssarray_release(program->wide);
     ssarray_release(program->line);
+
+    if(program->jit != NULL)
+        surgescript_jit_destroy(program->jit);
+
     ssfree(program);
 
     return NULL;
@@ -154,22 +249,8 @@ surgescript_program_t* surgescript_program_destroy(surgescript_program_t* progra
  */
 int surgescript_program_add_line(surgescript_program_t* program, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
 {
-    surgescript_program_operation_t line = { op, a, b };
+    surgescript_program_operation_t line = encode_operation(program, op, a, b, NULL);
     ssarray_push(program->line, line);
-
-#if WANT_OPTIMIZED_PROGRAM_CALLS
-    /* we add two NOPs after every CALL as a trick to help the
-       program optimize itself during its own execution. Each
-       optimized CALL uses 6 operands instead of 2. */
-    if(op == SSOP_CALL) {
-        surgescript_program_operand_t zero = surgescript_program_operand_u(0);
-        surgescript_program_operation_t nop = { SSOP_NOP, zero, zero };
-
-        ssarray_push(program->line, nop);
-        ssarray_push(program->line, nop);
-    }
-#endif
-
     return ssarray_length(program->line) - 1;
 }
 
@@ -179,11 +260,8 @@ int surgescript_program_add_line(surgescript_program_t* program, surgescript_pro
  */
 int surgescript_program_chg_line(surgescript_program_t* program, int line, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
 {
-    surgescript_program_operation_t newline = { op, a, b };
-    ssassert(op != SSOP_CALL); /* can't change the line do CALL due to the NOP optimization trick in surgescript_program_add_line(); won't change the labels */
-
     if(line >= 0 && line < ssarray_length(program->line)) {
-        program->line[line] = newline;
+        program->line[line] = encode_operation(program, op, a, b, &program->line[line]);
         return line;
     }
     else
@@ -204,14 +282,21 @@ bool surgescript_program_read_line(const surgescript_program_t* program, int lin
         return false;
     }
 
+    surgescript_program_operand_t oa, ob;
+    surgescript_program_operator_t instruction = decode_operation(program, &program->line[line], &oa, &ob);
+
+    /* the operand a of a CALL is the name of the called program */
+    if(instruction == SSOP_CALL || instruction == SSOP_OPTCALL)
+        oa = surgescript_program_operand_u(program->callsite[oa.u].fun_name);
+
     if(op != NULL)
-        *op = program->line[line].instruction;
+        *op = instruction;
 
     if(a != NULL)
-        *a = program->line[line].a;
+        *a = oa;
 
     if(b != NULL)
-        *b = program->line[line].b;
+        *b = ob;
 
     return true;
 }
@@ -225,6 +310,28 @@ int surgescript_program_count_lines(const surgescript_program_t* program)
     return ssarray_length(program->line);
 }
 
+/*
+ * surgescript_program_truncate()
+ * Removes the lines of code after the first num_lines lines of the program.
+ * No label may point to the removed lines (labels may point to line num_lines)
+ */
+void surgescript_program_truncate(surgescript_program_t* program, int num_lines)
+{
+    ssassert(num_lines >= 0);
+
+    while(ssarray_length(program->line) > num_lines) {
+        const surgescript_program_operation_t* line = &program->line[ssarray_length(program->line) - 1];
+        int wide_index, callsite_index;
+
+        ssassert(surgescript_program_find_label(program, ssarray_length(program->line)) == SURGESCRIPT_PROGRAM_UNDEFINED_LABEL);
+
+        /* the entries of the latest lines are the last ones */
+        find_entries(program, line, &wide_index, &callsite_index);
+        discard_entries(program, wide_index, callsite_index);
+        ssarray_length(program->line)--;
+    }
+}
+
 /*
  * surgescript_program_add_label()
  * Adds a newly created label to the program
@@ -249,6 +356,18 @@ surgescript_program_label_t surgescript_program_find_label(const surgescript_pro
     return SURGESCRIPT_PROGRAM_UNDEFINED_LABEL;
 }
 
+/*
+ * surgescript_program_label_line()
+ * The line of code a label points to, or -1 if there is no such label
+ */
+int surgescript_program_label_line(const surgescript_program_t* program, surgescript_program_label_t label)
+{
+    if(label < ssarray_length(program->label) && program->label[label] != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL)
+        return (int)program->label[label];
+
+    return -1;
+}
+
 /*
  * surgescript_program_add_text()
  * Adds a text to a program (each program has a set of read-only texts)
@@ -349,6 +468,189 @@ bool surgescript_program_is_native(const surgescript_program_t* program)
     return program->run == run_cprogram;
 }
 
+/*
+ * surgescript_program_is_empty()
+ * Is the program empty, i.e., does it return without doing anything?
+ * Native programs are empty only if they encapsulate surgescript_program_nop()
+ */
+bool surgescript_program_is_empty(const surgescript_program_t* program)
+{
+    if(surgescript_program_is_native(program))
+        return ((const surgescript_cprogram_t*)program)->cfunction == surgescript_program_nop;
+
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        switch(OPERATION_INSTRUCTION(program->line[i].code)) {
+            case SSOP_RET:
+                return true;
+
+            case SSOP_NOP:
+            case SSOP_MOVN: /* the return value of an empty program */
+                continue;
+
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * surgescript_program_unfused_operator()
+ * The first of the instructions fused by a superinstruction. Other
+ * instructions are returned unchanged
+ */
+surgescript_program_operator_t surgescript_program_unfused_operator(surgescript_program_operator_t op)
+{
+    switch(op) {
+        case SSOP_SPEEKPUSH:
+        case SSOP_SPEEKINC:
+            return SSOP_SPEEK;
+
+        case SSOP_PEEKPUSH:
+            return SSOP_PEEK;
+
+        case SSOP_PUSHMOVFPOP:
+            return SSOP_PUSH;
+
+        case SSOP_TESTJE:
+            return SSOP_TEST;
+
+        default:
+            return op;
+    }
+}
+
+/*
+ * surgescript_program_fingerprint()
+ * A hash of the code of the program, computed after resolving its labels.
+ * It doesn't change when CALL instructions are optimized at runtime.
+ */
+uint64_t surgescript_program_fingerprint(surgescript_program_t* program)
+{
+    /* FNV-1a */
+    #define HASH(x) do { \
+        uint64_t _x = (uint64_t)(x); \
+        for(int _k = 0; _k < 8; _k++, _x >>= 8) \
+            hash = (hash ^ (_x & 0xFF)) * UINT64_C(0x100000001B3); \
+    } while(0)
+
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+
+    remove_labels(program);
+    HASH(program->arity);
+    HASH(ssarray_length(program->line));
+    HASH(ssarray_length(program->text));
+
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        surgescript_program_operator_t instruction;
+        surgescript_program_operand_t a, b;
+
+        /* the operand a of a CALL is read as the name of the called program */
+        surgescript_program_read_line(program, i, &instruction, &a, &b);
+        if(instruction == SSOP_OPTCALL)
+            instruction = SSOP_CALL;
+
+        HASH(instruction);
+        HASH(a.u64);
+        HASH(b.u64);
+    }
+
+    for(int j = 0; j < ssarray_length(program->text); j++) {
+        for(const char* p = program->text[j]; *p; p++)
+            HASH((unsigned char)*p);
+        HASH(0);
+    }
+
+    return hash;
+
+    #undef HASH
+}
+
+/*
+ * surgescript_program_bind_aot()
+ * Runs the program with ahead-of-time compiled code, which must have been
+ * generated from the same bytecode (i.e., the fingerprints must match).
+ * Returns true on success
+ */
+bool surgescript_program_bind_aot(surgescript_program_t* program, surgescript_program_aotfunction_t aot, uint64_t fingerprint)
+{
+    /* native programs have no bytecode */
+    if(program->run == run_cprogram)
+        return false;
+
+    /* the scripts have changed since the AOT compilation */
+    if(surgescript_program_fingerprint(program) != fingerprint)
+        return false;
+
+    program->aot = aot;
+    program->run = (aot != NULL) ? run_aotprogram : run_program;
+    return true;
+}
+
+/*
+ * surgescript_program_run_line()
+ * Interprets a single line of code and returns the next line to be run.
+ * AOT-compiled code delegates complex instructions to the interpreter.
+ * Superinstructions run only the first of the instructions they fuse.
+ */
+unsigned surgescript_program_run_line(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned line)
+{
+    if(line >= ssarray_length(program->line))
+        return ssarray_length(program->line);
+
+    return run_instruction(program, runtime_environment, line, true);
+}
+
+/* resolves the labels of the program ahead of its first execution
+   (used before running programs in parallel) */
+void surgescript_program_resolve_labels(surgescript_program_t* program)
+{
+    remove_labels(program);
+}
+
+/* clears the inline caches of the program, restoring its optimized calls.
+   Required when programs of the pool are replaced (hot reloading) */
+void surgescript_program_invalidate_caches(surgescript_program_t* program)
+{
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        surgescript_program_operation_t* operation = &program->line[i];
+
+        if(OPERATION_INSTRUCTION(operation->code) == SSOP_OPTCALL)
+            operation->code = (operation->code & ~UINT32_C(0x7F)) | SSOP_CALL;
+    }
+
+    for(int j = 0; j < ssarray_length(program->callsite); j++)
+        reset_callsite(&program->callsite[j]);
+}
+
+/* resumes a suspended program (a state) at the given line. The caller
+   restores its stack frame. AOT-compiled code is not used, as it can't
+   be entered at an arbitrary line */
+void surgescript_program_resume(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned line)
+{
+    if(program->run != run_cprogram)
+        run_program_from(program, runtime_environment, line);
+}
+
+/* is there any jump to the given line of code? */
+bool surgescript_program_is_jump_target(surgescript_program_t* program, int line)
+{
+    remove_labels(program);
+
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        surgescript_program_operand_t a, b;
+        surgescript_program_operator_t instruction = decode_operation(program, &program->line[i], &a, &b);
+
+        if(is_jump_instruction(instruction) && a.u == (unsigned)line)
+            return true;
+        else if(instruction == SSOP_NEXT && b.u == (unsigned)line)
+            return true;
+    }
+
+    return false;
+}
+
 /* has this program ever been executed? */
 bool surgescript_program_executed(const surgescript_program_t* program)
 {
@@ -360,7 +662,8 @@ void surgescript_program_dump(surgescript_program_t* program, FILE* fp)
 {
     int i;
     char hex[2][1 + 2 * sizeof(unsigned)];
-    surgescript_program_operation_t* op;
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
 
     remove_labels(program);
 
@@ -373,12 +676,12 @@ void surgescript_program_dump(surgescript_program_t* program, FILE* fp)
 
     /* print code */
     for(i = 0; i < ssarray_length(program->line); i++) {
-        op = &(program->line[i]);
+        surgescript_program_read_line(program, i, &op, &a, &b);
         fprintf(fp,
             "        \"%s\t  %s    %s\"%s\n",
-            instruction_name[op->instruction],
-            hexdump(op->a.u, hex[0]),
-            hexdump(op->b.u, hex[1]),
+            instruction_name[op],
+            hexdump(a.u, hex[0]),
+            hexdump(b.u, hex[1]),
             (i < ssarray_length(program->line) - 1) ? "," : ""
         );
     }
@@ -416,8 +719,13 @@ surgescript_program_t* init_program(surgescript_program_t* program, int arity, v
     program->arity = ssmax(0, arity);
     program->executed = false;
     program->run = run_function;
+    program->aot = NULL;
+    program->jit = NULL;
+    program->calls = 0;
 
     ssarray_init(program->line);
+    ssarray_init(program->wide);
+    ssarray_init(program->callsite);
     ssarray_init(program->label);
     ssarray_init(program->text);
 
@@ -427,14 +735,51 @@ surgescript_program_t* init_program(surgescript_program_t* program, int arity, v
 /* runs a SurgeScript program */
 void run_program(surgescript_program_t* program, const surgescript_renv_t* runtime_environment)
 {
-    unsigned int ip = 0; /* instruction pointer */
+    run_program_from(program, runtime_environment, 0);
+}
 
+/* runs a SurgeScript program starting at the given line */
+void run_program_from(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip)
+{
     program->executed = true;
     if(ssarray_length(program->label) > 0)
         remove_labels(program);
 
+#if SURGESCRIPT_ENABLE_JIT
+    /* compile hot programs. The machine code is shared by all threads */
+    if(program->calls < JIT_THRESHOLD && !ssconcurrent()) {
+        if(++program->calls == JIT_THRESHOLD)
+            program->jit = surgescript_jit_compile(program);
+    }
+
+    /* run the machine code, re-entering it after each guard exit */
+    if(program->jit != NULL) {
+        while(ip < ssarray_length(program->line))
+            ip = surgescript_jit_run(program->jit, program, runtime_environment, ip);
+        return;
+    }
+#endif
+
+#if SURGESCRIPT_ENABLE_PROFILING
+    /* count the pairs of instructions run in sequence */
+    for(int previous = -1; ip < ssarray_length(program->line); ) {
+        surgescript_program_operator_t instruction = OPERATION_INSTRUCTION(program->line[ip].code);
+        if(previous >= 0)
+            count_pair(previous, instruction);
+        previous = instruction;
+        ip = run_instruction(program, runtime_environment, ip, false);
+    }
+#else
     while(ip < ssarray_length(program->line))
-        ip = run_instruction(program, runtime_environment, ip);
+        ip = run_instruction(program, runtime_environment, ip, false);
+#endif
+}
+
+/* runs an AOT-compiled program */
+void run_aotprogram(surgescript_program_t* program, const surgescript_renv_t* runtime_environment)
+{
+    program->executed = true;
+    program->aot(program, runtime_environment);
 }
 
 /* runs a C-program */
@@ -463,8 +808,9 @@ void run_cprogram(surgescript_program_t* program, const surgescript_renv_t* runt
         surgescript_var_set_null(*(surgescript_renv_tmp(runtime_environment) + 0));
 }
 
-/* runs an instruction and returns a new value for the instruction pointer */
-unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip)
+/* runs an instruction and returns a new value for the instruction pointer.
+   If single_line is true, superinstructions run only their first instruction */
+unsigned int run_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned int ip, bool single_line)
 {
     /* helper macro */
     #ifdef t
@@ -477,16 +823,18 @@ unsigned int run_instruction(const surgescript_program_t* program, const surgesc
 
     /* read the operation */
     surgescript_program_operation_t* operation = program->line + ip;
-    surgescript_program_operand_t a = operation->a;
-    surgescript_program_operand_t b = operation->b;
+    surgescript_program_operand_t a, b;
+    surgescript_program_operator_t instruction = decode_operation(program, operation, &a, &b);
+    if(single_line)
+        instruction = surgescript_program_unfused_operator(instruction);
 
     /* debug mode */
     #if SURGESCRIPT_DEBUG_MODE
-    debug(program, runtime_environment, operation->instruction, a, b, _t);
+    debug(program, runtime_environment, instruction, a, b, _t);
     #endif
 
     /* run the instruction */
-    switch(operation->instruction) {
+    switch(instruction) {
         /* basics */
         case SSOP_NOP: /* no-operation */
             break;
@@ -505,6 +853,10 @@ unsigned int run_instruction(const surgescript_program_t* program, const surgesc
                 surgescript_var_set_string(t(a), surgescript_object_state(surgescript_renv_owner(runtime_environment)));
             break;
 
+        case SSOP_SETSTATEID: /* sets the current state given its id in the state table of the class of the object */
+            surgescript_object_set_state_id(surgescript_renv_owner(runtime_environment), a.i);
+            break;
+
         case SSOP_CALLER: /* caller object */
             surgescript_var_set_objecthandle(t(a), surgescript_renv_caller(runtime_environment));
             break;
@@ -648,6 +1000,29 @@ unsigned int run_instruction(const surgescript_program_t* program, const surgesc
             surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) ^ surgescript_var_get_rawbits(t(b)));
             break;
 
+        /* numeric operations: the compiler has inferred that the operands are numbers */
+        case SSOP_FADD:
+            surgescript_var_set_number(t(a), surgescript_var_fast_get_number(t(a)) + surgescript_var_fast_get_number(t(b)));
+            break;
+
+        case SSOP_FSUB:
+            surgescript_var_set_number(t(a), surgescript_var_fast_get_number(t(a)) - surgescript_var_fast_get_number(t(b)));
+            break;
+
+        case SSOP_FMUL:
+            surgescript_var_set_number(t(a), surgescript_var_fast_get_number(t(a)) * surgescript_var_fast_get_number(t(b)));
+            break;
+
+        case SSOP_FDIV:
+            surgescript_var_set_number(t(a), surgescript_var_fast_get_number(t(a)) / surgescript_var_fast_get_number(t(b)));
+            break;
+
+        case SSOP_FCMP: {
+            double x = surgescript_var_fast_get_number(t(a)), y = surgescript_var_fast_get_number(t(b));
+            surgescript_var_set_rawbits(_t[2], isgreater(x, y) - isless(x, y)); /* same as surgescript_var_compare() */
+            break;
+        }
+
         /* comparing & testing */
         case SSOP_TEST:
             if(a.u64 == b.u64)
@@ -711,10 +1086,138 @@ unsigned int run_instruction(const surgescript_program_t* program, const surgesc
             return ssarray_length(program->line);
 
         case SSOP_CALL:
-            return ip + run_call_instruction(program, runtime_environment, operation, a, b);
+            return ip + run_call_instruction(program, runtime_environment, operation, &program->callsite[a.u], b.i);
 
         case SSOP_OPTCALL:
-            return ip + run_optcall_instruction(program, runtime_environment, operation, a, b);
+            return ip + run_optcall_instruction(program, runtime_environment, operation, &program->callsite[a.u], b.i);
+
+        case SSOP_MATH: /* run a method of the Math object without calling it */
+            surgescript_mathintrinsic_run(a.i, surgescript_renv_stack(runtime_environment), _t[0]);
+            break;
+
+        /* Array & Dictionary literals */
+        case SSOP_ARRAY: {
+            surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(runtime_environment);
+            const surgescript_stack_t* stack = surgescript_renv_stack(runtime_environment);
+            const surgescript_var_t** values = a.u > 0 ? alloca(a.u * sizeof(*values)) : NULL;
+            surgescript_objecthandle_t handle = b.b ?
+                surgescript_var_get_objecthandle(surgescript_stack_peek_top(stack, -(int)a.u)) :
+                surgescript_objectmanager_spawn_array(manager);
+
+            for(int i = 0; i < (int)a.u; i++)
+                values[i] = surgescript_stack_peek_top(stack, 1 + i - (int)a.u);
+
+            surgescript_sslib_array_append(surgescript_objectmanager_get(manager, handle), values, a.u);
+            surgescript_var_set_objecthandle(_t[0], handle);
+            break;
+        }
+
+        case SSOP_DICT: {
+            surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(runtime_environment);
+            const surgescript_stack_t* stack = surgescript_renv_stack(runtime_environment);
+            surgescript_objecthandle_t handle = b.b ?
+                surgescript_var_get_objecthandle(surgescript_stack_peek_top(stack, -2 * (int)a.u)) :
+                surgescript_objectmanager_spawn_dictionary(manager);
+            surgescript_object_t* dictionary = surgescript_objectmanager_get(manager, handle);
+
+            for(int i = 0; i < (int)a.u; i++) {
+                const surgescript_var_t* param[] = {
+                    surgescript_stack_peek_top(stack, 1 + 2 * (i - (int)a.u)), /* key */
+                    surgescript_stack_peek_top(stack, 2 + 2 * (i - (int)a.u)) /* value */
+                };
+                surgescript_object_call_function(dictionary, "set", param, 2, NULL);
+            }
+
+            surgescript_var_set_objecthandle(_t[0], handle);
+            break;
+        }
+
+        /* foreach loops over Arrays, without iterator objects */
+        case SSOP_ITER:
+            if(surgescript_var_is_objecthandle(_t[0])) {
+                surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(runtime_environment);
+                surgescript_objecthandle_t handle = surgescript_var_get_objecthandle(_t[0]);
+                int length = surgescript_objectmanager_exists(manager, handle) ? surgescript_sslib_array_foreach_length(surgescript_objectmanager_get(manager, handle)) : -1;
+
+                if(length >= 0) {
+                    surgescript_var_set_number(_t[0], 0);
+                    surgescript_var_set_number(_t[1], length);
+                    return a.u;
+                }
+            }
+            break;
+
+        case SSOP_NEXT: {
+            /* stack[top-1] is null if we're using an iterator object */
+            const surgescript_stack_t* stack = surgescript_renv_stack(runtime_environment);
+            const surgescript_var_t* length = surgescript_stack_peek_top(stack, -1);
+
+            if(surgescript_var_is_number(length)) {
+                surgescript_objectmanager_t* manager = surgescript_renv_objectmanager(runtime_environment);
+                surgescript_objecthandle_t handle = surgescript_var_get_objecthandle(surgescript_stack_peek_top(stack, -2));
+                surgescript_var_t* cursor = (surgescript_var_t*)surgescript_stack_peek_top(stack, 0); /* the cursor is ours */
+                int index = surgescript_var_get_number(cursor);
+                const surgescript_var_t* element = NULL;
+
+                /* the Array may have shrunk during the loop */
+                if(index < surgescript_var_get_number(length) && surgescript_objectmanager_exists(manager, handle))
+                    element = surgescript_sslib_array_foreach_element(surgescript_objectmanager_get(manager, handle), index);
+
+                if(element == NULL)
+                    return a.u;
+
+                surgescript_var_copy(_t[0], element);
+                surgescript_var_set_number(cursor, index + 1);
+                return b.u;
+            }
+            break;
+        }
+
+        /* coroutines */
+        case SSOP_WAIT:
+            surgescript_object_suspend(surgescript_renv_owner(runtime_environment), program, ip + 1, surgescript_var_get_number(t(a)), surgescript_renv_stack(runtime_environment));
+            return ssarray_length(program->line);
+
+        /* superinstructions: the instructions they fuse are kept in the next lines */
+        case SSOP_SPEEKPUSH: /* speek a, b; push a */
+            surgescript_var_copy(t(a), surgescript_stack_peek(surgescript_renv_stack(runtime_environment), b.i));
+            surgescript_stack_push(surgescript_renv_stack(runtime_environment), surgescript_var_clone(t(a)));
+            return ip + 2;
+
+        case SSOP_PEEKPUSH: /* peek a, b; push a */
+            surgescript_var_copy(t(a), surgescript_heap_at(surgescript_renv_heap(runtime_environment), b.u));
+            surgescript_stack_push(surgescript_renv_stack(runtime_environment), surgescript_var_clone(t(a)));
+            return ip + 2;
+
+        case SSOP_PUSHMOVFPOP: { /* push a; movf a, f; pop c (c != a) */
+            surgescript_program_operand_t c, f, unused;
+            decode_operation(program, operation + 1, &unused, &f);
+            decode_operation(program, operation + 2, &c, &unused);
+            surgescript_var_copy(t(c), t(a));
+            surgescript_var_set_number(t(a), f.f);
+            return ip + 3;
+        }
+
+        case SSOP_SPEEKINC: { /* speek a, b; mov c, a; inc c; spoke c, b (c != a, c != 2) */
+            surgescript_program_operand_t c, unused;
+            decode_operation(program, operation + 1, &c, &unused);
+            surgescript_var_copy(t(a), surgescript_stack_peek(surgescript_renv_stack(runtime_environment), b.i));
+            surgescript_var_set_number(t(c), surgescript_var_get_number(t(a)) + 1);
+            surgescript_stack_poke(surgescript_renv_stack(runtime_environment), b.i, t(c));
+            return ip + 4;
+        }
+
+        case SSOP_TESTJE: { /* test a, b; je line */
+            surgescript_program_operand_t line, unused;
+            if(a.u64 == b.u64)
+                surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(a)));
+            else
+                surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(a)) & surgescript_var_get_rawbits(t(b)));
+            if(surgescript_var_get_rawbits(_t[2]))
+                return ip + 2;
+            decode_operation(program, operation + 1, &line, &unused);
+            return line.u;
+        }
     }
 
     /* next line */
@@ -725,65 +1228,82 @@ unsigned int run_instruction(const surgescript_program_t* program, const surgesc
 }
 
 /* run a SSOP_CALL instruction */
-unsigned int run_call_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_operand_t a, surgescript_program_operand_t b)
+unsigned int run_call_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_callsite_t* callsite, int number_of_params)
 {
     /* validate; this should never happen */
-    if(a.u >= ssarray_length(program->text))
+    if(callsite->fun_name >= ssarray_length(program->text))
         return +1; /* next line; treat it as a NOP */
 
+    const char* program_name = program->text[callsite->fun_name];
+
+    /* a method of a primitive value may run without being called. Calls
+       on objects become OPTCALLs, which don't pay for this check */
+    if(callsite->intrinsic >= 0) {
+        surgescript_var_t** _t = surgescript_renv_tmp(runtime_environment);
+        if(surgescript_intrinsic_run(callsite->intrinsic, surgescript_renv_stack(runtime_environment), _t[0]))
+            return +1; /* next line */
+    }
+
 #if !(WANT_OPTIMIZED_PROGRAM_CALLS)
     /* unoptimized version */
     surgescript_objectclassid_t class_id = 0;
-    call_program(runtime_environment, b.u, program->text[a.u], NULL, &class_id);
+    call_program(runtime_environment, number_of_params, program_name, NULL, &class_id);
     return +1; /* next line */
 #else
     /* optimized version */
     surgescript_objectclassid_t class_id = 0;
-    bool is_locked = (operation[2].b.i != 0);
+    bool is_locked = (callsite->lock != 0);
+
+    /* the inline cache is shared by all threads; leave it alone
+       while objects are being updated in parallel */
+    if(ssconcurrent()) {
+        call_program(runtime_environment, number_of_params, program_name, NULL, &class_id);
+        return +1;
+    }
 
-    operation[2].b.i++; /* lock */
-    surgescript_program_t* callee_program = call_program(runtime_environment, b.u, program->text[a.u], NULL, &class_id);
-    operation[2].b.i--; /* unlock */
+    callsite->lock++; /* lock */
+    surgescript_program_t* callee_program = call_program(runtime_environment, number_of_params, program_name, NULL, &class_id);
+    callsite->lock--; /* unlock */
 
     /* don't modify this call instruction if it's locked. This
        prevents data corruption with (possibly indirect) recursion. */
     if(is_locked) {
         /* faster counter */
         /*
-        if(operation[1].a.u == class_id)
-            operation[1].b.i++;
+        if(callsite->class_id == class_id)
+            callsite->count++;
         else
-            operation[1].b.i = 0;
+            callsite->count = 0;
         */
     }
     /* count the number of consecutive times the program has been
        executed with this same callee or equivalent object of the
-       same class (a: class_id; b: count) */
-    else if(operation[1].a.u == class_id) {
-        if(++operation[1].b.i >= OPTIMIZED_CALL_THRESHOLD) {
+       same class */
+    else if(callsite->class_id == class_id) {
+        if(++callsite->count >= OPTIMIZED_CALL_THRESHOLD) {
             /* the program has run enough consecutive times with
                the same or equivalent callee. Let's optimize. */
 
             /* cache the program */
-            operation[2].a = surgescript_program_operand_p(callee_program);
+            callsite->program = callee_program;
 
             /* let's change this instruction */
-            operation[0].instruction = SSOP_OPTCALL;
+            operation->code = (operation->code & ~UINT32_C(0x7F)) | SSOP_OPTCALL;
         }
     }
     else {
         /* new class. Reset the counter */
-        operation[1].a = surgescript_program_operand_u(class_id);
-        operation[1].b = surgescript_program_operand_i(1);
+        callsite->class_id = class_id;
+        callsite->count = 1;
     }
 
-    /* skip the two NOPs placed after every CALL */
-    return +3;
+    /* next line */
+    return +1;
 #endif
 }
 
 /* run a SSOP_OPTCALL instruction */
-unsigned int run_optcall_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_operand_t a, surgescript_program_operand_t b)
+unsigned int run_optcall_instruction(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operation_t* operation, surgescript_program_callsite_t* callsite, int number_of_params)
 {
 #if !(WANT_OPTIMIZED_PROGRAM_CALLS)
     /* no operation */
@@ -791,15 +1311,24 @@ unsigned int run_optcall_instruction(const surgescript_program_t* program, const
 #else
     /* run the cached program. We can afford to cache because
        surgescript_program_t* entries of the program pool will not
-       change after execution */
-    surgescript_objectclassid_t expected_class_id = operation[1].a.u;
-    surgescript_program_t* expected_program = operation[2].a.p;
-    const char* program_name = program->text[a.u];
+       change after execution (unless the scripts are reloaded, in
+       which case the caches are invalidated) */
+    surgescript_objectclassid_t expected_class_id = callsite->class_id;
+    surgescript_program_t* expected_program = callsite->program;
+    const char* program_name = program->text[callsite->fun_name];
+
+    /* while objects are being updated in parallel, the inline cache
+       is read-only: fall back to a regular lookup on a cache miss */
+    if(ssconcurrent()) {
+        if(call_program(runtime_environment, number_of_params, program_name, expected_program, &expected_class_id) == NULL)
+            call_program(runtime_environment, number_of_params, program_name, NULL, &expected_class_id);
+        return +1;
+    }
 
-    bool is_locked = (operation[2].b.i != 0);
-    operation[2].b.i++; /* lock */
-    bool success = (call_program(runtime_environment, b.u, program_name, expected_program, &expected_class_id) != NULL);
-    operation[2].b.i--; /* unlock */
+    bool is_locked = (callsite->lock != 0);
+    callsite->lock++; /* lock */
+    bool success = (call_program(runtime_environment, number_of_params, program_name, expected_program, &expected_class_id) != NULL);
+    callsite->lock--; /* unlock */
 
     if(!success) {
 
@@ -810,12 +1339,10 @@ unsigned int run_optcall_instruction(const surgescript_program_t* program, const
             /* Let's de-optimize */
 
             /* reset the counter */
-            operation[1].a = surgescript_program_operand_u(0);
-            operation[1].b = surgescript_program_operand_i(0);
-            operation[2].a = surgescript_program_operand_p(NULL);
+            reset_callsite(callsite);
 
             /* restore the original CALL */
-            operation[0].instruction = SSOP_CALL;
+            operation->code = (operation->code & ~UINT32_C(0x7F)) | SSOP_CALL;
 
             /* run the same instruction again */
             return +0;
@@ -829,10 +1356,10 @@ unsigned int run_optcall_instruction(const surgescript_program_t* program, const
                locked. Let's perform a regular lookup. Running
                call_program() twice is slightly slower than having
                no optimization at all, so this shouldn't happen often. */
-            call_program(runtime_environment, b.u, program_name, NULL, &expected_class_id);
+            call_program(runtime_environment, number_of_params, program_name, NULL, &expected_class_id);
 
             /* signal that this event is undesirable */
-            /*operation[1].b.i -= OPTIMIZED_CALL_THRESHOLD;*/
+            /*callsite->count -= OPTIMIZED_CALL_THRESHOLD;*/
 
             /* testing */
             /*printf("undesirable event %u %s\n", expected_class_id, program_name);*/
@@ -846,8 +1373,8 @@ unsigned int run_optcall_instruction(const surgescript_program_t* program, const
 
     }
 
-    /* skip the two NOPs placed after every CALL */
-    return +3;
+    /* next line */
+    return +1;
 #endif
 }
 
@@ -981,6 +1508,8 @@ bool is_jump_instruction(surgescript_program_operator_t instruction)
         case SSOP_JGE:
         case SSOP_JL:
         case SSOP_JLE:
+        case SSOP_ITER:
+        case SSOP_NEXT:
             return true;
         default:
             return false;
@@ -997,14 +1526,30 @@ bool remove_labels(surgescript_program_t* program)
 
     /* correct all jump instructions */
     for(int i = 0; i < ssarray_length(program->line); i++) {
-        if(is_jump_instruction(program->line[i].instruction)) {
-            surgescript_program_label_t label = program->line[i].a.u;
+        surgescript_program_operand_t a, b;
+        surgescript_program_operator_t instruction = decode_operation(program, &program->line[i], &a, &b);
+
+        if(is_jump_instruction(instruction)) {
+            surgescript_program_label_t label = a.u;
             if(label >= 0 && label < ssarray_length(program->label)) {
                 ssassert(program->label[label] != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL); /* check if initialized */
-                program->line[i].a.u = program->label[label];
+                a = surgescript_program_operand_u(program->label[label]);
             }
             else
                 ssfatal("Runtime Error: invalid jump instruction - unknown label 0x%X.", label);
+
+            /* SSOP_NEXT jumps to two labels */
+            if(instruction == SSOP_NEXT) {
+                label = b.u;
+                if(label >= 0 && label < ssarray_length(program->label)) {
+                    ssassert(program->label[label] != SURGESCRIPT_PROGRAM_UNDEFINED_LABEL);
+                    b = surgescript_program_operand_u(program->label[label]);
+                }
+                else
+                    ssfatal("Runtime Error: invalid jump instruction - unknown label 0x%X.", label);
+            }
+
+            program->line[i] = encode_operation(program, instruction, a, b, &program->line[i]);
         }
     }
 
@@ -1013,6 +1558,151 @@ bool remove_labels(surgescript_program_t* program)
     return true;
 }
 
+/* encodes an operation. Operands that don't fit in the operation are
+   moved to the table of wide operands, and each CALL gets a call site.
+   If the operation replaces a previous one, its entries of these tables
+   are reused */
+surgescript_program_operation_t encode_operation(surgescript_program_t* program, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b, const surgescript_program_operation_t* previous)
+{
+    surgescript_program_operation_t operation;
+    int wide_index = -1, callsite_index = -1;
+
+    /* find the entries of the previous operation */
+    if(previous != NULL)
+        find_entries(program, previous, &wide_index, &callsite_index);
+
+    /* the operand a of a CALL is the name of the called program */
+    if(op == SSOP_CALL || op == SSOP_OPTCALL) {
+        surgescript_program_callsite_t callsite = { .fun_name = a.u, .program = NULL };
+        callsite.intrinsic = surgescript_intrinsic_find(program->text[a.u], b.i);
+
+        if(callsite_index >= 0) {
+            program->callsite[callsite_index] = callsite;
+            a = surgescript_program_operand_u(callsite_index);
+            callsite_index = -1;
+        }
+        else {
+            ssarray_push(program->callsite, callsite);
+            a = surgescript_program_operand_u(ssarray_length(program->callsite) - 1);
+        }
+
+        op = SSOP_CALL;
+    }
+
+    /* narrow operation: a is a signed 24-bit integer and b is a 32-bit integer */
+    if((a.u64 >> 32) == 0 && OPERATION_A(a.u << 8) == a.u && (b.u64 >> 32) == 0) {
+        operation.code = (a.u << 8) | op;
+        operation.b = b.u;
+    }
+    else {
+        surgescript_program_wideoperation_t wide = { a, b };
+
+        if(wide_index >= 0) {
+            program->wide[wide_index] = wide;
+            operation.code = ((uint32_t)wide_index << 8) | OPERATION_WIDE | op;
+            wide_index = -1;
+        }
+        else {
+            ssarray_push(program->wide, wide);
+            operation.code = ((uint32_t)(ssarray_length(program->wide) - 1) << 8) | OPERATION_WIDE | op;
+        }
+
+        operation.b = 0;
+    }
+
+    /* discard the entries that are no longer used */
+    discard_entries(program, wide_index, callsite_index);
+    return operation;
+}
+
+/* finds the indices of the wide operands and of the call site of an
+   operation in their tables, or -1 if the operation doesn't have them */
+static void find_entries(const surgescript_program_t* program, const surgescript_program_operation_t* operation, int* wide_index, int* callsite_index)
+{
+    surgescript_program_operand_t a, b;
+    surgescript_program_operator_t instruction = decode_operation(program, operation, &a, &b);
+
+    *wide_index = (operation->code & OPERATION_WIDE) ? (int)(operation->code >> 8) : -1;
+    *callsite_index = (instruction == SSOP_CALL || instruction == SSOP_OPTCALL) ? (int)a.u : -1;
+}
+
+/* discards unused entries of the tables of wide operands and of call sites.
+   Only the last entries are removed, so that the other indices are kept */
+static void discard_entries(surgescript_program_t* program, int wide_index, int callsite_index)
+{
+    if(wide_index >= 0 && wide_index == ssarray_length(program->wide) - 1)
+        ssarray_length(program->wide)--;
+
+    if(callsite_index >= 0 && callsite_index == ssarray_length(program->callsite) - 1)
+        ssarray_length(program->callsite)--;
+}
+
+/* decodes an operation, returning its instruction */
+surgescript_program_operator_t decode_operation(const surgescript_program_t* program, const surgescript_program_operation_t* operation, surgescript_program_operand_t* a, surgescript_program_operand_t* b)
+{
+    uint32_t code = operation->code;
+
+    if(!(code & OPERATION_WIDE)) {
+        a->u64 = OPERATION_A(code);
+        b->u64 = operation->b;
+    }
+    else {
+        const surgescript_program_wideoperation_t* wide = &program->wide[code >> 8];
+        *a = wide->a;
+        *b = wide->b;
+    }
+
+    return OPERATION_INSTRUCTION(code);
+}
+
+/* clears the inline cache of a call site */
+void reset_callsite(surgescript_program_callsite_t* callsite)
+{
+    callsite->class_id = 0;
+    callsite->count = 0;
+    callsite->program = NULL;
+}
+
+/* profiling */
+#if SURGESCRIPT_ENABLE_PROFILING
+void init_profile()
+{
+    atexit(report_profile);
+}
+
+/* reports the most frequent pairs of instructions to stderr */
+void report_profile()
+{
+    const int n = sizeof(instruction_name) / sizeof(instruction_name[0]);
+    int* pair = ssmalloc(n * n * sizeof(*pair));
+    uint64_t total = 0;
+
+    for(int k = 0; k < n * n; k++) {
+        pair[k] = ((k / n) << 7) | (k % n);
+        total += pair_count[k / n][k % n];
+    }
+
+    qsort(pair, n * n, sizeof(*pair), compare_pairs);
+
+    fprintf(stderr, "Pairs of instructions run in sequence (%" PRIu64 " in total):\n", total);
+    for(int k = 0; k < n * n && k < PROFILE_REPORT_SIZE; k++) {
+        uint64_t count = pair_count[pair[k] >> 7][pair[k] & 0x7F];
+        if(count > 0)
+            fprintf(stderr, "%14" PRIu64 " %6.2f%%  %s %s\n", count, 100.0 * count / total, instruction_name[pair[k] >> 7], instruction_name[pair[k] & 0x7F]);
+    }
+
+    ssfree(pair);
+}
+
+/* sorts the pairs of instructions by decreasing count */
+int compare_pairs(const void* a, const void* b)
+{
+    uint64_t x = pair_count[*((const int*)a) >> 7][*((const int*)a) & 0x7F];
+    uint64_t y = pair_count[*((const int*)b) >> 7][*((const int*)b) & 0x7F];
+    return (x < y) - (x > y);
+}
+#endif
+
 /* debug mode */
 #if SURGESCRIPT_DEBUG_MODE
 void debug(const surgescript_program_t* program, const surgescript_renv_t* runtime_environment, surgescript_program_operator_t instruction, surgescript_program_operand_t a, surgescript_program_operand_t b, surgescript_var_t** _t)
@@ -45,6 +45,9 @@ struct surgescript_program_t;
 /* C-functions can also be encapsulated in programs */
 typedef surgescript_var_t* (*surgescript_program_cfunction_t)(surgescript_object_t*, const surgescript_var_t**, int);
 
+/* ahead-of-time compiled code replaces the interpreter loop of a program */
+typedef void (*surgescript_program_aotfunction_t)(surgescript_program_t*, const surgescript_renv_t*);
+
 /* labels */
 typedef unsigned surgescript_program_label_t;
 #define SURGESCRIPT_PROGRAM_UNDEFINED_LABEL (surgescript_program_label_t)(~0u)
@@ -90,6 +93,7 @@ static inline surgescript_program_operand_t surgescript_program_operand_p(void*
 /* life-cycle: create, destroy & run */
 surgescript_program_t* surgescript_program_create(int arity); /* create a new program */
 surgescript_program_t* surgescript_program_create_native(int arity, surgescript_program_cfunction_t cfunction); /* a native C-program must return a newly-allocated surgescript_var_t*, or NULL */
+surgescript_var_t* surgescript_program_nop(surgescript_object_t* object, const surgescript_var_t** param, int num_params); /* a C-function that does nothing; native states bound to it are empty */
 surgescript_program_t* surgescript_program_destroy(surgescript_program_t* program); /* called by the program pool */
 void surgescript_program_call(surgescript_program_t* program, surgescript_renv_t* runtime_environment, int num_params); /* low-level program call; you'll need to push the stack parameters by yourself */
 
@@ -100,7 +104,9 @@ int surgescript_program_add_line(surgescript_program_t* program, surgescript_pro
 int surgescript_program_chg_line(surgescript_program_t* program, int line, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b); /* changes an existing line of code of the program */
 bool surgescript_program_read_line(const surgescript_program_t* program, int line, surgescript_program_operator_t* op, surgescript_program_operand_t* a, surgescript_program_operand_t* b); /* reads a line of code of the program */
 int surgescript_program_count_lines(const surgescript_program_t* program); /* the number of lines of code of the program */
+void surgescript_program_truncate(surgescript_program_t* program, int num_lines); /* removes the lines of code after the first num_lines lines; no label may point to the removed lines */
 surgescript_program_label_t surgescript_program_find_label(const surgescript_program_t* program, int line); /* finds a label that points to a line of code */
+int surgescript_program_label_line(const surgescript_program_t* program, surgescript_program_label_t label); /* the line of code a label points to, or -1 if there is no such label */
 
 /* program data */
 int surgescript_program_arity(const surgescript_program_t* program); /* what's the arity of this program? (i.e., how many parameters does it take) */
@@ -110,5 +116,12 @@ int surgescript_program_find_text(const surgescript_program_t* program, const ch
 int surgescript_program_text_count(const surgescript_program_t* program); /* how many string literals exist in the program? */
 void surgescript_program_dump(surgescript_program_t* program, FILE* fp); /* dump the program to a file */
 bool surgescript_program_is_native(const surgescript_program_t* program); /* is the program native (i.e., written in C)? */
+bool surgescript_program_is_empty(const surgescript_program_t* program); /* does the program return without doing anything? */
+surgescript_program_operator_t surgescript_program_unfused_operator(surgescript_program_operator_t op); /* the first of the instructions fused by a superinstruction */
+
+/* ahead-of-time compilation */
+uint64_t surgescript_program_fingerprint(surgescript_program_t* program); /* a hash of the code of the program, used to match AOT-compiled code with the bytecode it was generated from */
+bool surgescript_program_bind_aot(surgescript_program_t* program, surgescript_program_aotfunction_t aot, uint64_t fingerprint); /* runs the program with AOT-compiled code, provided that the fingerprints match */
+unsigned surgescript_program_run_line(surgescript_program_t* program, const surgescript_renv_t* runtime_environment, unsigned line); /* interprets a single line of code, returning the next line to be run; used by AOT-compiled code */
 
 #endif
@@ -37,6 +37,7 @@
     F( SSOP_NOP, "nop" )                                 /* no-operation */ \
     F( SSOP_SELF, "self" )                      /* t[a] = "this" pointer */ \
     F( SSOP_STATE, "state" )   /* t[a] = get/set the state of the object */ \
+    F( SSOP_SETSTATEID, "setstateid" ) /* set the state to state id a */ \
     F( SSOP_CALLER, "caller" )     /* t[a] = handle to the caller object */ \
                                                                             \
     F( SSOP_MOV, "mov" )                                  /* t[a] = t[b] */ \
@@ -74,6 +75,13 @@
     F( SSOP_OR, "or" )                             /* t[a] = t[a] | t[b] */ \
     F( SSOP_XOR, "xor" )                           /* t[a] = t[a] ^ t[b] */ \
                                                                             \
+    F( SSOP_FADD, "fadd" )                              /* t[a] += t[b] */ \
+    F( SSOP_FSUB, "fsub" )                              /* t[a] -= t[b] */ \
+    F( SSOP_FMUL, "fmul" )                              /* t[a] *= t[b] */ \
+    F( SSOP_FDIV, "fdiv" )                              /* t[a] /= t[b] */ \
+    F( SSOP_FCMP, "fcmp" )                /* t[2] = compare(t[a], t[b]) */ \
+           /* numeric operations: both operands are known to be numbers */ \
+                                                                            \
     F( SSOP_TEST, "test" )                         /* t[2] = t[a] & t[b] */ \
     F( SSOP_TCHK, "tchk" )                  /* t[2] = typecheck(t[a], b) */ \
     F( SSOP_TC01, "tc01" )       /* t[2] = tchk(t[0], a) | tchk(t[1], a) */ \
@@ -95,6 +103,32 @@
                                  /* parameters are stacked left-to-right */ \
     F( SSOP_RET, "ret" )                 /* returns, halting the program */ \
     F( SSOP_OPTCALL, "optcall" )          /* optimized program call with */ \
-                                        /* b parameters and located at a */
+                                        /* b parameters and located at a */ \
+    F( SSOP_MATH, "math" )             /* t[0] = math intrinsic a with b */ \
+                                  /* parameters at stack[top-b+1 .. top] */ \
+    F( SSOP_ITER, "iter" )     /* if t[0] is an Array, set t[0] = 0 and */ \
+                                     /* t[1] = its length; jump to line a */ \
+    F( SSOP_NEXT, "next" )      /* native foreach: if stack[top] indexes */ \
+                                  /* the Array at stack[top-2], which had */ \
+                               /* stack[top-1] elements, t[0] = the next */ \
+                               /* element & jump to line b, or to line a */ \
+                                              /* if there are no elements */ \
+    F( SSOP_ARRAY, "array" )   /* t[0] = new Array with the a values at */ \
+                           /* stack[top-a+1 .. top]; if b is true, these */ \
+                               /* are appended to the Array at stack[top-a] */ \
+    F( SSOP_DICT, "dict" )     /* t[0] = new Dictionary with the a pairs */ \
+                        /* at stack[top-2a+1 .. top]; if b is true, these */ \
+                          /* are added to the Dictionary at stack[top-2a] */ \
+    F( SSOP_WAIT, "wait" )    /* suspend the current state for t[a] secs */ \
+                                 /* and resume it at the next line later */ \
+                                                                            \
+    F( SSOP_SPEEKPUSH, "speekpush" )               /* speek a, b; push a */ \
+    F( SSOP_PEEKPUSH, "peekpush" )                  /* peek a, b; push a */ \
+    F( SSOP_PUSHMOVFPOP, "pushmovfpop" )     /* push a; movf a, f; pop c */ \
+    F( SSOP_SPEEKINC, "speekinc" )       /* speek a, b; mov c, a; inc c; */ \
+                                                           /* spoke c, b */ \
+    F( SSOP_TESTJE, "testje" )                     /* test a, b; je line */ \
+               /* superinstructions: the instructions they fuse are kept */ \
+                    /* in the lines that follow (which may be jump targets) */
 
 #endif
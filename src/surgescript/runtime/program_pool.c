@@ -26,6 +26,7 @@
 #include "program.h"
 #include "../util/util.h"
 #include "../util/ssarray.h"
+#include "../util/thread.h"
 #include "../third_party/uthash.h"
 
 #define FASTHASH_INLINE
@@ -57,10 +58,12 @@ struct surgescript_programpool_metadata_t /* meta data for each class of objects
 {
     char* object_name; /* name of the class of objects */
     SSARRAY(char*, program_name); /* names of its programs */
+    SSARRAY(char*, field_name); /* names of its fields, indexed by heap address; NULL if there is no field at an address */
 
     UT_hash_handle hh;
 };
 
+static surgescript_programpool_metadata_t* find_metadata(surgescript_programpool_t* pool, const char* object_name, bool create);
 static void insert_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name);
 static void remove_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name);
 static void remove_object_metadata(surgescript_programpool_t* pool, const char* object_name);
@@ -68,6 +71,35 @@ static void clear_metadata(surgescript_programpool_t* pool);
 static void traverse_metadata(surgescript_programpool_t* pool, const char* object_name, void* data, void (*callback)(const char*,void*));
 static void traverse_adapter(const char* program_name, void* callback);
 static void foreach_object_name(surgescript_programpool_t* pool, void* data, void (*callback)(const char*,void*));
+static void clear_fields(surgescript_programpool_metadata_t* m);
+
+
+/*
+ * Each class of objects has a state table that maps small integers (state ids)
+ * to its states. The compiler resolves string literals assigned to the state
+ * to state ids, so that state transitions don't need any hashing at runtime.
+ * State ids are never reused; the programs are resolved lazily.
+ */
+typedef struct surgescript_statetable_entry_t surgescript_statetable_entry_t;
+struct surgescript_statetable_entry_t
+{
+    char* state_name; /* name of the state */
+    surgescript_program_t* program; /* cached program of the state; NULL if not resolved */
+};
+
+struct surgescript_statetable_t
+{
+    char* object_name; /* name of the class of objects */
+    SSARRAY(surgescript_statetable_entry_t, entry); /* indexed by state id */
+    surgescript_programpool_t* pool; /* the pool in which the programs are stored */
+
+    UT_hash_handle hh;
+};
+
+static surgescript_statetable_t* find_statetable(surgescript_programpool_t* pool, const char* object_name);
+static void register_state_program(surgescript_programpool_t* pool, const char* object_name, const char* program_name);
+static void invalidate_statetable(surgescript_programpool_t* pool, const char* object_name);
+static void clear_statetables(surgescript_programpool_t* pool);
 
 /* program pool hash type */
 typedef struct surgescript_programpool_hashpair_t surgescript_programpool_hashpair_t;
@@ -83,6 +115,7 @@ struct surgescript_programpool_t
 {
     fasthash_t* hash; /* a hash table of hashpair_t's */
     surgescript_programpool_metadata_t* meta;
+    surgescript_statetable_t* statetable; /* a hash table of state tables */
     bool is_locked;
     xxhash_t seed;
 };
@@ -90,6 +123,7 @@ struct surgescript_programpool_t
 /* misc */
 static void delete_pair(void* pair);
 static void delete_program(const char* program_name, void* data);
+static void accumulate_fingerprint(const char* program_name, void* data);
 
 
 
@@ -107,6 +141,7 @@ surgescript_programpool_t* surgescript_programpool_create()
     surgescript_programpool_t* pool = ssmalloc(sizeof *pool);
     pool->hash = fasthash_create(delete_pair, 16);
     pool->meta = NULL;
+    pool->statetable = NULL;
     pool->is_locked = false;
     pool->seed = surgescript_util_random64(); /* will *probably* generate perfect hashes [!] */
 
@@ -126,6 +161,7 @@ surgescript_programpool_t* surgescript_programpool_destroy(surgescript_programpo
 {
     fasthash_destroy(pool->hash);
     clear_metadata(pool);
+    clear_statetables(pool);
     return ssfree(pool);
 }
 
@@ -156,7 +192,7 @@ bool surgescript_programpool_shallowcheck(surgescript_programpool_t* pool, const
 bool surgescript_programpool_put(surgescript_programpool_t* pool, const char* object_name, const char* program_name, surgescript_program_t* program)
 {
     if(pool->is_locked) {
-        if(!surgescript_programpool_is_compiled(pool, object_name)) {
+        if(find_metadata(pool, object_name, false) == NULL) {
             ssfatal("Runtime Error: can't add function \"%s\" of object \"%s\" in a locked pool", program_name, object_name);
             return false;
         }
@@ -172,6 +208,7 @@ bool surgescript_programpool_put(surgescript_programpool_t* pool, const char* ob
     pair->program = program;
     fasthash_put(pool->hash, pair->signature, pair);
     insert_metadata(pool, object_name, program_name);
+    register_state_program(pool, object_name, program_name);
     return true;
 }
 
@@ -256,6 +293,7 @@ bool surgescript_programpool_replace(surgescript_programpool_t* pool, const char
         /* replace the program */
         surgescript_program_destroy(pair->program);
         pair->program = program;
+        invalidate_statetable(pool, object_name);
         return true;
     }
     else {
@@ -274,6 +312,7 @@ void surgescript_programpool_purge(surgescript_programpool_t* pool, const char*
     void* data[] = { pool, (void*)object_name };
     surgescript_programpool_foreach_ex(pool, object_name, data, delete_program);
     remove_object_metadata(pool, object_name);
+    invalidate_statetable(pool, object_name);
 }
 
 
@@ -290,6 +329,7 @@ void surgescript_programpool_delete(surgescript_programpool_t* pool, const char*
 
     /* delete metadata */
     remove_metadata(pool, object_name, program_name);
+    invalidate_statetable(pool, object_name);
 }
 
 
@@ -307,6 +347,21 @@ bool surgescript_programpool_is_compiled(surgescript_programpool_t* pool, const
 }
 
 
+/*
+ * surgescript_programpool_fingerprint()
+ * A hash of the code of all programs of object_name. It changes
+ * whenever the object is compiled again with different code
+ */
+uint64_t surgescript_programpool_fingerprint(surgescript_programpool_t* pool, const char* object_name)
+{
+    uint64_t hash = 0;
+    void* data[] = { pool, (void*)object_name, &hash };
+
+    traverse_metadata(pool, object_name, data, accumulate_fingerprint);
+    return hash;
+}
+
+
 /*
  * surgescript_programpool_lock()
  * Locks the program pool, so that no (programs of) new objects can be added to it
@@ -317,6 +372,148 @@ void surgescript_programpool_lock(surgescript_programpool_t* pool)
 }
 
 
+/*
+ * surgescript_programpool_register_field()
+ * Registers a field of object_name stored at the given heap address
+ */
+void surgescript_programpool_register_field(surgescript_programpool_t* pool, const char* object_name, const char* field_name, int address)
+{
+    surgescript_programpool_metadata_t* m = find_metadata(pool, object_name, false);
+
+    if(m == NULL) {
+        if(pool->is_locked) {
+            ssfatal("Runtime Error: can't add object \"%s\" to a locked pool", object_name);
+            return;
+        }
+        m = find_metadata(pool, object_name, true);
+    }
+
+    ssassert(address >= 0);
+    while(ssarray_length(m->field_name) <= address)
+        ssarray_push(m->field_name, NULL);
+
+    ssfree(m->field_name[address]);
+    m->field_name[address] = ssstrdup(field_name);
+}
+
+/*
+ * surgescript_programpool_clear_fields()
+ * Forgets the fields of object_name
+ */
+void surgescript_programpool_clear_fields(surgescript_programpool_t* pool, const char* object_name)
+{
+    surgescript_programpool_metadata_t* m = find_metadata(pool, object_name, false);
+
+    if(m != NULL)
+        clear_fields(m);
+}
+
+/*
+ * surgescript_programpool_field_count()
+ * The number of heap addresses spanned by the fields of object_name
+ */
+int surgescript_programpool_field_count(surgescript_programpool_t* pool, const char* object_name)
+{
+    surgescript_programpool_metadata_t* m = find_metadata(pool, object_name, false);
+    return m != NULL ? ssarray_length(m->field_name) : 0;
+}
+
+/*
+ * surgescript_programpool_field_name()
+ * The name of the field of object_name stored at the given heap address,
+ * or NULL if there is no such field
+ */
+const char* surgescript_programpool_field_name(surgescript_programpool_t* pool, const char* object_name, int address)
+{
+    surgescript_programpool_metadata_t* m = find_metadata(pool, object_name, false);
+
+    if(m == NULL || address < 0 || address >= ssarray_length(m->field_name))
+        return NULL;
+
+    return m->field_name[address];
+}
+
+
+/*
+ * surgescript_programpool_statetable()
+ * The state table of object_name
+ */
+surgescript_statetable_t* surgescript_programpool_statetable(surgescript_programpool_t* pool, const char* object_name)
+{
+    return find_statetable(pool, object_name);
+}
+
+/*
+ * surgescript_programpool_register_state()
+ * Registers a state of object_name, returning its state id.
+ * If the state is already registered, its id is returned.
+ */
+int surgescript_programpool_register_state(surgescript_programpool_t* pool, const char* object_name, const char* state_name)
+{
+    surgescript_statetable_t* table = find_statetable(pool, object_name);
+    int state_id = surgescript_statetable_find(table, state_name);
+
+    if(state_id < 0) {
+        surgescript_statetable_entry_t entry = { ssstrdup(state_name), NULL };
+        ssarray_push(table->entry, entry);
+        state_id = ssarray_length(table->entry) - 1;
+    }
+
+    return state_id;
+}
+
+/*
+ * surgescript_statetable_find()
+ * Finds the id of a state, or returns -1 if the state isn't registered
+ */
+int surgescript_statetable_find(const surgescript_statetable_t* table, const char* state_name)
+{
+    for(int i = 0; i < ssarray_length(table->entry); i++) {
+        if(strcmp(table->entry[i].state_name, state_name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * surgescript_statetable_name()
+ * The name of a registered state
+ */
+const char* surgescript_statetable_name(const surgescript_statetable_t* table, int state_id)
+{
+    ssassert(state_id >= 0 && state_id < ssarray_length(table->entry));
+    return table->entry[state_id].state_name;
+}
+
+/*
+ * surgescript_statetable_program()
+ * The program of a registered state (returns NULL if the state doesn't exist)
+ */
+surgescript_program_t* surgescript_statetable_program(surgescript_statetable_t* table, int state_id)
+{
+    surgescript_statetable_entry_t* entry;
+    surgescript_program_t* program;
+    char fun_name[SS_NAMEMAX + 7] = "state:";
+
+    ssassert(state_id >= 0 && state_id < ssarray_length(table->entry));
+    entry = &(table->entry[state_id]);
+    if(entry->program != NULL)
+        return entry->program;
+
+    /* resolve the program */
+    surgescript_util_strncpy(fun_name + 6, entry->state_name, sizeof(fun_name) - 6);
+    program = surgescript_programpool_get(table->pool, table->object_name, fun_name);
+
+    /* the table is shared by all threads; don't cache while
+       objects are being updated in parallel */
+    if(!ssconcurrent())
+        entry->program = program;
+
+    return program;
+}
+
+
 
 /* -------------------------------
  * private methods
@@ -324,19 +521,27 @@ void surgescript_programpool_lock(surgescript_programpool_t* pool)
 
 
  /* metadata */
-void insert_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
+surgescript_programpool_metadata_t* find_metadata(surgescript_programpool_t* pool, const char* object_name, bool create)
 {
     surgescript_programpool_metadata_t *m = NULL;
     HASH_FIND(hh, pool->meta, object_name, strlen(object_name), m);
 
     /* create the hash entry if it doesn't exist yet */
-    if(m == NULL) {
+    if(m == NULL && create) {
         m = ssmalloc(sizeof *m);
         m->object_name = ssstrdup(object_name);
         ssarray_init(m->program_name);
+        ssarray_init(m->field_name);
         HASH_ADD_KEYPTR(hh, pool->meta, m->object_name, strlen(m->object_name), m);
     }
 
+    return m;
+}
+
+void insert_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
+{
+    surgescript_programpool_metadata_t *m = find_metadata(pool, object_name, true);
+
     /* no need to check for key uniqueness (it's checked before) */
     ssarray_push(m->program_name, ssstrdup(program_name));
 }
@@ -374,6 +579,8 @@ void remove_object_metadata(surgescript_programpool_t* pool, const char* object_
         for(int i = 0; i < ssarray_length(m->program_name); i++)
             ssfree(m->program_name[i]);
         ssarray_release(m->program_name);
+        clear_fields(m);
+        ssarray_release(m->field_name);
         ssfree(m->object_name);
         ssfree(m);
     }
@@ -389,6 +596,8 @@ void clear_metadata(surgescript_programpool_t* pool)
         for(int i = 0; i < ssarray_length(it->program_name); i++)
             ssfree(it->program_name[i]);
         ssarray_release(it->program_name);
+        clear_fields(it);
+        ssarray_release(it->field_name);
         ssfree(it->object_name);
         ssfree(it);
     }
@@ -418,6 +627,76 @@ void foreach_object_name(surgescript_programpool_t* pool, void* data, void (*cal
         callback(m->object_name, data);
 }
 
+void clear_fields(surgescript_programpool_metadata_t* m)
+{
+    for(int i = 0; i < ssarray_length(m->field_name); i++)
+        ssfree(m->field_name[i]);
+    ssarray_reset(m->field_name);
+}
+
+
+/* state tables */
+surgescript_statetable_t* find_statetable(surgescript_programpool_t* pool, const char* object_name)
+{
+    surgescript_statetable_t* table = NULL;
+    HASH_FIND(hh, pool->statetable, object_name, strlen(object_name), table);
+
+    /* create the state table if it doesn't exist yet */
+    if(table == NULL) {
+        table = ssmalloc(sizeof *table);
+        table->object_name = ssstrdup(object_name);
+        table->pool = pool;
+        ssarray_init(table->entry);
+        HASH_ADD_KEYPTR(hh, pool->statetable, table->object_name, strlen(table->object_name), table);
+    }
+
+    return table;
+}
+
+void register_state_program(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
+{
+    /* states are programs named "state:<state_name>" */
+    if(strncmp(program_name, "state:", 6) == 0) {
+        surgescript_programpool_register_state(pool, object_name, program_name + 6);
+        invalidate_statetable(pool, object_name);
+    }
+}
+
+void invalidate_statetable(surgescript_programpool_t* pool, const char* object_name)
+{
+    surgescript_statetable_t* table = NULL;
+
+    /* all classes of objects fall back to the programs of "Object" */
+    if(strcmp(object_name, "Object") == 0) {
+        for(table = pool->statetable; table != NULL; table = table->hh.next) {
+            for(int i = 0; i < ssarray_length(table->entry); i++)
+                table->entry[i].program = NULL;
+        }
+        return;
+    }
+
+    /* clear the cached programs */
+    HASH_FIND(hh, pool->statetable, object_name, strlen(object_name), table);
+    if(table != NULL) {
+        for(int i = 0; i < ssarray_length(table->entry); i++)
+            table->entry[i].program = NULL;
+    }
+}
+
+void clear_statetables(surgescript_programpool_t* pool)
+{
+    surgescript_statetable_t *it, *tmp;
+
+    HASH_ITER(hh, pool->statetable, it, tmp) {
+        HASH_DEL(pool->statetable, it);
+        for(int i = 0; i < ssarray_length(it->entry); i++)
+            ssfree(it->entry[i].state_name);
+        ssarray_release(it->entry);
+        ssfree(it->object_name);
+        ssfree(it);
+    }
+}
+
 
 /* utilities */
 void delete_pair(void* pair)
@@ -437,6 +716,18 @@ void delete_program(const char* program_name, void* data)
     fasthash_delete(pool->hash, signature);
 }
 
+/* helper function (callback) of the fingerprint; the order of the programs doesn't matter */
+void accumulate_fingerprint(const char* program_name, void* data)
+{
+    surgescript_programpool_t* pool = (surgescript_programpool_t*)(((void**)data)[0]);
+    const char* object_name = (const char*)(((void**)data)[1]);
+    uint64_t* hash = (uint64_t*)(((void**)data)[2]);
+    surgescript_program_t* program = surgescript_programpool_get(pool, object_name, program_name);
+
+    if(program != NULL)
+        *hash += XXH3_64bits_withSeed(program_name, strlen(program_name), surgescript_program_fingerprint(program));
+}
+
 
 /* program signature generator: must be extremely fast */
 surgescript_programpool_signature_t generate_signature(const char* object_name, const char* program_name, xxhash_t seed)
@@ -23,9 +23,11 @@
 #define _SURGESCRIPT_RUNTIME_PROGRAMPOOL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* types */
 typedef struct surgescript_programpool_t surgescript_programpool_t;
+typedef struct surgescript_statetable_t surgescript_statetable_t;
 
 /* forward declarations */
 struct surgescript_program_t;
@@ -45,6 +47,20 @@ bool surgescript_programpool_replace(surgescript_programpool_t* pool, const char
 void surgescript_programpool_delete(surgescript_programpool_t* pool, const char* object_name, const char* program_name); /* deletes a programs from the specified object */
 void surgescript_programpool_purge(surgescript_programpool_t* pool, const char* object_name); /* deletes all programs from the specified object */
 bool surgescript_programpool_is_compiled(surgescript_programpool_t* pool, const char* object_name); /* is there any code for object_name? */
+uint64_t surgescript_programpool_fingerprint(surgescript_programpool_t* pool, const char* object_name); /* a hash of the code of all programs of object_name */
 void surgescript_programpool_lock(surgescript_programpool_t* pool); /* locks the program pool, so that no (programs of) new objects can be added to it */
 
+/* fields */
+void surgescript_programpool_register_field(surgescript_programpool_t* pool, const char* object_name, const char* field_name, int address); /* registers a field of object_name stored at the given heap address */
+void surgescript_programpool_clear_fields(surgescript_programpool_t* pool, const char* object_name); /* forgets the fields of object_name */
+int surgescript_programpool_field_count(surgescript_programpool_t* pool, const char* object_name); /* the number of heap addresses spanned by the fields of object_name */
+const char* surgescript_programpool_field_name(surgescript_programpool_t* pool, const char* object_name, int address); /* the name of the field stored at address, or NULL */
+
+/* state tables */
+surgescript_statetable_t* surgescript_programpool_statetable(surgescript_programpool_t* pool, const char* object_name); /* the state table of object_name */
+int surgescript_programpool_register_state(surgescript_programpool_t* pool, const char* object_name, const char* state_name); /* registers a state of object_name, returning its state id */
+int surgescript_statetable_find(const surgescript_statetable_t* table, const char* state_name); /* finds the id of a state, or returns -1 if it isn't registered */
+const char* surgescript_statetable_name(const surgescript_statetable_t* table, int state_id); /* the name of a registered state */
+struct surgescript_program_t* surgescript_statetable_program(surgescript_statetable_t* table, int state_id); /* the program of a registered state; may return NULL */
+
 #endif
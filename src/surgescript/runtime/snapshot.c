@@ -0,0 +1,384 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/snapshot.c
+ * SurgeScript snapshots: binary images of the state of the VM
+ */
+
+#include <string.h>
+#include "snapshot.h"
+#include "../util/ssarray.h"
+#include "../util/util.h"
+
+#define XXH_INLINE_ALL
+#include "../third_party/xxhash.h"
+
+/* an image starts with a header: a magic number, the version of the format,
+   and the length & the checksum of the data that follows the header */
+static const char MAGIC[4] = { 'S', 'S', 'V', 'M' };
+static const uint8_t FORMAT_VERSION = 5;
+#define LENGTH_OFFSET (sizeof(MAGIC) + 1)
+#define CHECKSUM_OFFSET (LENGTH_OFFSET + 8)
+#define HEADER_SIZE (CHECKSUM_OFFSET + 8)
+SS_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t), double_size);
+SS_STATIC_ASSERT(sizeof(float) == sizeof(uint32_t), float_size);
+
+/* snapshot */
+struct surgescript_snapshot_t
+{
+    SSARRAY(uint8_t, data); /* the image */
+    size_t ptr; /* read pointer */
+    bool is_corrupted; /* did we try to read past the end of the image? */
+};
+
+/* helpers */
+static inline uint8_t next_byte(surgescript_snapshot_t* snapshot);
+static inline void write_uint64_at(uint8_t* bytes, uint64_t value);
+static inline uint64_t read_uint64_at(const uint8_t* bytes);
+static inline uint64_t double_to_bits(double value);
+static inline double bits_to_double(uint64_t bits);
+
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_snapshot_create()
+ * Creates an empty snapshot for writing
+ */
+surgescript_snapshot_t* surgescript_snapshot_create()
+{
+    surgescript_snapshot_t* snapshot = ssmalloc(sizeof *snapshot);
+
+    ssarray_init_ex(snapshot->data, 4096);
+    snapshot->ptr = 0;
+    snapshot->is_corrupted = false;
+
+    for(int i = 0; i < sizeof(MAGIC); i++)
+        surgescript_snapshot_write_byte(snapshot, MAGIC[i]);
+    surgescript_snapshot_write_byte(snapshot, FORMAT_VERSION);
+
+    /* the length & the checksum are written on release */
+    while(ssarray_length(snapshot->data) < HEADER_SIZE)
+        surgescript_snapshot_write_byte(snapshot, 0);
+
+    return snapshot;
+}
+
+/*
+ * surgescript_snapshot_open()
+ * Opens an image for reading. Returns NULL if it's not a valid image,
+ * i.e., if its header, its length or its checksum don't match
+ */
+surgescript_snapshot_t* surgescript_snapshot_open(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    surgescript_snapshot_t* snapshot;
+
+    /* validate the header */
+    if(data == NULL || size < HEADER_SIZE || memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0)
+        return NULL;
+    else if(bytes[sizeof(MAGIC)] != FORMAT_VERSION)
+        return NULL;
+
+    /* validate the data: a truncated or damaged image is rejected here */
+    if(read_uint64_at(bytes + LENGTH_OFFSET) != size - HEADER_SIZE)
+        return NULL;
+    else if(read_uint64_at(bytes + CHECKSUM_OFFSET) != XXH3_64bits(bytes + HEADER_SIZE, size - HEADER_SIZE))
+        return NULL;
+
+    /* copy the image */
+    snapshot = ssmalloc(sizeof *snapshot);
+    ssarray_init_ex(snapshot->data, size);
+    memcpy(snapshot->data, bytes, size);
+    snapshot->data_len = size;
+    snapshot->ptr = HEADER_SIZE;
+    snapshot->is_corrupted = false;
+
+    return snapshot;
+}
+
+/*
+ * surgescript_snapshot_destroy()
+ * Destroys a snapshot
+ */
+surgescript_snapshot_t* surgescript_snapshot_destroy(surgescript_snapshot_t* snapshot)
+{
+    ssarray_release(snapshot->data);
+    return ssfree(snapshot);
+}
+
+/*
+ * surgescript_snapshot_release()
+ * Destroys a snapshot, returning its image. The caller must
+ * free the image with ssfree(). Its size is written to *size
+ */
+void* surgescript_snapshot_release(surgescript_snapshot_t* snapshot, size_t* size)
+{
+    void* data = snapshot->data;
+    size_t length = ssarray_length(snapshot->data);
+
+    /* complete the header */
+    write_uint64_at(snapshot->data + LENGTH_OFFSET, length - HEADER_SIZE);
+    write_uint64_at(snapshot->data + CHECKSUM_OFFSET, XXH3_64bits(snapshot->data + HEADER_SIZE, length - HEADER_SIZE));
+
+    if(size != NULL)
+        *size = length;
+
+    ssfree(snapshot);
+    return data;
+}
+
+/*
+ * surgescript_snapshot_write_byte()
+ * Writes a byte
+ */
+void surgescript_snapshot_write_byte(surgescript_snapshot_t* snapshot, uint8_t value)
+{
+    ssarray_push(snapshot->data, value);
+}
+
+/*
+ * surgescript_snapshot_write_uint()
+ * Writes an unsigned integer using a variable-length encoding:
+ * small numbers (handles, lengths, and so on) take a single byte
+ */
+void surgescript_snapshot_write_uint(surgescript_snapshot_t* snapshot, uint64_t value)
+{
+    while(value >= 0x80) {
+        ssarray_push(snapshot->data, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+
+    ssarray_push(snapshot->data, (uint8_t)value);
+}
+
+/*
+ * surgescript_snapshot_write_int()
+ * Writes a signed integer
+ */
+void surgescript_snapshot_write_int(surgescript_snapshot_t* snapshot, int64_t value)
+{
+    /* zigzag encoding: small negative numbers are small too */
+    uint64_t u = (uint64_t)value;
+    surgescript_snapshot_write_uint(snapshot, (u << 1) ^ (value < 0 ? UINT64_MAX : 0));
+}
+
+/*
+ * surgescript_snapshot_write_double()
+ * Writes a double-precision floating-point number
+ */
+void surgescript_snapshot_write_double(surgescript_snapshot_t* snapshot, double value)
+{
+    uint64_t bits = double_to_bits(value);
+
+    /* little-endian */
+    for(int i = 0; i < 8; i++, bits >>= 8)
+        ssarray_push(snapshot->data, (uint8_t)bits);
+}
+
+/*
+ * surgescript_snapshot_write_float()
+ * Writes a single-precision floating-point number
+ */
+void surgescript_snapshot_write_float(surgescript_snapshot_t* snapshot, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    for(int i = 0; i < 4; i++, bits >>= 8)
+        ssarray_push(snapshot->data, (uint8_t)bits);
+}
+
+/*
+ * surgescript_snapshot_write_string()
+ * Writes a string
+ */
+void surgescript_snapshot_write_string(surgescript_snapshot_t* snapshot, const char* string)
+{
+    size_t length = strlen(string);
+
+    surgescript_snapshot_write_uint(snapshot, length);
+    while(length-- > 0)
+        ssarray_push(snapshot->data, (uint8_t)(*string++));
+}
+
+/*
+ * surgescript_snapshot_read_byte()
+ * Reads a byte
+ */
+uint8_t surgescript_snapshot_read_byte(surgescript_snapshot_t* snapshot)
+{
+    return next_byte(snapshot);
+}
+
+/*
+ * surgescript_snapshot_read_uint()
+ * Reads an unsigned integer
+ */
+uint64_t surgescript_snapshot_read_uint(surgescript_snapshot_t* snapshot)
+{
+    uint64_t value = 0;
+    uint8_t byte;
+    int shift = 0;
+
+    do {
+        byte = next_byte(snapshot);
+        if(shift < 64)
+            value |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+
+    return value;
+}
+
+/*
+ * surgescript_snapshot_read_int()
+ * Reads a signed integer
+ */
+int64_t surgescript_snapshot_read_int(surgescript_snapshot_t* snapshot)
+{
+    uint64_t u = surgescript_snapshot_read_uint(snapshot);
+    return (int64_t)((u >> 1) ^ (~(u & 1) + 1));
+}
+
+/*
+ * surgescript_snapshot_read_double()
+ * Reads a double-precision floating-point number
+ */
+double surgescript_snapshot_read_double(surgescript_snapshot_t* snapshot)
+{
+    uint64_t bits = 0;
+
+    for(int i = 0; i < 8; i++)
+        bits |= (uint64_t)next_byte(snapshot) << (8 * i);
+
+    return bits_to_double(bits);
+}
+
+/*
+ * surgescript_snapshot_read_float()
+ * Reads a single-precision floating-point number
+ */
+float surgescript_snapshot_read_float(surgescript_snapshot_t* snapshot)
+{
+    uint32_t bits = 0;
+    float value;
+
+    for(int i = 0; i < 4; i++)
+        bits |= (uint32_t)next_byte(snapshot) << (8 * i);
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*
+ * surgescript_snapshot_read_string()
+ * Reads a string. The caller must free it with ssfree()
+ */
+char* surgescript_snapshot_read_string(surgescript_snapshot_t* snapshot)
+{
+    uint64_t length = surgescript_snapshot_read_uint(snapshot);
+    char* string;
+
+    /* don't allocate absurd amounts of memory if the image is corrupted */
+    if(length > ssarray_length(snapshot->data) - snapshot->ptr) {
+        snapshot->is_corrupted = true;
+        snapshot->ptr = ssarray_length(snapshot->data);
+        length = 0;
+    }
+
+    string = ssmalloc((length + 1) * sizeof(*string));
+    memcpy(string, snapshot->data + snapshot->ptr, length);
+    string[length] = '\0';
+    snapshot->ptr += length;
+
+    return string;
+}
+
+/*
+ * surgescript_snapshot_eof()
+ * Have we read the whole image?
+ */
+bool surgescript_snapshot_eof(const surgescript_snapshot_t* snapshot)
+{
+    return snapshot->ptr >= ssarray_length(snapshot->data);
+}
+
+/*
+ * surgescript_snapshot_is_corrupted()
+ * Did we try to read past the end of the image?
+ */
+bool surgescript_snapshot_is_corrupted(const surgescript_snapshot_t* snapshot)
+{
+    return snapshot->is_corrupted;
+}
+
+
+
+/* -------------------------------
+ * private stuff
+ * ------------------------------- */
+
+/* reads the next byte of the image; past the end, we read zeros */
+uint8_t next_byte(surgescript_snapshot_t* snapshot)
+{
+    if(snapshot->ptr < ssarray_length(snapshot->data))
+        return snapshot->data[snapshot->ptr++];
+
+    snapshot->is_corrupted = true;
+    return 0;
+}
+
+/* writes a 64-bit little-endian integer */
+void write_uint64_at(uint8_t* bytes, uint64_t value)
+{
+    for(int i = 0; i < 8; i++, value >>= 8)
+        bytes[i] = (uint8_t)value;
+}
+
+/* reads a 64-bit little-endian integer */
+uint64_t read_uint64_at(const uint8_t* bytes)
+{
+    uint64_t value = 0;
+
+    for(int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+
+    return value;
+}
+
+/* the bits of a double */
+uint64_t double_to_bits(double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+/* the double represented by the given bits */
+double bits_to_double(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
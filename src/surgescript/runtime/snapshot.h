@@ -0,0 +1,57 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/snapshot.h
+ * SurgeScript snapshots: binary images of the state of the VM
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_SNAPSHOT_H
+#define _SURGESCRIPT_RUNTIME_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct surgescript_snapshot_t surgescript_snapshot_t;
+
+/* create & destroy */
+surgescript_snapshot_t* surgescript_snapshot_create(); /* creates an empty snapshot for writing */
+surgescript_snapshot_t* surgescript_snapshot_open(const void* data, size_t size); /* opens an existing image for reading; returns NULL if it's not a valid image (bad header, length or checksum) */
+surgescript_snapshot_t* surgescript_snapshot_destroy(surgescript_snapshot_t* snapshot); /* destroys a snapshot */
+void* surgescript_snapshot_release(surgescript_snapshot_t* snapshot, size_t* size); /* destroys a snapshot, returning its image; free it with ssfree() */
+
+/* write */
+void surgescript_snapshot_write_byte(surgescript_snapshot_t* snapshot, uint8_t value);
+void surgescript_snapshot_write_uint(surgescript_snapshot_t* snapshot, uint64_t value);
+void surgescript_snapshot_write_int(surgescript_snapshot_t* snapshot, int64_t value);
+void surgescript_snapshot_write_double(surgescript_snapshot_t* snapshot, double value);
+void surgescript_snapshot_write_float(surgescript_snapshot_t* snapshot, float value);
+void surgescript_snapshot_write_string(surgescript_snapshot_t* snapshot, const char* string);
+
+/* read */
+uint8_t surgescript_snapshot_read_byte(surgescript_snapshot_t* snapshot);
+uint64_t surgescript_snapshot_read_uint(surgescript_snapshot_t* snapshot);
+int64_t surgescript_snapshot_read_int(surgescript_snapshot_t* snapshot);
+double surgescript_snapshot_read_double(surgescript_snapshot_t* snapshot);
+float surgescript_snapshot_read_float(surgescript_snapshot_t* snapshot);
+char* surgescript_snapshot_read_string(surgescript_snapshot_t* snapshot); /* free it with ssfree() */
+
+/* status */
+bool surgescript_snapshot_eof(const surgescript_snapshot_t* snapshot); /* have we read the whole image? */
+bool surgescript_snapshot_is_corrupted(const surgescript_snapshot_t* snapshot); /* did we try to read past the end of the image? */
+
+#endif
@@ -20,13 +20,17 @@
  */
 
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include "../vm.h"
 #include "../heap.h"
+#include "../program.h"
 #include "../object.h"
 #include "../object_manager.h"
 #include "../tag_system.h"
 #include "../../util/ssarray.h"
 #include "../../util/util.h"
+#include "sslib.h"
 
 
 /* private stuff */
@@ -34,7 +38,6 @@
 /* Array */
 static surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_destructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_getlength(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_get(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_set(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
@@ -43,16 +46,24 @@ static surgescript_var_t* fun_pop(surgescript_object_t* object, const surgescrip
 static surgescript_var_t* fun_shift(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_unshift(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_sort(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_sortby(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_reverse(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_shuffle(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_indexof(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_clear(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_iterator(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_tostring(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_fill(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_add(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_mul(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_sum(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_min(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_max(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_dot(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_slice(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 
 /* ArrayIterator */
 static surgescript_var_t* fun_it_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_it_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_next(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_hasnext(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_tostring(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
@@ -62,12 +73,31 @@ typedef int (*surgescript_sortcmp_t)(surgescript_object_t* object, const surgesc
 static int default_sort_function(surgescript_object_t* object, const surgescript_var_t* a, const surgescript_var_t* b);
 static int custom_sort_function(surgescript_object_t* object, const surgescript_var_t* a, const surgescript_var_t* b);
 
+/* sorting by keys */
+typedef struct surgescript_sortkey_t surgescript_sortkey_t;
+struct surgescript_sortkey_t
+{
+    union {
+        uint64_t number; /* numbers are mapped to unsigned integers of the same order */
+        const char* string;
+        const surgescript_var_t* var;
+    } key;
+    int index; /* the index of the element in the array */
+};
+static bool sort_by_keys(surgescript_heap_t* heap, const surgescript_var_t** keys, int length, bool any_type);
+static void radix_sort(surgescript_sortkey_t* sortkey, surgescript_sortkey_t* tmp, int length);
+static void merge_sort(surgescript_sortkey_t* sortkey, surgescript_sortkey_t* tmp, int length, int (*compare)(const surgescript_sortkey_t*, const surgescript_sortkey_t*));
+static int compare_strings(const surgescript_sortkey_t* a, const surgescript_sortkey_t* b);
+static int compare_vars(const surgescript_sortkey_t* a, const surgescript_sortkey_t* b);
+static void permute(surgescript_heap_t* heap, surgescript_sortkey_t* sortkey, int length);
+
 /* utilities */
 #define ORDINAL(j)              (((j) == 1) ? "st" : (((j) == 2) ? "nd" : (((j) == 3) ? "rd" : "th")))
 #define ARRAY_LENGTH(heap)      ((int)surgescript_var_get_number(surgescript_heap_at((heap), LENGTH_ADDR)))
 static void quicksort(surgescript_heap_t* heap, surgescript_heapptr_t begin, surgescript_heapptr_t end, surgescript_sortcmp_t compare, surgescript_object_t* compare_object);
 static inline surgescript_heapptr_t partition(surgescript_heap_t* heap, surgescript_heapptr_t begin, surgescript_heapptr_t end, surgescript_sortcmp_t compare, surgescript_object_t* compare_object);
 static inline surgescript_var_t* med3(surgescript_var_t* a, surgescript_var_t* b, surgescript_var_t* c);
+static surgescript_heap_t* array_heap(surgescript_object_t* object, const surgescript_var_t* var);
 static const surgescript_heapptr_t LENGTH_ADDR = 0; /* the length of the array is allocated on the first address */
 static const surgescript_heapptr_t BASE_ADDR = 1; /* array elements come later */
 static const surgescript_heapptr_t IT_LENGTH_ADDR = 0;
@@ -88,7 +118,7 @@ void surgescript_sslib_register_array(surgescript_vm_t* vm)
     /* methods */
     surgescript_vm_bind(vm, "Array", "constructor", fun_constructor, 0);
     surgescript_vm_bind(vm, "Array", "destructor", fun_destructor, 0);
-    surgescript_vm_bind(vm, "Array", "state:main", fun_main, 0);
+    surgescript_vm_bind(vm, "Array", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "Array", "get_length", fun_getlength, 0);
     surgescript_vm_bind(vm, "Array", "get", fun_get, 1);
     surgescript_vm_bind(vm, "Array", "set", fun_set, 2);
@@ -98,14 +128,23 @@ void surgescript_sslib_register_array(surgescript_vm_t* vm)
     surgescript_vm_bind(vm, "Array", "unshift", fun_unshift, 1);
     surgescript_vm_bind(vm, "Array", "clear", fun_clear, 0);
     surgescript_vm_bind(vm, "Array", "sort", fun_sort, 1);
+    surgescript_vm_bind(vm, "Array", "sortBy", fun_sortby, 1);
     surgescript_vm_bind(vm, "Array", "reverse", fun_reverse, 0);
     surgescript_vm_bind(vm, "Array", "shuffle", fun_shuffle, 0);
     surgescript_vm_bind(vm, "Array", "indexOf", fun_indexof, 1);
     surgescript_vm_bind(vm, "Array", "iterator", fun_iterator, 0);
     surgescript_vm_bind(vm, "Array", "toString", fun_tostring, 0);
+    surgescript_vm_bind(vm, "Array", "fill", fun_fill, 1);
+    surgescript_vm_bind(vm, "Array", "add", fun_add, 1);
+    surgescript_vm_bind(vm, "Array", "mul", fun_mul, 1);
+    surgescript_vm_bind(vm, "Array", "sum", fun_sum, 0);
+    surgescript_vm_bind(vm, "Array", "min", fun_min, 0);
+    surgescript_vm_bind(vm, "Array", "max", fun_max, 0);
+    surgescript_vm_bind(vm, "Array", "dot", fun_dot, 1);
+    surgescript_vm_bind(vm, "Array", "slice", fun_slice, 2);
 
     surgescript_vm_bind(vm, "ArrayIterator", "constructor", fun_it_constructor, 0);
-    surgescript_vm_bind(vm, "ArrayIterator", "state:main", fun_it_main, 0);
+    surgescript_vm_bind(vm, "ArrayIterator", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "ArrayIterator", "next", fun_it_next, 0);
     surgescript_vm_bind(vm, "ArrayIterator", "hasNext", fun_it_hasnext, 0);
     surgescript_vm_bind(vm, "ArrayIterator", "toString", fun_it_tostring, 0);
@@ -133,13 +172,6 @@ surgescript_var_t* fun_destructor(surgescript_object_t* object, const surgescrip
     return NULL;
 }
 
-/* main state */
-surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    /* do nothing */
-    return NULL;
-}
-
 /* returns the length of the array */
 surgescript_var_t* fun_getlength(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
@@ -279,8 +311,56 @@ surgescript_var_t* fun_sort(surgescript_object_t* object, const surgescript_var_
     surgescript_objectmanager_t* manager = surgescript_object_manager(object);
     surgescript_sortcmp_t compare = surgescript_var_is_null(param[0]) ? default_sort_function : custom_sort_function;
     surgescript_object_t* compare_object = (compare == custom_sort_function) ? surgescript_objectmanager_get(manager, surgescript_var_get_objecthandle(param[0])) : NULL;
+    int length = ARRAY_LENGTH(heap);
+
+    /* arrays of numbers only or of strings only are sorted natively */
+    if(compare == default_sort_function && length > 1) {
+        if(sort_by_keys(heap, NULL, length, false))
+            return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+    }
+
+    quicksort(heap, BASE_ADDR, BASE_ADDR + length - 1, compare, compare_object);
+
+    return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+}
+
+/* sorts the array in ascending order of the keys extracted by a functor. The sort is stable */
+surgescript_var_t* fun_sortby(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    surgescript_objecthandle_t key_handle = surgescript_var_get_objecthandle(param[0]);
+    int length = ARRAY_LENGTH(heap);
 
-    quicksort(heap, BASE_ADDR, BASE_ADDR + ARRAY_LENGTH(heap) - 1, compare, compare_object);
+    if(!surgescript_objectmanager_exists(manager, key_handle)) {
+        sslog("Array.sortBy(): expected a functor");
+        return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+    }
+    else if(length > 1) {
+        surgescript_object_t* key_object = surgescript_objectmanager_get(manager, key_handle);
+        surgescript_var_t** keys = ssmalloc(length * sizeof(*keys));
+
+        /* call the functor once per element */
+        for(int i = 0; i < length; i++) {
+            const surgescript_var_t* element = surgescript_heap_at(heap, BASE_ADDR + i);
+            keys[i] = surgescript_var_create();
+            surgescript_object_call_function(key_object, "call", &element, 1, keys[i]);
+
+            if(ARRAY_LENGTH(heap) != length) {
+                sslog("Array.sortBy(): the array must not be modified while extracting the keys");
+                length = i + 1;
+                break;
+            }
+        }
+
+        /* sort */
+        if(length == ARRAY_LENGTH(heap))
+            sort_by_keys(heap, (const surgescript_var_t**)keys, length, true);
+
+        for(int i = 0; i < length; i++)
+            surgescript_var_destroy(keys[i]);
+        ssfree(keys);
+    }
 
     return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
 }
@@ -421,6 +501,216 @@ surgescript_var_t* fun_tostring(surgescript_object_t* object, const surgescript_
 
 
 
+/* sets all elements of the array to the given value. Returns the array */
+surgescript_var_t* fun_fill(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+
+    for(int i = 0; i < length; i++)
+        surgescript_var_copy(surgescript_heap_at(heap, BASE_ADDR + i), param[0]);
+
+    return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+}
+
+/* adds x to the elements of the array, where x is either a number or an array
+   of numbers (element-wise addition). Returns the array */
+surgescript_var_t* fun_add(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    surgescript_heap_t* other = array_heap(object, param[0]);
+    int length = ARRAY_LENGTH(heap);
+
+    if(other != NULL) {
+        length = ssmin(length, ARRAY_LENGTH(other));
+        for(int i = 0; i < length; i++) {
+            surgescript_var_t* element = surgescript_heap_at(heap, BASE_ADDR + i);
+            double x = surgescript_var_get_number(surgescript_heap_at(other, BASE_ADDR + i));
+            surgescript_var_set_number(element, surgescript_var_get_number(element) + x);
+        }
+    }
+    else {
+        double x = surgescript_var_get_number(param[0]);
+        for(int i = 0; i < length; i++) {
+            surgescript_var_t* element = surgescript_heap_at(heap, BASE_ADDR + i);
+            surgescript_var_set_number(element, surgescript_var_get_number(element) + x);
+        }
+    }
+
+    return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+}
+
+/* multiplies the elements of the array by x, where x is either a number or
+   an array of numbers (element-wise multiplication). Returns the array */
+surgescript_var_t* fun_mul(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    surgescript_heap_t* other = array_heap(object, param[0]);
+    int length = ARRAY_LENGTH(heap);
+
+    if(other != NULL) {
+        length = ssmin(length, ARRAY_LENGTH(other));
+        for(int i = 0; i < length; i++) {
+            surgescript_var_t* element = surgescript_heap_at(heap, BASE_ADDR + i);
+            double x = surgescript_var_get_number(surgescript_heap_at(other, BASE_ADDR + i));
+            surgescript_var_set_number(element, surgescript_var_get_number(element) * x);
+        }
+    }
+    else {
+        double x = surgescript_var_get_number(param[0]);
+        for(int i = 0; i < length; i++) {
+            surgescript_var_t* element = surgescript_heap_at(heap, BASE_ADDR + i);
+            surgescript_var_set_number(element, surgescript_var_get_number(element) * x);
+        }
+    }
+
+    return surgescript_var_set_objecthandle(surgescript_var_create(), surgescript_object_handle(object));
+}
+
+/* the sum of the elements of the array */
+surgescript_var_t* fun_sum(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+    double sum = 0.0;
+
+    for(int i = 0; i < length; i++)
+        sum += surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + i));
+
+    return surgescript_var_set_number(surgescript_var_create(), sum);
+}
+
+/* the smallest element of the array, or null if the array is empty */
+surgescript_var_t* fun_min(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+    double min;
+
+    if(length == 0)
+        return NULL;
+
+    min = surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + 0));
+    for(int i = 1; i < length; i++) {
+        double x = surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + i));
+        min = (x < min) ? x : min;
+    }
+
+    return surgescript_var_set_number(surgescript_var_create(), min);
+}
+
+/* the largest element of the array, or null if the array is empty */
+surgescript_var_t* fun_max(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+    double max;
+
+    if(length == 0)
+        return NULL;
+
+    max = surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + 0));
+    for(int i = 1; i < length; i++) {
+        double x = surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + i));
+        max = (x > max) ? x : max;
+    }
+
+    return surgescript_var_set_number(surgescript_var_create(), max);
+}
+
+/* the dot product of this array and another array of numbers */
+surgescript_var_t* fun_dot(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    surgescript_heap_t* other = array_heap(object, param[0]);
+    double dot = 0.0;
+
+    if(other != NULL) {
+        int length = ssmin(ARRAY_LENGTH(heap), ARRAY_LENGTH(other));
+        for(int i = 0; i < length; i++) {
+            double a = surgescript_var_get_number(surgescript_heap_at(heap, BASE_ADDR + i));
+            double b = surgescript_var_get_number(surgescript_heap_at(other, BASE_ADDR + i));
+            dot += a * b;
+        }
+    }
+
+    return surgescript_var_set_number(surgescript_var_create(), dot);
+}
+
+/* returns a new array with (at most) length elements of this array, starting at index start */
+surgescript_var_t* fun_slice(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+    int start = ssclamp((int)surgescript_var_get_number(param[0]), 0, length);
+    int count = ssclamp((int)surgescript_var_get_number(param[1]), 0, length - start);
+
+    /* the new array is a sibling of this array */
+    surgescript_objecthandle_t slice_handle = surgescript_objectmanager_spawn(manager, surgescript_object_parent(object), "Array", NULL);
+    surgescript_heap_t* slice = surgescript_object_heap(surgescript_objectmanager_get(manager, slice_handle));
+
+    /* copy the elements */
+    for(int i = 0; i < count; i++) {
+        surgescript_heapptr_t ptr = surgescript_heap_malloc(slice);
+        surgescript_var_copy(surgescript_heap_at(slice, ptr), surgescript_heap_at(heap, BASE_ADDR + (start + i)));
+        ssassert(ptr == BASE_ADDR + i);
+    }
+    surgescript_var_set_number(surgescript_heap_at(slice, LENGTH_ADDR), count);
+
+    return surgescript_var_set_objecthandle(surgescript_var_create(), slice_handle);
+}
+
+
+
+/* --- native construction of Array literals (see SSOP_ARRAY) --- */
+
+/* appends values[0 .. count - 1] to the Array */
+void surgescript_sslib_array_append(surgescript_object_t* object, const surgescript_var_t** values, int count)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+    int length = ARRAY_LENGTH(heap);
+
+    /* allocate exactly the cells we need */
+    surgescript_heap_reserve(heap, BASE_ADDR + length + count);
+
+    for(int i = 0; i < count; i++) {
+        surgescript_heapptr_t ptr = surgescript_heap_malloc(heap);
+        surgescript_var_copy(surgescript_heap_at(heap, ptr), values[i]);
+        ssassert(ptr == BASE_ADDR + (length + i));
+    }
+
+    surgescript_var_set_number(surgescript_heap_at(heap, LENGTH_ADDR), length + count);
+}
+
+
+
+/* --- native foreach loops (see SSOP_ITER and SSOP_NEXT) --- */
+
+/* the length of the Array, or -1 if the object is not an Array */
+int surgescript_sslib_array_foreach_length(surgescript_object_t* object)
+{
+    if(strcmp(surgescript_object_name(object), "Array") != 0)
+        return -1;
+
+    return ARRAY_LENGTH(surgescript_object_heap(object));
+}
+
+/* the index-th element of the Array, or NULL if there is no such element */
+const surgescript_var_t* surgescript_sslib_array_foreach_element(surgescript_object_t* object, int index)
+{
+    surgescript_heap_t* heap = surgescript_object_heap(object);
+
+    if(strcmp(surgescript_object_name(object), "Array") != 0)
+        return NULL;
+    else if(index < 0 || index >= ARRAY_LENGTH(heap))
+        return NULL;
+
+    return surgescript_heap_at(heap, BASE_ADDR + index);
+}
+
+
+
 /* ArrayIterator */
 
 surgescript_var_t* fun_it_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
@@ -443,11 +733,6 @@ surgescript_var_t* fun_it_constructor(surgescript_object_t* object, const surges
     return NULL;
 }
 
-surgescript_var_t* fun_it_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    return NULL;
-}
-
 surgescript_var_t* fun_it_next(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
     surgescript_heap_t* heap = surgescript_object_heap(object);
@@ -545,3 +830,179 @@ int custom_sort_function(surgescript_object_t* object, const surgescript_var_t*
 
     return (return_value > 0) - (return_value < 0);
 }
+
+/* the heap of the Array referenced by var, or NULL if var doesn't reference an Array */
+surgescript_heap_t* array_heap(surgescript_object_t* object, const surgescript_var_t* var)
+{
+    if(surgescript_var_is_objecthandle(var)) {
+        surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+        surgescript_objecthandle_t handle = surgescript_var_get_objecthandle(var);
+
+        if(surgescript_objectmanager_exists(manager, handle)) {
+            surgescript_object_t* array = surgescript_objectmanager_get(manager, handle);
+            if(strcmp(surgescript_object_name(array), "Array") == 0)
+                return surgescript_object_heap(array);
+        }
+    }
+
+    return NULL;
+}
+
+/* sorts heap[BASE_ADDR .. BASE_ADDR + length - 1] in ascending order of keys[0 .. length - 1],
+   or of the elements themselves if keys is NULL. If the keys are not all numbers
+   or all strings, they are sorted by surgescript_var_compare() if any_type is
+   true, or not at all otherwise. Returns true if the array has been sorted */
+bool sort_by_keys(surgescript_heap_t* heap, const surgescript_var_t** keys, int length, bool any_type)
+{
+    surgescript_sortkey_t* sortkey;
+    surgescript_sortkey_t* tmp;
+    bool numbers = true, strings = true, nan = false;
+    #define KEY(i) ((keys != NULL) ? keys[i] : surgescript_heap_at(heap, BASE_ADDR + (i)))
+
+    /* detect the type of the keys */
+    for(int i = 0; i < length && (numbers || strings); i++) {
+        const surgescript_var_t* key = KEY(i);
+        numbers = numbers && surgescript_var_is_number(key);
+        strings = strings && surgescript_var_is_string(key);
+    }
+
+    if(!numbers && !strings && !any_type)
+        return false;
+
+    /* extract the keys */
+    sortkey = ssmalloc(2 * length * sizeof(*sortkey));
+    tmp = sortkey + length;
+
+    for(int i = 0; i < length; i++) {
+        const surgescript_var_t* key = KEY(i);
+        sortkey[i].index = i;
+
+        if(numbers) {
+            /* flip the sign bit of non-negative numbers and all bits of negative
+               numbers, so that the unsigned integers have the order of the numbers.
+               -0 is taken as +0 when sorting by keys, so that the sort is stable.
+               NaNs, whatever their sign, come last */
+            uint64_t bits = (uint64_t)surgescript_var_get_rawbits(key);
+            if(keys != NULL && surgescript_var_get_number(key) == 0.0)
+                bits = 0;
+            if(isnan(surgescript_var_get_number(key))) {
+                sortkey[i].key.number = UINT64_MAX;
+                nan = true;
+            }
+            else
+                sortkey[i].key.number = ((bits >> 63) != 0) ? ~bits : bits | (UINT64_C(1) << 63);
+        }
+        else if(strings)
+            sortkey[i].key.string = surgescript_var_fast_get_string(key);
+        else
+            sortkey[i].key.var = key;
+    }
+
+    #undef KEY
+
+    /* sort the keys */
+    if(numbers)
+        radix_sort(sortkey, tmp, length);
+    else
+        merge_sort(sortkey, tmp, length, strings ? compare_strings : compare_vars);
+
+    /* rearrange the elements */
+    if(numbers && keys == NULL && !nan) {
+        /* the numbers are recovered from the keys, which is cheaper than moving the elements */
+        for(int i = 0; i < length; i++) {
+            uint64_t bits = sortkey[i].key.number;
+            double x;
+
+            bits = ((bits >> 63) != 0) ? bits & ~(UINT64_C(1) << 63) : ~bits;
+            memcpy(&x, &bits, sizeof(x));
+            surgescript_var_set_number(surgescript_heap_at(heap, BASE_ADDR + i), x);
+        }
+    }
+    else
+        permute(heap, sortkey, length);
+
+    ssfree(sortkey);
+    return true;
+}
+
+/* stable LSD radix sort of numeric keys, one byte at a time */
+void radix_sort(surgescript_sortkey_t* sortkey, surgescript_sortkey_t* tmp, int length)
+{
+    int count[8][256] = { { 0 } };
+
+    for(int i = 0; i < length; i++) {
+        for(int b = 0; b < 8; b++)
+            count[b][(sortkey[i].key.number >> (8 * b)) & 0xFF]++;
+    }
+
+    for(int b = 0; b < 8; b++) {
+        int offset = 0;
+
+        /* skip this byte if it's the same in all keys */
+        if(count[b][(sortkey[0].key.number >> (8 * b)) & 0xFF] == length)
+            continue;
+
+        for(int d = 0; d < 256; d++) {
+            int c = count[b][d];
+            count[b][d] = offset;
+            offset += c;
+        }
+
+        for(int i = 0; i < length; i++)
+            tmp[count[b][(sortkey[i].key.number >> (8 * b)) & 0xFF]++] = sortkey[i];
+
+        memcpy(sortkey, tmp, length * sizeof(*sortkey));
+    }
+}
+
+/* stable bottom-up merge sort */
+void merge_sort(surgescript_sortkey_t* sortkey, surgescript_sortkey_t* tmp, int length, int (*compare)(const surgescript_sortkey_t*, const surgescript_sortkey_t*))
+{
+    for(int width = 1; width < length; width *= 2) {
+        for(int begin = 0; begin < length; begin += 2 * width) {
+            int mid = ssmin(begin + width, length);
+            int end = ssmin(begin + 2 * width, length);
+            int i = begin, j = mid, k = begin;
+
+            while(i < mid && j < end)
+                tmp[k++] = (compare(&sortkey[j], &sortkey[i]) < 0) ? sortkey[j++] : sortkey[i++];
+            while(i < mid)
+                tmp[k++] = sortkey[i++];
+            while(j < end)
+                tmp[k++] = sortkey[j++];
+        }
+
+        memcpy(sortkey, tmp, length * sizeof(*sortkey));
+    }
+}
+
+/* compares string keys */
+int compare_strings(const surgescript_sortkey_t* a, const surgescript_sortkey_t* b)
+{
+    return strcmp(a->key.string, b->key.string);
+}
+
+/* compares keys of any type */
+int compare_vars(const surgescript_sortkey_t* a, const surgescript_sortkey_t* b)
+{
+    return surgescript_var_compare(a->key.var, b->key.var);
+}
+
+/* moves the elements of the array to their sorted positions:
+   heap[BASE_ADDR + k] <- heap[BASE_ADDR + sortkey[k].index] */
+void permute(surgescript_heap_t* heap, surgescript_sortkey_t* sortkey, int length)
+{
+    for(int i = 0; i < length; i++) {
+        int k = i;
+
+        /* follow a cycle of the permutation */
+        while(sortkey[k].index != i) {
+            int next = sortkey[k].index;
+            surgescript_var_swap(surgescript_heap_at(heap, BASE_ADDR + k), surgescript_heap_at(heap, BASE_ADDR + next));
+            sortkey[k].index = k;
+            k = next;
+        }
+
+        sortkey[k].index = k;
+    }
+}
@@ -24,6 +24,7 @@
 #include "../vm.h"
 #include "../object.h"
 #include "../object_manager.h"
+#include "../vm_console.h"
 #include "../../util/util.h"
 
 /* private stuff */
@@ -34,6 +35,7 @@ static surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescr
 static surgescript_var_t* fun_print(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_write(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_readline(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static void write_var(surgescript_object_t* object, const surgescript_var_t* var, bool newline);
 
 
 /*
@@ -83,33 +85,31 @@ surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var
     return NULL;
 }
 
-/* print a line to stdout */
+/* print a line to the output */
 surgescript_var_t* fun_print(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    const surgescript_objectmanager_t* manager = surgescript_object_manager(object);
-    char* str = surgescript_var_get_string(param[0], manager);
-    puts(str);
-    ssfree(str);
-    fflush(stdout); /* keep this */
+    write_var(object, param[0], true);
     return NULL;
 }
 
-/* write a string to stdout */
+/* write a string to the output */
 surgescript_var_t* fun_write(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    const surgescript_objectmanager_t* manager = surgescript_object_manager(object);
-    char* str = surgescript_var_get_string(param[0], manager);
-    fputs(str, stdout);
-    ssfree(str);
-    fflush(stdout);
+    write_var(object, param[0], false);
     return NULL;
 }
 
 /* read a line from stdin */
 surgescript_var_t* fun_readline(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
+    const surgescript_objectmanager_t* manager = surgescript_object_manager(object);
     char str[1024] = "";
-    char* result = fgets(str, sizeof(str) / sizeof(char), stdin);
+    char* result;
+
+    /* the user should see any pending output */
+    surgescript_vmconsole_flush(surgescript_objectmanager_vmconsole(manager));
+
+    result = fgets(str, sizeof(str) / sizeof(char), stdin);
 
     if(result != NULL && !ferror(stdin)) {
         if(!feof(stdin)) {
@@ -121,4 +121,27 @@ surgescript_var_t* fun_readline(surgescript_object_t* object, const surgescript_
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+/* writes var to the output of the Console, without allocating memory if possible */
+void write_var(surgescript_object_t* object, const surgescript_var_t* var, bool newline)
+{
+    const surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    surgescript_vmconsole_t* console = surgescript_objectmanager_vmconsole(manager);
+    void (*write)(surgescript_vmconsole_t*,const char*,size_t) = newline ? surgescript_vmconsole_writeln : surgescript_vmconsole_write;
+
+    if(surgescript_var_is_string(var)) {
+        const char* str = surgescript_var_fast_get_string(var);
+        write(console, str, strlen(str));
+    }
+    else if(surgescript_var_is_objecthandle(var)) {
+        char* str = surgescript_var_get_string(var, manager); /* calls toString() */
+        write(console, str, strlen(str));
+        ssfree(str);
+    }
+    else {
+        char buf[32];
+        surgescript_var_to_string(var, buf, sizeof(buf));
+        write(console, buf, strlen(buf));
+    }
+}
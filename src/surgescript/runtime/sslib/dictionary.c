@@ -22,6 +22,7 @@
 #include <string.h>
 #include "../vm.h"
 #include "../heap.h"
+#include "../program.h"
 #include "../object.h"
 #include "../object_manager.h"
 #include "../tag_system.h"
@@ -32,7 +33,6 @@
 
 /* Dictionary */
 static surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_getcount(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_get(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_set(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
@@ -45,14 +45,12 @@ static surgescript_var_t* fun_tostring(surgescript_object_t* object, const surge
 
 /* DictionaryIterator */
 static surgescript_var_t* fun_it_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_it_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_next(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_hasnext(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_it_tostring(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 
 /* DictionaryEntry: useful for iterators */
 static surgescript_var_t* fun_entry_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_entry_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_entry_getkey(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_entry_getvalue(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_entry_setvalue(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
@@ -103,7 +101,7 @@ void surgescript_sslib_register_dictionary(surgescript_vm_t* vm)
 
     /* methods */
     surgescript_vm_bind(vm, "Dictionary", "constructor", fun_constructor, 0);
-    surgescript_vm_bind(vm, "Dictionary", "state:main", fun_main, 0);
+    surgescript_vm_bind(vm, "Dictionary", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "Dictionary", "get_count", fun_getcount, 0);
     surgescript_vm_bind(vm, "Dictionary", "get", fun_get, 1);
     surgescript_vm_bind(vm, "Dictionary", "set", fun_set, 2);
@@ -115,13 +113,13 @@ void surgescript_sslib_register_dictionary(surgescript_vm_t* vm)
     surgescript_vm_bind(vm, "Dictionary", "toString", fun_tostring, 0);
 
     surgescript_vm_bind(vm, "DictionaryIterator", "constructor", fun_it_constructor, 0);
-    surgescript_vm_bind(vm, "DictionaryIterator", "state:main", fun_it_main, 0);
+    surgescript_vm_bind(vm, "DictionaryIterator", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "DictionaryIterator", "next", fun_it_next, 0);
     surgescript_vm_bind(vm, "DictionaryIterator", "hasNext", fun_it_hasnext, 0);
     surgescript_vm_bind(vm, "DictionaryIterator", "toString", fun_it_tostring, 0);
 
     surgescript_vm_bind(vm, "DictionaryEntry", "constructor", fun_entry_constructor, 0);
-    surgescript_vm_bind(vm, "DictionaryEntry", "state:main", fun_entry_main, 0);
+    surgescript_vm_bind(vm, "DictionaryEntry", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "DictionaryEntry", "get_key", fun_entry_getkey, 0);
     surgescript_vm_bind(vm, "DictionaryEntry", "get_value", fun_entry_getvalue, 0);
     surgescript_vm_bind(vm, "DictionaryEntry", "set_value", fun_entry_setvalue, 1);
@@ -159,12 +157,6 @@ surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescri
     return NULL;
 }
 
-/* main state: do nothing */
-surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    return NULL;
-}
-
 /* getCount(): how many entries does this Dictionary have? */
 surgescript_var_t* fun_getcount(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
@@ -465,13 +457,6 @@ surgescript_var_t* fun_it_constructor(surgescript_object_t* object, const surges
     return NULL;
 }
 
-/* "main" state */
-surgescript_var_t* fun_it_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    /* do nothing */
-    return NULL;
-}
-
 /* next(): advances the iterator and returns the item previously pointed to by the iterator */
 surgescript_var_t* fun_it_next(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
@@ -546,11 +531,6 @@ surgescript_var_t* fun_entry_constructor(surgescript_object_t* object, const sur
     return NULL;
 }
 
-surgescript_var_t* fun_entry_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    return NULL;
-}
-
 surgescript_var_t* fun_entry_getkey(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
     surgescript_heap_t* heap = surgescript_object_heap(object);
@@ -58,6 +58,10 @@ static surgescript_var_t* fun_invoke(surgescript_object_t* object, const surgesc
 static surgescript_var_t* fun_arity(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_file(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_assert(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_sleep(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_wake(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_getsleeping(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
+static surgescript_var_t* fun_schedule(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 
 /* utilities */
 static void add_to_array(surgescript_objecthandle_t handle, void* arr);
@@ -91,8 +95,12 @@ void surgescript_sslib_register_object(surgescript_vm_t* vm)
     surgescript_vm_bind(vm, "Object", "__invoke", fun_invoke, 2);
     surgescript_vm_bind(vm, "Object", "__arity", fun_arity, 1);
     surgescript_vm_bind(vm, "Object", "__assert", fun_assert, 4);
+    surgescript_vm_bind(vm, "Object", "__sleep", fun_sleep, 1);
+    surgescript_vm_bind(vm, "Object", "__wake", fun_wake, 0);
+    surgescript_vm_bind(vm, "Object", "__schedule", fun_schedule, 2);
     surgescript_vm_bind(vm, "Object", "get___name", fun_name, 0);
     surgescript_vm_bind(vm, "Object", "get___active", fun_getactive, 0);
+    surgescript_vm_bind(vm, "Object", "get___sleeping", fun_getsleeping, 0);
     surgescript_vm_bind(vm, "Object", "set___active", fun_setactive, 1);
     surgescript_vm_bind(vm, "Object", "get___functions", fun_functions, 0);
     surgescript_vm_bind(vm, "Object", "get___children", fun_childlist, 0);
@@ -348,6 +356,38 @@ surgescript_var_t* fun_setactive(surgescript_object_t* object, const surgescript
     return NULL;
 }
 
+/* puts this object and its descendants to sleep for param[0] seconds: they won't be updated */
+surgescript_var_t* fun_sleep(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_object_sleep(object, surgescript_var_get_number(param[0]));
+    return NULL;
+}
+
+/* wakes up this object if it's sleeping */
+surgescript_var_t* fun_wake(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_object_wake(object);
+    return NULL;
+}
+
+/* is this object sleeping? */
+surgescript_var_t* fun_getsleeping(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    return surgescript_var_set_bool(surgescript_var_create(), surgescript_object_is_sleeping(object));
+}
+
+/* calls function param[0], which takes no parameters, after param[1] seconds */
+surgescript_var_t* fun_schedule(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
+{
+    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    char* fun_name = surgescript_var_get_string(param[0], manager);
+
+    surgescript_object_schedule(object, fun_name, surgescript_var_get_number(param[1]));
+    ssfree(fun_name);
+
+    return NULL;
+}
+
 /* returns the source file of this object */
 surgescript_var_t* fun_file(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
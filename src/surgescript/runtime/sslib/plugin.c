@@ -32,7 +32,6 @@
 
 /* private stuff */
 static surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
-static surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_destroy(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
 static surgescript_var_t* fun_get(surgescript_object_t* object, const surgescript_var_t** param, int num_params);
@@ -51,7 +50,7 @@ static bool is_builtin_object(const char* plugin_name, surgescript_objectmanager
 void surgescript_sslib_register_plugin(surgescript_vm_t* vm)
 {
     surgescript_vm_bind(vm, "Plugin", "constructor", fun_constructor, 0);
-    surgescript_vm_bind(vm, "Plugin", "state:main", fun_main, 0);
+    surgescript_vm_bind(vm, "Plugin", "state:main", surgescript_program_nop, 0);
     surgescript_vm_bind(vm, "Plugin", "spawn", fun_spawn, 1);
     surgescript_vm_bind(vm, "Plugin", "destroy", fun_destroy, 0);
     surgescript_vm_bind(vm, "Plugin", "get", fun_get, 1);
@@ -69,13 +68,6 @@ surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescri
     return NULL;
 }
 
-/* main state */
-surgescript_var_t* fun_main(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
-{
-    /* do nothing */
-    return NULL;
-}
-
 /* spawn */
 surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
@@ -24,6 +24,8 @@
 
 /* forward declarations */
 struct surgescript_vm_t;
+struct surgescript_object_t;
+struct surgescript_var_t;
 
 /* Register common methods to all objects */
 void surgescript_sslib_register_object(struct surgescript_vm_t* vm);
@@ -45,4 +47,9 @@ void surgescript_sslib_register_tagsystem(struct surgescript_vm_t* vm);
 void surgescript_sslib_register_surgescript(struct surgescript_vm_t* vm);
 void surgescript_sslib_register_plugin(struct surgescript_vm_t* vm);
 
+/* Arrays handled natively by the VM (see SSOP_ARRAY, SSOP_ITER and SSOP_NEXT) */
+int surgescript_sslib_array_foreach_length(struct surgescript_object_t* object); /* the length of the Array, or -1 if the object is not an Array */
+const struct surgescript_var_t* surgescript_sslib_array_foreach_element(struct surgescript_object_t* object, int index); /* the index-th element of the Array, or NULL */
+void surgescript_sslib_array_append(struct surgescript_object_t* object, const struct surgescript_var_t** values, int count); /* appends count values to the Array */
+
 #endif
\ No newline at end of file
@@ -195,6 +195,21 @@ const surgescript_var_t* surgescript_stack_peek(const surgescript_stack_t* stack
     return NULL;
 }
 
+/*
+ * surgescript_stack_peek_top()
+ * Reads the (top+offset)-th element from the stack, offset <= 0
+ */
+const surgescript_var_t* surgescript_stack_peek_top(const surgescript_stack_t* stack, surgescript_stackptr_t offset)
+{
+    const surgescript_stackptr_t idx = stack->sp + offset;
+
+    if(idx > stack->bp && idx <= stack->sp)
+        return stack->data[idx];
+
+    ssfatal("Runtime Error: surgescript_stack_peek_top() can't read an element (%d) that is out of bounds [%d, %d]", idx, stack->bp + 1, stack->sp);
+    return NULL;
+}
+
 /*
  * surgescript_stack_poke()
  * Writes data on stack[base+offset]
@@ -242,4 +257,14 @@ void surgescript_stack_scan_objects(surgescript_stack_t* stack, void* userdata,
 size_t surgescript_stack_size(const surgescript_stack_t* stack)
 {
     return stack->sp;
+}
+
+/*
+ * surgescript_stack_envsize()
+ * The number of variables of the topmost environment
+ * (i.e., the ones after the previous BP)
+ */
+size_t surgescript_stack_envsize(const surgescript_stack_t* stack)
+{
+    return stack->sp - stack->bp;
 }
\ No newline at end of file
@@ -44,9 +44,11 @@ void surgescript_stack_pushn(surgescript_stack_t* stack, size_t n); /* pushes n
 void surgescript_stack_popn(surgescript_stack_t* stack, size_t n); /* pops n variables from the stack */
 const struct surgescript_var_t* surgescript_stack_top(const surgescript_stack_t* stack); /* gets the topmost element */
 const struct surgescript_var_t* surgescript_stack_peek(const surgescript_stack_t* stack, surgescript_stackptr_t offset); /* reads stack[base + offset] */
+const struct surgescript_var_t* surgescript_stack_peek_top(const surgescript_stack_t* stack, surgescript_stackptr_t offset); /* reads stack[top + offset], offset <= 0 */
 void surgescript_stack_poke(surgescript_stack_t* stack, surgescript_stackptr_t offset, const struct surgescript_var_t* data); /* writes data on stack[base + offset] */
 int surgescript_stack_empty(const surgescript_stack_t* stack); /* is the stack empty? */
 void surgescript_stack_scan_objects(surgescript_stack_t* stack, void* userdata, bool (*callback)(unsigned,void*));
 size_t surgescript_stack_size(const surgescript_stack_t* stack); /* stack size */
+size_t surgescript_stack_envsize(const surgescript_stack_t* stack); /* number of variables of the topmost environment */
 
 #endif
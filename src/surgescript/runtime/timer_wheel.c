@@ -0,0 +1,402 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/timer_wheel.c
+ * SurgeScript timer wheel: a hierarchical timer wheel keyed on the VM time
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "timer_wheel.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+/*
+ * The wheel has a few levels of slots. A slot of level l holds the timers
+ * that expire within a block of 64^l ms; the level of a timer is given by
+ * how far in the future it expires. When the time crosses the boundary of
+ * a block, the timers of the block are moved to the lower levels (cascade).
+ * Adding & cancelling timers takes constant time, and so does advancing
+ * the time by one ms, regardless of the number of pending timers
+ */
+#define SLOT_BITS               6
+#define SLOT_COUNT              (1 << SLOT_BITS)
+#define SLOT_MASK               (SLOT_COUNT - 1)
+#define LEVEL_COUNT             4
+#define WHEEL_SPAN              (UINT64_C(1) << (SLOT_BITS * LEVEL_COUNT)) /* about 4.6 hours */
+#define OVERFLOW_LIST           (LEVEL_COUNT * SLOT_COUNT) /* timers that expire beyond the span of the wheel */
+#define OVERDUE_LIST            (OVERFLOW_LIST + 1) /* timers added after their expiration time */
+#define LIST_COUNT              (OVERDUE_LIST + 1)
+#define MAX_TICKS_PER_ADVANCE   4096 /* if the time leaps further, we rebuild the wheel instead */
+
+/* pseudo-lists */
+#define NIL                     (-1) /* the end of a list; also the list of the free timers */
+#define EXPIRED                 (-2) /* expired timers that are about to be fired */
+#define CANCELLED               (-3) /* expired timers that have been cancelled before being fired */
+
+/* timer */
+typedef struct surgescript_timer_t surgescript_timer_t;
+struct surgescript_timer_t
+{
+    uint64_t expires; /* expiration time */
+    unsigned data; /* user data */
+    int list; /* slot of the wheel or pseudo-list the timer belongs to */
+    int prev, next; /* doubly-linked list */
+};
+
+/* timer wheel */
+struct surgescript_timerwheel_t
+{
+    uint64_t now; /* the next tick (ms) to be processed */
+    int head[LIST_COUNT]; /* the lists of timers of the slots */
+    SSARRAY(surgescript_timer_t, timer); /* all timers, indexed by ID */
+    SSARRAY(int, expired); /* expired timers, in chronological order */
+    int free_timer; /* the first timer of the free list */
+    int count; /* number of pending timers */
+};
+
+/* helper for rebuilding the wheel */
+typedef struct surgescript_pendingtimer_t surgescript_pendingtimer_t;
+struct surgescript_pendingtimer_t
+{
+    uint64_t expires;
+    int id;
+};
+
+/* private */
+static int new_timer(surgescript_timerwheel_t* wheel);
+static void link_timer(surgescript_timerwheel_t* wheel, int id, int list);
+static void unlink_timer(surgescript_timerwheel_t* wheel, int id);
+static void free_timer(surgescript_timerwheel_t* wheel, int id);
+static void insert_timer(surgescript_timerwheel_t* wheel, int id);
+static void cascade(surgescript_timerwheel_t* wheel, int list);
+static void process_tick(surgescript_timerwheel_t* wheel);
+static void collect_expired_timers(surgescript_timerwheel_t* wheel, int list);
+static void rebuild(surgescript_timerwheel_t* wheel, uint64_t now);
+static int compare_pending_timers(const void* a, const void* b);
+
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_timerwheel_create()
+ * Creates an empty timer wheel. Times are measured in ms
+ */
+surgescript_timerwheel_t* surgescript_timerwheel_create(uint64_t now)
+{
+    surgescript_timerwheel_t* wheel = ssmalloc(sizeof *wheel);
+
+    wheel->now = now;
+    for(int i = 0; i < LIST_COUNT; i++)
+        wheel->head[i] = NIL;
+
+    ssarray_init(wheel->timer);
+    ssarray_init(wheel->expired);
+    wheel->free_timer = NIL;
+    wheel->count = 0;
+
+    return wheel;
+}
+
+/*
+ * surgescript_timerwheel_destroy()
+ * Destroys a timer wheel
+ */
+surgescript_timerwheel_t* surgescript_timerwheel_destroy(surgescript_timerwheel_t* wheel)
+{
+    ssarray_release(wheel->expired);
+    ssarray_release(wheel->timer);
+    return ssfree(wheel);
+}
+
+/*
+ * surgescript_timerwheel_add()
+ * Adds a timer that expires at the given time, returning its ID. Timers
+ * that expire in the past are fired on the next call to advance()
+ */
+int surgescript_timerwheel_add(surgescript_timerwheel_t* wheel, uint64_t expires, unsigned data)
+{
+    int id = new_timer(wheel);
+
+    wheel->timer[id].expires = expires;
+    wheel->timer[id].data = data;
+    insert_timer(wheel, id);
+    wheel->count++;
+
+    return id;
+}
+
+/*
+ * surgescript_timerwheel_cancel()
+ * Cancels a pending timer. Its ID may be reused afterwards
+ */
+void surgescript_timerwheel_cancel(surgescript_timerwheel_t* wheel, int timer)
+{
+    ssassert(timer >= 0 && timer < ssarray_length(wheel->timer));
+
+    switch(wheel->timer[timer].list) {
+        case NIL:
+        case CANCELLED:
+            return; /* nothing to do */
+
+        case EXPIRED:
+            /* this timer is in the queue of advance(); it will be freed there */
+            wheel->timer[timer].list = CANCELLED;
+            break;
+
+        default:
+            unlink_timer(wheel, timer);
+            free_timer(wheel, timer);
+            break;
+    }
+
+    wheel->count--;
+}
+
+/*
+ * surgescript_timerwheel_count()
+ * The number of pending timers
+ */
+int surgescript_timerwheel_count(const surgescript_timerwheel_t* wheel)
+{
+    return wheel->count;
+}
+
+/*
+ * surgescript_timerwheel_advance()
+ * Advances the time of the wheel up to now (inclusive), firing the timers
+ * that have expired in chronological order. The callback receives the ID
+ * of the timer, its user data and the userdata parameter. It may add and
+ * cancel timers; the ones that expire up to now are fired on the next call
+ */
+void surgescript_timerwheel_advance(surgescript_timerwheel_t* wheel, uint64_t now, void* userdata, void (*callback)(int,unsigned,void*))
+{
+    /* collect the expired timers. If the time has gone
+       backwards (snapshots) or leaped forward, rebuild the wheel */
+    if(wheel->count == 0) {
+        wheel->now = now + 1;
+        return;
+    }
+    else if(now + 1 < wheel->now || (now >= wheel->now && now - wheel->now >= MAX_TICKS_PER_ADVANCE))
+        rebuild(wheel, now);
+
+    collect_expired_timers(wheel, OVERDUE_LIST);
+    while(wheel->now <= now)
+        process_tick(wheel);
+
+    /* the overdue timers come first; the list is almost sorted */
+    for(int i = 1; i < ssarray_length(wheel->expired); i++) {
+        int id = wheel->expired[i], j = i;
+        uint64_t expires = wheel->timer[id].expires;
+
+        for(; j > 0 && wheel->timer[wheel->expired[j-1]].expires > expires; j--)
+            wheel->expired[j] = wheel->expired[j-1];
+
+        wheel->expired[j] = id;
+    }
+
+    /* fire the expired timers. Their IDs are freed before the
+       callbacks run, as these may add new timers */
+    for(int i = 0; i < ssarray_length(wheel->expired); i++) {
+        int id = wheel->expired[i];
+        unsigned data = wheel->timer[id].data;
+        bool cancelled = (wheel->timer[id].list == CANCELLED);
+
+        free_timer(wheel, id);
+        if(!cancelled) {
+            wheel->count--;
+            callback(id, data, userdata);
+        }
+    }
+
+    ssarray_reset(wheel->expired);
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+/* allocates a timer */
+int new_timer(surgescript_timerwheel_t* wheel)
+{
+    surgescript_timer_t timer = { 0, 0, NIL, NIL, NIL };
+    int id = wheel->free_timer;
+
+    if(id == NIL) {
+        id = ssarray_length(wheel->timer);
+        ssarray_push(wheel->timer, timer);
+    }
+    else
+        wheel->free_timer = wheel->timer[id].next;
+
+    return id;
+}
+
+/* returns a timer to the free list */
+void free_timer(surgescript_timerwheel_t* wheel, int id)
+{
+    wheel->timer[id].list = NIL;
+    wheel->timer[id].next = wheel->free_timer;
+    wheel->free_timer = id;
+}
+
+/* adds a timer to the front of a list */
+void link_timer(surgescript_timerwheel_t* wheel, int id, int list)
+{
+    surgescript_timer_t* timer = &(wheel->timer[id]);
+
+    timer->list = list;
+    timer->prev = NIL;
+    timer->next = wheel->head[list];
+
+    if(timer->next != NIL)
+        wheel->timer[timer->next].prev = id;
+    wheel->head[list] = id;
+}
+
+/* removes a timer from its list */
+void unlink_timer(surgescript_timerwheel_t* wheel, int id)
+{
+    surgescript_timer_t* timer = &(wheel->timer[id]);
+
+    if(timer->prev != NIL)
+        wheel->timer[timer->prev].next = timer->next;
+    else
+        wheel->head[timer->list] = timer->next;
+
+    if(timer->next != NIL)
+        wheel->timer[timer->next].prev = timer->prev;
+
+    timer->list = NIL;
+}
+
+/* places a timer in the appropriate slot, given the current time */
+void insert_timer(surgescript_timerwheel_t* wheel, int id)
+{
+    uint64_t expires = wheel->timer[id].expires;
+    uint64_t delta = 0;
+    int level = 0;
+
+    /* timers that have expired are fired on the next advance() */
+    if(expires < wheel->now) {
+        link_timer(wheel, id, OVERDUE_LIST);
+        return;
+    }
+    delta = expires - wheel->now;
+
+    /* timers that expire beyond the span of the wheel are placed
+       in the overflow list, which is cascaded once in a while */
+    if(delta >= WHEEL_SPAN) {
+        link_timer(wheel, id, OVERFLOW_LIST);
+        return;
+    }
+
+    while(delta >= (UINT64_C(1) << (SLOT_BITS * (level + 1))))
+        level++;
+
+    link_timer(wheel, id, level * SLOT_COUNT + ((expires >> (SLOT_BITS * level)) & SLOT_MASK));
+}
+
+/* moves the timers of a list to the lower levels of the wheel */
+void cascade(surgescript_timerwheel_t* wheel, int list)
+{
+    int id = wheel->head[list];
+
+    wheel->head[list] = NIL;
+    while(id != NIL) {
+        int next = wheel->timer[id].next;
+        insert_timer(wheel, id);
+        id = next;
+    }
+}
+
+/* processes the current tick, collecting the timers that expire on it */
+void process_tick(surgescript_timerwheel_t* wheel)
+{
+    uint64_t now = wheel->now;
+    int slot = now & SLOT_MASK;
+
+    /* cascade the blocks of the upper levels that begin at this tick */
+    for(int level = 1; level <= LEVEL_COUNT; level++) {
+        if(((now >> (SLOT_BITS * (level - 1))) & SLOT_MASK) != 0)
+            break;
+        else if(level == LEVEL_COUNT)
+            cascade(wheel, OVERFLOW_LIST);
+        else
+            cascade(wheel, level * SLOT_COUNT + ((now >> (SLOT_BITS * level)) & SLOT_MASK));
+    }
+
+    /* the timers of the current slot of the lowest level have expired */
+    collect_expired_timers(wheel, slot);
+    wheel->now = now + 1;
+}
+
+/* moves the timers of a list to the queue of expired timers */
+void collect_expired_timers(surgescript_timerwheel_t* wheel, int list)
+{
+    int id;
+
+    while((id = wheel->head[list]) != NIL) {
+        unlink_timer(wheel, id);
+        wheel->timer[id].list = EXPIRED;
+        ssarray_push(wheel->expired, id);
+    }
+}
+
+/* places all pending timers again in the wheel, given a new current time */
+void rebuild(surgescript_timerwheel_t* wheel, uint64_t now)
+{
+    SSARRAY(surgescript_pendingtimer_t, pending);
+    ssarray_init_ex(pending, wheel->count);
+
+    /* collect the pending timers */
+    for(int list = 0; list < LIST_COUNT; list++) {
+        for(int id = wheel->head[list]; id != NIL; id = wheel->timer[id].next) {
+            surgescript_pendingtimer_t p = { wheel->timer[id].expires, id };
+            ssarray_push(pending, p);
+        }
+        wheel->head[list] = NIL;
+    }
+
+    /* place them in reverse chronological order. Timers are added
+       to the front of the lists, so the ones that have expired will
+       be fired in chronological order */
+    qsort(pending, ssarray_length(pending), sizeof *pending, compare_pending_timers);
+
+    wheel->now = now;
+    for(int i = ssarray_length(pending) - 1; i >= 0; i--)
+        insert_timer(wheel, pending[i].id);
+
+    ssarray_release(pending);
+}
+
+/* compares pending timers by expiration time (and ID, for a stable order) */
+int compare_pending_timers(const void* a, const void* b)
+{
+    const surgescript_pendingtimer_t* p = (const surgescript_pendingtimer_t*)a;
+    const surgescript_pendingtimer_t* q = (const surgescript_pendingtimer_t*)b;
+
+    if(p->expires != q->expires)
+        return p->expires < q->expires ? -1 : 1;
+    else
+        return p->id - q->id;
+}
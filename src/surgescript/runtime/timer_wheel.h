@@ -0,0 +1,41 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/timer_wheel.h
+ * SurgeScript timer wheel: a hierarchical timer wheel keyed on the VM time
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_TIMER_WHEEL_H
+#define _SURGESCRIPT_RUNTIME_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+typedef struct surgescript_timerwheel_t surgescript_timerwheel_t;
+
+/* create & destroy */
+surgescript_timerwheel_t* surgescript_timerwheel_create(uint64_t now); /* creates an empty timer wheel; times are measured in ms */
+surgescript_timerwheel_t* surgescript_timerwheel_destroy(surgescript_timerwheel_t* wheel); /* destroys a timer wheel */
+
+/* timers */
+int surgescript_timerwheel_add(surgescript_timerwheel_t* wheel, uint64_t expires, unsigned data); /* adds a timer that expires at the given time, returning its ID */
+void surgescript_timerwheel_cancel(surgescript_timerwheel_t* wheel, int timer); /* cancels a pending timer; its ID may be reused */
+int surgescript_timerwheel_count(const surgescript_timerwheel_t* wheel); /* the number of pending timers */
+
+/* advance the time, firing the expired timers in chronological order */
+void surgescript_timerwheel_advance(surgescript_timerwheel_t* wheel, uint64_t now, void* userdata, void (*callback)(int,unsigned,void*));
+
+#endif
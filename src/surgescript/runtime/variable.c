@@ -31,7 +31,9 @@
 #include "object.h"
 #include "object_manager.h"
 #include "managed_string.h"
+#include "snapshot.h"
 #include "../util/util.h"
+#include "../util/thread.h"
 #include "../third_party/utf8.h"
 
 
@@ -100,6 +102,7 @@ static surgescript_varpool_t* new_varpool(surgescript_varpool_t* next);
 static surgescript_varpool_t* delete_varpools(surgescript_varpool_t* head);
 static surgescript_varpool_t* varpool = NULL;
 static surgescript_varbucket_t* varpool_currbucket = NULL;
+static surgescript_mutex_t varpool_mutex; /* taken only while objects are updated in parallel */
 
 /* helpers */
 #define FIRST_BUCKET(pool) (&((pool)->bucket[0])) /* the first bucket of a pool */
@@ -519,6 +522,15 @@ const char* surgescript_var_fast_get_string(const surgescript_var_t* var)
     return var->type == SSVAR_STRING ? surgescript_managedstring_data(var->managed_string) : "";
 }
 
+/*
+ * surgescript_var_fast_get_number()
+ * gets the numeric value of var without performing any type conversion
+ */
+double surgescript_var_fast_get_number(const surgescript_var_t* var)
+{
+    return var->type == SSVAR_NUMBER ? var->number : 0.0;
+}
+
 /*
  * surgescript_var_compare()
  * Compares a to b. Returns:
@@ -636,6 +648,69 @@ size_t surgescript_var_size(const surgescript_var_t* var)
     return sizeof(surgescript_var_t);
 }
 
+/*
+ * surgescript_var_snapshot()
+ * Writes var to a snapshot
+ */
+void surgescript_var_snapshot(const surgescript_var_t* var, surgescript_snapshot_t* snapshot)
+{
+    surgescript_snapshot_write_byte(snapshot, var->type);
+
+    switch(var->type) {
+        case SSVAR_NULL:
+            break;
+        case SSVAR_BOOL:
+            surgescript_snapshot_write_byte(snapshot, var->boolean);
+            break;
+        case SSVAR_NUMBER:
+            surgescript_snapshot_write_double(snapshot, var->number);
+            break;
+        case SSVAR_STRING:
+            surgescript_snapshot_write_string(snapshot, surgescript_managedstring_data(var->managed_string));
+            break;
+        case SSVAR_OBJECTHANDLE:
+            surgescript_snapshot_write_uint(snapshot, var->handle);
+            break;
+        case SSVAR_RAW:
+            surgescript_snapshot_write_int(snapshot, var->raw);
+            break;
+    }
+}
+
+/*
+ * surgescript_var_restore()
+ * Reads var from a snapshot
+ */
+void surgescript_var_restore(surgescript_var_t* var, surgescript_snapshot_t* snapshot)
+{
+    switch(surgescript_snapshot_read_byte(snapshot)) {
+        case SSVAR_NULL:
+            surgescript_var_set_null(var);
+            break;
+        case SSVAR_BOOL:
+            surgescript_var_set_bool(var, surgescript_snapshot_read_byte(snapshot) != 0);
+            break;
+        case SSVAR_NUMBER:
+            surgescript_var_set_number(var, surgescript_snapshot_read_double(snapshot));
+            break;
+        case SSVAR_STRING: {
+            char* string = surgescript_snapshot_read_string(snapshot);
+            surgescript_var_set_string(var, string);
+            ssfree(string);
+            break;
+        }
+        case SSVAR_OBJECTHANDLE:
+            surgescript_var_set_objecthandle(var, surgescript_snapshot_read_uint(snapshot));
+            break;
+        case SSVAR_RAW:
+            surgescript_var_set_rawbits(var, surgescript_snapshot_read_int(snapshot));
+            break;
+        default:
+            ssfatal("surgescript_var_restore(): corrupted snapshot.");
+            break;
+    }
+}
+
 
 
 
@@ -649,6 +724,7 @@ size_t surgescript_var_size(const surgescript_var_t* var)
 void surgescript_var_init_pool()
 {
     if(varpool == NULL) {
+        ssmutex_init(&varpool_mutex);
         varpool = new_varpool(NULL);
         varpool_currbucket = FIRST_BUCKET(varpool);
     }
@@ -663,6 +739,7 @@ void surgescript_var_release_pool()
     if(varpool != NULL) {
         varpool_currbucket = NULL;
         varpool = delete_varpools(varpool);
+        ssmutex_destroy(&varpool_mutex);
     }
 }
 
@@ -747,6 +824,10 @@ surgescript_varpool_t* delete_varpools(surgescript_varpool_t* head)
 /* Allocates a bucket (must be fast) */
 surgescript_varbucket_t* allocate_bucket()
 {
+    bool concurrent = ssconcurrent_any(); /* the pool is shared by all VMs */
+    if(concurrent)
+        ssmutex_lock(&varpool_mutex);
+
     surgescript_varbucket_t* bucket = varpool_currbucket;
 
     /* consistency check */
@@ -760,6 +841,9 @@ surgescript_varbucket_t* allocate_bucket()
     varpool_currbucket = bucket->next;
     bucket->in_use = true;
 
+    if(concurrent)
+        ssmutex_unlock(&varpool_mutex);
+
     /* done! */
     return bucket;
 }
@@ -771,7 +855,14 @@ void free_bucket(surgescript_varbucket_t* bucket)
     /*ssassert(bucket->in_use);*/
 
     /* put the bucket back in the pool */
+    bool concurrent = ssconcurrent_any();
+    if(concurrent)
+        ssmutex_lock(&varpool_mutex);
+
     bucket->in_use = false;
     bucket->next = varpool_currbucket;
     varpool_currbucket = bucket;
+
+    if(concurrent)
+        ssmutex_unlock(&varpool_mutex);
 }
\ No newline at end of file
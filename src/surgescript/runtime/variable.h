@@ -31,6 +31,7 @@ typedef struct surgescript_var_t surgescript_var_t;
 
 /* misc */
 struct surgescript_objectmanager_t;
+struct surgescript_snapshot_t;
 
 
 
@@ -71,9 +72,12 @@ surgescript_var_t* surgescript_var_copy(surgescript_var_t* dst, const surgescrip
 surgescript_var_t* surgescript_var_clone(const surgescript_var_t* var); /* similar to strdup */
 char* surgescript_var_to_string(const surgescript_var_t* var, char* buf, size_t bufsize); /* copies var to buf and returns buf, converting var to string if necessary (similar to itoa / strncpy) */
 const char* surgescript_var_fast_get_string(const surgescript_var_t* var); /* gets the string contents of var without performing any type conversion */
+double surgescript_var_fast_get_number(const surgescript_var_t* var); /* gets the numeric value of var without performing any type conversion */
 int surgescript_var_compare(const surgescript_var_t* a, const surgescript_var_t* b); /* similar to strcmp */
 void surgescript_var_swap(surgescript_var_t* a, surgescript_var_t* b); /* swaps a <-> b */
 size_t surgescript_var_size(const surgescript_var_t* var); /* used memory in user space, in bytes */
+void surgescript_var_snapshot(const surgescript_var_t* var, struct surgescript_snapshot_t* snapshot); /* writes var to a snapshot */
+void surgescript_var_restore(surgescript_var_t* var, struct surgescript_snapshot_t* snapshot); /* reads var from a snapshot */
 
 /* var pooling */
 void surgescript_var_init_pool();
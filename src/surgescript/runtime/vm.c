@@ -29,10 +29,14 @@
 #include "tag_system.h"
 #include "object_manager.h"
 #include "vm_time.h"
+#include "vm_console.h"
 #include "managed_string.h"
+#include "snapshot.h"
 #include "sslib/sslib.h"
 #include "../compiler/parser.h"
 #include "../util/util.h"
+#include "../util/ssarray.h"
+#include "../util/thread.h"
 
 
 /* auxiliary data structure */
@@ -45,6 +49,42 @@ struct surgescript_vm_updater_t {
     void (*late_update)(surgescript_object_t*,void*); /* runs immediately after surgescript_object_update() */
 };
 
+/* the update list is the object tree flattened in pre-order */
+typedef struct surgescript_vm_updatelistentry_t surgescript_vm_updatelistentry_t;
+struct surgescript_vm_updatelistentry_t {
+    surgescript_object_t* object; /* the object to be updated */
+    int size; /* size of the subtree rooted at this object (skip size) */
+    int parent; /* index of the parent of this object in the update list; -1 if root */
+    int child_index; /* index of this object in the list of children of its parent */
+};
+
+/* parallel updates */
+typedef struct surgescript_vm_scheduler_t surgescript_vm_scheduler_t;
+struct surgescript_vm_scheduler_t {
+    /* isolated subtrees are deferred during the serial traversal
+       of the object tree and then updated in parallel */
+    surgescript_vm_t* vm;
+    surgescript_vm_updater_t* updater;
+    bool (*callback)(surgescript_object_t*,void*);
+};
+
+/* hot reloading */
+typedef struct surgescript_vm_fieldlayout_t surgescript_vm_fieldlayout_t;
+struct surgescript_vm_fieldlayout_t {
+    char* object_name; /* class of objects */
+    char** field; /* names of the fields indexed by heap address; NULL if there is no field at an address */
+    int field_count; /* length of field[] */
+    uint64_t fingerprint; /* hash of the code of the class */
+    bool replaced; /* was the code of the class replaced? */
+};
+
+typedef struct surgescript_vm_reloader_t surgescript_vm_reloader_t;
+struct surgescript_vm_reloader_t {
+    surgescript_vm_t* vm;
+    surgescript_parser_flags_t flags; /* flags of the parser before reloading */
+    SSARRAY(surgescript_vm_fieldlayout_t, layout); /* layouts of the fields before reloading */
+};
+
 /* VM command-line arguments */
 typedef struct surgescript_vmargs_t surgescript_vmargs_t;
 struct surgescript_vmargs_t {
@@ -66,7 +106,17 @@ struct surgescript_vm_t
     surgescript_parser_t* parser;
     surgescript_vmargs_t* args;
     surgescript_vmtime_t* time;
+    surgescript_vmconsole_t* console; /* output of the Console; it persists across resets */
     bool is_paused;
+
+    int worker_count; /* number of worker threads used to update isolated subtrees */
+    surgescript_threadpool_t* workers; /* worker threads (may be NULL) */
+    SSARRAY(surgescript_objecthandle_t, isolated); /* isolated subtrees to be updated in parallel */
+    bool labels_resolved; /* have all programs been prepared for parallel execution? */
+
+    SSARRAY(surgescript_vm_updatelistentry_t, update_list); /* flattened object tree */
+    unsigned update_list_version; /* version of the object tree when the update list was built */
+    bool has_update_list; /* is the update list built? */
 };
 
 /* misc */
@@ -75,7 +125,34 @@ static void release_vm(surgescript_vm_t* vm);
 static bool call_updater1(surgescript_object_t* object, void* updater);
 static bool call_updater2(surgescript_object_t* object, void* updater);
 static bool call_updater3(surgescript_object_t* object, void* updater);
+static bool call_updater0(surgescript_object_t* object, void* updater);
 static void install_plugin(const char* object_name, void* data);
+static void isolate_class(const char* object_name, void* data);
+static void update_in_parallel(surgescript_vm_t* vm, surgescript_vm_updater_t* updater, bool (*callback)(surgescript_object_t*,void*));
+static bool defer_isolated(surgescript_object_t* object, void* scheduler);
+static void update_isolated(int index, void* scheduler);
+static void* init_worker(void* data);
+static void release_worker(void* context);
+static void resolve_labels(const char* object_name, void* data);
+static void resolve_labels_of_program(const char* program_name, void* data);
+static void traverse_update_list(surgescript_vm_t* vm, void* data, bool (*callback)(surgescript_object_t*,void*));
+static void resume_traversal(surgescript_vm_t* vm, int index, bool visit_children, void* data, bool (*callback)(surgescript_object_t*,void*));
+static void rebuild_update_list(surgescript_vm_t* vm);
+static int flatten_tree(surgescript_vm_t* vm, surgescript_object_t* object, int parent, int child_index);
+static bool begin_reload(surgescript_vm_t* vm, surgescript_vm_reloader_t* reloader);
+static void end_reload(surgescript_vm_reloader_t* reloader);
+static void save_layout(const char* object_name, void* reloader);
+static void invalidate_caches(const char* object_name, void* data);
+static void invalidate_caches_of_program(const char* program_name, void* data);
+static bool reload_object(surgescript_object_t* object, void* reloader);
+
+/* object & program methods acessible by me */
+extern void surgescript_object_bind_thread_stack(surgescript_stack_t* stack);
+extern void surgescript_program_resolve_labels(surgescript_program_t* program);
+extern void surgescript_objectmanager_snapshot(const surgescript_objectmanager_t* manager, surgescript_snapshot_t* snapshot);
+extern bool surgescript_objectmanager_restore(surgescript_objectmanager_t* manager, surgescript_snapshot_t* snapshot);
+extern void surgescript_program_invalidate_caches(surgescript_program_t* program);
+extern void surgescript_object_reload(surgescript_object_t* object, char* const* old_field, int old_field_count, bool replaced);
 
 
 /*
@@ -97,6 +174,12 @@ surgescript_vm_t* surgescript_vm_create()
     surgescript_managedstring_init_pool();
     surgescript_var_init_pool();
 
+    /* no worker threads by default */
+    vm->worker_count = 0;
+
+    /* the Console writes to stdout by default */
+    vm->console = surgescript_vmconsole_create();
+
     /* set up the VM */
     sslog("Creating the VM...");
     init_vm(vm);
@@ -113,6 +196,7 @@ surgescript_vm_t* surgescript_vm_destroy(surgescript_vm_t* vm)
 {
     sslog("Shutting down the VM...");
     release_vm(vm);
+    surgescript_vmconsole_destroy(vm->console); /* flush the output */
 
     sslog("Releasing the pools...");
     surgescript_var_release_pool();
@@ -242,6 +326,9 @@ void surgescript_vm_launch_ex(surgescript_vm_t* vm, int argc, char** argv)
     /* Generate class IDs */
     surgescript_objectmanager_generate_class_ids(vm->object_manager);
 
+    /* Isolate classes (parallel updates) */
+    surgescript_parser_foreach_isolated(vm->parser, vm, isolate_class);
+
     /* Create the root object */
     surgescript_objectmanager_spawn_root(vm->object_manager);
 }
@@ -273,21 +360,36 @@ bool surgescript_vm_update(surgescript_vm_t* vm)
 bool surgescript_vm_update_ex(surgescript_vm_t* vm, void* user_data, void (*user_update)(surgescript_object_t*,void*), void (*late_update)(surgescript_object_t*,void*))
 {
     if(surgescript_vm_is_active(vm) && !vm->is_paused) {
-        surgescript_object_t* root = surgescript_vm_root_object(vm);
         surgescript_vm_updater_t updater = { user_data, user_update, late_update };
 
         /* update time */
         surgescript_vmtime_update(vm->time);
 
+        /* wake up the objects whose time has come */
+        surgescript_objectmanager_run_timers(vm->object_manager);
+
         /* update */
-        if(user_update != NULL && late_update != NULL)
-            surgescript_object_traverse_tree_ex(root, &updater, call_updater3);
+        if(vm->workers != NULL && surgescript_threadpool_size(vm->workers) > 0) {
+            if(user_update != NULL && late_update != NULL)
+                update_in_parallel(vm, &updater, call_updater3);
+            else if(late_update != NULL)
+                update_in_parallel(vm, &updater, call_updater2);
+            else if(user_update != NULL)
+                update_in_parallel(vm, &updater, call_updater1);
+            else
+                update_in_parallel(vm, &updater, call_updater0);
+        }
+        else if(user_update != NULL && late_update != NULL)
+            traverse_update_list(vm, &updater, call_updater3);
         else if(late_update != NULL)
-            surgescript_object_traverse_tree_ex(root, &updater, call_updater2);
+            traverse_update_list(vm, &updater, call_updater2);
         else if(user_update != NULL)
-            surgescript_object_traverse_tree_ex(root, &updater, call_updater1);
+            traverse_update_list(vm, &updater, call_updater1);
         else
-            surgescript_object_traverse_tree(root, surgescript_object_update);
+            traverse_update_list(vm, &updater, call_updater0);
+
+        /* flush the output of the Console at the end of the frame */
+        surgescript_vmconsole_flush(vm->console);
 
         /* done! */
         return surgescript_vm_is_active(vm);
@@ -347,6 +449,70 @@ bool surgescript_vm_is_paused(const surgescript_vm_t* vm)
     return vm->is_paused;
 }
 
+/*
+ * surgescript_vm_set_worker_count()
+ * Sets the number of worker threads used to update isolated subtrees of the
+ * object tree in parallel. Zero (the default) disables parallel updates.
+ * Don't call this while the VM is being updated.
+ */
+void surgescript_vm_set_worker_count(surgescript_vm_t* vm, int worker_count)
+{
+    worker_count = ssmax(0, worker_count);
+
+    /* nothing to do */
+    if(worker_count == vm->worker_count)
+        return;
+
+    /* recreate the worker threads */
+    if(vm->workers != NULL)
+        vm->workers = surgescript_threadpool_destroy(vm->workers);
+
+    vm->worker_count = worker_count;
+    if(worker_count > 0)
+        vm->workers = surgescript_threadpool_create(worker_count, NULL, init_worker, release_worker);
+}
+
+/*
+ * surgescript_vm_worker_count()
+ * The number of worker threads used to update isolated subtrees of the object tree
+ */
+int surgescript_vm_worker_count(const surgescript_vm_t* vm)
+{
+    return vm->workers != NULL ? surgescript_threadpool_size(vm->workers) : 0;
+}
+
+/*
+ * surgescript_vm_set_console_output()
+ * Redirects the output of the Console to a callback. The callback receives
+ * text that is not NULL-terminated. Pass NULL to restore the default output
+ * (stdout). Buffered output is flushed before the output is changed.
+ */
+void surgescript_vm_set_console_output(surgescript_vm_t* vm, void (*output)(const char*,size_t,void*), void* user_data)
+{
+    surgescript_vmconsole_set_output(vm->console, output, user_data);
+}
+
+/*
+ * surgescript_vm_set_console_flush_threshold()
+ * The output of the Console is buffered and flushed whenever the given number
+ * of lines is buffered, at the end of each update cycle, before reading from
+ * the Console, before errors are reported and when the VM is destroyed.
+ * A threshold of zero flushes the output on every write.
+ */
+void surgescript_vm_set_console_flush_threshold(surgescript_vm_t* vm, int lines)
+{
+    surgescript_vmconsole_set_flush_threshold(vm->console, lines);
+}
+
+/*
+ * surgescript_vm_flush_console()
+ * Flushes the buffered output of the Console
+ */
+void surgescript_vm_flush_console(surgescript_vm_t* vm)
+{
+    surgescript_vmconsole_flush(vm->console);
+}
+
 /*
  * surgescript_vm_programpool()
  * Gets the program pool
@@ -443,6 +609,127 @@ void surgescript_vm_bind(surgescript_vm_t* vm, const char* object_name, const ch
     surgescript_programpool_replace(vm->program_pool, object_name, fun_name, cprogram);
 }
 
+/*
+ * surgescript_vm_bind_aot()
+ * Binds ahead-of-time compiled code (see compiler/aot.h) to a function
+ * of an object that has been compiled from the same SurgeScript code.
+ * If the code has changed, the function will be interpreted instead.
+ */
+bool surgescript_vm_bind_aot(surgescript_vm_t* vm, const char* object_name, const char* fun_name, surgescript_program_aotfunction_t aot, uint64_t fingerprint)
+{
+    surgescript_program_t* program = NULL;
+
+    if(surgescript_programpool_shallowcheck(vm->program_pool, object_name, fun_name))
+        program = surgescript_programpool_get(vm->program_pool, object_name, fun_name);
+
+    if(program == NULL || !surgescript_program_bind_aot(program, aot, fingerprint)) {
+        sslog("Can't bind AOT-compiled code to %s.%s(): the code doesn't match", object_name, fun_name);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * surgescript_vm_snapshot()
+ * Takes a snapshot of the runtime state of the VM: the objects, their heaps,
+ * the state of the garbage collector and the VM time. Returns a binary image
+ * that must be freed with ssfree(); its size is written to *size. Call this
+ * between update cycles. Returns NULL if the VM isn't active
+ */
+void* surgescript_vm_snapshot(surgescript_vm_t* vm, size_t* size)
+{
+    surgescript_snapshot_t* snapshot;
+
+    if(!surgescript_vm_is_active(vm) || !surgescript_stack_empty(vm->stack)) {
+        sslog("Can't take a snapshot of the VM: it's %s", surgescript_vm_is_active(vm) ? "busy" : "inactive");
+        if(size != NULL)
+            *size = 0;
+        return NULL;
+    }
+
+    snapshot = surgescript_snapshot_create();
+    surgescript_objectmanager_snapshot(vm->object_manager, snapshot);
+    surgescript_vmtime_snapshot(vm->time, snapshot);
+
+    return surgescript_snapshot_release(snapshot, size);
+}
+
+/*
+ * surgescript_vm_restore()
+ * Restores a snapshot taken with surgescript_vm_snapshot() in a VM that has
+ * compiled the same scripts. Object handles are preserved. Constructors and
+ * destructors are not called. Call this between update cycles. Returns true
+ * on success; if the snapshot is corrupted or doesn't match the VM, nothing
+ * is changed
+ */
+bool surgescript_vm_restore(surgescript_vm_t* vm, const void* data, size_t size)
+{
+    surgescript_snapshot_t* snapshot;
+    bool success;
+
+    if(!surgescript_vm_is_active(vm) || !surgescript_stack_empty(vm->stack)) {
+        sslog("Can't restore a snapshot of the VM: it's %s", surgescript_vm_is_active(vm) ? "busy" : "inactive");
+        return false;
+    }
+    else if(NULL == (snapshot = surgescript_snapshot_open(data, size))) {
+        sslog("Can't restore a snapshot of the VM: invalid data");
+        return false;
+    }
+
+    if((success = surgescript_objectmanager_restore(vm->object_manager, snapshot))) {
+        surgescript_vmtime_restore(vm->time, snapshot);
+        if(surgescript_snapshot_is_corrupted(snapshot) || !surgescript_snapshot_eof(snapshot))
+            ssfatal("Can't restore a snapshot of the VM: the data is corrupted");
+        vm->has_update_list = false;
+    }
+
+    surgescript_snapshot_destroy(snapshot);
+    return success;
+}
+
+/*
+ * surgescript_vm_reload()
+ * Compiles a file again, given its absolute filepath, replacing the code of
+ * the objects defined in it. Existing objects keep their state and the values
+ * of their fields; new fields are initialized if their values are constant.
+ * Constructors are not called again. Objects that don't exist in the VM can't
+ * be added to it while it's running. Call this between update cycles.
+ * Returns true on success; false otherwise
+ */
+bool surgescript_vm_reload(surgescript_vm_t* vm, const char* absolute_path)
+{
+    surgescript_vm_reloader_t reloader;
+    bool success;
+
+    if(!begin_reload(vm, &reloader))
+        return false;
+
+    success = surgescript_vm_compile(vm, absolute_path);
+    end_reload(&reloader);
+
+    return success;
+}
+
+/*
+ * surgescript_vm_reload_virtual_file()
+ * Same as surgescript_vm_reload(), but the code is stored in memory
+ * Returns true on success; false otherwise
+ */
+bool surgescript_vm_reload_virtual_file(surgescript_vm_t* vm, const char* code, const char* filename)
+{
+    surgescript_vm_reloader_t reloader;
+    bool success;
+
+    if(!begin_reload(vm, &reloader))
+        return false;
+
+    success = surgescript_vm_compile_virtual_file(vm, code, filename);
+    end_reload(&reloader);
+
+    return success;
+}
+
 /*
  * surgescript_vm_install_plugin()
  * Sets a certain object as a plugin. Call before launching the VM.
@@ -459,6 +746,7 @@ void surgescript_vm_install_plugin(surgescript_vm_t* vm, const char* object_name
 void init_vm(surgescript_vm_t* vm)
 {
     vm->is_paused = false;
+    vm->labels_resolved = false;
 
     /* create the VM components */
     vm->stack = surgescript_stack_create();
@@ -466,9 +754,20 @@ void init_vm(surgescript_vm_t* vm)
     vm->tag_system = surgescript_tagsystem_create();
     vm->args = surgescript_vmargs_create();
     vm->time = surgescript_vmtime_create();
-    vm->object_manager = surgescript_objectmanager_create(vm->program_pool, vm->tag_system, vm->stack, vm->args, vm->time);
+    vm->object_manager = surgescript_objectmanager_create(vm->program_pool, vm->tag_system, vm->stack, vm->args, vm->time, vm->console);
     vm->parser = surgescript_parser_create(vm->program_pool, vm->tag_system);
 
+    /* the update list will be built on the first update */
+    ssarray_init(vm->update_list);
+    vm->update_list_version = 0;
+    vm->has_update_list = false;
+
+    /* create the worker threads */
+    ssarray_init(vm->isolated);
+    vm->workers = NULL;
+    if(vm->worker_count > 0)
+        vm->workers = surgescript_threadpool_create(vm->worker_count, NULL, init_worker, release_worker);
+
     /* load the SurgeScript standard library */
     surgescript_sslib_register_object(vm);
     surgescript_sslib_register_string(vm);
@@ -493,6 +792,12 @@ void init_vm(surgescript_vm_t* vm)
 /* releases the VM */
 void release_vm(surgescript_vm_t* vm)
 {
+    /* destroy the worker threads */
+    if(vm->workers != NULL)
+        vm->workers = surgescript_threadpool_destroy(vm->workers);
+    ssarray_release(vm->isolated);
+    ssarray_release(vm->update_list);
+
     /* destroy the VM components */
     surgescript_parser_destroy(vm->parser);
     surgescript_objectmanager_destroy(vm->object_manager);
@@ -503,10 +808,15 @@ void release_vm(surgescript_vm_t* vm)
     surgescript_stack_destroy(vm->stack);
 }
 
-/* these auxiliary functions help traversing the object tree */
+/* these auxiliary functions help traversing the object tree.
+   Sleeping subtrees are skipped entirely, user callbacks included */
 bool call_updater1(surgescript_object_t* object, void* updater)
 {
     surgescript_vm_updater_t* vm_updater = (surgescript_vm_updater_t*)updater;
+
+    if(surgescript_object_is_sleeping(object))
+        return false;
+
     vm_updater->user_update(object, vm_updater->user_data);
     return surgescript_object_update(object);
 }
@@ -518,6 +828,9 @@ bool call_updater2(surgescript_object_t* object, void* updater)
     surgescript_objecthandle_t handle = surgescript_object_handle(object);
     bool update_children = true;
 
+    if(surgescript_object_is_sleeping(object))
+        return false;
+
     update_children = surgescript_object_update(object);
     if(surgescript_objectmanager_exists(manager, handle) && /* is the object still valid? */
     surgescript_objectmanager_get(manager, handle) == object)
@@ -533,6 +846,9 @@ bool call_updater3(surgescript_object_t* object, void* updater)
     surgescript_objecthandle_t handle = surgescript_object_handle(object);
     bool update_children = true;
 
+    if(surgescript_object_is_sleeping(object))
+        return false;
+
     vm_updater->user_update(object, vm_updater->user_data);
     update_children = surgescript_object_update(object);
     if(surgescript_objectmanager_exists(manager, handle) && /* is the object still valid? */
@@ -542,6 +858,91 @@ bool call_updater3(surgescript_object_t* object, void* updater)
     return update_children;
 }
 
+bool call_updater0(surgescript_object_t* object, void* updater)
+{
+    return surgescript_object_update(object);
+}
+
+/* traverses the object tree using the update list. If the callback returns
+   false, the children of the object are skipped, as in a recursive traversal */
+void traverse_update_list(surgescript_vm_t* vm, void* data, bool (*callback)(surgescript_object_t*,void*))
+{
+    unsigned version = surgescript_objectmanager_tree_version(vm->object_manager);
+
+    /* rebuild the update list only if the object tree has changed */
+    if(!vm->has_update_list || vm->update_list_version != version)
+        rebuild_update_list(vm);
+
+    /* iterate linearly */
+    for(int i = 0, n = ssarray_length(vm->update_list); i < n; ) {
+        bool visit_children = callback(vm->update_list[i].object, data);
+
+        /* the object tree has changed: the update list is no longer valid */
+        if(surgescript_objectmanager_tree_version(vm->object_manager) != version) {
+            resume_traversal(vm, i, visit_children, data, callback);
+            return;
+        }
+
+        /* skip the subtree if necessary */
+        i += visit_children ? 1 : vm->update_list[i].size;
+    }
+}
+
+/* finishes the traversal of the object tree after the index-th entry
+   of the update list, as the recursive traversal would do */
+void resume_traversal(surgescript_vm_t* vm, int index, bool visit_children, void* data, bool (*callback)(surgescript_object_t*,void*))
+{
+    const surgescript_vm_updatelistentry_t* entry = vm->update_list;
+    surgescript_objectmanager_t* manager = vm->object_manager;
+
+    /* traverse the children of the index-th object */
+    if(visit_children) {
+        surgescript_object_t* object = entry[index].object;
+        for(int j = 0; j < surgescript_object_child_count(object); j++) {
+            surgescript_object_t* child = surgescript_objectmanager_get(manager, surgescript_object_nth_child(object, j));
+            surgescript_object_traverse_tree_ex(child, data, callback);
+        }
+    }
+
+    /* traverse the next siblings of the index-th object and of its ascendants */
+    for(int i = index; entry[i].parent >= 0; i = entry[i].parent) {
+        surgescript_object_t* parent = entry[entry[i].parent].object;
+        for(int j = entry[i].child_index + 1; j < surgescript_object_child_count(parent); j++) {
+            surgescript_object_t* child = surgescript_objectmanager_get(manager, surgescript_object_nth_child(parent, j));
+            surgescript_object_traverse_tree_ex(child, data, callback);
+        }
+    }
+}
+
+/* flattens the traversed part of the object tree into the update list */
+void rebuild_update_list(surgescript_vm_t* vm)
+{
+    ssarray_reset(vm->update_list);
+    flatten_tree(vm, surgescript_vm_root_object(vm), -1, 0);
+
+    vm->update_list_version = surgescript_objectmanager_tree_version(vm->object_manager);
+    vm->has_update_list = true;
+}
+
+/* adds a subtree to the update list in pre-order, returning its size.
+   The children of inactive objects are not traversed, so we skip them */
+int flatten_tree(surgescript_vm_t* vm, surgescript_object_t* object, int parent, int child_index)
+{
+    surgescript_vm_updatelistentry_t entry = { object, 1, parent, child_index };
+    int index = ssarray_length(vm->update_list);
+
+    ssarray_push(vm->update_list, entry);
+
+    if(surgescript_object_is_active(object)) {
+        for(int j = 0; j < surgescript_object_child_count(object); j++) {
+            surgescript_object_t* child = surgescript_objectmanager_get(vm->object_manager, surgescript_object_nth_child(object, j));
+            vm->update_list[index].size += flatten_tree(vm, child, index, j);
+        }
+    }
+
+    return vm->update_list[index].size;
+}
+
 /* plugin installer */
 void install_plugin(const char* object_name, void* data)
 {
@@ -549,6 +950,205 @@ void install_plugin(const char* object_name, void* data)
     surgescript_objectmanager_install_plugin(vm->object_manager, object_name);
 }
 
+/* marks a class of objects as isolated */
+void isolate_class(const char* object_name, void* data)
+{
+    surgescript_vm_t* vm = (surgescript_vm_t*)data;
+    surgescript_objectmanager_isolate_class(vm->object_manager, object_name);
+}
+
+/* updates the object tree, running isolated subtrees in parallel */
+void update_in_parallel(surgescript_vm_t* vm, surgescript_vm_updater_t* updater, bool (*callback)(surgescript_object_t*,void*))
+{
+    surgescript_vm_scheduler_t scheduler = { vm, updater, callback };
+
+    /* programs resolve their labels when they first run; do it beforehand */
+    if(!vm->labels_resolved) {
+        surgescript_programpool_foreach_object_ex(vm->program_pool, vm, resolve_labels);
+        vm->labels_resolved = true;
+    }
+
+    /* update the object tree serially, deferring the isolated subtrees */
+    ssarray_reset(vm->isolated);
+    traverse_update_list(vm, &scheduler, defer_isolated);
+
+    /* update the isolated subtrees in parallel. Growing the object
+       table while this happens is costly, so we make room first */
+    if(ssarray_length(vm->isolated) > 0) {
+        surgescript_objectmanager_reserve(vm->object_manager, surgescript_objectmanager_count(vm->object_manager));
+        surgescript_threadpool_run(vm->workers, ssarray_length(vm->isolated), &scheduler, update_isolated);
+        ssarray_reset(vm->isolated);
+    }
+}
+
+/* traversal callback: defers the isolated subtrees */
+bool defer_isolated(surgescript_object_t* object, void* scheduler)
+{
+    surgescript_vm_scheduler_t* s = (surgescript_vm_scheduler_t*)scheduler;
+
+    if(surgescript_object_is_isolated(object) && surgescript_object_is_active(object) && !surgescript_object_is_killed(object)) {
+        ssarray_push(s->vm->isolated, surgescript_object_handle(object));
+        return false; /* don't visit the children now */
+    }
+
+    return s->callback(object, s->updater);
+}
+
+/* job: updates the index-th isolated subtree (runs on any thread) */
+void update_isolated(int index, void* scheduler)
+{
+    surgescript_vm_scheduler_t* s = (surgescript_vm_scheduler_t*)scheduler;
+    surgescript_objectmanager_t* manager = s->vm->object_manager;
+    surgescript_objecthandle_t handle = s->vm->isolated[index];
+
+    /* the object may have been deleted during the serial traversal */
+    if(surgescript_objectmanager_exists(manager, handle)) {
+        surgescript_object_t* object = surgescript_objectmanager_get(manager, handle);
+        if(surgescript_object_is_isolated(object))
+            surgescript_object_traverse_tree_ex(object, s->updater, s->callback);
+    }
+}
+
+/* each worker thread has its own stack */
+void* init_worker(void* data)
+{
+    surgescript_stack_t* stack = surgescript_stack_create();
+    surgescript_object_bind_thread_stack(stack);
+    return stack;
+}
+
+void release_worker(void* context)
+{
+    surgescript_stack_t* stack = (surgescript_stack_t*)context;
+    surgescript_object_bind_thread_stack(NULL);
+    surgescript_stack_destroy(stack);
+}
+
+/* resolves the labels of all programs of an object */
+void resolve_labels(const char* object_name, void* data)
+{
+    surgescript_vm_t* vm = (surgescript_vm_t*)data;
+    const void* args[] = { vm->program_pool, object_name };
+    surgescript_programpool_foreach_ex(vm->program_pool, object_name, (void*)args, resolve_labels_of_program);
+}
+
+void resolve_labels_of_program(const char* program_name, void* data)
+{
+    const void** args = (const void**)data;
+    surgescript_programpool_t* program_pool = (surgescript_programpool_t*)args[0];
+    const char* object_name = (const char*)args[1];
+    surgescript_program_t* program = surgescript_programpool_get(program_pool, object_name, program_name);
+
+    if(program != NULL)
+        surgescript_program_resolve_labels(program);
+}
+
+/* prepares the VM for reloading scripts: duplicate definitions of objects
+   replace the existing ones. Returns false if the VM is busy */
+bool begin_reload(surgescript_vm_t* vm, surgescript_vm_reloader_t* reloader)
+{
+    if(surgescript_vm_is_active(vm) && !surgescript_stack_empty(vm->stack)) {
+        sslog("Can't reload scripts: the VM is busy");
+        return false;
+    }
+
+    reloader->vm = vm;
+    reloader->flags = surgescript_parser_get_flags(vm->parser);
+    ssarray_init(reloader->layout);
+
+    surgescript_programpool_foreach_object_ex(vm->program_pool, reloader, save_layout);
+    surgescript_parser_set_flags(vm->parser, (reloader->flags & ~SSPARSER_SKIP_DUPLICATES) | SSPARSER_RELOAD);
+
+    return true;
+}
+
+/* updates the existing objects after reloading scripts */
+void end_reload(surgescript_vm_reloader_t* reloader)
+{
+    surgescript_vm_t* vm = reloader->vm;
+
+    surgescript_parser_set_flags(vm->parser, reloader->flags);
+
+    /* the inline caches may point to replaced programs */
+    surgescript_programpool_foreach_object_ex(vm->program_pool, vm->program_pool, invalidate_caches);
+    vm->labels_resolved = false;
+
+    /* find the classes with new code */
+    for(int i = 0; i < ssarray_length(reloader->layout); i++) {
+        surgescript_vm_fieldlayout_t* layout = &(reloader->layout[i]);
+        layout->replaced = (layout->fingerprint != surgescript_programpool_fingerprint(vm->program_pool, layout->object_name));
+    }
+
+    /* update the objects */
+    if(surgescript_vm_is_active(vm))
+        surgescript_object_traverse_tree_ex(surgescript_vm_root_object(vm), reloader, reload_object);
+
+    /* release the layouts */
+    for(int i = 0; i < ssarray_length(reloader->layout); i++) {
+        surgescript_vm_fieldlayout_t* layout = &(reloader->layout[i]);
+        for(int j = 0; j < layout->field_count; j++)
+            ssfree(layout->field[j]);
+        ssfree(layout->field);
+        ssfree(layout->object_name);
+    }
+    ssarray_release(reloader->layout);
+}
+
+/* saves the layout of the fields of a class of objects */
+void save_layout(const char* object_name, void* reloader)
+{
+    surgescript_vm_reloader_t* r = (surgescript_vm_reloader_t*)reloader;
+    surgescript_vm_fieldlayout_t layout;
+
+    layout.object_name = ssstrdup(object_name);
+    layout.field_count = surgescript_programpool_field_count(r->vm->program_pool, object_name);
+    layout.field = ssmalloc((1 + layout.field_count) * sizeof(*(layout.field)));
+    layout.fingerprint = surgescript_programpool_fingerprint(r->vm->program_pool, object_name);
+    layout.replaced = false;
+    for(int i = 0; i < layout.field_count; i++) {
+        const char* field = surgescript_programpool_field_name(r->vm->program_pool, object_name, i);
+        layout.field[i] = (field != NULL) ? ssstrdup(field) : NULL;
+    }
+
+    ssarray_push(r->layout, layout);
+}
+
+/* invalidates the inline caches of all programs of an object */
+void invalidate_caches(const char* object_name, void* data)
+{
+    surgescript_programpool_t* program_pool = (surgescript_programpool_t*)data;
+    const void* args[] = { program_pool, object_name };
+    surgescript_programpool_foreach_ex(program_pool, object_name, (void*)args, invalidate_caches_of_program);
+}
+
+void invalidate_caches_of_program(const char* program_name, void* data)
+{
+    const void** args = (const void**)data;
+    surgescript_programpool_t* program_pool = (surgescript_programpool_t*)args[0];
+    const char* object_name = (const char*)args[1];
+    surgescript_program_t* program = surgescript_programpool_get(program_pool, object_name, program_name);
+
+    if(program != NULL && !surgescript_program_is_native(program))
+        surgescript_program_invalidate_caches(program);
+}
+
+/* updates an existing object after reloading scripts */
+bool reload_object(surgescript_object_t* object, void* reloader)
+{
+    surgescript_vm_reloader_t* r = (surgescript_vm_reloader_t*)reloader;
+    const char* object_name = surgescript_object_name(object);
+
+    for(int i = 0; i < ssarray_length(r->layout); i++) {
+        if(strcmp(r->layout[i].object_name, object_name) == 0) {
+            surgescript_object_reload(object, r->layout[i].field, r->layout[i].field_count, r->layout[i].replaced);
+            return true;
+        }
+    }
+
+    surgescript_object_reload(object, NULL, 0, true);
+    return true;
+}
+
 /* VM command-line arguments */
 surgescript_vmargs_t* surgescript_vmargs_create()
 {
@@ -22,6 +22,7 @@
 #ifndef _SURGESCRIPT_RUNTIME_VM_H
 #define _SURGESCRIPT_RUNTIME_VM_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "program.h"
@@ -57,6 +58,39 @@ void surgescript_vm_pause(surgescript_vm_t* vm); /* pause the VM */
 void surgescript_vm_resume(surgescript_vm_t* vm); /* resume a paused VM */
 bool surgescript_vm_is_paused(const surgescript_vm_t* vm); /* is the VM paused? */
 
+/* Parallel updates: the subtrees of objects annotated with @Isolated are
+   updated by worker threads after the rest of the object tree has been
+   updated. Isolated subtrees must not modify objects outside of themselves,
+   and the updater callbacks of surgescript_vm_update_ex() may be called from
+   any thread. Requires a build with multithreading support. */
+void surgescript_vm_set_worker_count(surgescript_vm_t* vm, int worker_count); /* number of worker threads; 0 (default) disables parallel updates */
+int surgescript_vm_worker_count(const surgescript_vm_t* vm); /* number of worker threads in use */
+
+/* Console output: it's buffered and flushed when enough lines are buffered,
+   at the end of each update cycle, before reading from the Console, before
+   errors and log messages are reported, and when the VM is destroyed or the
+   application exits. These settings persist across resets of the VM. */
+void surgescript_vm_set_console_output(surgescript_vm_t* vm, void (*output)(const char*,size_t,void*), void* user_data); /* redirects the output to output(text, length, user_data); NULL (default) means stdout */
+void surgescript_vm_set_console_flush_threshold(surgescript_vm_t* vm, int lines); /* flush whenever this many lines are buffered (default: 64); 0 flushes on every write */
+void surgescript_vm_flush_console(surgescript_vm_t* vm); /* flushes the buffered output */
+
+/* Snapshots: a compact binary image of the runtime state of the VM (objects,
+   heaps, garbage collector, VM time). Restoring a snapshot preserves the
+   handles of the objects, but requires the same scripts to be compiled.
+   Take & restore snapshots between update cycles; free them with ssfree(). */
+void* surgescript_vm_snapshot(surgescript_vm_t* vm, size_t* size); /* takes a snapshot; returns NULL if the VM isn't active */
+bool surgescript_vm_restore(surgescript_vm_t* vm, const void* data, size_t size); /* restores a snapshot; returns false (and changes nothing) if it is corrupted or if it does not match the scripts */
+
+/* Hot reloading: scripts can be compiled again while the VM is running. The
+   code of the objects defined in them is replaced and the existing objects
+   keep their state and the values of their fields; new fields get their
+   constant initial values (or null). Objects whose code has changed enter
+   their current state again; the others aren't affected. Constructors are not
+   called again and new objects can't be added to a running VM. Reload between
+   update cycles. */
+bool surgescript_vm_reload(surgescript_vm_t* vm, const char* absolute_path); /* compiles a file again; returns false on error */
+bool surgescript_vm_reload_virtual_file(surgescript_vm_t* vm, const char* code, const char* filename); /* same as above, with code stored in memory */
+
 /* VM components */
 struct surgescript_programpool_t* surgescript_vm_programpool(const surgescript_vm_t* vm); /* gets the program pool */
 struct surgescript_tagsystem_t* surgescript_vm_tagsystem(const surgescript_vm_t* vm); /* gets the tag system */
@@ -70,6 +104,7 @@ surgescript_object_t* surgescript_vm_root_object(surgescript_vm_t* vm); /* root
 surgescript_object_t* surgescript_vm_spawn_object(surgescript_vm_t* vm, surgescript_object_t* parent, const char* object_name, void* user_data); /* user_data may be NULL */
 surgescript_object_t* surgescript_vm_find_object(surgescript_vm_t* vm, const char* object_name); /* finds an object */
 void surgescript_vm_bind(surgescript_vm_t* vm, const char* object_name, const char* fun_name, surgescript_program_cfunction_t cfun, int num_params); /* binds a C function to an object */
+bool surgescript_vm_bind_aot(surgescript_vm_t* vm, const char* object_name, const char* fun_name, surgescript_program_aotfunction_t aot, uint64_t fingerprint); /* binds ahead-of-time compiled code to a compiled function of an object */
 void surgescript_vm_install_plugin(surgescript_vm_t* vm, const char* object_name); /* sets a certain object as a plugin */
 
 #endif
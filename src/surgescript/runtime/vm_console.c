@@ -0,0 +1,279 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/vm_console.c
+ * SurgeScript Virtual Machine Console - buffers the output of the Console
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm_console.h"
+#include "../util/util.h"
+#include "../util/thread.h"
+
+/* VM console */
+struct surgescript_vmconsole_t {
+    surgescript_vmconsole_output_t output; /* NULL means stdout */
+    void* user_data; /* passed to output */
+
+    char* buffer; /* output buffered for the callback */
+    size_t length; /* number of bytes buffered (for stdout, the number of bytes written since the last flush) */
+    size_t capacity; /* capacity of the buffer */
+    int lines; /* number of lines buffered */
+    int flush_threshold; /* flush whenever this many lines are buffered */
+
+    surgescript_mutex_t mutex; /* Console may be used by isolated subtrees updated in parallel */
+    surgescript_vmconsole_t* next; /* consoles of all VMs, flushed before errors are reported */
+};
+
+/* the default number of lines buffered before flushing */
+#define DEFAULT_FLUSH_THRESHOLD 64
+
+/* the buffer is also flushed if it grows this large without enough lines */
+#define MAX_BUFFER_LENGTH 65536
+
+/* private stuff */
+static void flush(surgescript_vmconsole_t* console);
+static void append(surgescript_vmconsole_t* console, const char* text, size_t length);
+static int count_lines(const char* text, size_t length);
+static void init_consoles();
+static void flush_at_exit();
+static surgescript_vmconsole_t* consoles = NULL;
+static surgescript_mutex_t consoles_mutex;
+static surgescript_once_t consoles_once = SSONCE_INIT;
+
+/*
+ * surgescript_vmconsole_create()
+ * Create a VM console object
+ */
+surgescript_vmconsole_t* surgescript_vmconsole_create()
+{
+    surgescript_vmconsole_t* console = ssmalloc(sizeof *console);
+
+    console->output = NULL;
+    console->user_data = NULL;
+
+    console->buffer = NULL;
+    console->length = 0;
+    console->capacity = 0;
+    console->lines = 0;
+    console->flush_threshold = DEFAULT_FLUSH_THRESHOLD;
+
+    ssmutex_init(&console->mutex);
+
+    /* register the console */
+    ssonce(&consoles_once, init_consoles);
+    ssmutex_lock(&consoles_mutex);
+    console->next = consoles;
+    consoles = console;
+    ssmutex_unlock(&consoles_mutex);
+
+    return console;
+}
+
+/*
+ * surgescript_vmconsole_destroy()
+ * Destroy a VM console object, flushing its output
+ */
+surgescript_vmconsole_t* surgescript_vmconsole_destroy(surgescript_vmconsole_t* console)
+{
+    /* unregister the console */
+    ssmutex_lock(&consoles_mutex);
+    for(surgescript_vmconsole_t** it = &consoles; *it != NULL; it = &((*it)->next)) {
+        if(*it == console) {
+            *it = console->next;
+            break;
+        }
+    }
+    ssmutex_unlock(&consoles_mutex);
+
+    /* flush & release */
+    flush(console);
+    ssmutex_destroy(&console->mutex);
+
+    if(console->buffer != NULL)
+        ssfree(console->buffer);
+
+    ssfree(console);
+    return NULL;
+}
+
+/*
+ * surgescript_vmconsole_write()
+ * Write text to the console. The output is flushed when enough lines are buffered
+ */
+void surgescript_vmconsole_write(surgescript_vmconsole_t* console, const char* text, size_t length)
+{
+    if(length == 0)
+        return;
+
+    ssmutex_lock(&console->mutex);
+
+    if(console->output == NULL) {
+        /* stdout has a buffer of its own; we only decide when to flush it */
+        fwrite(text, sizeof(char), length, stdout);
+        console->length += length;
+    }
+    else
+        append(console, text, length);
+
+    console->lines += count_lines(text, length);
+    if(console->lines >= console->flush_threshold || console->length >= MAX_BUFFER_LENGTH)
+        flush(console);
+
+    ssmutex_unlock(&console->mutex);
+}
+
+/*
+ * surgescript_vmconsole_writeln()
+ * Write text followed by a newline to the console
+ */
+void surgescript_vmconsole_writeln(surgescript_vmconsole_t* console, const char* text, size_t length)
+{
+    /* the mutex is recursive; lines written in parallel won't be mixed */
+    ssmutex_lock(&console->mutex);
+    surgescript_vmconsole_write(console, text, length);
+    surgescript_vmconsole_write(console, "\n", 1);
+    ssmutex_unlock(&console->mutex);
+}
+
+/*
+ * surgescript_vmconsole_flush()
+ * Flush the buffered output
+ */
+void surgescript_vmconsole_flush(surgescript_vmconsole_t* console)
+{
+    ssmutex_lock(&console->mutex);
+    flush(console);
+    ssmutex_unlock(&console->mutex);
+}
+
+/*
+ * surgescript_vmconsole_flush_all()
+ * Flush the buffered output of all consoles. This is called before
+ * errors and log messages are reported, so that they appear in order
+ */
+void surgescript_vmconsole_flush_all()
+{
+    ssonce(&consoles_once, init_consoles);
+    ssmutex_lock(&consoles_mutex);
+    for(surgescript_vmconsole_t* console = consoles; console != NULL; console = console->next)
+        surgescript_vmconsole_flush(console);
+    ssmutex_unlock(&consoles_mutex);
+}
+
+/*
+ * surgescript_vmconsole_set_output()
+ * Redirect the output of the console to a callback, which receives text that
+ * is not NULL-terminated. Pass NULL to restore the default output (stdout)
+ */
+void surgescript_vmconsole_set_output(surgescript_vmconsole_t* console, surgescript_vmconsole_output_t output, void* user_data)
+{
+    ssmutex_lock(&console->mutex);
+
+    flush(console);
+    console->output = output;
+    console->user_data = user_data;
+
+    ssmutex_unlock(&console->mutex);
+}
+
+/*
+ * surgescript_vmconsole_set_flush_threshold()
+ * The output is flushed whenever this many lines are buffered.
+ * If the threshold is zero, the output is flushed on every write
+ */
+void surgescript_vmconsole_set_flush_threshold(surgescript_vmconsole_t* console, int lines)
+{
+    ssmutex_lock(&console->mutex);
+
+    flush(console);
+    console->flush_threshold = ssmax(lines, 0);
+
+    ssmutex_unlock(&console->mutex);
+}
+
+/*
+ * surgescript_vmconsole_flush_threshold()
+ * The number of lines buffered before the output is flushed
+ */
+int surgescript_vmconsole_flush_threshold(const surgescript_vmconsole_t* console)
+{
+    return console->flush_threshold;
+}
+
+
+
+/* private stuff */
+
+/* flush the buffered output */
+void flush(surgescript_vmconsole_t* console)
+{
+    size_t length = console->length;
+
+    if(length == 0)
+        return;
+
+    /* reset before calling the output, which may report an error and flush again */
+    console->length = 0;
+    console->lines = 0;
+
+    if(console->output == NULL)
+        fflush(stdout);
+    else
+        console->output(console->buffer, length, console->user_data);
+}
+
+/* append text to the buffer of the callback */
+void append(surgescript_vmconsole_t* console, const char* text, size_t length)
+{
+    if(console->length + length > console->capacity) {
+        console->capacity = ssmax(console->length + length, 2 * console->capacity);
+        console->buffer = ssrealloc(console->buffer, console->capacity * sizeof(char));
+    }
+
+    memcpy(console->buffer + console->length, text, length);
+    console->length += length;
+}
+
+/* count the newlines of the text */
+int count_lines(const char* text, size_t length)
+{
+    const char* end = text + length;
+    int lines = 0;
+
+    while((text = memchr(text, '\n', end - text)) != NULL) {
+        lines++;
+        text++;
+    }
+
+    return lines;
+}
+
+/* set up the list of consoles */
+void init_consoles()
+{
+    ssmutex_init(&consoles_mutex);
+    atexit(flush_at_exit);
+}
+
+/* consoles of VMs that haven't been destroyed are flushed at exit */
+void flush_at_exit()
+{
+    surgescript_vmconsole_flush_all();
+}
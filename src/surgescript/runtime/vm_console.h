@@ -0,0 +1,42 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/vm_console.h
+ * SurgeScript Virtual Machine Console - buffers the output of the Console
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_VM_CONSOLE_H
+#define _SURGESCRIPT_RUNTIME_VM_CONSOLE_H
+
+#include <stddef.h>
+
+typedef struct surgescript_vmconsole_t surgescript_vmconsole_t;
+typedef void (*surgescript_vmconsole_output_t)(const char* text, size_t length, void* user_data);
+
+surgescript_vmconsole_t* surgescript_vmconsole_create(); /* create a VM console object */
+surgescript_vmconsole_t* surgescript_vmconsole_destroy(surgescript_vmconsole_t* console); /* destroy a VM console object, flushing its output */
+
+void surgescript_vmconsole_write(surgescript_vmconsole_t* console, const char* text, size_t length); /* write text to the console */
+void surgescript_vmconsole_writeln(surgescript_vmconsole_t* console, const char* text, size_t length); /* write text followed by a newline */
+void surgescript_vmconsole_flush(surgescript_vmconsole_t* console); /* flush the buffered output */
+void surgescript_vmconsole_flush_all(); /* flush the buffered output of all consoles */
+
+void surgescript_vmconsole_set_output(surgescript_vmconsole_t* console, surgescript_vmconsole_output_t output, void* user_data); /* redirect the output to a callback; NULL means stdout */
+void surgescript_vmconsole_set_flush_threshold(surgescript_vmconsole_t* console, int lines); /* flush whenever this many lines are buffered; 0 flushes on every write */
+int surgescript_vmconsole_flush_threshold(const surgescript_vmconsole_t* console); /* the number of lines buffered before flushing */
+
+#endif
@@ -20,6 +20,7 @@
  */
 
 #include "vm_time.h"
+#include "snapshot.h"
 #include "../util/util.h"
 
 /* VM time */
@@ -111,4 +112,22 @@ uint64_t surgescript_vmtime_time(const surgescript_vmtime_t* vmtime)
 bool surgescript_vmtime_is_paused(const surgescript_vmtime_t* vmtime)
 {
     return vmtime->is_paused;
-}
\ No newline at end of file
+}
+/*
+ * surgescript_vmtime_snapshot()
+ * Write the VM time to a snapshot
+ */
+void surgescript_vmtime_snapshot(const surgescript_vmtime_t* vmtime, surgescript_snapshot_t* snapshot)
+{
+    surgescript_snapshot_write_uint(snapshot, vmtime->time);
+}
+
+/*
+ * surgescript_vmtime_restore()
+ * Read the VM time from a snapshot. The pause state isn't changed
+ */
+void surgescript_vmtime_restore(surgescript_vmtime_t* vmtime, surgescript_snapshot_t* snapshot)
+{
+    vmtime->time = surgescript_snapshot_read_uint(snapshot);
+    vmtime->ticks_at_last_update = surgescript_util_gettickcount();
+}
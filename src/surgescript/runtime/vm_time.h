@@ -26,6 +26,7 @@
 #include <stdbool.h>
 
 typedef struct surgescript_vmtime_t surgescript_vmtime_t;
+struct surgescript_snapshot_t;
 
 surgescript_vmtime_t* surgescript_vmtime_create(); /* create a VM time object */
 surgescript_vmtime_t* surgescript_vmtime_destroy(surgescript_vmtime_t* vmtime); /* destroy a VM time object */
@@ -37,4 +38,7 @@ void surgescript_vmtime_resume(surgescript_vmtime_t* vmtime); /* resume the VM t
 uint64_t surgescript_vmtime_time(const surgescript_vmtime_t* vmtime); /* the time at the beginning of the current update cycle */
 bool surgescript_vmtime_is_paused(const surgescript_vmtime_t* vmtime); /* is the VM time paused? */
 
+void surgescript_vmtime_snapshot(const surgescript_vmtime_t* vmtime, struct surgescript_snapshot_t* snapshot); /* write the VM time to a snapshot */
+void surgescript_vmtime_restore(surgescript_vmtime_t* vmtime, struct surgescript_snapshot_t* snapshot); /* read the VM time from a snapshot */
+
 #endif
\ No newline at end of file
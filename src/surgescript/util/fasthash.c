@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include "fasthash.h"
 #include "util.h"
+#include "thread.h"
 
 /* types */
 typedef enum fasthash_entry_state_t fasthash_entry_state_t;
@@ -124,8 +125,8 @@ void* fasthash_get(fasthash_t* hashtable, uint64_t key)
     while(hashtable->data[k].state != BLANK) {
         if(hashtable->data[k].state == ACTIVE) {
             if(hashtable->data[k].key == key) {
-                /* swap marker */
-                if(marker < hashtable->capacity) {
+                /* swap marker (the table is read-only while running in parallel) */
+                if(marker < hashtable->capacity && !ssconcurrent()) {
                     fasthash_entry_t deleted = hashtable->data[marker];
                     hashtable->data[marker] = hashtable->data[k];
                     hashtable->data[k] = deleted;
@@ -0,0 +1,247 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * util/thread.c
+ * SurgeScript threading utilities
+ */
+
+#include "thread.h"
+#include "util.h"
+
+/* thread pool */
+struct surgescript_threadpool_t
+{
+    int num_threads; /* number of worker threads */
+
+#if SURGESCRIPT_ENABLE_THREADS
+    thrd_t* thread; /* worker threads */
+    mtx_t mutex; /* protects the fields below */
+    cnd_t has_work; /* signals a new batch of jobs */
+    cnd_t has_finished; /* signals the end of a batch */
+
+    /* current batch of jobs */
+    int generation; /* incremented for each new batch */
+    int num_jobs; /* number of jobs of the current batch */
+    int next_job; /* index of the next job to be picked */
+    int finished_jobs; /* how many jobs of the current batch are done */
+    void* job_data; /* data passed to each job */
+    void (*job)(int,void*); /* job function */
+    bool quit; /* should the workers quit? */
+
+    /* per-worker setup */
+    void* data; /* data passed to init() */
+    void* (*init)(void*); /* runs on each worker before any jobs */
+    void (*release)(void*); /* runs on each worker before it quits */
+#endif
+};
+
+#if SURGESCRIPT_ENABLE_THREADS
+SS_THREAD_LOCAL bool surgescript_thread_concurrent = false;
+atomic_int surgescript_thread_concurrent_batches = 0;
+static int worker_main(void* arg);
+static void run_jobs(surgescript_threadpool_t* pool);
+#endif
+
+
+
+/*
+ * surgescript_threadpool_create()
+ * Spawns num_threads worker threads. init() runs on each worker before it
+ * executes any jobs; its return value is passed to release() when the
+ * worker quits. Both init() and release() may be NULL.
+ */
+surgescript_threadpool_t* surgescript_threadpool_create(int num_threads, void* data, void* (*init)(void*), void (*release)(void*))
+{
+    surgescript_threadpool_t* pool = ssmalloc(sizeof *pool);
+    pool->num_threads = 0;
+
+#if SURGESCRIPT_ENABLE_THREADS
+    pool->thread = ssmalloc(ssmax(1, num_threads) * sizeof(*(pool->thread)));
+    mtx_init(&pool->mutex, mtx_plain);
+    cnd_init(&pool->has_work);
+    cnd_init(&pool->has_finished);
+
+    pool->generation = 0;
+    pool->num_jobs = 0;
+    pool->next_job = 0;
+    pool->finished_jobs = 0;
+    pool->job_data = NULL;
+    pool->job = NULL;
+    pool->quit = false;
+
+    pool->data = data;
+    pool->init = init;
+    pool->release = release;
+
+    for(int i = 0; i < num_threads; i++) {
+        if(thrd_create(&pool->thread[pool->num_threads], worker_main, pool) == thrd_success)
+            pool->num_threads++;
+        else
+            sslog("Can't create worker thread %d", i);
+    }
+
+    sslog("Created a thread pool with %d worker threads", pool->num_threads);
+#else
+    if(num_threads > 0)
+        sslog("Can't create worker threads: SurgeScript has been compiled without multithreading support");
+#endif
+
+    return pool;
+}
+
+/*
+ * surgescript_threadpool_destroy()
+ * Joins the worker threads and destroys the pool
+ */
+surgescript_threadpool_t* surgescript_threadpool_destroy(surgescript_threadpool_t* pool)
+{
+#if SURGESCRIPT_ENABLE_THREADS
+    mtx_lock(&pool->mutex);
+    pool->quit = true;
+    cnd_broadcast(&pool->has_work);
+    mtx_unlock(&pool->mutex);
+
+    for(int i = 0; i < pool->num_threads; i++)
+        thrd_join(pool->thread[i], NULL);
+
+    cnd_destroy(&pool->has_finished);
+    cnd_destroy(&pool->has_work);
+    mtx_destroy(&pool->mutex);
+    ssfree(pool->thread);
+#endif
+
+    return ssfree(pool);
+}
+
+/*
+ * surgescript_threadpool_run()
+ * Runs job(0, data), ..., job(num_jobs-1, data) in parallel and waits until
+ * all of them are done. The calling thread also runs jobs. While the jobs
+ * are running, ssconcurrent() evaluates to true on the threads that run
+ * them, and ssconcurrent_any() evaluates to true on all threads.
+ */
+void surgescript_threadpool_run(surgescript_threadpool_t* pool, int num_jobs, void* data, void (*job)(int,void*))
+{
+#if SURGESCRIPT_ENABLE_THREADS
+    /* run on the calling thread if there's nothing to parallelize */
+    if(pool->num_threads == 0 || num_jobs <= 1) {
+        for(int i = 0; i < num_jobs; i++)
+            job(i, data);
+        return;
+    }
+
+    /* start a new batch */
+    mtx_lock(&pool->mutex);
+    pool->num_jobs = num_jobs;
+    pool->next_job = 0;
+    pool->finished_jobs = 0;
+    pool->job_data = data;
+    pool->job = job;
+    pool->generation++;
+    atomic_fetch_add(&surgescript_thread_concurrent_batches, 1);
+    surgescript_thread_concurrent = true;
+    cnd_broadcast(&pool->has_work);
+
+    /* help the workers */
+    run_jobs(pool);
+
+    /* wait for the batch to complete */
+    while(pool->finished_jobs < pool->num_jobs)
+        cnd_wait(&pool->has_finished, &pool->mutex);
+
+    surgescript_thread_concurrent = false;
+    atomic_fetch_sub(&surgescript_thread_concurrent_batches, 1);
+    pool->job = NULL;
+    pool->job_data = NULL;
+    mtx_unlock(&pool->mutex);
+#else
+    for(int i = 0; i < num_jobs; i++)
+        job(i, data);
+#endif
+}
+
+/*
+ * surgescript_threadpool_size()
+ * The number of worker threads
+ */
+int surgescript_threadpool_size(const surgescript_threadpool_t* pool)
+{
+    return pool->num_threads;
+}
+
+/*
+ * surgescript_thread_is_supported()
+ * Has SurgeScript been compiled with multithreading support?
+ */
+bool surgescript_thread_is_supported()
+{
+    return SURGESCRIPT_ENABLE_THREADS;
+}
+
+
+
+/* private */
+
+#if SURGESCRIPT_ENABLE_THREADS
+
+/* the main function of a worker thread */
+int worker_main(void* arg)
+{
+    surgescript_threadpool_t* pool = (surgescript_threadpool_t*)arg;
+    void* context = pool->init != NULL ? pool->init(pool->data) : NULL;
+    int generation = 0;
+
+    /* workers only run jobs of parallel batches */
+    surgescript_thread_concurrent = true;
+
+    mtx_lock(&pool->mutex);
+    for(;;) {
+        /* wait for a new batch */
+        while(!pool->quit && pool->generation == generation)
+            cnd_wait(&pool->has_work, &pool->mutex);
+
+        if(pool->quit)
+            break;
+
+        /* work */
+        generation = pool->generation;
+        run_jobs(pool);
+    }
+    mtx_unlock(&pool->mutex);
+
+    if(pool->release != NULL)
+        pool->release(context);
+
+    return 0;
+}
+
+/* picks jobs of the current batch until there are none left (call with the mutex locked) */
+void run_jobs(surgescript_threadpool_t* pool)
+{
+    while(pool->next_job < pool->num_jobs) {
+        int index = pool->next_job++;
+
+        mtx_unlock(&pool->mutex);
+        pool->job(index, pool->job_data);
+        mtx_lock(&pool->mutex);
+
+        if(++pool->finished_jobs == pool->num_jobs)
+            cnd_broadcast(&pool->has_finished);
+    }
+}
+
+#endif
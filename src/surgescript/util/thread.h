@@ -0,0 +1,90 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * util/thread.h
+ * SurgeScript threading utilities
+ */
+
+#ifndef _SURGESCRIPT_THREAD_H
+#define _SURGESCRIPT_THREAD_H
+
+#include <stdbool.h>
+
+/*
+ * Multithreading is enabled at compile-time with SURGESCRIPT_ENABLE_THREADS.
+ * If it's disabled, the macros below compile to nothing and the thread pool
+ * runs its jobs on the calling thread.
+ */
+#if !defined(SURGESCRIPT_ENABLE_THREADS)
+#define SURGESCRIPT_ENABLE_THREADS  0
+#endif
+
+#if SURGESCRIPT_ENABLE_THREADS
+
+#include <threads.h>
+#include <stdatomic.h>
+
+/* thread-local storage */
+#define SS_THREAD_LOCAL             _Thread_local
+
+/* recursive mutexes */
+typedef mtx_t surgescript_mutex_t;
+#define ssmutex_init(m)             mtx_init((m), mtx_plain | mtx_recursive)
+#define ssmutex_destroy(m)          mtx_destroy(m)
+#define ssmutex_lock(m)             mtx_lock(m)
+#define ssmutex_unlock(m)           mtx_unlock(m)
+
+/* one-time initialization */
+typedef once_flag surgescript_once_t;
+#define SSONCE_INIT                 ONCE_FLAG_INIT
+#define ssonce(flag, fn)            call_once((flag), (fn))
+
+/* is the VM that runs on the calling thread updating objects in parallel? */
+extern SS_THREAD_LOCAL bool surgescript_thread_concurrent;
+#define ssconcurrent()              (surgescript_thread_concurrent)
+
+/* is any VM of this process updating objects in parallel? (for data shared by all VMs) */
+extern atomic_int surgescript_thread_concurrent_batches;
+#define ssconcurrent_any()          (atomic_load(&surgescript_thread_concurrent_batches) > 0)
+
+#else
+
+#define SS_THREAD_LOCAL
+typedef int surgescript_mutex_t;
+#define ssmutex_init(m)             ((void)(m))
+#define ssmutex_destroy(m)          ((void)(m))
+#define ssmutex_lock(m)             ((void)(m))
+#define ssmutex_unlock(m)           ((void)(m))
+typedef bool surgescript_once_t;
+#define SSONCE_INIT                 false
+#define ssonce(flag, fn)            do { if(!*(flag)) { *(flag) = true; (fn)(); } } while(0)
+#define ssconcurrent()              (false)
+#define ssconcurrent_any()          (false)
+
+#endif
+
+/* thread pool */
+typedef struct surgescript_threadpool_t surgescript_threadpool_t;
+
+/* public routines */
+surgescript_threadpool_t* surgescript_threadpool_create(int num_threads, void* data, void* (*init)(void*), void (*release)(void*)); /* spawns num_threads worker threads; init() and release() run on each worker (may be NULL) */
+surgescript_threadpool_t* surgescript_threadpool_destroy(surgescript_threadpool_t* pool); /* joins the worker threads */
+void surgescript_threadpool_run(surgescript_threadpool_t* pool, int num_jobs, void* data, void (*job)(int,void*)); /* runs job(0), ..., job(num_jobs-1) in parallel and waits for all of them; the calling thread helps */
+int surgescript_threadpool_size(const surgescript_threadpool_t* pool); /* number of worker threads */
+bool surgescript_thread_is_supported(); /* has SurgeScript been compiled with multithreading support? */
+
+#endif
@@ -26,6 +26,8 @@
 #include "transform.h"
 #include "../runtime/object.h"
 #include "../runtime/object_manager.h"
+#include "../runtime/snapshot.h"
+#include "thread.h"
 
 /* A Transform holds position, rotation and scale
    TODO: change this to a 4x4 matrix representation for more flexibility */
@@ -48,6 +50,9 @@ struct surgescript_transform_t
     struct {
         float sx, cx, sy, cy, sz, cz; /* cached sin & cos of each component of the rotation */
     } _;
+
+    /* the object that owns this local transform, if any */
+    surgescript_object_t* owner;
 };
 
 /* utilities */
@@ -62,8 +67,18 @@ static const surgescript_transform_t IDENTITY = {
         .cx = 1.0f, .cy = 1.0f, .cz = 1.0f
     }
 };
+static const surgescript_worldtransform2d_t IDENTITY_WORLD = {
+    .a = 1.0, .b = 0.0, .c = 0.0, .d = 1.0, .tx = 0.0, .ty = 0.0,
+    .angle = 0.0f, .lossy_sx = 1.0f, .lossy_sy = 1.0f,
+    .generation = 0, .is_valid = true
+};
 static float y_axis = 1.0f;
+static unsigned generation = 0; /* incremented whenever the cached world transforms become obsolete */
+static inline void changed(surgescript_transform_t* t);
+static const surgescript_worldtransform2d_t* world_transform(const surgescript_object_t* object, surgescript_worldtransform2d_t* buf);
 static void world2local(surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle, surgescript_objecthandle_t root, float* x, float* y);
+extern surgescript_worldtransform2d_t* surgescript_object_world_transform_cache(surgescript_object_t* object); /* object.c */
+extern void surgescript_object_invalidate_world_transform(surgescript_object_t* object); /* object.c */
 
 /*
  * surgescript_transform_create()
@@ -72,7 +87,8 @@ static void world2local(surgescript_objectmanager_t* manager, surgescript_object
 surgescript_transform_t* surgescript_transform_create()
 {
     surgescript_transform_t* t = ssmalloc(sizeof *t);
-    surgescript_transform_reset(t);
+    *t = IDENTITY; /* not bound to any object */
+    t->owner = NULL;
     return t;
 }
 
@@ -91,7 +107,11 @@ surgescript_transform_t* surgescript_transform_destroy(surgescript_transform_t*
  */
 void surgescript_transform_reset(surgescript_transform_t* t)
 {
+    surgescript_object_t* owner = t->owner;
+
     *t = IDENTITY;
+    t->owner = owner;
+    changed(t);
 }
 
 /*
@@ -100,7 +120,11 @@ void surgescript_transform_reset(surgescript_transform_t* t)
  */
 void surgescript_transform_copy(surgescript_transform_t* dst, const surgescript_transform_t* src)
 {
+    surgescript_object_t* owner = dst->owner;
+
     *dst = *src;
+    dst->owner = owner;
+    changed(dst);
 }
 
 /*
@@ -111,6 +135,7 @@ void surgescript_transform_setposition2d(surgescript_transform_t* t, float x, fl
 {
     t->position.x = x;
     t->position.y = y;
+    changed(t);
 }
 
 /*
@@ -132,6 +157,7 @@ void surgescript_transform_setrotation2d(surgescript_transform_t* t, float degre
     t->rotation.z = fmodf(degrees, 360.0f);
     t->_.sz = sinf(t->rotation.z * DEG2RAD);
     t->_.cz = cosf(t->rotation.z * DEG2RAD);
+    changed(t);
 }
 
 /*
@@ -151,6 +177,7 @@ void surgescript_transform_setscale2d(surgescript_transform_t* t, float sx, floa
 {
     t->scale.x = sx;
     t->scale.y = sy;
+    changed(t);
 }
 
 /*
@@ -171,6 +198,7 @@ void surgescript_transform_translate2d(surgescript_transform_t* t, float x, floa
 {
     t->position.x += x;
     t->position.y += y;
+    changed(t);
 }
 
 /*
@@ -182,6 +210,7 @@ void surgescript_transform_rotate2d(surgescript_transform_t* t, float degrees)
     t->rotation.z = fmodf(t->rotation.z + degrees, 360.0f);
     t->_.sz = sinf(t->rotation.z * DEG2RAD);
     t->_.cz = cosf(t->rotation.z * DEG2RAD);
+    changed(t);
 }
 
 /*
@@ -192,6 +221,7 @@ void surgescript_transform_scale2d(surgescript_transform_t* t, float sx, float s
 {
     t->scale.x *= sx;
     t->scale.y *= sy;
+    changed(t);
 }
 
 /*
@@ -231,22 +261,11 @@ void surgescript_transform_apply2dinverse(const surgescript_transform_t* t, floa
 void surgescript_transform_util_worldposition2d(const surgescript_object_t* object, float* x, float* y)
 {
     /* this must be fast! */
-    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
-    surgescript_objecthandle_t root = surgescript_objectmanager_root(manager);
-    surgescript_objecthandle_t handle;
-    const surgescript_transform_t* transform;
+    surgescript_worldtransform2d_t buf;
+    const surgescript_worldtransform2d_t* world = world_transform(object, &buf);
 
-    /* initialize (identity translation) */
-    *x = *y = 0.0f;
-
-    /* compute world position */
-    do {
-        if(surgescript_object_transform_changed(object)) {
-            transform = surgescript_object_transform((surgescript_object_t*)object);
-            surgescript_transform_apply2d(transform, x, y);
-        }
-        handle = surgescript_object_parent(object);
-    } while(handle != root && (object = surgescript_objectmanager_get(manager, handle)));
+    *x = world->tx;
+    *y = world->ty;
 
     /* note: changing the transform of the root object is not supported (nor it is needed!) */
 }
@@ -260,14 +279,31 @@ void surgescript_transform_util_setworldposition2d(surgescript_object_t* object,
     surgescript_objectmanager_t* manager = surgescript_object_manager(object);
     surgescript_objecthandle_t root = surgescript_objectmanager_root(manager);
     surgescript_objecthandle_t handle = surgescript_object_handle(object);
+    surgescript_objecthandle_t parent_handle = surgescript_object_parent(object);
     surgescript_transform_t* transform = surgescript_object_transform(object);
 
     /* compute local position */
-    world2local(manager, surgescript_object_parent(object), root, &x, &y);
+    if(parent_handle != root && parent_handle != handle) {
+        surgescript_worldtransform2d_t buf;
+        const surgescript_worldtransform2d_t* parent_world = world_transform(surgescript_objectmanager_get(manager, parent_handle), &buf);
+        double det = parent_world->a * parent_world->d - parent_world->b * parent_world->c;
+
+        if(fpclassify(det) != FP_ZERO) {
+            /* invert the world transform of the parent */
+            double dx = x - parent_world->tx, dy = y - parent_world->ty;
+            x = (parent_world->d * dx - parent_world->c * dy) / det;
+            y = (parent_world->a * dy - parent_world->b * dx) / det;
+        }
+        else {
+            /* some scale is zero; undo the transforms one by one */
+            world2local(manager, parent_handle, root, &x, &y);
+        }
+    }
 
     /* set local position */
     transform->position.x = x;
     transform->position.y = y;
+    changed(transform);
 }
 
 /*
@@ -277,23 +313,10 @@ void surgescript_transform_util_setworldposition2d(surgescript_object_t* object,
 float surgescript_transform_util_worldangle2d(const surgescript_object_t* object)
 {
     /* this must be fast! */
-    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
-    surgescript_objecthandle_t root = surgescript_objectmanager_root(manager);
-    surgescript_objecthandle_t handle;
-    const surgescript_transform_t* transform;
-    float degrees = 0.0f; /* identity rotation */
-
-    /* compute world angle */
-    do {
-        if(surgescript_object_transform_changed(object)) {
-            transform = surgescript_object_transform((surgescript_object_t*)object);
-            degrees += transform->rotation.z;
-        }
-        handle = surgescript_object_parent(object);
-    } while(handle != root && (object = surgescript_objectmanager_get(manager, handle)));
+    surgescript_worldtransform2d_t buf;
+    const surgescript_worldtransform2d_t* world = world_transform(object, &buf);
 
-    /* done! */
-    return fmodf(degrees, 360.0f);
+    return fmodf(world->angle, 360.0f);
 }
 
 /*
@@ -370,27 +393,57 @@ void surgescript_transform_util_up2d(const surgescript_object_t* object, float*
 void surgescript_transform_util_lossyscale2d(const surgescript_object_t* object, float* x, float* y)
 {
     /* this must be fast! */
-    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
-    surgescript_objecthandle_t root = surgescript_objectmanager_root(manager);
-    surgescript_objecthandle_t handle;
-    const surgescript_transform_t* transform;
-    const float upper_bound = 1.0f + FLT_EPSILON;
-    const float lower_bound = 1.0f - FLT_EPSILON;
-
-    /* initialize (identity) */
-    *x = *y = 1.0f;
-
-    /* compute lossy scale */
-    do {
-        if(surgescript_object_transform_changed(object)) {
-            transform = surgescript_object_transform((surgescript_object_t*)object);
-            if(transform->scale.x <= lower_bound || transform->scale.x >= upper_bound)
-                *x *= transform->scale.x;
-            if(transform->scale.y <= lower_bound || transform->scale.y >= upper_bound)
-                *y *= transform->scale.y;
-        }
-        handle = surgescript_object_parent(object);
-    } while(handle != root && (object = surgescript_objectmanager_get(manager, handle)));
+    surgescript_worldtransform2d_t buf;
+    const surgescript_worldtransform2d_t* world = world_transform(object, &buf);
+
+    *x = world->lossy_sx;
+    *y = world->lossy_sy;
+}
+
+/*
+ * surgescript_transform_bind_object()
+ * Binds a local transform to the object that owns it. Changing the transform
+ * will invalidate the cached world transforms of the object and of its
+ * descendants. This is used internally by the objects.
+ */
+void surgescript_transform_bind_object(surgescript_transform_t* t, surgescript_object_t* object)
+{
+    t->owner = object;
+}
+
+/*
+ * surgescript_transform_snapshot()
+ * Writes a local transform to a snapshot. This is used internally by the objects.
+ */
+void surgescript_transform_snapshot(const surgescript_transform_t* t, surgescript_snapshot_t* snapshot)
+{
+    const float data[] = {
+        t->position.x, t->position.y, t->position.z,
+        t->rotation.x, t->rotation.y, t->rotation.z,
+        t->scale.x, t->scale.y, t->scale.z,
+        t->_.sx, t->_.cx, t->_.sy, t->_.cy, t->_.sz, t->_.cz
+    };
+
+    for(int i = 0; i < sizeof(data) / sizeof(*data); i++)
+        surgescript_snapshot_write_float(snapshot, data[i]);
+}
+
+/*
+ * surgescript_transform_restore()
+ * Reads a local transform from a snapshot. The owner is kept and isn't notified
+ * of the change: the world transforms are invalidated by the caller.
+ */
+void surgescript_transform_restore(surgescript_transform_t* t, surgescript_snapshot_t* snapshot)
+{
+    float* data[] = {
+        &t->position.x, &t->position.y, &t->position.z,
+        &t->rotation.x, &t->rotation.y, &t->rotation.z,
+        &t->scale.x, &t->scale.y, &t->scale.z,
+        &t->_.sx, &t->_.cx, &t->_.sy, &t->_.cy, &t->_.sz, &t->_.cz
+    };
+
+    for(int i = 0; i < sizeof(data) / sizeof(*data); i++)
+        *(data[i]) = surgescript_snapshot_read_float(snapshot);
 }
 
 /*
@@ -400,7 +453,13 @@ void surgescript_transform_util_lossyscale2d(const surgescript_object_t* object,
  */
 void surgescript_transform_use_inverted_y(bool inverted)
 {
-    y_axis = inverted ? -1.0f : 1.0f;
+    float new_y_axis = inverted ? -1.0f : 1.0f;
+
+    /* the cached world transforms are now obsolete */
+    if(new_y_axis != y_axis)
+        generation++;
+
+    y_axis = new_y_axis;
 }
 
 /*
@@ -431,3 +490,67 @@ static void world2local(surgescript_objectmanager_t* manager, surgescript_object
         surgescript_transform_apply2dinverse(transform, x, y);
     }
 }
+
+/* the local transform has been changed */
+static inline void changed(surgescript_transform_t* t)
+{
+    if(t->owner != NULL)
+        surgescript_object_invalidate_world_transform(t->owner);
+}
+
+/* gets the world transform of an object, computing it if necessary.
+   The result is cached, unless objects are being updated in parallel;
+   in that case, buf is used to store the result (no cache is written) */
+static const surgescript_worldtransform2d_t* world_transform(const surgescript_object_t* object, surgescript_worldtransform2d_t* buf)
+{
+    surgescript_worldtransform2d_t* cache = surgescript_object_world_transform_cache((surgescript_object_t*)object);
+    const surgescript_worldtransform2d_t* parent_world = &IDENTITY_WORLD;
+    surgescript_worldtransform2d_t* world, parent_buf;
+    surgescript_objectmanager_t* manager;
+    surgescript_objecthandle_t handle, parent_handle;
+
+    /* the cache is up-to-date */
+    if(cache->is_valid && cache->generation == generation)
+        return cache;
+
+    /* get the world transform of the parent
+       (the transform of the root object is not taken into account) */
+    manager = surgescript_object_manager(object);
+    handle = surgescript_object_handle(object);
+    parent_handle = surgescript_object_parent(object);
+    if(parent_handle != surgescript_objectmanager_root(manager) && parent_handle != handle)
+        parent_world = world_transform(surgescript_objectmanager_get(manager, parent_handle), &parent_buf);
+
+    /* compose it with the local transform */
+    world = ssconcurrent() ? buf : cache;
+    if(surgescript_object_transform_changed(object)) {
+        const surgescript_transform_t* t = surgescript_object_transform((surgescript_object_t*)object);
+        const float upper_bound = 1.0f + FLT_EPSILON;
+        const float lower_bound = 1.0f - FLT_EPSILON;
+        double cz = t->_.cz, sz = t->_.sz * y_axis;
+        double a = t->scale.x * cz, b = t->scale.x * sz;
+        double c = -t->scale.y * sz, d = t->scale.y * cz;
+        double tx = t->position.x, ty = t->position.y;
+
+        world->a = parent_world->a * a + parent_world->c * b;
+        world->b = parent_world->b * a + parent_world->d * b;
+        world->c = parent_world->a * c + parent_world->c * d;
+        world->d = parent_world->b * c + parent_world->d * d;
+        world->tx = parent_world->a * tx + parent_world->c * ty + parent_world->tx;
+        world->ty = parent_world->b * tx + parent_world->d * ty + parent_world->ty;
+        world->angle = parent_world->angle + t->rotation.z;
+        world->lossy_sx = parent_world->lossy_sx;
+        world->lossy_sy = parent_world->lossy_sy;
+        if(t->scale.x <= lower_bound || t->scale.x >= upper_bound)
+            world->lossy_sx *= t->scale.x;
+        if(t->scale.y <= lower_bound || t->scale.y >= upper_bound)
+            world->lossy_sy *= t->scale.y;
+    }
+    else
+        *world = *parent_world;
+
+    /* done! */
+    world->generation = generation;
+    world->is_valid = true;
+    return world;
+}
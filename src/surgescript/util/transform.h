@@ -65,6 +65,18 @@ void surgescript_transform_util_right2d(const struct surgescript_object_t* objec
 void surgescript_transform_util_up2d(const struct surgescript_object_t* object, float* x, float* y); /* get the up vector of the transform */
 void surgescript_transform_util_lossyscale2d(const struct surgescript_object_t* object, float* x, float* y); /* an approximation of the 2D world scale */
 
+/* world transform cache (used internally by the objects) */
+typedef struct surgescript_worldtransform2d_t surgescript_worldtransform2d_t;
+struct surgescript_worldtransform2d_t
+{
+    double a, b, c, d, tx, ty; /* affine map: local space -> world space */
+    float angle; /* world angle in degrees, not wrapped */
+    float lossy_sx, lossy_sy; /* lossy scale */
+    unsigned generation; /* see surgescript_transform_use_inverted_y() */
+    bool is_valid; /* if false, so are the caches of the descendants */
+};
+void surgescript_transform_bind_object(surgescript_transform_t* t, struct surgescript_object_t* object); /* changes to t will invalidate the world transform of object */
+
 /* global settings */
 void surgescript_transform_use_inverted_y(bool inverted); /* set it to true if your y-axis grows downwards */
 bool surgescript_transform_is_using_inverted_y(); /* defaults to false (i.e., y-axis grows upwards) */
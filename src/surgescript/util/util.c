@@ -110,6 +110,10 @@ void surgescript_util_log(const char* fmt, ...)
     vsnprintf(buf+len, sizeof(buf)-len, fmt, args);
     va_end(args);
 
+    /* the message should appear after any buffered output of the Console */
+    extern void surgescript_vmconsole_flush_all(); /* runtime/vm_console.c */
+    surgescript_vmconsole_flush_all();
+
     log_function(buf, log_context);
 }
 
@@ -127,6 +131,10 @@ void surgescript_util_fatal(const char* fmt, ...)
     vsnprintf(buf+len, sizeof(buf)-len, fmt, args);
     va_end(args);
 
+    /* don't lose the buffered output of the Console */
+    extern void surgescript_vmconsole_flush_all(); /* runtime/vm_console.c */
+    surgescript_vmconsole_flush_all();
+
     crash_function(buf, crash_context);
 }
 
@@ -388,17 +396,18 @@ uint64_t surgescript_util_gettickcount()
 
 /*
  * surgescript_util_srand()
- * Sets the seed of the pseudo-random number generator
+ * Sets the seed of the pseudo-random number generator of the calling thread
  */
 void surgescript_util_srand(uint64_t seed)
 {
     /* using splitmix64 to seed the generator */
-    extern uint64_t* xor_seed;
+    extern uint64_t* xor_seed(void);
+    uint64_t* state = xor_seed();
     for(int i = 0; i <= 1; i++) {
         uint64_t x = (seed += UINT64_C(0x9e3779b97f4a7c15));
         x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
         x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
-        xor_seed[i] = x ^ (x >> 31);
+        state[i] = x ^ (x >> 31);
     }
 }
 
@@ -408,7 +417,15 @@ void surgescript_util_srand(uint64_t seed)
  */
 uint64_t surgescript_util_random64()
 {
+    extern uint64_t* xor_seed(void);
     extern uint64_t (*xor_next)(void);
+    uint64_t* state = xor_seed();
+
+    /* each thread has its own generator. The worker threads
+       seed theirs when they first use it */
+    if(state[0] == 0 && state[1] == 0)
+        surgescript_util_srand((uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)state);
+
     return xor_next();
 }
 
@@ -473,6 +490,7 @@ void my_log_function(const char* message, void* context)
 
 void my_crash_function(const char* message, void* context)
 {
+    fflush(stdout);
     fprintf(stderr, "%s\n", message);
     exit(1); /* must exit the app */
 }
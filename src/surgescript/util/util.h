@@ -93,7 +93,7 @@ char* surgescript_util_accessorfun(const char* prefix, const char* text); /* get
 unsigned surgescript_util_htob(unsigned x); /* host to big-endian */
 unsigned surgescript_util_btoh(unsigned x); /* big to host-endian */
 
-void surgescript_util_srand(uint64_t seed); /* sets the seed of the pseudo-random number generator */
+void surgescript_util_srand(uint64_t seed); /* sets the seed of the pseudo-random number generator of the calling thread */
 uint64_t surgescript_util_random64(); /* generates a pseudo-random 64-bit unsigned integer */
 double surgescript_util_random(); /* generates a pseudo-random double in the [0,1) range */
 
@@ -0,0 +1,106 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * aot.c
+ * A minimal host of ahead-of-time compiled scripts. It's linked to the output
+ * of surgescript --aot and runs the same scripts the way the CLI does
+ */
+
+#include <surgescript.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/* defined in the output of surgescript --aot */
+extern void surgescript_aot_register(surgescript_vm_t* vm);
+
+/* settings */
+#define TIME_LIMIT 30 /* in seconds */
+
+/* helpers */
+static void check_binding(const char* message);
+static void crash(const char* message);
+static bool mismatch = false;
+
+/*
+ * main()
+ * Entry point
+ */
+int main(int argc, char* argv[])
+{
+    surgescript_vm_t* vm;
+    uint64_t end_time;
+
+    /* SurgeScript uses UTF-8 */
+    setlocale(LC_ALL, "en_US.UTF-8");
+
+    /* show usage */
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s <script.ss> [<script.ss> ...]\n", surgescript_util_basename(argv[0]));
+        return 1;
+    }
+
+    /* compile the same scripts that have been translated */
+    surgescript_util_set_error_functions(check_binding, crash);
+    vm = surgescript_vm_create();
+    for(int i = 1; i < argc; i++)
+        surgescript_vm_compile(vm, argv[i]);
+
+    /* the translated code must match the compiled scripts */
+    surgescript_aot_register(vm);
+    if(mismatch) {
+        surgescript_vm_destroy(vm);
+        return 1;
+    }
+
+    /* run the VM with a time limit, like the CLI */
+    surgescript_vm_launch(vm);
+    end_time = surgescript_util_gettickcount() + TIME_LIMIT * 1000;
+    while(surgescript_vm_update(vm)) {
+        if(surgescript_util_gettickcount() > end_time) {
+            fprintf(stderr, "Time limit of %d seconds exceeded.\n", TIME_LIMIT);
+            break;
+        }
+    }
+
+    /* done! */
+    surgescript_vm_destroy(vm);
+    return 0;
+}
+
+
+
+/*
+ * helpers
+ */
+
+/* a program that can't be bound would silently be interpreted */
+void check_binding(const char* message)
+{
+    if(strstr(message, "Can't bind AOT") != NULL) {
+        fprintf(stderr, "[surgescript-error] %s\n", message);
+        mismatch = true;
+    }
+}
+
+/* same as the CLI */
+void crash(const char* message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
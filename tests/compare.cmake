@@ -0,0 +1,26 @@
+# Runs a script with the interpreter and with another program (e.g., a host of
+# ahead-of-time compiled code, or a build of the CLI with the JIT compiler)
+# and compares the results. EMULATOR is optional (see CMAKE_CROSSCOMPILING_EMULATOR).
+# Usage: cmake -DINTERPRETER=<surgescript> -DPROGRAM=<program> -DSCRIPT=<script.ss> [-DEMULATOR=<emulator>] -P compare.cmake
+
+execute_process(
+    COMMAND ${EMULATOR} "${INTERPRETER}" --timelimit 30 "${SCRIPT}"
+    RESULT_VARIABLE EXPECTED_RESULT
+    OUTPUT_VARIABLE EXPECTED_OUTPUT
+    ERROR_VARIABLE EXPECTED_ERROR
+)
+
+execute_process(
+    COMMAND ${EMULATOR} "${PROGRAM}" "${SCRIPT}"
+    RESULT_VARIABLE RESULT
+    OUTPUT_VARIABLE OUTPUT
+    ERROR_VARIABLE ERROR
+)
+
+if(NOT RESULT STREQUAL EXPECTED_RESULT)
+    message(FATAL_ERROR "Exit status ${RESULT} differs from the interpreter's (${EXPECTED_RESULT}).\n${ERROR}")
+elseif(NOT OUTPUT STREQUAL EXPECTED_OUTPUT)
+    message(FATAL_ERROR "Output differs from the interpreter's.\nExpected:\n${EXPECTED_OUTPUT}\nGot:\n${OUTPUT}")
+elseif(NOT ERROR STREQUAL EXPECTED_ERROR)
+    message(FATAL_ERROR "Error output differs from the interpreter's.\nExpected:\n${EXPECTED_ERROR}\nGot:\n${ERROR}")
+endif()
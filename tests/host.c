@@ -0,0 +1,573 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2025 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * host.c
+ * Regression tests of the features that are driven by the host application
+ */
+
+#include <surgescript.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* where the test scripts are located */
+#ifndef TEST_DIR
+#define TEST_DIR "tests/host"
+#endif
+
+/* settings */
+#define MAX_FRAMES 10000 /* a safety net for scripts that never exit */
+
+/* test cases */
+typedef struct testcase_t testcase_t;
+struct testcase_t
+{
+    const char* name;
+    bool (*run)();
+};
+
+static bool test_parallel();
+static bool test_console();
+static bool test_snapshot();
+static bool test_reload();
+static bool test_transforms();
+
+static const testcase_t TESTCASE[] = {
+    { "parallel", test_parallel },
+    { "console", test_console },
+    { "snapshot", test_snapshot },
+    { "reload", test_reload },
+    { "transforms", test_transforms },
+    { NULL, NULL }
+};
+
+/* helpers */
+static surgescript_vm_t* create_vm(const char* script);
+static char* read_script(const char* script);
+static void replace_text(char* code, const char* text, const char* new_text);
+static int run_vm(surgescript_vm_t* vm, int max_frames);
+static void fail(const char* message);
+static void crash(const char* message);
+static void discard(const char* message);
+static void console_output(const char* text, size_t length, void* user_data);
+static void console_crash(const char* message, void* context);
+static void console_collect(const char* text, size_t length, void* user_data);
+static bool same_snapshot(surgescript_vm_t* vm, const void* data, size_t size);
+static bool same_world_transform(const surgescript_object_t* object);
+static bool same_world_transforms(surgescript_object_t* const* object, int count);
+
+/*
+ * main()
+ * Entry point
+ */
+int main(int argc, char* argv[])
+{
+    /* SurgeScript uses UTF-8 */
+    setlocale(LC_ALL, "en_US.UTF-8");
+
+    /* errors are failures */
+    surgescript_util_set_error_functions(discard, crash);
+
+    /* run the requested test case */
+    if(argc == 2) {
+        for(const testcase_t* t = TESTCASE; t->name != NULL; t++) {
+            if(strcmp(t->name, argv[1]) == 0) {
+                if(!t->run())
+                    return 1;
+                printf("%s: passed\n", t->name);
+                return 0;
+            }
+        }
+    }
+
+    /* show usage */
+    fprintf(stderr, "Usage: %s <test>\nAvailable tests:", surgescript_util_basename(argv[0]));
+    for(const testcase_t* t = TESTCASE; t->name != NULL; t++)
+        fprintf(stderr, " %s", t->name);
+    fprintf(stderr, "\n");
+    return 1;
+}
+
+
+
+/*
+ * test cases
+ */
+
+/* isolated subtrees spawn many objects and call Math.random() while
+   being updated in parallel (it works the same without threads) */
+bool test_parallel()
+{
+    surgescript_vm_t* vm = create_vm("parallel.ss");
+    int frames;
+
+    surgescript_vm_set_worker_count(vm, 4);
+    surgescript_vm_launch(vm);
+    frames = run_vm(vm, MAX_FRAMES);
+    surgescript_vm_destroy(vm);
+
+    if(frames >= MAX_FRAMES) {
+        fail("the script didn't exit");
+        return false;
+    }
+
+    return true;
+}
+
+/* the output of the Console is flushed on a line threshold, at the end
+   of the frame and before an error is reported */
+bool test_console()
+{
+    static char output[1024] = "";
+    surgescript_vm_t* vm = create_vm("console.ss");
+
+    surgescript_vm_set_console_output(vm, console_output, output);
+    surgescript_vm_set_console_flush_threshold(vm, 3);
+    surgescript_vm_launch(vm);
+
+    /* the first frame prints 5 lines and flushes on the 3rd line */
+    surgescript_vm_update(vm);
+    if(strcmp(output, "[line 1\nline 2\nline 3\n][line 4\nline 5\nno newline]") != 0) {
+        fail("unexpected output of the Console");
+        return false;
+    }
+
+    /* the second frame crashes; console_crash() checks the output & exits */
+    *output = 0;
+    surgescript_util_set_crash_function(console_crash, output);
+    surgescript_vm_update(vm);
+
+    fail("the script didn't crash");
+    return false;
+}
+/* restoring a snapshot resumes the execution exactly where it was taken;
+   corrupted snapshots and snapshots of different code are rejected without
+   changing the VM */
+bool test_snapshot()
+{
+    static char expected[16384] = "", output[16384] = "";
+    surgescript_vm_t* vm = create_vm("snapshot.ss");
+    char* code = read_script("snapshot.ss");
+    void* data; size_t size;
+    unsigned char* corrupted;
+    bool ok = true;
+
+    /* take a snapshot in the middle of the execution */
+    surgescript_vm_set_console_output(vm, console_collect, expected);
+    surgescript_vm_launch(vm);
+    run_vm(vm, 10);
+    data = surgescript_vm_snapshot(vm, &size);
+    if(data == NULL)
+        crash("Can't take a snapshot");
+
+    /* truncated and corrupted snapshots are rejected */
+    corrupted = malloc(size);
+    memcpy(corrupted, data, size);
+    if(surgescript_vm_restore(vm, corrupted, size - 1) || surgescript_vm_restore(vm, corrupted, size / 2)) {
+        fail("a truncated snapshot was restored");
+        ok = false;
+    }
+
+    corrupted[size / 2] ^= 0x40;
+    if(surgescript_vm_restore(vm, corrupted, size)) {
+        fail("a corrupted snapshot was restored");
+        ok = false;
+    }
+
+    free(corrupted);
+    if(!same_snapshot(vm, data, size)) {
+        fail("a rejected snapshot changed the VM");
+        ok = false;
+    }
+
+    /* run the script until it exits */
+    *expected = 0;
+    if(run_vm(vm, MAX_FRAMES) >= MAX_FRAMES) {
+        fail("the script didn't exit");
+        ok = false;
+    }
+    surgescript_vm_destroy(vm);
+
+    /* restore the snapshot in another VM and compare the output */
+    vm = create_vm("snapshot.ss");
+    surgescript_vm_set_console_output(vm, console_collect, output);
+    surgescript_vm_launch(vm);
+    run_vm(vm, 3);
+    if(!surgescript_vm_restore(vm, data, size)) {
+        fail("can't restore a snapshot");
+        ok = false;
+    }
+    else if(!same_snapshot(vm, data, size)) {
+        fail("the restored state doesn't match the snapshot");
+        ok = false;
+    }
+
+    *output = 0;
+    run_vm(vm, MAX_FRAMES);
+    if(strcmp(output, expected) != 0) {
+        fail("the restored VM didn't resume the execution");
+        ok = false;
+    }
+    surgescript_vm_destroy(vm);
+
+    /* a snapshot of different code is rejected */
+    replace_text(code, "version = 1", "version = 2");
+
+    vm = surgescript_vm_create();
+    if(!surgescript_vm_compile_virtual_file(vm, code, "snapshot.ss"))
+        crash("Can't compile the test script");
+    surgescript_vm_set_console_output(vm, console_collect, output);
+    surgescript_vm_launch(vm);
+    run_vm(vm, 10);
+    ssfree(data);
+    data = surgescript_vm_snapshot(vm, &size);
+    surgescript_vm_destroy(vm);
+
+    vm = create_vm("snapshot.ss");
+    surgescript_vm_set_console_output(vm, console_collect, output);
+    surgescript_vm_launch(vm);
+    if(surgescript_vm_restore(vm, data, size)) {
+        fail("a snapshot of different code was restored");
+        ok = false;
+    }
+    surgescript_vm_destroy(vm);
+
+    /* done */
+    ssfree(data);
+    free(code);
+    return ok;
+}
+
+/* reloading a script restarts the current state of the objects whose code
+   has changed; other objects keep their suspended states */
+bool test_reload()
+{
+    static char output[16384] = "";
+    surgescript_vm_t* vm = surgescript_vm_create();
+    char* code = read_script("reload.ss");
+    bool ok = true;
+
+    if(!surgescript_vm_compile_virtual_file(vm, code, "reload.ss"))
+        crash("Can't compile the test script");
+
+    surgescript_vm_set_console_output(vm, console_collect, output);
+    surgescript_vm_launch(vm);
+    run_vm(vm, 3);
+
+    /* change the code of the Application only */
+    *output = 0;
+    replace_text(code, "\"app \"", "\"APP \"");
+    if(!surgescript_vm_reload_virtual_file(vm, code, "reload.ss"))
+        crash("Can't reload the test script");
+
+    surgescript_vm_update(vm);
+    if(strcmp(output, "APP 4\nwaiter 4\n") != 0) {
+        fail("reloading restarted an object whose code didn't change");
+        ok = false;
+    }
+
+    /* change the code of the Waiter */
+    *output = 0;
+    replace_text(code, "\"waiter \"", "\"WAITER \"");
+    if(!surgescript_vm_reload_virtual_file(vm, code, "reload.ss"))
+        crash("Can't reload the test script");
+
+    surgescript_vm_update(vm);
+    if(strcmp(output, "APP 5\nwaiter start\nWAITER 1\n") != 0) {
+        fail("reloading didn't restart an object whose code changed");
+        ok = false;
+    }
+
+    /* done */
+    if(run_vm(vm, MAX_FRAMES) >= MAX_FRAMES) {
+        fail("the script didn't exit");
+        ok = false;
+    }
+
+    surgescript_vm_destroy(vm);
+    free(code);
+    return ok;
+}
+
+/* the world transforms of the objects are cached. Changing the transform
+   of an ancestor, or the ancestors themselves, must invalidate the caches
+   of the descendants */
+bool test_transforms()
+{
+    surgescript_vm_t* vm = create_vm("transforms.ss");
+    surgescript_object_t *arm, *hand, *finger, *other;
+    surgescript_transform_t* transform;
+    bool ok = true;
+
+    surgescript_vm_launch(vm);
+    surgescript_vm_update(vm);
+
+    arm = surgescript_vm_find_object(vm, "Arm");
+    hand = surgescript_vm_find_object(vm, "Hand");
+    finger = surgescript_vm_find_object(vm, "Finger");
+    other = surgescript_vm_find_object(vm, "Other");
+    surgescript_object_t* const object[] = { arm, hand, finger, other };
+    const int count = sizeof(object) / sizeof(object[0]);
+
+    /* the world transforms are computed and cached */
+    surgescript_transform_setposition2d(surgescript_object_transform(arm), 10.0f, 20.0f);
+    surgescript_transform_setrotation2d(surgescript_object_transform(arm), 30.0f);
+    surgescript_transform_setposition2d(surgescript_object_transform(hand), 5.0f, 0.0f);
+    surgescript_transform_setscale2d(surgescript_object_transform(hand), 2.0f, 0.5f);
+    surgescript_transform_setposition2d(surgescript_object_transform(finger), 1.0f, 1.0f);
+    surgescript_transform_setrotation2d(surgescript_object_transform(finger), 45.0f);
+    if(!same_world_transforms(object, count)) {
+        fail("wrong world transforms");
+        ok = false;
+    }
+
+    /* setters through the inner pointer */
+    transform = surgescript_object_transform(arm);
+    surgescript_transform_translate2d(transform, -4.0f, 3.0f);
+    surgescript_transform_rotate2d(transform, 100.0f);
+    surgescript_transform_scale2d(transform, 1.5f, 1.5f);
+    if(!same_world_transforms(object, count)) {
+        fail("changing a transform through its inner pointer didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* poke transform */
+    transform = surgescript_transform_create();
+    surgescript_object_peek_transform(hand, transform);
+    surgescript_transform_setposition2d(transform, -7.0f, 2.0f);
+    surgescript_transform_setrotation2d(transform, 300.0f);
+    surgescript_object_poke_transform(hand, transform);
+    surgescript_transform_destroy(transform);
+    if(!same_world_transforms(object, count)) {
+        fail("poking a transform didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* world setters */
+    surgescript_transform_util_setworldposition2d(arm, 50.0f, -25.0f);
+    if(!same_world_transforms(object, count)) {
+        fail("setting a world position didn't invalidate the caches");
+        ok = false;
+    }
+
+    surgescript_transform_util_setworldangle2d(hand, 200.0f);
+    if(!same_world_transforms(object, count)) {
+        fail("setting a world angle didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* reparent */
+    surgescript_transform_setposition2d(surgescript_object_transform(other), 100.0f, 100.0f);
+    surgescript_transform_setrotation2d(surgescript_object_transform(other), 90.0f);
+    same_world_transforms(object, count);
+    surgescript_object_reparent(hand, surgescript_object_handle(other), 0);
+    if(!same_world_transforms(object, count)) {
+        fail("reparenting an object didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* look at */
+    surgescript_transform_util_lookat2d(other, -30.0f, 60.0f);
+    if(!same_world_transforms(object, count)) {
+        fail("looking at a point didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* inverted y-axis */
+    surgescript_transform_use_inverted_y(true);
+    if(!same_world_transforms(object, count)) {
+        fail("inverting the y-axis didn't invalidate the caches");
+        ok = false;
+    }
+
+    surgescript_transform_use_inverted_y(false);
+    if(!same_world_transforms(object, count)) {
+        fail("restoring the y-axis didn't invalidate the caches");
+        ok = false;
+    }
+
+    /* done */
+    surgescript_vm_destroy(vm);
+    return ok;
+}
+
+
+
+/*
+ * helpers
+ */
+
+/* reads a test script into a new buffer (free it with free()) */
+char* read_script(const char* script)
+{
+    char filepath[4096];
+    char* code = NULL;
+    long length;
+    FILE* fp;
+
+    snprintf(filepath, sizeof(filepath), "%s/%s", TEST_DIR, script);
+    if(NULL == (fp = fopen(filepath, "rb")))
+        crash("Can't open the test script");
+
+    fseek(fp, 0, SEEK_END);
+    length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    code = malloc(length + 1);
+    code[fread(code, 1, length, fp)] = 0;
+    fclose(fp);
+
+    return code;
+}
+
+/* replaces the first occurrence of text in a test script by new_text of the same length */
+void replace_text(char* code, const char* text, const char* new_text)
+{
+    char* p = strstr(code, text);
+
+    if(p == NULL || strlen(text) != strlen(new_text))
+        crash("Can't change the test script");
+
+    memcpy(p, new_text, strlen(new_text));
+}
+
+/* creates a VM and compiles a test script */
+surgescript_vm_t* create_vm(const char* script)
+{
+    surgescript_vm_t* vm = surgescript_vm_create();
+    char filepath[4096];
+
+    snprintf(filepath, sizeof(filepath), "%s/%s", TEST_DIR, script);
+    if(!surgescript_vm_compile(vm, filepath))
+        crash("Can't compile the test script");
+
+    return vm;
+}
+
+/* updates the VM until it exits or until max_frames frames have passed */
+int run_vm(surgescript_vm_t* vm, int max_frames)
+{
+    int frames = 0;
+
+    while(frames < max_frames && surgescript_vm_update(vm))
+        frames++;
+
+    return frames;
+}
+
+/* reports a failure */
+void fail(const char* message)
+{
+    fprintf(stderr, "[surgescript-error] Test failed: %s\n", message);
+}
+
+/* errors are failures */
+void crash(const char* message)
+{
+    fail(message);
+    exit(1);
+}
+
+/* discard log messages */
+void discard(const char* message)
+{
+    ;
+}
+
+/* collects the output of the Console, delimiting each flush with [] */
+void console_output(const char* text, size_t length, void* user_data)
+{
+    char* output = (char*)user_data;
+    size_t n = strlen(output);
+
+    if(n + length + 3 <= 1024) {
+        output[n++] = '[';
+        memcpy(output + n, text, length);
+        strcpy(output + n + length, "]");
+    }
+}
+
+/* the buffered output is flushed before the error is reported */
+void console_crash(const char* message, void* context)
+{
+    const char* output = (const char*)context;
+
+    if(strcmp(output, "[last words\n]") != 0)
+        crash("the output of the Console was lost on error");
+
+    printf("console: passed\n");
+    exit(0);
+}
+
+/* collects the output of the Console */
+void console_collect(const char* text, size_t length, void* user_data)
+{
+    char* output = (char*)user_data;
+    size_t n = strlen(output);
+
+    if(n + length < 16384) {
+        memcpy(output + n, text, length);
+        output[n + length] = 0;
+    }
+}
+
+/* checks if a snapshot of the VM matches the given data */
+bool same_snapshot(surgescript_vm_t* vm, const void* data, size_t size)
+{
+    size_t other_size = 0;
+    void* other_data = surgescript_vm_snapshot(vm, &other_size);
+    bool same = (other_data != NULL && other_size == size && memcmp(other_data, data, size) == 0);
+
+    ssfree(other_data);
+    return same;
+}
+
+/* compares the (cached) world transform of an object with one that is
+   computed by walking the local transforms of its ascendants */
+bool same_world_transform(const surgescript_object_t* object)
+{
+    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    surgescript_objecthandle_t root = surgescript_objectmanager_root(manager);
+    surgescript_transform_t* transform = surgescript_transform_create();
+    float x, y, angle, expected_x = 0.0f, expected_y = 0.0f, expected_angle = 0.0f;
+
+    surgescript_transform_util_worldposition2d(object, &x, &y);
+    angle = surgescript_transform_util_worldangle2d(object);
+
+    for(const surgescript_object_t* o = object; surgescript_object_handle(o) != root; o = surgescript_objectmanager_get(manager, surgescript_object_parent(o))) {
+        surgescript_object_peek_transform(o, transform);
+        surgescript_transform_apply2d(transform, &expected_x, &expected_y);
+        expected_angle += surgescript_transform_getrotation2d(transform);
+    }
+
+    surgescript_transform_destroy(transform);
+    return fabsf(x - expected_x) < 0.01f && fabsf(y - expected_y) < 0.01f &&
+           fabsf(remainderf(angle - expected_angle, 360.0f)) < 0.01f;
+}
+
+/* checks the world transforms of the given objects */
+bool same_world_transforms(surgescript_object_t* const* object, int count)
+{
+    bool same = true;
+
+    for(int i = 0; i < count; i++)
+        same = same_world_transform(object[i]) && same;
+
+    return same;
+}